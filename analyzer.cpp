@@ -54,6 +54,8 @@
 #include <sstream>
 #include <math.h>
 #include <cmath>
+#include <mutex>
+#include <string.h>
 
 //ROOT Includes
 #include "TRandom.h"
@@ -68,158 +70,172 @@
 #include "TPaveText.h"
 #include "TGraph.h"
 #include "TCanvas.h"
+#include "TDirectory.h"
+#include "TROOT.h"
+#ifdef Make_Removed_Spectra
+#include "TRandom3.h"
+#endif
 
 using namespace std;
 
 stringstream amsg;
 
+//The events, histograms and the state carried from event to event are thread_local.  In the Pipeline the analysis thread, or each of
+//the Analysis_Threads analysis workers, fills its own histograms (made by Create_Analyzer_Worker_Histograms), and they are added into
+//the ones of the main thread by Merge_Analyzer_Histograms at the end
+
 //Events
-DANCE_Event devent;      //DANCE Event
-DANCE_Event devent2;     //Second DANCE Event for processing removed spectra
-U235_Event u235event;    //U235 Event
-He3_Event he3event;      //He3 Event
-Li6_Event li6event;      //Li6 Event
-Bkg_Event bkgevent;      //Background Monitor Event
+thread_local DANCE_Event devent;      //DANCE Event
+thread_local DANCE_Event devent2;     //Second DANCE Event for processing removed spectra
+thread_local U235_Event u235event;    //U235 Event
+thread_local He3_Event he3event;      //He3 Event
+thread_local Li6_Event li6event;      //Li6 Event
+thread_local Bkg_Event bkgevent;      //Background Monitor Event
+
+#ifdef Make_Removed_Spectra
+//Picks the gamma rays thrown away.  The calibrator uses gRandom, and with Pipeline on it runs on another thread
+thread_local TRandom3 removed_random;
+#endif
 
 //Histograms
-TH2D *hCoinCAEN;                      //coincidence matrix
+thread_local TH2D *hCoinCAEN;                      //coincidence matrix
 
 //Time Diagnostics
-TH1D *hEventLength;                   //length in ns of the event (diagnostic)
-TH2D *hEventLength_Etot;              //ESum vs Event Legnth
-TH2D *hEventLength_MCr;              //Mcr vs Event Legnth
-TH2D *hEventTimeDist_Etot;              //ESum vs Event Legnth
-
-TH1D *hTimeBetweenDEvents;            //time between subsequent DANCE events (ns)
-TH3D *hTimeBetweenDEvents_ESum_Mcr;   //DANCE ESum vs time between subsequent DANCE events for Mcr==1
-TH1D *hTimeBetweenT0s;                //time between T0s (ns)
-TH2D *hCrystalIDvsTOF;                //TOF for each crystal 
-TH1D *hCrystalTOF;                    //TOF for all crytals
-TH2D *hCrystalIDvsTOF_Corr;           //Corrected TOF for each crystal 
-TH1D *hCrystalTOF_Corr; //TOF for all crytals
-TH1D *hDANCE_Entries_per_T0;
-TH1D *hDANCE_Events_per_T0;
+thread_local TH1D *hEventLength;                   //length in ns of the event (diagnostic)
+thread_local TH2D *hEventLength_Etot;              //ESum vs Event Legnth
+thread_local TH2D *hEventLength_MCr;              //Mcr vs Event Legnth
+thread_local TH2D *hEventTimeDist_Etot;              //ESum vs Event Legnth
+
+thread_local TH1D *hTimeBetweenDEvents;            //time between subsequent DANCE events (ns)
+thread_local TH3D *hTimeBetweenDEvents_ESum_Mcr;   //DANCE ESum vs time between subsequent DANCE events for Mcr==1
+thread_local TH1D *hTimeBetweenT0s;                //time between T0s (ns)
+thread_local TH2D *hCrystalIDvsTOF;                //TOF for each crystal 
+thread_local TH1D *hCrystalTOF;                    //TOF for all crytals
+thread_local TH2D *hCrystalIDvsTOF_Corr;           //Corrected TOF for each crystal 
+thread_local TH1D *hCrystalTOF_Corr; //TOF for all crytals
+thread_local TH1D *hDANCE_Entries_per_T0;
+thread_local TH1D *hDANCE_Events_per_T0;
 
 //Time Deviations
-TH2D *hTimeDev_Rel0;  //Time deviations of all crystals to crystal 0
-TH2D *hTimeDev;  //Time deviations relative to adjacent crystals
+thread_local TH2D *hTimeDev_Rel0;  //Time deviations of all crystals to crystal 0
+thread_local TH2D *hTimeDev;  //Time deviations relative to adjacent crystals
 
 
 //Physics Spectra
-TH1D *hEn;                   //Neutron Energy from dance events
-TH1D *hTOF;                  //TOF for dance events
-TH2D *hTOF_Mcl;              //MCl vs TOF from dance events
+thread_local TH1D *hEn;                   //Neutron Energy from dance events
+thread_local TH1D *hTOF;                  //TOF for dance events
+thread_local TH2D *hTOF_Mcl;              //MCl vs TOF from dance events
 
-TH1D *hEn_Corr;              //Neutron Energy from dance events
-TH1D *hCrystal_En_Corr;      //Neutron Energy from each crystal dance events
-TH2D *hECrystal_En_Corr;      //Neutron Energy from each crystal dance events
-TH1D *hTOF_Corr;             //TOF for dance events
-TH2D *hTOF_Mcl_Corr;         //MCl vs TOF for dance events
+thread_local TH1D *hEn_Corr;              //Neutron Energy from dance events
+thread_local TH1D *hCrystal_En_Corr;      //Neutron Energy from each crystal dance events
+thread_local TH2D *hECrystal_En_Corr;      //Neutron Energy from each crystal dance events
+thread_local TH1D *hTOF_Corr;             //TOF for dance events
+thread_local TH2D *hTOF_Mcl_Corr;         //MCl vs TOF for dance events
 
 
-TH2D *hGamma_Mcr1;
-TH2D *hGammaCalib_Mcr1;
-TH2D* hGammaCalib_Mcr2_late;
-TH2D* hGammaCalib_Mcr1_late;
+thread_local TH2D *hGamma_Mcr1;
+thread_local TH2D *hGammaCalib_Mcr1;
+thread_local TH2D* hGammaCalib_Mcr2_late;
+thread_local TH2D* hGammaCalib_Mcr1_late;
 
-TH2D* ID_TOF;
+thread_local TH2D* ID_TOF;
 
 // QGated spectra
-TH3F *En_Ecl_Mcl_QGated[10]; //Max is 10 QGates. 
-TH3F *En_Ecr_Mcr_QGated[10]; //Max is 10 QGates. 
-TH3F *ID_Ecr_Mcr_QGated[10]; //Max is 10 QGates. 
-TH2D *hTOF_Mcl_QGated[10];
+thread_local TH3F *En_Ecl_Mcl_QGated[10]; //Max is 10 QGates. 
+thread_local TH3F *En_Ecr_Mcr_QGated[10]; //Max is 10 QGates. 
+thread_local TH3F *ID_Ecr_Mcr_QGated[10]; //Max is 10 QGates. 
+thread_local TH2D *hTOF_Mcl_QGated[10];
 
 
 
 
 //Isomer spectra
-TH1D *hIsomer_Prompt[10];   //Prompt singles TOF spectrum
-TH1D *hIsomer_Delayed[10];  //Delayed singles TOF spectrum
-TH1D *hIsomer_TDiff[10];    //Delayed - Prompt spectrum
-vector<double> Isomer_Prompt[10]; //Storage for Prompt TOFs
-vector<double> Isomer_Delayed[10]; //Storage for Delayed TOFs
+thread_local TH1D *hIsomer_Prompt[10];   //Prompt singles TOF spectrum
+thread_local TH1D *hIsomer_Delayed[10];  //Delayed singles TOF spectrum
+thread_local TH1D *hIsomer_TDiff[10];    //Delayed - Prompt spectrum
+thread_local vector<double> Isomer_Prompt[10]; //Storage for Prompt TOFs
+thread_local vector<double> Isomer_Delayed[10]; //Storage for Delayed TOFs
 
 //3D Histograms
-TH3F *En_Esum_Mcl;
-TH3F *En_Esum_Mcr;
-TH3F *En_Esum_Mcr_Pileup;
-TH3F *En_Esum_Mcr_NoPileup;
+thread_local TH3F *En_Esum_Mcl;
+thread_local TH3F *En_Esum_Mcr;
+thread_local TH3F *En_Esum_Mcr_Pileup;
+thread_local TH3F *En_Esum_Mcr_NoPileup;
 
-TH3F *hTOF_Esum_Mcl;
-TH3F *hTOF_Esum_Mcr;
+thread_local TH3F *hTOF_Esum_Mcl;
+thread_local TH3F *hTOF_Esum_Mcr;
 
-TH3F *hTOF_Esum_Mcr_Removed[Max_Gamma_Removed];
-TH3F *hEn_Esum_Mcr_Removed[Max_Gamma_Removed];
+thread_local TH3F *hTOF_Esum_Mcr_Removed[Max_Gamma_Removed];
+thread_local TH3F *hEn_Esum_Mcr_Removed[Max_Gamma_Removed];
 
-TH3F *En_Ecr1_Ecr2_mcr2;
-TH2F *En_Ecr1_mcr1;
+thread_local TH3F *En_Ecr1_Ecr2_mcr2;
+thread_local TH2F *En_Ecr1_mcr1;
 
-TH3F *hEn_TimeBetweenCrystals_Mcr;  // En vs time between subsequent hits of the same crystal (ns) vs mcr
+thread_local TH3F *hEn_TimeBetweenCrystals_Mcr;  // En vs time between subsequent hits of the same crystal (ns) vs mcr
 
-TH3F *hEn_Eg_Mcr;
+thread_local TH3F *hEn_Eg_Mcr;
 
 //Beam Monitors
 //U235 Monitor
-TH1D *hU235_TOF;  //Raw TOF for U235 Monitor
-TH1D *hU235_TOF_Corr; //Corrected TOF for U235 Monitor
-TH2D *hU235_PH_TOF;
-TH1D *hU235_PulseHeight;  //Energy for U235 Monitor
-TH1D *hU235_En;  //Neutron Energy for U235 Monitor 
-TH1D *hU235_En_Corr;  //Neutron Energy for U235 Monitor (From Corrected TOF)
-TH1D *hU235_Time_Between_Events; //Time between U235 hits
+thread_local TH1D *hU235_TOF;  //Raw TOF for U235 Monitor
+thread_local TH1D *hU235_TOF_Corr; //Corrected TOF for U235 Monitor
+thread_local TH2D *hU235_PH_TOF;
+thread_local TH1D *hU235_PulseHeight;  //Energy for U235 Monitor
+thread_local TH1D *hU235_En;  //Neutron Energy for U235 Monitor 
+thread_local TH1D *hU235_En_Corr;  //Neutron Energy for U235 Monitor (From Corrected TOF)
+thread_local TH1D *hU235_Time_Between_Events; //Time between U235 hits
 
 //Li6 Monitor
-TH1D *hLi6_TOF;  //Raw TOF for Li6 Monitor
-TH1D *hLi6_TOF_Corr; //Corrected TOF for Li6 Monitor
-TH1D *hLi6_PulseHeight;  //Energy for Li6 Monitor
-TH1D *hLi6_En;  //Neutron Energy for Li6 Monitor 
-TH1D *hLi6_En_Corr;  //Neutron Energy for Li6 Monitor (From Corrected TOF)
-TH2D *hLi6_PSD; 
-TH1D *hLi6_Time_Between_Events; //Time between Li6 hits
+thread_local TH1D *hLi6_TOF;  //Raw TOF for Li6 Monitor
+thread_local TH1D *hLi6_TOF_Corr; //Corrected TOF for Li6 Monitor
+thread_local TH1D *hLi6_PulseHeight;  //Energy for Li6 Monitor
+thread_local TH1D *hLi6_En;  //Neutron Energy for Li6 Monitor 
+thread_local TH1D *hLi6_En_Corr;  //Neutron Energy for Li6 Monitor (From Corrected TOF)
+thread_local TH2D *hLi6_PSD; 
+thread_local TH1D *hLi6_Time_Between_Events; //Time between Li6 hits
 
 //Background Monitor
-TH1D *hBkg_TOF;  //Raw TOF for Bkg Monitor
-TH1D *hBkg_TOF_Corr; //Corrected TOF for Bkg Monitor
-TH1D *hBkg_PulseHeight;  //Energy for Bkg Monitor
-TH1D *hBkg_En;  //Neutron Energy for Bkg Monitor 
-TH1D *hBkg_En_Corr;  //Neutron Energy for Bkg Monitor (From Corrected TOF)
-TH2D *hBkg_PSD; 
-TH1D *hBkg_Time_Between_Events; //Time between Bkg hits
+thread_local TH1D *hBkg_TOF;  //Raw TOF for Bkg Monitor
+thread_local TH1D *hBkg_TOF_Corr; //Corrected TOF for Bkg Monitor
+thread_local TH1D *hBkg_PulseHeight;  //Energy for Bkg Monitor
+thread_local TH1D *hBkg_En;  //Neutron Energy for Bkg Monitor 
+thread_local TH1D *hBkg_En_Corr;  //Neutron Energy for Bkg Monitor (From Corrected TOF)
+thread_local TH2D *hBkg_PSD; 
+thread_local TH1D *hBkg_Time_Between_Events; //Time between Bkg hits
 
 //He3 Monitor
-TH1D *hHe3_TOF;  //Raw TOF for He3 Monitor
-TH1D *hHe3_TOF_Corr; //Corrected TOF for He3 Monitor
-TH1D *hHe3_PulseHeight;  //Energy for He3 Monitor
-TH1D *hHe3_En;  //Neutron Energy for He3 Monitor 
-TH1D *hHe3_En_Corr;  //Neutron Energy for He3 Monitor (From Corrected TOF)
-TH1D *hHe3_Time_Between_Events; //Time between He3 hits
+thread_local TH1D *hHe3_TOF;  //Raw TOF for He3 Monitor
+thread_local TH1D *hHe3_TOF_Corr; //Corrected TOF for He3 Monitor
+thread_local TH1D *hHe3_PulseHeight;  //Energy for He3 Monitor
+thread_local TH1D *hHe3_En;  //Neutron Energy for He3 Monitor 
+thread_local TH1D *hHe3_En_Corr;  //Neutron Energy for He3 Monitor (From Corrected TOF)
+thread_local TH1D *hHe3_Time_Between_Events; //Time between He3 hits
 
 // JU Histograms
-TH1F *hU235_TOF_gated;
-TH1F *hU235_TOF_long_gated;
-TH1F *hLi6_TOF_gated;
-TH1F *hLi6_TOF_long_gated;
-TH1F *hHe3_TOF_gated;
-TH1F *hHe3_TOF_long_gated;
-TH1F *tof;
-TH1F *tof_gated_QM;
-TH1F *tof_gated_BM;
-TH1F *tof_gated_QM_long;
-TH1F *tof_gated_BM_long;
-TH1D *esum;	// These esum histos included for convenience
-TH1D *esum2;	// they are redundant - could project from 3D
-TH1D *esum3;
-TH1D *esum4;
-TH1D *esum5;
-
-TH2D* hGamma_Mcr2_1stex;
-TH2D* hGammaCalib_Mcr2_1stex;
+thread_local TH1F *hU235_TOF_gated;
+thread_local TH1F *hU235_TOF_long_gated;
+thread_local TH1F *hLi6_TOF_gated;
+thread_local TH1F *hLi6_TOF_long_gated;
+thread_local TH1F *hHe3_TOF_gated;
+thread_local TH1F *hHe3_TOF_long_gated;
+thread_local TH1F *tof;
+thread_local TH1F *tof_gated_QM;
+thread_local TH1F *tof_gated_BM;
+thread_local TH1F *tof_gated_QM_long;
+thread_local TH1F *tof_gated_BM_long;
+thread_local TH1D *esum;	// These esum histos included for convenience
+thread_local TH1D *esum2;	// they are redundant - could project from 3D
+thread_local TH1D *esum3;
+thread_local TH1D *esum4;
+thread_local TH1D *esum5;
+
+thread_local TH2D* hGamma_Mcr2_1stex;
+thread_local TH2D* hGammaCalib_Mcr2_1stex;
 
 // HighRateDebug histos
-TH1F* hID_resonancegated;
-TH1F* hID_backgroundgated;
-TH2F* ISlow_ID_mcr2;
+thread_local TH1F* hID_resonancegated;
+thread_local TH1F* hID_backgroundgated;
+thread_local TH2F* ISlow_ID_mcr2;
 //TH2F* En_ID;
 
 
@@ -242,21 +258,21 @@ double *angleBin_edges = new double[NAngleBins + 1];
 const int maxNEnResGates_Ang = 20; // max En resonance gates allowed in cfg file
 
 //En gated Angular Analysis histograms
-TH2D* ngAngle_Esum_byMult_EnGated[maxNEnResGates_Ang][maxMultiplicity]; //Esum vs angle
+thread_local TH2D* ngAngle_Esum_byMult_EnGated[maxNEnResGates_Ang][maxMultiplicity]; //Esum vs angle
 //TGraph* T_ngAngle_Esum_byMult_EnGated[maxNEnResGates_Ang][maxMultiplicity]; //Esum vs angle
 
-TH2D* ggAngle_Esum_Mcl2_maxEcr_EnGated[maxNEnResGates_Ang]; // Esum vs angle
+thread_local TH2D* ggAngle_Esum_Mcl2_maxEcr_EnGated[maxNEnResGates_Ang]; // Esum vs angle
 //TGraph* T_ggAngle_Esum_Mcl2_maxEcr_EnGated[maxNEnResGates_Ang]; // Esum vs angle
 
-TH2D* ggAngle_Esum_Mcl2_Mcr2_EnGated[maxNEnResGates_Ang]; // Esum vs angle
+thread_local TH2D* ggAngle_Esum_Mcl2_Mcr2_EnGated[maxNEnResGates_Ang]; // Esum vs angle
 //TGraph* T_ggAngle_Esum_Mcl2_Mcr2_EnGated[maxNEnResGates_Ang]; // Esum vs angle
 
 //TH3D* ngAngle_Esum_allMult_EnGated[maxNEnResGates_Ang]; //multiplicity vs Esum vs angle
 
-TH2D* ngAngle_Ecr_byMult_EnGated[maxNEnResGates_Ang][maxMultiplicity]; //Ecr vs angle
-TH2D* ngAngle_Ecl_byMult_EnGated[maxNEnResGates_Ang][maxMultiplicity]; //Ecl vs angle
+thread_local TH2D* ngAngle_Ecr_byMult_EnGated[maxNEnResGates_Ang][maxMultiplicity]; //Ecr vs angle
+thread_local TH2D* ngAngle_Ecl_byMult_EnGated[maxNEnResGates_Ang][maxMultiplicity]; //Ecl vs angle
 
-TH1I* hClusterSize = nullptr;
+thread_local TH1I* hClusterSize = nullptr;
 
 double theta[162] = {90. , 99.6795 , 105.786 , 90 , 74.2137 , 80.3205 , 90. , 108.001 , 117.284 , 120.001 , 106.458 , 90 , 73.5423 , 59.9987 , 62.716 , 71.9993 , 97.41 , 115.379 , 125.971 , 131.842 , 133.908 , 119.471 , 106.458 , 90 , 73.5423 , 60.529 , 46.0923 , 48.1581 , 54.0294 , 64.6209 , 82.59 , 89.9979 , 105.097 , 121.719 , 134.479 , 144.002 , 149.499 , 148.287 , 133.907 , 120.003 , 105.786 , 90 , 74.2137 , 60.0005 , 46.0934 , 31.7134 , 30.501 , 35.9954 , 45.5211 , 58.281 , 74.9026 , 97.4085 , 115.378 , 134.478 , 150.535 , 161.868 , 164.908 , 149.496 , 131.839 , 117.284 , 99.6795 , 80.3205 , 62.716 , 48.1612 , 30.5037 , 15.0917 , 18.1315 , 29.4654 , 45.5223 , 64.6224 , 82.5915 , 90 , 107.998 , 125.968 , 143.998 , 161.864 , 180 , 161.864 , 144.002 , 125.968 , 108.002 , 90 , 72.0019 , 54.0322 , 36.0019 , 18.1361 , 0 , 18.1361 , 35.9981 , 54.0322 , 71.9981 , 99.6795 , 117.284 , 131.839 , 149.496 , 164.908 , 161.868 , 150.535 , 134.478 , 115.378 , 97.4085 , 82.5915 , 64.6224 , 45.5223 , 29.4654 , 18.1315 , 15.0918 , 30.5037 , 48.1612 , 62.716 , 80.3205 , 90 , 105.786 , 120 , 133.907 , 148.287 , 149.499 , 144.005 , 134.479 , 121.719 , 105.097 , 90.0021 , 74.9026 , 58.281 , 45.5211 , 35.9976 , 30.501 , 31.7134 , 46.0935 , 59.9966 , 74.2137 , 90 , 106.458 , 119.471 , 133.908 , 131.842 , 125.971 , 115.379 , 97.41 , 82.59 , 64.6209 , 54.0294 , 48.1581 , 46.0923 , 60.529 , 73.5423 , 90 , 106.458 , 120.001 , 117.284 , 108.001 , 90 , 71.9993 , 62.716 , 59.9987 , 73.5423 , 90 , 105.786 , 99.6795 , 80.3205 , 74.2137 , 90};
 double phi[162] = {0. , 346.422 , 5.27057 , 16.6216 , 5.27057 , 346.422 , 331.184 , 333.434 , 350.352 , 10.8129 , 23.9913 , 31.7189 , 23.9913 , 10.8129 , 350.352 , 333.434 , 318.313 , 319.236 , 336.211 , 353.747 , 18.2257 , 31.7205 , 39.4487 , 46.8184 , 39.4487 , 31.7205 , 18.2257 , 353.747 , 336.211 , 319.236 , 318.313 , 301.713 , 301.713 , 301.712 , 315.341 , 333.428 , 359.312 , 31.7231 , 45.2171 , 52.6262 , 58.1694 , 63.44 , 58.1694 , 52.6279 , 45.2171 , 31.7231 , 359.312 , 333.434 , 315.341 , 301.712 , 301.713 , 285.113 , 284.188 , 288.081 , 301.709 , 326.181 , 31.7284 , 64.1331 , 69.6945 , 73.0877 , 77.0176 , 77.0176 , 73.0877 , 69.6945 , 64.1331 , 31.7284 , 326.181 , 301.709 , 288.081 , 284.188 , 285.113 , 272.256 , 270 , 267.213 , 270 , 277.264 , 0 , 97.2639 , 90 , 87.2127 , 90 , 92.2556 , 90 , 87.2126 , 90 , 97.2639 , 0 , 277.264 , 270 , 267.213 , 270 , 257.018 , 253.088 , 249.694 , 244.133 , 211.728 , 146.181 , 121.709 , 108.081 , 104.188 , 105.113 , 105.113 , 104.188 , 108.081 , 121.709 , 146.181 , 211.728 , 244.133 , 249.694 , 253.088 , 257.018 , 243.44 , 238.169 , 232.628 , 225.217 , 211.723 , 179.312 , 153.434 , 135.341 , 121.712 , 121.713 , 121.713 , 121.713 , 121.712 , 135.341 , 153.428 , 179.312 , 211.723 , 225.217 , 232.626 , 238.169 , 226.818 , 219.449 , 211.72 , 198.226 , 173.747 , 156.211 , 139.236 , 138.313 , 138.313 , 139.236 , 156.211 , 173.747 , 198.226 , 211.72 , 219.449 , 211.719 , 203.991 , 190.813 , 170.352 , 153.434 , 151.184 , 153.434 , 170.352 , 190.813 , 203.991 , 196.622 , 185.271 , 166.422 , 166.422 , 185.271 , 180.0};
@@ -282,12 +298,12 @@ double GetAngle(int det1, int det2, const double theta[], const double phi[]) {
 
 
 /* VARIABLES */
-double last_timestamp_devent[256];        //This keeps track of the last timestamp valid or not
-double last_energy_devent[256];           //This keeps track of the last timestamp valid or not
+thread_local int64_t last_timestamp_devent[256];       //This keeps track of the last timestamp valid or not (time ticks)
+thread_local double last_energy_devent[256];           //This keeps track of the last timestamp valid or not
 
 
-double last_devent_timestamp;       //This keeps track of the last DANCE event timestamp valid or not
-double last_valid_devent_timestamp; //This keeps track of the last DANCE event timestamp that was valid
+thread_local int64_t last_devent_timestamp;       //This keeps track of the last DANCE event timestamp valid or not (time ticks)
+thread_local int64_t last_valid_devent_timestamp; //This keeps track of the last DANCE event timestamp that was valid (time ticks)
 
 //TMatrix Things
 int reftoindex1[200];
@@ -309,11 +325,21 @@ int DetMat7[167];
 
 
 //Diagnostics
-uint32_t T0_Counter=0;
-uint32_t DANCE_Entries_per_T0=0;
-uint32_t DANCE_Events_per_T0=0;
-
-vector<int> removed_crystals;
+thread_local uint32_t T0_Counter=0;
+thread_local uint32_t DANCE_Entries_per_T0=0;
+thread_local uint32_t DANCE_Events_per_T0=0;
+
+thread_local vector<int> removed_crystals;
+
+//Directory the histograms of this thread are made in when there are analysis workers, so every thread has them in the same order
+thread_local TDirectory *analyzer_directory = NULL;
+vector<TDirectory*> worker_directories;   //Directories of the analysis workers, in worker order
+std::mutex worker_mutex;                  //The workers make their histograms one at a time
+vector<TDirectory*> scan_directories;     //Directories of the scanned coincidence windows (NCoincidence_Scan), in window order
+vector<TDirectory*> sweep_directories;    //Directories of the sweep variants (NSweep_Variants), in variant order
+#ifdef Validate_Analysis_Units
+TDirectory *validation_directory = NULL;  //Histograms of every event analyzed in order on the pipeline analysis thread
+#endif
 
 
 
@@ -1131,7 +1157,14 @@ int Initialize_Analyzer(Input_Parameters input_params) {
   }
 
   func_ret = Read_DMatrix();
-  func_ret = Create_Analyzer_Histograms(input_params);
+  if(input_params.Pipeline) {
+    analyzer_directory = gROOT->mkdir("Analyzer");
+    TDirectory::TContext context(analyzer_directory);
+    func_ret = Create_Analyzer_Histograms(input_params);
+  }
+  else {
+    func_ret = Create_Analyzer_Histograms(input_params);
+  }
   
   for(int eye=0; eye<162; eye++) {
     last_timestamp_devent[eye]=0;
@@ -1152,7 +1185,287 @@ int Initialize_Analyzer(Input_Parameters input_params) {
 }
 
 
-int Analyze_Data(std::vector<DEVT_BANK> eventvector, Input_Parameters input_params, Analysis_Parameters *analysis_params) {
+//Histograms of analysis worker number worker, made on the worker thread
+int Create_Analyzer_Worker_Histograms(Input_Parameters input_params, int worker) {
+
+  std::lock_guard<std::mutex> lock(worker_mutex);
+
+  analyzer_directory = gROOT->mkdir(Form("Analyzer_Worker_%d",worker));
+  if((int)worker_directories.size() <= worker) {
+    worker_directories.resize(worker+1, NULL);
+  }
+  worker_directories[worker] = analyzer_directory;
+
+  TDirectory::TContext context(analyzer_directory);
+  return Create_Analyzer_Histograms(input_params);
+}
+
+//Adds the histograms of the analysis workers into the ones of the main thread, one worker after the other, and frees them.  Called on the
+//main thread after the workers are done
+int Merge_Analyzer_Histograms() {
+
+  if(!analyzer_directory) {
+    return 0;
+  }
+
+  for(size_t worker=0; worker<worker_directories.size(); worker++) {
+    if(!worker_directories[worker]) {
+      continue;
+    }
+    TIter next_main(analyzer_directory->GetList());
+    TIter next_worker(worker_directories[worker]->GetList());
+    TObject *main_hist;
+    TObject *worker_hist;
+    while((main_hist = next_main()) && (worker_hist = next_worker())) {
+      if(strcmp(main_hist->GetName(), worker_hist->GetName()) != 0 || !main_hist->InheritsFrom(TH1::Class())) {
+	amsg.str("");
+	amsg<<"Histograms of Analysis Worker "<<worker<<" do not match: "<<worker_hist->GetName()<<" and "<<main_hist->GetName();
+	DANCE_Error("Analyzer",amsg.str());
+	return -1;
+      }
+      ((TH1*)main_hist)->Add((TH1*)worker_hist);
+    }
+    worker_directories[worker]->GetList()->Delete();
+  }
+
+  amsg.str("");
+  amsg<<"Added the Histograms of "<<worker_directories.size()<<" Analysis Threads";
+  DANCE_Success("Analyzer",amsg.str());
+  worker_directories.clear();
+  return 0;
+}
+
+//Histograms of scanned coincidence window number window (from 1), made on the analysis worker of the window.  input_params has the
+//scanned window as its Coincidence_Window
+int Create_Coincidence_Scan_Histograms(Input_Parameters input_params, int window) {
+
+  std::lock_guard<std::mutex> lock(worker_mutex);
+
+  analyzer_directory = gROOT->mkdir(Form("Coincidence_Window_%dns",(int)input_params.Coincidence_Window));
+  if(!analyzer_directory) {
+    amsg.str("");
+    amsg<<"Could not make the directory for Coincidence Window "<<input_params.Coincidence_Window<<" ns (two scanned windows with the same ns?)";
+    DANCE_Error("Analyzer",amsg.str());
+    return -1;
+  }
+  if((int)scan_directories.size() < window) {
+    scan_directories.resize(window, NULL);
+  }
+  scan_directories[window-1] = analyzer_directory;
+
+  TDirectory::TContext context(analyzer_directory);
+  return Create_Analyzer_Histograms(input_params);
+}
+
+//Histograms of sweep variant number variant (from 1), made on the analysis worker of the variant.  input_params has the blocking times
+//and threshold of the variant, which go in the title of the directory
+int Create_Sweep_Variant_Histograms(Input_Parameters input_params, int variant) {
+
+  std::lock_guard<std::mutex> lock(worker_mutex);
+
+  stringstream title;
+  title<<"Crystal_Blocking_Time "<<input_params.Crystal_Blocking_Time<<" ns DEvent_Blocking_Time "<<input_params.DEvent_Blocking_Time;
+  title<<" ns Energy_Threshold "<<input_params.Energy_Threshold<<" MeV HAVE_Threshold "<<input_params.HAVE_Threshold;
+  analyzer_directory = gROOT->mkdir(Form("Sweep_Variant_%d",variant),title.str().c_str());
+  if(!analyzer_directory) {
+    amsg.str("");
+    amsg<<"Could not make the directory for Sweep Variant "<<variant;
+    DANCE_Error("Analyzer",amsg.str());
+    return -1;
+  }
+  if((int)sweep_directories.size() < variant) {
+    sweep_directories.resize(variant, NULL);
+  }
+  sweep_directories[variant-1] = analyzer_directory;
+
+  TDirectory::TContext context(analyzer_directory);
+  return Create_Analyzer_Histograms(input_params);
+}
+
+//Writes the histograms in each of directories into a directory of the root file with the same name and title
+static int Write_Directory_Histograms(TFile *fout, const vector<TDirectory*> &directories) {
+
+  for(size_t eye=0; eye<directories.size(); eye++) {
+    if(!directories[eye]) {
+      continue;
+    }
+    TDirectory *file_directory = fout->mkdir(directories[eye]->GetName(),directories[eye]->GetTitle());
+    if(!file_directory) {
+      amsg.str("");
+      amsg<<"Could not make the directory "<<directories[eye]->GetName()<<" in the root file";
+      DANCE_Error("Analyzer",amsg.str());
+      return -1;
+    }
+    file_directory->cd();
+    TIter next(directories[eye]->GetList());
+    TObject *hist;
+    while((hist = next())) {
+      hist->Write();
+    }
+  }
+  fout->cd();
+  return 0;
+}
+
+//Writes the histograms of each scanned coincidence window into its own directory of the root file
+int Write_Coincidence_Scan_Histograms(TFile *fout) {
+
+  if(Write_Directory_Histograms(fout, scan_directories)) {
+    return -1;
+  }
+  if(scan_directories.size() > 0) {
+    amsg.str("");
+    amsg<<"Wrote the Histograms of "<<scan_directories.size()<<" Scanned Coincidence Windows";
+    DANCE_Success("Analyzer",amsg.str());
+  }
+  return 0;
+}
+
+//Writes the histograms of each sweep variant into its own directory of the root file
+int Write_Sweep_Variant_Histograms(TFile *fout) {
+
+  if(Write_Directory_Histograms(fout, sweep_directories)) {
+    return -1;
+  }
+  if(sweep_directories.size() > 0) {
+    amsg.str("");
+    amsg<<"Wrote the Histograms of "<<sweep_directories.size()<<" Sweep Variants";
+    DANCE_Success("Analyzer",amsg.str());
+  }
+  return 0;
+}
+
+#ifdef Validate_Analysis_Units
+//Histograms the pipeline analysis thread fills from every event in order when there are analysis workers, for Check_Analysis_Units
+int Create_Validation_Histograms(Input_Parameters input_params) {
+
+  std::lock_guard<std::mutex> lock(worker_mutex);
+
+  validation_directory = gROOT->mkdir("Analyzer_Validation");
+  if(!validation_directory) {
+    DANCE_Error("Analyzer","Could not make the directory for the validation of the analysis units");
+    return -1;
+  }
+  analyzer_directory = validation_directory;
+
+  TDirectory::TContext context(validation_directory);
+  return Create_Analyzer_Histograms(input_params);
+}
+
+//Checks every histogram the analysis workers filled (after Merge_Analyzer_Histograms) bin for bin, with the underflow and overflow bins,
+//against the same histogram of one analyzer that had every event in order.  The contents are sums of the same weights added up in a
+//different order, so they only have to agree to Analysis_Units_Tolerance of the content
+int Check_Analysis_Units(Input_Parameters input_params) {
+
+  if(!validation_directory || !analyzer_directory) {
+    return 0;
+  }
+
+  int nhists = 0;
+  int failed_hists = 0;
+  TIter next(validation_directory->GetList());
+  TObject *obj;
+  while((obj = next())) {
+    if(!obj->InheritsFrom(TH1::Class())) {
+      continue;
+    }
+    TH1 *in_order = (TH1*)obj;
+    TH1 *merged = (TH1*)analyzer_directory->GetList()->FindObject(in_order->GetName());
+    nhists++;
+    if(!merged) {
+      amsg.str("");
+      amsg<<"The analysis workers have no histogram "<<in_order->GetName();
+      DANCE_Error("Analyzer",amsg.str());
+      failed_hists++;
+      continue;
+    }
+
+    //Global bins cover every dimension with their underflow and overflow bins
+    int failed_bins = 0;
+    for(int bin=0; bin<in_order->GetNcells(); bin++) {
+      double content = in_order->GetBinContent(bin);
+      if(fabs(merged->GetBinContent(bin) - content) > Analysis_Units_Tolerance*fabs(content)) {
+	failed_bins++;
+      }
+    }
+    if(failed_bins > 0 || merged->GetNcells() != in_order->GetNcells()) {
+      amsg.str("");
+      amsg<<"Histogram "<<in_order->GetName()<<" of the analysis workers differs from one analyzer in "<<failed_bins<<" of "<<in_order->GetNcells()<<" bins";
+      DANCE_Error("Analyzer",amsg.str());
+      failed_hists++;
+    }
+  }
+  validation_directory->GetList()->Delete();
+  validation_directory = NULL;
+
+  amsg.str("");
+  if(failed_hists > 0) {
+    amsg<<failed_hists<<" of "<<nhists<<" Histograms of the analysis workers differ from one analyzer";
+    DANCE_Error("Analyzer",amsg.str());
+    return -1;
+  }
+  amsg<<"All "<<nhists<<" Histograms of the analysis workers match one analyzer bin for bin";
+  DANCE_Success("Analyzer",amsg.str());
+  return 0;
+}
+#endif
+
+void Get_Analyzer_State(Analyzer_State *state) {
+  state->T0_Counter = T0_Counter;
+  state->DANCE_Entries_per_T0 = DANCE_Entries_per_T0;
+  state->DANCE_Events_per_T0 = DANCE_Events_per_T0;
+  state->last_devent_timestamp = last_devent_timestamp;
+  state->last_valid_devent_timestamp = last_valid_devent_timestamp;
+}
+
+//Starts the analyzer of this thread partway through the events.  The isomer TOFs are only kept from one T0 to the next, and the events
+//are only cut up right after a T0 when there are isomer spectra, so there are none to carry over
+void Set_Analyzer_State(const Analyzer_State &state) {
+  T0_Counter = state.T0_Counter;
+  DANCE_Entries_per_T0 = state.DANCE_Entries_per_T0;
+  DANCE_Events_per_T0 = state.DANCE_Events_per_T0;
+  last_devent_timestamp = state.last_devent_timestamp;
+  last_valid_devent_timestamp = state.last_valid_devent_timestamp;
+  for(int isom=0; isom<10; isom++) {
+    Isomer_Prompt[isom].clear();
+    Isomer_Delayed[isom].clear();
+  }
+}
+
+//Brings the state forward over an event the way Analyze_Data does, without analyzing it.  last_T0 is last_timestamp[T0_ID] for the event.
+//This has to follow the DANCE event blocking and the per T0 counts in Analyze_Data
+void Advance_Analyzer_State(const DEVT_BANK *eventvector, size_t nentries, const Input_Parameters &input_params, int64_t last_T0, Analyzer_State *state) {
+
+  bool dance_event = false;
+  int64_t first_timestamp = 0;
+
+  for(size_t eye=0; eye<nentries; eye++) {
+    int id_eye = eventvector[eye].ID;
+    if(id_eye<162 && eventvector[eye].IsGamma == 1 && eventvector[eye].Valid==1) {
+      if(!dance_event) {
+	first_timestamp = eventvector[eye].timestamp;
+	dance_event = true;
+      }
+      state->DANCE_Entries_per_T0++;
+    }
+    if(id_eye==200) {
+      state->DANCE_Entries_per_T0 = 0;
+      state->DANCE_Events_per_T0 = 0;
+      state->T0_Counter++;
+    }
+  }
+
+  if(dance_event && (input_params.Analysis_Stage==1 || input_params.Read_Simulation ==1) && last_T0 > 0) {
+    state->DANCE_Events_per_T0++;
+    if((first_timestamp-state->last_valid_devent_timestamp) >= input_params.DEvent_Blocking_Ticks) {
+      state->last_valid_devent_timestamp = first_timestamp;
+    }
+    state->last_devent_timestamp = first_timestamp;
+  }
+}
+
+
+int Analyze_Data(const DEVT_BANK *eventvector, size_t nentries, const Input_Parameters &input_params, Analysis_Parameters *analysis_params) {
 
 
   int Crystal_Mult=0;
@@ -1177,11 +1490,11 @@ int Analyze_Data(std::vector<DEVT_BANK> eventvector, Input_Parameters input_para
   
  
   //Event length
-  hEventLength->Fill(eventvector[eventvector.size()-1].timestamp-eventvector[0].timestamp);
-  hEventLength_MCr->Fill(eventvector[eventvector.size()-1].timestamp-eventvector[0].timestamp,eventvector.size());
+  hEventLength->Fill(Time_To_ns(eventvector[nentries-1].timestamp-eventvector[0].timestamp));
+  hEventLength_MCr->Fill(Time_To_ns(eventvector[nentries-1].timestamp-eventvector[0].timestamp),nentries);
 
   //Loop over event 
-  for(uint32_t eye=0; eye<eventvector.size(); eye++) {
+  for(uint32_t eye=0; eye<nentries; eye++) {
 
     //Fill ID histogram
     int id_eye=eventvector[eye].ID;
@@ -1190,10 +1503,10 @@ int Analyze_Data(std::vector<DEVT_BANK> eventvector, Input_Parameters input_para
     if(id_eye<162) {
               
       //Coincidences
-      if(eventvector.size() > 1 && eye < (eventvector.size()-1)) {
+      if(nentries > 1 && eye < (nentries-1)) {
 	
 	//start with the next one
-	for(uint32_t jay=eye+1; jay<eventvector.size(); jay++) {
+	for(uint32_t jay=eye+1; jay<nentries; jay++) {
 	  
 	  int id_jay = eventvector[jay].ID;
         
@@ -1201,7 +1514,7 @@ int Analyze_Data(std::vector<DEVT_BANK> eventvector, Input_Parameters input_para
 	  if(id_jay<162 && id_jay>=0) {
 
 	    //time difference between crystal jay and eye
-	    double ddT = eventvector[jay].timestamp - eventvector[eye].timestamp;
+	    double ddT = Time_To_ns(eventvector[jay].timestamp - eventvector[eye].timestamp);
 
 	    //Fill the coincidence matrix
 	    hCoinCAEN->Fill(id_eye,id_jay,1);
@@ -1297,7 +1610,7 @@ int Analyze_Data(std::vector<DEVT_BANK> eventvector, Input_Parameters input_para
       
       //Do some T0 diagnostics
       if(analysis_params->last_timestamp[T0_ID] > 0) {
-	hTimeBetweenT0s->Fill(eventvector[eye].timestamp-analysis_params->last_last_T0);
+	hTimeBetweenT0s->Fill(Time_To_ns(eventvector[eye].timestamp-analysis_params->last_last_T0));
       }
       
       //Fill Histos
@@ -1325,7 +1638,7 @@ int Analyze_Data(std::vector<DEVT_BANK> eventvector, Input_Parameters input_para
       he3event.Valid = 1; //he3 event now valid
 
       //Fill time Diagnostics
-      hHe3_Time_Between_Events->Fill(eventvector[eye].timestamp-analysis_params->last_timestamp[id_eye]);
+      hHe3_Time_Between_Events->Fill(Time_To_ns(eventvector[eye].timestamp-analysis_params->last_timestamp[id_eye]));
     }
     
     //U235
@@ -1339,7 +1652,7 @@ int Analyze_Data(std::vector<DEVT_BANK> eventvector, Input_Parameters input_para
       u235event.Valid = 1; //u235 event now valid
 
       //Fill time Diagnostics
-      hU235_Time_Between_Events->Fill(eventvector[eye].timestamp-analysis_params->last_timestamp[id_eye]);
+      hU235_Time_Between_Events->Fill(Time_To_ns(eventvector[eye].timestamp-analysis_params->last_timestamp[id_eye]));
     }
     
     //Li6
@@ -1353,7 +1666,7 @@ int Analyze_Data(std::vector<DEVT_BANK> eventvector, Input_Parameters input_para
       li6event.Valid = 1; //li6 event now valid
       
       //Fill time Diagnostics
-      hLi6_Time_Between_Events->Fill(eventvector[eye].timestamp-analysis_params->last_timestamp[id_eye]);
+      hLi6_Time_Between_Events->Fill(Time_To_ns(eventvector[eye].timestamp-analysis_params->last_timestamp[id_eye]));
     }
 
 
@@ -1368,7 +1681,7 @@ int Analyze_Data(std::vector<DEVT_BANK> eventvector, Input_Parameters input_para
       bkgevent.Valid = 1; //bkg event now valid
       
       //Fill time Diagnostics
-      hBkg_Time_Between_Events->Fill(eventvector[eye].timestamp-analysis_params->last_timestamp[id_eye]);
+      hBkg_Time_Between_Events->Fill(Time_To_ns(eventvector[eye].timestamp-analysis_params->last_timestamp[id_eye]));
     }
     analysis_params->entries_analyzed++;
     
@@ -1395,20 +1708,20 @@ int Analyze_Data(std::vector<DEVT_BANK> eventvector, Input_Parameters input_para
 	DANCE_Events_per_T0++;
 
 	//DEvent Blocking Time
-	if((devent.timestamp[0]-last_valid_devent_timestamp) < input_params.DEvent_Blocking_Time) {
+	if((devent.timestamp[0]-last_valid_devent_timestamp) < input_params.DEvent_Blocking_Ticks) {
 	  devent.Valid=0;
 	  cout<<"DEvent Blocked"<<endl;
 	}
 	//Event not within blocking time
 	else {
-	  if((devent.timestamp[0]-last_valid_devent_timestamp) < input_params.Coincidence_Window) {
-	    cout<<RED<<" Too small of a time difference! "<<devent.timestamp[0]-last_devent_timestamp<<RESET<<endl;
+	  if((devent.timestamp[0]-last_valid_devent_timestamp) < input_params.Coincidence_Window_Ticks) {
+	    cout<<RED<<" Too small of a time difference! "<<Time_To_ns(devent.timestamp[0]-last_devent_timestamp)<<RESET<<endl;
 	    // string stuff;
 	    // cin>>stuff;
 	  }
-	  hTimeBetweenDEvents->Fill(devent.timestamp[0]-last_valid_devent_timestamp);
+	  hTimeBetweenDEvents->Fill(Time_To_ns(devent.timestamp[0]-last_valid_devent_timestamp));
 #ifdef TurnOffGoSmall	  
-          hTimeBetweenDEvents_ESum_Mcr->Fill(devent.timestamp[0]-last_valid_devent_timestamp,devent.ESum,devent.Crystal_mult);
+          hTimeBetweenDEvents_ESum_Mcr->Fill(Time_To_ns(devent.timestamp[0]-last_valid_devent_timestamp),devent.ESum,devent.Crystal_mult);
 #endif
 	  //Update the last valid devent timestamp.  Same non-paralyzable model
 	  last_valid_devent_timestamp=devent.timestamp[0];
@@ -1733,7 +2046,7 @@ int Analyze_Data(std::vector<DEVT_BANK> eventvector, Input_Parameters input_para
           }
 	}
 	
-	double largesttimediff=0;
+	int64_t largesttimediff=0;
 
 	//Loop over the crystal mult
 	if(devent.Crystal_mult>1) {
@@ -1746,7 +2059,7 @@ int Analyze_Data(std::vector<DEVT_BANK> eventvector, Input_Parameters input_para
 	    }
 	  }
 	}
-	hEventTimeDist_Etot->Fill(largesttimediff,devent.ESum);
+	hEventTimeDist_Etot->Fill(Time_To_ns(largesttimediff),devent.ESum);
 
 	
 	/*
@@ -1765,7 +2078,7 @@ int Analyze_Data(std::vector<DEVT_BANK> eventvector, Input_Parameters input_para
 	}
 	*/
 
-	hEventLength_Etot->Fill(eventvector[eventvector.size()-1].TOF-eventvector[0].TOF,devent.ESum);
+	hEventLength_Etot->Fill(eventvector[nentries-1].TOF-eventvector[0].TOF,devent.ESum);
 
 
   
@@ -1798,7 +2111,7 @@ int Analyze_Data(std::vector<DEVT_BANK> eventvector, Input_Parameters input_para
 	    
 	    //The first one just gets pushed back
 	    if(removed_crystals.size()==0) {
-	      int removed_hit = gRandom->Uniform(0,devent.Crystal_mult); //Pick a random crystal
+	      int removed_hit = removed_random.Uniform(0,devent.Crystal_mult); //Pick a random crystal
 #ifdef Removed_Verbose
 	      cout<<"removed hit: "<<removed_hit<<"  vector size: "<<removed_crystals.size()<<endl;
 #endif
@@ -1812,7 +2125,7 @@ int Analyze_Data(std::vector<DEVT_BANK> eventvector, Input_Parameters input_para
 		bool duplicate=false;
 
 		//Pick a crystal at random
-		int removed_hit = gRandom->Uniform(0,devent.Crystal_mult); //Pick a random crystal
+		int removed_hit = removed_random.Uniform(0,devent.Crystal_mult); //Pick a random crystal
 #ifdef Removed_Verbose
 		cout<<"removed hit: "<<removed_hit<<"  vector size: "<<removed_crystals.size()<<endl;
 #endif
@@ -60,13 +60,36 @@
 #include "TCutG.h"
 #include "TH1.h"
 
+//Analyzer state carried from one event to the next outside of the histograms.  Each analysis worker (Analysis_Threads) starts its share
+//of the events from the state at the first one
+struct Analyzer_State {
+  uint32_t T0_Counter;
+  uint32_t DANCE_Entries_per_T0;
+  uint32_t DANCE_Events_per_T0;
+  int64_t last_devent_timestamp;        //Time ticks
+  int64_t last_valid_devent_timestamp;
+};
+
 //Function Prototypes
 int Read_TMatrix();
 int Read_DMatrix();
 int Initialize_Analyzer(Input_Parameters input_params);
 int Create_Analyzer_Histograms(Input_Parameters input_params);
+int Create_Analyzer_Worker_Histograms(Input_Parameters input_params, int worker);
+int Merge_Analyzer_Histograms();
+int Create_Coincidence_Scan_Histograms(Input_Parameters input_params, int window);
+int Write_Coincidence_Scan_Histograms(TFile *fout);
+int Create_Sweep_Variant_Histograms(Input_Parameters input_params, int variant);
+int Write_Sweep_Variant_Histograms(TFile *fout);
+#ifdef Validate_Analysis_Units
+int Create_Validation_Histograms(Input_Parameters input_params);
+int Check_Analysis_Units(Input_Parameters input_params);
+#endif
+void Get_Analyzer_State(Analyzer_State *state);
+void Set_Analyzer_State(const Analyzer_State &state);
+void Advance_Analyzer_State(const DEVT_BANK *eventvector, size_t nentries, const Input_Parameters &input_params, int64_t last_T0, Analyzer_State *state);
 
-int Analyze_Data(std::vector<DEVT_BANK> eventvector,Input_Parameters input_params,Analysis_Parameters *analysis_params);
+int Analyze_Data(const DEVT_BANK *eventvector, size_t nentries, const Input_Parameters &input_params, Analysis_Parameters *analysis_params);
 int Write_Analyzer_Histograms(TFile *fout, Input_Parameters input_params);
 int Reset_Analyzer_Histograms(TFile *fout, Input_Parameters input_params);
 int Make_Time_Deviations(int RunNumber);
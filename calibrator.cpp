@@ -47,6 +47,7 @@
 #include "calibrator.h"
 #include "global.h"
 #include "message.h"
+#include "channel_table.h"
 
 #include <iostream>
 #include <sstream>
@@ -182,16 +183,18 @@ int Calibrate_DANCE(DEVT_BANK *devt_bank) {
   //DANCE Ball
   if(devt_bank->ID < 162) {
     
+    const Detector_Descriptor_t &detector = channel_table.detector[devt_bank->ID];
+
     double temp_slow = devt_bank->Islow + gRandom->Uniform(0,1);
     double temp_fast = devt_bank->Ifast + gRandom->Uniform(0,1);
     
-    devt_bank->Eslow = 0.001*(temp_slow*temp_slow*slow_quad[devt_bank->ID] +
-			      temp_slow*slow_slope[devt_bank->ID] +
-			      slow_offset[devt_bank->ID]);
+    devt_bank->Eslow = 0.001*(temp_slow*temp_slow*detector.slow_quad +
+			      temp_slow*detector.slow_slope +
+			      detector.slow_offset);
     
-    devt_bank->Efast = 0.001*(temp_fast*temp_fast*fast_quad[devt_bank->ID] +
-			      temp_fast*fast_slope[devt_bank->ID] +
-			      fast_offset[devt_bank->ID]);
+    devt_bank->Efast = 0.001*(temp_fast*temp_fast*detector.fast_quad +
+			      temp_fast*detector.fast_slope +
+			      detector.fast_offset);
   
 #ifdef Calibrator_Verbose
     cout<<"Calibrator: fast: "<< devt_bank->Efast<<"  slow: "<< devt_bank->Eslow<<endl;
@@ -210,6 +213,11 @@ int Initialize_Calibrator(Input_Parameters input_params) {
 
   Read_Energy_Calibrations(input_params);
 
+  //Hand the calibrations to the channel table
+  for(int eye=0; eye<200; eye++) {
+    Set_Energy_Calibration(eye, slow_offset[eye], slow_slope[eye], slow_quad[eye], fast_offset[eye], fast_slope[eye], fast_quad[eye]);
+  }
+
   DANCE_Success("Calibrator","Initialized");
 
   return 0;
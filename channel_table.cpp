@@ -0,0 +1,344 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//***************************//
+//*  channel_table.cpp      *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+//File includes
+#include "channel_table.h"
+#include "global.h"
+#include "message.h"
+
+//C/C++ includes
+#include <iostream>
+#include <sstream>
+#include <string.h>
+
+using namespace std;
+
+Channel_Table_t channel_table;
+
+stringstream tmsg;
+
+//Entries read before the table is built
+static bool channel_mapped[Table_Boards][Table_Channels];
+static uint16_t channel_ID[Table_Boards][Table_Channels];
+static double time_deviations[Table_IDs];
+static bool calibrations_set = false;
+
+//Entries skipped by the unpacker
+static uint64_t rejected_channel_entries[Table_Boards][Table_Channels];
+static uint64_t rejected_ID_entries[Table_IDs];
+
+
+int Set_Channel_ID(int board, int channel, int ID) {
+
+  if(board < 0 || board >= Table_Boards || channel < 0 || channel >= Table_Channels || ID < 0 || ID >= Table_IDs) {
+    tmsg.str("");
+    tmsg<<"DANCE Map entry out of range. Board: "<<board<<" Channel: "<<channel<<" ID: "<<ID;
+    DANCE_Error("Channel Table",tmsg.str());
+    return -1;
+  }
+
+  channel_mapped[board][channel] = true;
+  channel_ID[board][channel] = ID;
+  return 0;
+}
+
+
+int Set_Time_Deviation(int ID, double time_deviation) {
+
+  if(ID < 0 || ID >= Table_IDs) {
+    return -1;
+  }
+  time_deviations[ID] = time_deviation;
+  return 0;
+}
+
+
+int Set_Energy_Calibration(int ID, double slow_offset, double slow_slope, double slow_quad, double fast_offset, double fast_slope, double fast_quad) {
+
+  if(ID < 0 || ID >= Table_IDs) {
+    return -1;
+  }
+
+  //Anything not calibrated keeps a slope of 1
+  if(!calibrations_set) {
+    for(int eye=0; eye<Table_IDs; eye++) {
+      channel_table.detector[eye].slow_offset = 0;
+      channel_table.detector[eye].slow_slope = 1;
+      channel_table.detector[eye].slow_quad = 0;
+      channel_table.detector[eye].fast_offset = 0;
+      channel_table.detector[eye].fast_slope = 1;
+      channel_table.detector[eye].fast_quad = 0;
+    }
+    calibrations_set = true;
+  }
+
+  Detector_Descriptor_t &detector = channel_table.detector[ID];
+  detector.slow_offset = slow_offset;
+  detector.slow_slope = slow_slope;
+  detector.slow_quad = slow_quad;
+  detector.fast_offset = fast_offset;
+  detector.fast_slope = fast_slope;
+  detector.fast_quad = fast_quad;
+  return 0;
+}
+
+
+//The PI gates are the same for every crystal for now
+int Set_PI_Gates(TCutG *gamma_gate, TCutG *alpha_gate, TCutG *retrigger_gate) {
+
+  for(int eye=0; eye<Table_IDs; eye++) {
+    channel_table.detector[eye].gamma_gate = gamma_gate;
+    channel_table.detector[eye].alpha_gate = alpha_gate;
+    channel_table.detector[eye].retrigger_gate = retrigger_gate;
+  }
+  return 0;
+}
+
+
+uint8_t Get_Detector_Class(int ID) {
+
+  if(ID >= 0 && ID < 162) {
+    return Detector::DANCE;
+  }
+  else if(ID == T0_ID) {
+    return Detector::T0;
+  }
+  else if(ID == He3_ID) {
+    return Detector::He3;
+  }
+  else if(ID == Li6_ID) {
+    return Detector::Li6;
+  }
+  else if(ID == U235_ID) {
+    return Detector::U235;
+  }
+  else if(ID == Bkg_ID) {
+    return Detector::Bkg;
+  }
+  return Detector::Unknown;
+}
+
+
+//Combines what the other modules read into the table.  Has to be called after they are initialized
+int Initialize_Channel_Table(Input_Parameters input_params) {
+
+  DANCE_Init("Channel Table","Initializing");
+
+  int nmapped = 0;
+  int nrejected = 0;
+
+  //Constants for each ID
+  for(int eye=0; eye<Table_IDs; eye++) {
+
+    Detector_Descriptor_t &detector = channel_table.detector[eye];
+
+    detector.detector_class = Get_Detector_Class(eye);
+    detector.mapped = 0;
+    detector.accepted = 1;
+
+    //Delays and flight paths
+    switch(detector.detector_class) {
+    case Detector::DANCE:
+      detector.delay = DANCE_Delay;
+      detector.flight_path = DANCE_FlightPath;
+      break;
+    case Detector::He3:
+      detector.delay = He3_Delay;
+      detector.flight_path = He3_FlightPath;
+      break;
+    case Detector::Li6:
+      detector.delay = Li6_Delay;
+      detector.flight_path = Li6_FlightPath;
+      break;
+    case Detector::U235:
+      detector.delay = U235_Delay;
+      detector.flight_path = U235_FlightPath;
+      break;
+    case Detector::Bkg:
+      detector.delay = Bkg_Delay;
+      detector.flight_path = Bkg_FlightPath;
+      break;
+    default:
+      detector.delay = 0;
+      detector.flight_path = 0;
+      break;
+    }
+
+    //Time deviations only exist for IDs below the T0
+    detector.time_deviation = 0;
+    if(eye < 200) {
+      detector.time_deviation = time_deviations[eye];
+    }
+
+    //Time deviations and delays are added from stage 1 on
+    detector.time_offset = 0;
+    if(input_params.Analysis_Stage > 0) {
+      detector.time_offset = detector.time_deviation + detector.delay;
+    }
+    detector.time_offset_ticks = Time_From_ns(detector.time_offset);
+
+    //Set_Energy_Calibration was never called (no calibrator)
+    if(!calibrations_set) {
+      detector.slow_offset = 0;
+      detector.slow_slope = 1;
+      detector.slow_quad = 0;
+      detector.fast_offset = 0;
+      detector.fast_slope = 1;
+      detector.fast_quad = 0;
+    }
+  }
+
+  //IDs excluded in the cfg file (dead crystals)
+  for(int eye=0; eye<input_params.NExcluded_IDs; eye++) {
+    int ID = input_params.Excluded_IDs[eye];
+    if(ID < 0 || ID >= Table_IDs) {
+      tmsg.str("");
+      tmsg<<"Excluded ID "<<ID<<" is out of range";
+      DANCE_Error("Channel Table",tmsg.str());
+      return -1;
+    }
+    channel_table.detector[ID].accepted = 0;
+  }
+
+  //Index by board and channel.  Channels not in the map get ID 0 like the old MapID array did
+  for(int bee=0; bee<Table_Boards; bee++) {
+
+    channel_table.accept_mask[bee] = 0;
+
+    for(int cee=0; cee<Table_Channels; cee++) {
+
+      Channel_Entry_t &entry = channel_table.channel[bee][cee];
+      uint16_t ID = 0;
+      entry.mapped = 0;
+
+      if(channel_mapped[bee][cee]) {
+        ID = channel_ID[bee][cee];
+        entry.mapped = 1;
+        channel_table.detector[ID].mapped = 1;
+        nmapped++;
+      }
+
+      entry.ID = ID;
+      entry.detector_class = channel_table.detector[ID].detector_class;
+      entry.time_offset_ticks = channel_table.detector[ID].time_offset_ticks;
+
+      //Unmapped channels and excluded IDs are skipped by the unpacker
+      entry.accepted = entry.mapped && channel_table.detector[ID].accepted;
+      if(entry.accepted) {
+        channel_table.accept_mask[bee] |= (1 << cee);
+      }
+      else if(entry.mapped) {
+        nrejected++;
+      }
+
+      rejected_channel_entries[bee][cee] = 0;
+    }
+  }
+
+  for(int eye=0; eye<Table_IDs; eye++) {
+    rejected_ID_entries[eye] = 0;
+  }
+
+  tmsg.str("");
+  tmsg<<"Built the Channel Table with "<<nmapped<<" Mapped Channels ("<<nrejected<<" Excluded)";
+  DANCE_Success("Channel Table",tmsg.str());
+
+  return 0;
+}
+
+
+void Add_Rejected_Entries(int board, int channel, uint32_t nrejected) {
+
+  if(board >= 0 && board < Table_Boards && channel >= 0 && channel < Table_Channels) {
+    rejected_channel_entries[board][channel] += nrejected;
+  }
+}
+
+
+void Add_Rejected_ID(int ID) {
+
+  if(ID >= 0 && ID < Table_IDs) {
+    rejected_ID_entries[ID]++;
+  }
+}
+
+
+//Prints the channels and IDs that had entries skipped
+int Report_Rejected_Entries() {
+
+  uint64_t total = 0;
+
+  for(int bee=0; bee<Table_Boards; bee++) {
+    for(int cee=0; cee<Table_Channels; cee++) {
+      if(rejected_channel_entries[bee][cee] > 0) {
+        tmsg.str("");
+        tmsg<<"Board "<<bee<<" Channel "<<cee;
+        if(channel_table.channel[bee][cee].mapped) {
+          tmsg<<" (Excluded ID "<<channel_table.channel[bee][cee].ID<<")";
+        }
+        else {
+          tmsg<<" (Not in the DANCE map)";
+        }
+        tmsg<<": "<<rejected_channel_entries[bee][cee]<<" Entries Skipped";
+        DANCE_Info("Channel Table",tmsg.str());
+        total += rejected_channel_entries[bee][cee];
+      }
+    }
+  }
+
+  for(int eye=0; eye<Table_IDs; eye++) {
+    if(rejected_ID_entries[eye] > 0) {
+      tmsg.str("");
+      tmsg<<"Excluded ID "<<eye<<": "<<rejected_ID_entries[eye]<<" Entries Skipped";
+      DANCE_Info("Channel Table",tmsg.str());
+      total += rejected_ID_entries[eye];
+    }
+  }
+
+  if(total > 0) {
+    tmsg.str("");
+    tmsg<<"Skipped "<<total<<" Entries from Unmapped or Excluded Channels";
+    DANCE_Info("Channel Table",tmsg.str());
+  }
+
+  return 0;
+}
@@ -0,0 +1,128 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//***************************//
+//*  channel_table.h        *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+#ifndef CHANNEL_TABLE_H
+#define CHANNEL_TABLE_H
+
+//C/C++ includes
+#include <stdint.h>
+
+//ROOT includes
+#include "TCutG.h"
+
+//File includes
+#include "structures.h"
+
+//Size of the board/channel index (board IDs are 8 bits in the entries, 16 channels per board)
+#define Table_Boards 256
+#define Table_Channels 16
+
+//Number of IDs (the ID in the stage1 binaries is 8 bits)
+#define Table_IDs 256
+
+//Detector classes
+namespace Detector
+{
+  const uint8_t Unknown = 0;
+  const uint8_t DANCE = 1;
+  const uint8_t T0 = 2;
+  const uint8_t He3 = 3;
+  const uint8_t Li6 = 4;
+  const uint8_t U235 = 5;
+  const uint8_t Bkg = 6;
+}
+
+//What the unpacker needs for each digitizer channel (kept small so the whole index stays in cache)
+struct Channel_Entry_t {
+  int64_t time_offset_ticks; //Time deviation plus detector delay in time ticks (0 in stage 0)
+  uint16_t ID;               //ID from the DANCE map
+  uint8_t detector_class;    //Detector class of the ID
+  uint8_t mapped;            //1 if the channel is in the DANCE map
+  uint8_t accepted;          //1 if entries from the channel are unpacked (mapped and the ID is not excluded)
+};
+
+//Everything known about one ID
+struct Detector_Descriptor_t {
+  double time_offset;        //Time deviation plus detector delay in ns (0 in stage 0)
+  int64_t time_offset_ticks; //The same in time ticks
+  double time_deviation;     //Time deviation from the TimeDeviations file in ns
+  double delay;              //Detector delay in ns
+  double flight_path;        //Flight path in m (0 if not a neutron detector)
+  double slow_offset;        //Slow integral energy calibration
+  double slow_slope;
+  double slow_quad;
+  double fast_offset;        //Fast integral energy calibration
+  double fast_slope;
+  double fast_quad;
+  TCutG *gamma_gate;         //PI gates
+  TCutG *alpha_gate;
+  TCutG *retrigger_gate;
+  uint8_t detector_class;    //Detector class
+  uint8_t mapped;            //1 if any channel maps to this ID
+  uint8_t accepted;          //0 if the ID is excluded in the cfg file
+};
+
+//Per channel and per ID constants, built once before unpacking starts
+struct Channel_Table_t {
+  Channel_Entry_t channel[Table_Boards][Table_Channels];
+  Detector_Descriptor_t detector[Table_IDs];
+  uint16_t accept_mask[Table_Boards];   //Bit n is set if channel n of the board is accepted
+};
+
+extern Channel_Table_t channel_table;
+
+//Function prototypes
+//These are filled by the modules that read the inputs
+int Set_Channel_ID(int board, int channel, int ID);
+int Set_Time_Deviation(int ID, double time_deviation);
+int Set_Energy_Calibration(int ID, double slow_offset, double slow_slope, double slow_quad, double fast_offset, double fast_slope, double fast_quad);
+int Set_PI_Gates(TCutG *gamma_gate, TCutG *alpha_gate, TCutG *retrigger_gate);
+
+uint8_t Get_Detector_Class(int ID);
+int Initialize_Channel_Table(Input_Parameters input_params);
+
+//Entries the unpacker skipped because their channel or ID is not accepted
+void Add_Rejected_Entries(int board, int channel, uint32_t nrejected);
+void Add_Rejected_ID(int ID);
+int Report_Rejected_Entries();
+
+#endif
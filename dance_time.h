@@ -0,0 +1,71 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//***************************//
+//*  dance_time.h           *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+#ifndef DANCE_TIME_H
+#define DANCE_TIME_H
+
+//File includes
+#include "global.h"
+
+//C/C++ includes
+#include <stdint.h>
+#include <math.h>
+
+//Times in the unpacker, sorter, eventbuilder and analyzer (the timestamps of the entries, the last times of each ID, and the windows
+//they are compared with) are 64 bit integers in Time_Ticks per ns.  Clock ticks and fine times add up exactly, comparisons and the sort
+//are integer operations, and the resolution is the same at any time in the run.  They are converted to ns only to fill histograms,
+//to compute the TOF, and to write the stage 1 binaries.
+
+//Later than any time
+#define Time_Max INT64_MAX
+
+//Time ticks from ns, rounded to the nearest tick
+inline int64_t Time_From_ns(double ns) {
+  return (int64_t)llround(ns*Time_Ticks);
+}
+
+//ns from time ticks
+inline double Time_To_ns(int64_t time) {
+  return time/(double)Time_Ticks;
+}
+
+#endif
@@ -0,0 +1,531 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+//***************************//
+//*  diagnostics.cpp        *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+//File includes
+#include "diagnostics.h"
+#include "global.h"
+#include "message.h"
+
+//C/C++ includes
+#include <iostream>
+#include <sstream>
+#include <string.h>
+#include <sys/time.h>
+
+using namespace std;
+
+//There is one consumer for the run
+static Diagnostics_Consumer diagnostics;
+
+static inline bool Bank_Is(const char *name, const char *bank_name) {
+  return name[0]==bank_name[0] && name[1]==bank_name[1] && name[2]==bank_name[2] && name[3]==bank_name[3];
+}
+
+//MIDAS banks are padded to 8 bytes
+static inline uint32_t Padded_Bank_Size(uint32_t size) {
+  return size + (8 - size%8)%8;
+}
+
+
+//****************** Diagnostics_Series ******************//
+
+Diagnostics_Series::Diagnostics_Series(const char *name, const char *title, int nrows) {
+  this->name = name;
+  this->title = title;
+  this->nrows = nrows;
+}
+
+void Diagnostics_Series::Add(uint32_t interval, int row, double value) {
+
+  if(row < 0 || row >= nrows) {
+    return;
+  }
+  if((size_t)(interval+1)*nrows > counts.size()) {
+    counts.resize((size_t)(interval+1)*nrows, 0);
+    sums.resize((size_t)(interval+1)*nrows, 0);
+  }
+  sums[(size_t)interval*nrows + row] += value;
+  counts[(size_t)interval*nrows + row]++;
+}
+
+//Average of each row in each interval, x is the time since the first record (s)
+TH2D* Diagnostics_Series::Make_Histogram(double interval_length) {
+
+  int nintervals = counts.size()/nrows;
+  TH2D *hist = new TH2D(name,title,nintervals,0,nintervals*interval_length,nrows,0,nrows);
+  for(int eye=0; eye<nintervals; eye++) {
+    for(int jay=0; jay<nrows; jay++) {
+      size_t index = (size_t)eye*nrows + jay;
+      if(counts[index] > 0) {
+	hist->SetBinContent(eye+1,jay+1,sums[index]/counts[index]);
+      }
+    }
+  }
+  return hist;
+}
+
+
+//****************** Diagnostics_Consumer ******************//
+
+Diagnostics_Consumer::Diagnostics_Consumer() :
+  digitizer_rates("Diagnostics_Digitizer_Rates","Digitizer Read Rate (bytes/s) vs Board",Diagnostics_Boards),
+  failures("Diagnostics_Failures","Fraction of Readouts with Board Failures vs Board",Diagnostics_Boards),
+  adc_temps("Diagnostics_ADC_Temps","ADC Temperature (C) vs 16*Board+Channel",Diagnostics_Boards*16),
+  scaler_rates("Diagnostics_Scaler_Rates","Scaler Rates vs Scaler",N_SCLR) {
+
+  running = false;
+  stop = false;
+  run_number = 0;
+  nrecords = 0;
+  nbad_events = 0;
+  have_first_time = false;
+  first_time = 0;
+  have_scaler_totals = false;
+  memset(scaler_totals, 0, sizeof(scaler_totals));
+}
+
+Diagnostics_Consumer::~Diagnostics_Consumer() {
+  Stop();
+}
+
+int Diagnostics_Consumer::Start(Input_Parameters input_params) {
+
+  if(running) {
+    return 0;
+  }
+  run_number = input_params.RunNumber;
+
+  //The time series only goes to disk in stage 0
+  if(input_params.Analysis_Stage == 0) {
+    stringstream outfilename;
+    outfilename << DIAGNOSTICS;
+    outfilename << "/diagnostics_run";
+    outfilename << run_number;
+    outfilename << ".bin";
+
+    diagnostics_file.open(outfilename.str().c_str(), ios::out | ios::binary);
+    if(!diagnostics_file.is_open()) {
+      stringstream dmsg;
+      dmsg<<"Could not Create Output Diagnostics File: "<<outfilename.str();
+      DANCE_Error("Diagnostics",dmsg.str());
+      return -1;
+    }
+
+    Diagnostics_File_Header_t file_header;
+    memcpy(file_header.magic, "DDGN", 4);
+    file_header.version = 1;
+    file_header.run = run_number;
+    file_header.reserved = 0;
+    diagnostics_file.write((const char*)&file_header, sizeof(file_header));
+    DANCE_Success("Diagnostics","Created Output Diagnostics File");
+  }
+  faillog.open("Readout_Status_Failures.txt", ios::app);
+
+  stop = false;
+  running = true;
+  consumer = std::thread(&Diagnostics_Consumer::Consumer_Loop, this);
+  return 0;
+}
+
+void Diagnostics_Consumer::Push(Event_t &event) {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    queue.push_back(Event_t());
+    queue.back().event_id = event.event_id;
+    queue.back().record_type = event.record_type;
+    queue.back().midas_time = event.midas_time;
+    queue.back().subrun = event.subrun;
+    queue.back().payload.swap(event.payload);
+  }
+  queue_cv.notify_one();
+}
+
+//The payload is taken (left empty)
+void Diagnostics_Consumer::Post(uint16_t event_id, uint32_t midas_time, uint16_t subrun, std::vector<char> &payload) {
+
+  if(!running) {
+    return;
+  }
+  Event_t event;
+  event.event_id = event_id;
+  event.record_type = 0;
+  event.midas_time = midas_time;
+  event.subrun = subrun;
+  event.payload.swap(payload);
+  Push(event);
+}
+
+void Diagnostics_Consumer::Post_Record(uint16_t type, uint32_t midas_time, uint16_t subrun, const uint32_t *values, int nvalues) {
+
+  if(!running) {
+    return;
+  }
+  Event_t event;
+  event.event_id = 0;
+  event.record_type = type;
+  event.midas_time = midas_time;
+  event.subrun = subrun;
+  event.payload.assign((const char*)values, (const char*)(values+nvalues));
+  Push(event);
+}
+
+void Diagnostics_Consumer::Consumer_Loop() {
+
+  while(true) {
+    Event_t event;
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex);
+      queue_cv.wait(lock, [&] { return stop || !queue.empty(); });
+      if(queue.empty()) {
+	return;
+      }
+      event.event_id = queue.front().event_id;
+      event.record_type = queue.front().record_type;
+      event.midas_time = queue.front().midas_time;
+      event.subrun = queue.front().subrun;
+      event.payload.swap(queue.front().payload);
+      queue.pop_front();
+    }
+
+    if(event.event_id == 2) {
+      Read_Scalers(event);
+    }
+    else if(event.event_id == 8) {
+      Read_Diagnostics(event);
+    }
+    else {
+      Write_Record(event.record_type, 1, event.payload.size()/sizeof(uint32_t), event.subrun, event.midas_time, 0, (const uint32_t*)event.payload.data());
+    }
+  }
+}
+
+//Everything posted before this is written out
+int Diagnostics_Consumer::Stop() {
+
+  if(!running) {
+    return 0;
+  }
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    stop = true;
+  }
+  queue_cv.notify_all();
+  consumer.join();
+  running = false;
+
+  if(diagnostics_file.is_open()) {
+    diagnostics_file.close();
+    stringstream dmsg;
+    dmsg<<"Wrote "<<nrecords<<" Diagnostics Records";
+    DANCE_Success("Diagnostics",dmsg.str());
+  }
+  if(faillog.is_open()) {
+    faillog.close();
+  }
+  if(nbad_events > 0) {
+    stringstream dmsg;
+    dmsg<<nbad_events<<" Scaler or Diagnostics Events had Banks Larger than the Event";
+    DANCE_Error("Diagnostics",dmsg.str());
+  }
+  return 0;
+}
+
+void Diagnostics_Consumer::Write_Record(uint16_t type, uint16_t nboards, uint16_t nvalues, uint16_t subrun, uint32_t tv_sec, uint32_t tv_usec, const uint32_t *values) {
+
+  if(!diagnostics_file.is_open()) {
+    return;
+  }
+  Diagnostics_Record_t record;
+  record.type = type;
+  record.nboards = nboards;
+  record.nvalues = nvalues;
+  record.subrun = subrun;
+  record.tv_sec = tv_sec;
+  record.tv_usec = tv_usec;
+  diagnostics_file.write((const char*)&record, sizeof(record));
+  diagnostics_file.write((const char*)values, (size_t)nboards*nvalues*sizeof(uint32_t));
+  nrecords++;
+}
+
+uint32_t Diagnostics_Consumer::Summary_Interval(uint32_t tv_sec) {
+
+  if(!have_first_time) {
+    have_first_time = true;
+    first_time = tv_sec;
+  }
+  if(tv_sec < first_time) {
+    return 0;
+  }
+  return (tv_sec - first_time)/Diagnostics_Summary_Interval;
+}
+
+//Scaler events (MIDAS event ID 2) are the same for both DAQs: MLTM, SCLR, and RATE 32-bit banks
+void Diagnostics_Consumer::Read_Scalers(Event_t &event) {
+
+  const char *data = event.payload.data();
+  uint32_t size = event.payload.size();
+  uint32_t pos = sizeof(BankHeader_t);
+  uint32_t tv_sec = event.midas_time;
+  uint32_t values[N_SCLR];
+
+  while(pos + sizeof(Bank32_t) <= size) {
+
+    Bank32_t bank32;
+    memcpy(&bank32, data+pos, sizeof(Bank32_t));
+    pos += sizeof(Bank32_t);
+    if(bank32.fDataSize > size - pos) {
+      nbad_events++;
+      return;
+    }
+    const char *bank_data = data+pos;
+    pos += Padded_Bank_Size(bank32.fDataSize);
+
+#ifdef Scaler_Verbose
+    cout<<"BANK "<<bank32.fName[0]<<bank32.fName[1]<<bank32.fName[2]<<bank32.fName[3]<<"  Size: "<<bank32.fDataSize<<endl;
+#endif
+
+    int nvalues = bank32.fDataSize/sizeof(uint32_t);
+    if(nvalues > N_SCLR) {
+      nvalues = N_SCLR;
+    }
+
+    if(Bank_Is(bank32.fName,"MLTM") && bank32.fDataSize >= sizeof(uint32_t)) {
+      memcpy(&tv_sec, bank_data, sizeof(uint32_t));
+    }
+    else if(Bank_Is(bank32.fName,"SCLR")) {
+      memcpy(values, bank_data, nvalues*sizeof(uint32_t));
+      Write_Record(Diagnostics::Scaler_Totals, 1, nvalues, event.subrun, tv_sec, 0, values);
+      memcpy(scaler_totals, values, nvalues*sizeof(uint32_t));
+      have_scaler_totals = true;
+    }
+    else if(Bank_Is(bank32.fName,"RATE")) {
+      memcpy(values, bank_data, nvalues*sizeof(uint32_t));
+      Write_Record(Diagnostics::Scaler_Rates, 1, nvalues, event.subrun, tv_sec, 0, values);
+      uint32_t interval = Summary_Interval(tv_sec);
+      for(int kay=0; kay<nvalues; kay++) {
+	scaler_rates.Add(interval, kay, values[kay]);
+      }
+    }
+  }
+}
+
+//Diagnostics events (MIDAS event ID 8) from the caen2018 DAQ: a TIME bank and then 16-bit banks of board registers
+void Diagnostics_Consumer::Read_Diagnostics(Event_t &event) {
+
+  const char *data = event.payload.data();
+  uint32_t size = event.payload.size();
+  uint32_t pos = sizeof(BankHeader_t);
+  uint32_t tv_sec = event.midas_time;
+  uint32_t tv_usec = 0;
+  uint32_t values[Diagnostics_Boards*16];
+
+  while(pos + sizeof(Bank_t) <= size) {
+
+    Bank_t bank;
+    memcpy(&bank, data+pos, sizeof(Bank_t));
+    pos += sizeof(Bank_t);
+    if(bank.fDataSize > size - pos) {
+      nbad_events++;
+      return;
+    }
+    const char *bank_data = data+pos;
+    pos += Padded_Bank_Size(bank.fDataSize);
+
+#ifdef Diagnostic_Verbose
+    cout<<"BANK "<<bank.fName[0]<<bank.fName[1]<<bank.fName[2]<<bank.fName[3]<<"  Size: "<<bank.fDataSize<<endl;
+#endif
+
+    //Time at which the registers were read
+    if(Bank_Is(bank.fName,"TIME")) {
+      if(bank.fDataSize >= sizeof(struct timeval)) {
+	struct timeval timevalue;
+	memcpy(&timevalue, bank_data, sizeof(timevalue));
+	tv_sec = timevalue.tv_sec;
+	tv_usec = timevalue.tv_usec;
+      }
+      continue;
+    }
+
+    //One register per board
+    uint16_t type = 0;
+    int nper_board = 1;
+    if(Bank_Is(bank.fName,"SCLR")) {
+      type = Diagnostics::Digitizer_Rates;
+    }
+    else if(Bank_Is(bank.fName,"ACQS")) {
+      type = Diagnostics::Acquisition_Status;
+    }
+    else if(Bank_Is(bank.fName,"FAIL")) {
+      type = Diagnostics::Failure_Status;
+    }
+    else if(Bank_Is(bank.fName,"READ")) {
+      type = Diagnostics::Readout_Status;
+    }
+    //Several registers per board
+    else if(Bank_Is(bank.fName,"DIAG")) {
+      type = Diagnostics::Register_0x8504n;
+      nper_board = 8;
+    }
+    else if(Bank_Is(bank.fName,"TEMP")) {
+      type = Diagnostics::ADC_Temp;
+      nper_board = 16;
+    }
+    else if(Bank_Is(bank.fName,"1n2C")) {
+      type = Diagnostics::Register_0x1n2C;
+      nper_board = 16;
+    }
+    else if(Bank_Is(bank.fName,"CHST")) {
+      type = Diagnostics::Channel_Status;
+      nper_board = 16;
+    }
+    else {
+      continue;
+    }
+
+    //The ADC temperatures are 16 bits, everything else 32
+    int nvalues = 0;
+    if(type == Diagnostics::ADC_Temp) {
+      nvalues = bank.fDataSize/sizeof(uint16_t);
+    }
+    else {
+      nvalues = bank.fDataSize/sizeof(uint32_t);
+    }
+    int nboards = nvalues/nper_board;
+    if(nboards > Diagnostics_Boards) {
+      nboards = Diagnostics_Boards;
+    }
+    nvalues = nboards*nper_board;
+
+    if(type == Diagnostics::ADC_Temp) {
+      for(int eye=0; eye<nvalues; eye++) {
+	uint16_t temp;
+	memcpy(&temp, bank_data + eye*sizeof(uint16_t), sizeof(uint16_t));
+	values[eye] = temp;
+      }
+    }
+    else {
+      memcpy(values, bank_data, nvalues*sizeof(uint32_t));
+    }
+    Write_Record(type, nboards, nper_board, event.subrun, tv_sec, tv_usec, values);
+
+    uint32_t interval = Summary_Interval(tv_sec);
+    if(type == Diagnostics::Digitizer_Rates) {
+      for(int eye=0; eye<nboards; eye++) {
+	digitizer_rates.Add(interval, eye, values[eye]);
+      }
+    }
+    else if(type == Diagnostics::Failure_Status) {
+      for(int eye=0; eye<nboards; eye++) {
+	if(values[eye] != 0 && faillog.is_open()) {
+	  faillog<<"Run: "<<run_number<<"  Board: "<<eye<<" Failure_Status: "<<values[eye]<<endl;
+	}
+	failures.Add(interval, eye, values[eye] != 0 ? 1 : 0);
+      }
+    }
+    else if(type == Diagnostics::ADC_Temp) {
+      for(int eye=0; eye<nvalues; eye++) {
+	adc_temps.Add(interval, eye, values[eye]);
+      }
+    }
+  }
+}
+
+//Called once the consumer is stopped
+int Diagnostics_Consumer::Write(TFile *fout, TH1I *hScalers) {
+
+  //Last scaler totals of the run
+  if(hScalers && have_scaler_totals) {
+    for(int kay=0; kay<N_SCLR; kay++) {
+      hScalers->SetBinContent(kay+1,scaler_totals[kay]);
+    }
+  }
+
+  fout->cd();
+  Diagnostics_Series *series[4] = {&digitizer_rates, &failures, &adc_temps, &scaler_rates};
+  for(int eye=0; eye<4; eye++) {
+    if(!series[eye]->Empty()) {
+      TH2D *hist = series[eye]->Make_Histogram(Diagnostics_Summary_Interval);
+      hist->Write();
+      delete hist;
+    }
+  }
+  return 0;
+}
+
+
+//****************** Interface ******************//
+
+//Starts the consumer for MIDAS input, the time series file is only written in stage 0
+int Start_Diagnostics(Input_Parameters input_params) {
+
+  if(input_params.Read_Binary != 0 || input_params.Read_Simulation != 0) {
+    return 0;
+  }
+  return diagnostics.Start(input_params);
+}
+
+//Hands a scaler (2) or diagnostics (8) event to the consumer, payload is everything after the event header
+void Post_Diagnostics_Event(uint16_t event_id, uint32_t midas_time, uint16_t subrun, std::vector<char> &payload) {
+  diagnostics.Post(event_id, midas_time, subrun, payload);
+}
+
+//Corrupt_Range record values: first_ns (int64), last_ns (int64, -1 if the subrun ended in the corrupted data),
+//bytes (uint64), events, last_midas_time (0xFFFFFFFF if the subrun ended).  The record time is first_midas_time
+void Post_Corrupt_Range(uint16_t subrun, double first_timestamp, double last_timestamp, uint32_t first_time, uint32_t last_time, uint64_t nbytes, uint32_t nevents) {
+
+  int64_t first_ns = (int64_t)first_timestamp;
+  int64_t last_ns = last_timestamp < 0 ? -1 : (int64_t)last_timestamp;
+  uint32_t values[8];
+  memcpy(&values[0], &first_ns, sizeof(int64_t));
+  memcpy(&values[2], &last_ns, sizeof(int64_t));
+  memcpy(&values[4], &nbytes, sizeof(uint64_t));
+  values[6] = nevents;
+  values[7] = last_timestamp < 0 ? 0xFFFFFFFF : last_time;
+  diagnostics.Post_Record(Diagnostics::Corrupt_Range, first_time, subrun, values, 8);
+}
+
+int Stop_Diagnostics() {
+  return diagnostics.Stop();
+}
+
+int Write_Diagnostics(TFile *fout, TH1I *hScalers) {
+  return diagnostics.Write(fout, hScalers);
+}
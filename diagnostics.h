@@ -0,0 +1,174 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+//***************************//
+//*  diagnostics.h          *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+//C/C++ includes
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+
+//ROOT includes
+#include "TFile.h"
+#include "TH1.h"
+#include "TH2.h"
+
+//File includes
+#include "structures.h"
+
+//Largest number of boards in a diagnostics bank
+#define Diagnostics_Boards 20
+
+//Diagnostics file (diagnostics_run#.bin).  A Diagnostics_File_Header_t followed by records, each a
+//Diagnostics_Record_t and then nboards*nvalues 32-bit values (board major)
+namespace Diagnostics
+{
+  const uint16_t Digitizer_Rates = 1;      //SCLR bank, bytes per second read from each board
+  const uint16_t Acquisition_Status = 2;   //ACQS bank, 0x8104
+  const uint16_t Failure_Status = 3;       //FAIL bank, 0x8178
+  const uint16_t Readout_Status = 4;       //READ bank, 0xEF04
+  const uint16_t Register_0x8504n = 5;     //DIAG bank, 8 per board
+  const uint16_t ADC_Temp = 6;             //TEMP bank, 16 per board in degrees C
+  const uint16_t Register_0x1n2C = 7;      //1n2C bank, 16 per board
+  const uint16_t Channel_Status = 8;       //CHST bank, 0x1n88, 16 per board
+  const uint16_t Scaler_Totals = 9;        //SCLR bank of the MIDAS scaler event (N_SCLR values)
+  const uint16_t Scaler_Rates = 10;        //RATE bank of the MIDAS scaler event (N_SCLR values)
+  const uint16_t Corrupt_Range = 11;       //Data skipped by the unpacker (see Post_Corrupt_Range)
+}
+
+struct Diagnostics_File_Header_t {
+  char magic[4];             //"DDGN"
+  uint32_t version;
+  int32_t run;
+  uint32_t reserved;
+};
+
+struct Diagnostics_Record_t {
+  uint16_t type;             //Diagnostics:: record type
+  uint16_t nboards;
+  uint16_t nvalues;          //Values per board
+  uint16_t subrun;
+  uint32_t tv_sec;           //Time of the readout (TIME bank, MLTM bank, or the MIDAS event time)
+  uint32_t tv_usec;
+};
+
+//Averages of one quantity in Diagnostics_Summary_Interval bins, for the ROOT summaries
+class Diagnostics_Series {
+ public:
+  Diagnostics_Series(const char *name, const char *title, int nrows);
+  void Add(uint32_t interval, int row, double value);
+  bool Empty() { return counts.empty(); }
+  TH2D* Make_Histogram(double interval_length);
+
+ private:
+  const char *name;
+  const char *title;
+  int nrows;
+  std::vector<double> sums;
+  std::vector<uint32_t> counts;
+};
+
+//Scaler (MIDAS event 2) and caen2018 diagnostics (MIDAS event 8) events are handed to this thread by
+//the unpacker.  It decodes the banks, writes the diagnostics file, and keeps the summaries
+class Diagnostics_Consumer {
+ public:
+  Diagnostics_Consumer();
+  ~Diagnostics_Consumer();
+
+  int Start(Input_Parameters input_params);
+  void Post(uint16_t event_id, uint32_t midas_time, uint16_t subrun, std::vector<char> &payload);
+  void Post_Record(uint16_t type, uint32_t midas_time, uint16_t subrun, const uint32_t *values, int nvalues);
+  int Stop();
+  int Write(TFile *fout, TH1I *hScalers);
+
+ private:
+  struct Event_t {
+    uint16_t event_id;            //MIDAS event ID, or 0 for a record made by the unpacker
+    uint16_t record_type;         //Diagnostics:: record type when event_id is 0
+    uint32_t midas_time;
+    uint16_t subrun;
+    std::vector<char> payload;    //Everything after the MIDAS event header, or the record values
+  };
+
+  void Consumer_Loop();
+  void Push(Event_t &event);
+  void Read_Scalers(Event_t &event);
+  void Read_Diagnostics(Event_t &event);
+  void Write_Record(uint16_t type, uint16_t nboards, uint16_t nvalues, uint16_t subrun, uint32_t tv_sec, uint32_t tv_usec, const uint32_t *values);
+  uint32_t Summary_Interval(uint32_t tv_sec);
+
+  std::thread consumer;
+  std::mutex queue_mutex;
+  std::condition_variable queue_cv;
+  std::deque<Event_t> queue;
+  bool running;
+  bool stop;
+
+  int run_number;
+  std::ofstream diagnostics_file;
+  std::ofstream faillog;             //Readout_Status_Failures.txt
+  uint64_t nrecords;
+  uint64_t nbad_events;              //Diagnostics and scaler events with banks that run past the event
+
+  //Summaries
+  bool have_first_time;
+  uint32_t first_time;
+  Diagnostics_Series digitizer_rates;
+  Diagnostics_Series failures;
+  Diagnostics_Series adc_temps;
+  Diagnostics_Series scaler_rates;
+  bool have_scaler_totals;
+  uint32_t scaler_totals[N_SCLR];
+};
+
+//Function prototypes
+int Start_Diagnostics(Input_Parameters input_params);
+void Post_Diagnostics_Event(uint16_t event_id, uint32_t midas_time, uint16_t subrun, std::vector<char> &payload);
+void Post_Corrupt_Range(uint16_t subrun, double first_timestamp, double last_timestamp, uint32_t first_time, uint32_t last_time, uint64_t nbytes, uint32_t nevents);
+int Stop_Diagnostics();
+int Write_Diagnostics(TFile *fout, TH1I *hScalers);
+
+#endif
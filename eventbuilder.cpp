@@ -51,15 +51,18 @@
 #include "eventbuilder.h"
 #include "validator.h"
 #include "calibrator.h"
+#include "pipeline.h"
 #include<iomanip>
+#include <algorithm>
 
 using namespace std;
 
 stringstream emsg;
 
-std::vector<DEVT_BANK> DANCE_eventvector;   //Vector to store dance events for analysis
-std::vector<DEVT_BANK> BM_eventvector;      //Vector to store beam monitor events for analysis
-std::vector<DEVT_BANK> T0_eventvector;      //Vector to store T0 monitor events for analysis
+std::vector<DEVT_BANK> DANCE_eventvector;   //Vector to store dance events for analysis (beam monitor and T0 events are analyzed in the sorted buffer)
+Event_Batch *event_batch = NULL;            //Batch the events go into for the analysis stage of the pipeline (NULL analyzes them as they are built)
+std::vector<DEVT_BANK> Scan_eventvector[Max_Coincidence_Scan];  //DANCE events of the scanned coincidence windows (NCoincidence_Scan)
+Analysis_Parameters scan_params[Max_Coincidence_Scan];           //Entries and events built with each scanned coincidence window
 
 std::ofstream outputbinfile;                //Ouput binary file
 DEVT_STAGE1_WF devt_out_wf;                 //Ouput struct for binaries with WF integral
@@ -77,6 +80,20 @@ double U235_TOF_Corr_Limit[2];   //[0] is lower [1] is upper
 double Li6_TOF_Corr_Limit[2];   //[0] is lower [1] is upper
 double He3_TOF_Corr_Limit[2];   //[0] is lower [1] is upper
 
+//TOF Corrections resampled on a uniform grid in log(TOF) between the limits (see Make_TOF_Corr_Table).  The tables hold the moderation
+//time (TOF minus corrected TOF) at the nbins+1 nodes since it changes much more slowly than the TOF itself
+struct TOF_Corr_Table {
+  double log_low;                  //log of the lower limit
+  double inv_step;                 //bins per unit of log(TOF)
+  int nbins;
+  std::vector<double> moderation;  //moderation time at the nodes (ns)
+};
+
+TOF_Corr_Table DANCE_TOF_Corr_Table;
+TOF_Corr_Table U235_TOF_Corr_Table;
+TOF_Corr_Table Li6_TOF_Corr_Table;
+TOF_Corr_Table He3_TOF_Corr_Table;
+
 //Histograms 
 #ifdef Histogram_DetectorLoad
 TH1F *hDetectorLoad; //Average detector load vs TOF
@@ -151,6 +168,137 @@ TH2F *hFastSlowRatio_ID;   //ID vs Ratio of Fast to Slow component
 TH2F* SlowID;
 TH2F* FastID;
 
+#ifdef Validate_Time_Grouping
+static inline uint32_t test_time_random(uint32_t *seed) {
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+  return *seed;
+}
+
+//Builds the same synthetic entries as double ns (the old timestamps) and as time ticks: 2 ns clock ticks, firmware fine times, and time
+//deviations plus the DANCE delay like the ones from the TimeDeviations files.  The entries come in clusters a few ns apart and some are put
+//exactly one coincidence window or one blocking time after the one before.  Going through the entries in the order of the time ticks, every
+//decision of the event building (time order, start of a new DANCE event, crystal blocking) is made on the time ticks and on the ns
+//timestamps.  They have to agree unless the ns timestamps are within Time_Grouping_Tolerance ticks of the decision, where the rounding of
+//the double sums (a difference of exactly one window can come out a hair short) decides the ns one
+static int test_time_grouping(Input_Parameters input_params) {
+
+  const int nentries = 1000000;
+  const double tolerance = Time_Grouping_Tolerance/(double)Time_Ticks;
+  uint32_t seed = 0x2545F491;
+
+  double offsets[162];
+  for(int eye=0; eye<162; eye++) {
+    offsets[eye] = DANCE_Delay + 40.0*(test_time_random(&seed) % 1000000)/1000000.0 - 20.0;
+  }
+
+  vector<double> ns(nentries);
+  vector<int64_t> ticks(nentries);
+  vector<int> IDs(nentries);
+  uint64_t coarse = 1000000;
+  uint32_t fine = 0;
+  for(int eye=0; eye<nentries; eye++) {
+    uint32_t step = test_time_random(&seed) % 16;
+    if(step == 0) {
+      coarse += 1000 + test_time_random(&seed) % 100000;         //next cluster
+    }
+    else if(step == 1) {
+      coarse += (uint64_t)(input_params.Coincidence_Window/2.0);  //one window later (2 ns ticks)
+    }
+    else if(step == 2) {
+      coarse += (uint64_t)(input_params.Crystal_Blocking_Time/2.0);
+    }
+    else {
+      coarse += test_time_random(&seed) % 4;
+      fine = test_time_random(&seed) % 1024;
+    }
+    IDs[eye] = test_time_random(&seed) % 162;
+    double dT = 2.*fine/1024.;
+    ns[eye] = coarse*2.0 + dT + offsets[IDs[eye]];
+    ticks[eye] = coarse*2*Time_Ticks + Time_From_ns(dT) + Time_From_ns(offsets[IDs[eye]]);
+  }
+
+  //time order of the time ticks (ties keep the order the entries were made)
+  vector<uint32_t> order(nentries);
+  for(int eye=0; eye<nentries; eye++) {
+    order[eye] = eye;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return ticks[a] < ticks[b]; });
+
+  int failures = 0;
+  int near_decisions = 0;
+  uint32_t nevents = 0;
+  uint32_t nblocked = 0;
+  uint32_t first = order[0];
+  vector<int64_t> last(162, INT64_MIN/2);
+  vector<uint32_t> last_entry(162, nentries);
+  for(int eye=0; eye<nentries; eye++) {
+    uint32_t entry = order[eye];
+
+    //time order
+    if(eye > 0) {
+      double ns_difference = ns[entry] - ns[order[eye-1]];
+      if(ns_difference < 0) {
+        if(ns_difference < -tolerance) {
+          failures++;
+        }
+        else {
+          near_decisions++;
+        }
+      }
+    }
+
+    //start of a new DANCE event
+    bool ticks_new = eye == 0 || ticks[entry] - ticks[first] >= input_params.Coincidence_Window_Ticks;
+    bool ns_new = eye == 0 || ns[entry] - ns[first] >= input_params.Coincidence_Window;
+    if(ticks_new != ns_new) {
+      if(fabs(ns[entry] - ns[first] - input_params.Coincidence_Window) > tolerance) {
+        failures++;
+      }
+      else {
+        near_decisions++;
+      }
+    }
+    if(ticks_new) {
+      first = entry;
+      nevents++;
+    }
+
+    //crystal blocking
+    int ID = IDs[entry];
+    bool ticks_blocked = ticks[entry] - last[ID] < input_params.Crystal_Blocking_Ticks;
+    if(last_entry[ID] < (uint32_t)nentries) {
+      bool ns_blocked = ns[entry] - ns[last_entry[ID]] < input_params.Crystal_Blocking_Time;
+      if(ticks_blocked != ns_blocked) {
+        if(fabs(ns[entry] - ns[last_entry[ID]] - input_params.Crystal_Blocking_Time) > tolerance) {
+          failures++;
+        }
+        else {
+          near_decisions++;
+        }
+      }
+    }
+    if(ticks_blocked) {
+      nblocked++;
+    }
+    last[ID] = ticks[entry];
+    last_entry[ID] = entry;
+  }
+
+  stringstream smsg;
+  if(failures > 0) {
+    smsg<<"Event building on the time ticks and on the ns timestamps disagrees on "<<failures<<" decisions for "<<nentries<<" synthetic entries";
+    DANCE_Error("Eventbuilder",smsg.str());
+    return -1;
+  }
+  smsg<<"Event building on the time ticks agrees with the ns timestamps on "<<nentries<<" synthetic entries ("<<nevents<<" DANCE events, ";
+  smsg<<nblocked<<" blocked entries, "<<near_decisions<<" decisions within "<<Time_Grouping_Tolerance<<" ticks where the ns sums round the other way)";
+  DANCE_Success("Eventbuilder",smsg.str());
+  return 0;
+}
+#endif
+
 int Initialize_Eventbuilder(Input_Parameters input_params) {
   
   DANCE_Init("Eventbuilder","Initializing");
@@ -163,10 +311,19 @@ int Initialize_Eventbuilder(Input_Parameters input_params) {
   //Moderator Function
   func_ret = Read_Moderation_Time_Graphs();
   
-  //clear the event vectors
+  //clear the event vector and make room for the events up front
   DANCE_eventvector.clear();
-  BM_eventvector.clear();
-  T0_eventvector.clear();
+  DANCE_eventvector.reserve(DANCE_Event_Reserve);
+  for(int eye=0; eye<input_params.NCoincidence_Scan; eye++) {
+    Scan_eventvector[eye].clear();
+    Scan_eventvector[eye].reserve(DANCE_Event_Reserve);
+    memset(&scan_params[eye],0,sizeof(Analysis_Parameters));
+  }
+
+#ifdef Validate_Time_Grouping
+  //event building on time ticks against the ns timestamps
+  func_ret += test_time_grouping(input_params);
+#endif
 
 #ifdef Histogram_DetectorLoad
   for(int eye=0; eye<100000000; eye++) {
@@ -228,415 +385,678 @@ int Initialize_Eventbuilder(Input_Parameters input_params) {
   return func_ret;
 }
 
-int Build_Events(deque<DEVT_BANK> &datadeque, Input_Parameters input_params, Analysis_Parameters *analysis_params) {
-  
-#ifdef Eventbuilder_Verbose
-  cout<<"Eventbuilder: About to event build deque size: "<<datadeque.size()<<endl;
-#endif
+//Corrected TOF from a table: the bin is found from log(TOF) directly and the moderation time is interpolated between its nodes.
+//The TOF has to be within the limits of the table
+static inline double Lookup_TOF_Corr(const TOF_Corr_Table &table, double tof) {
 
-  //Eventbuild
-  while(true) {
-    		  
-    //check to see if the buffer is longer than the length specificed in global.h
-    if((datadeque[datadeque.size()-1].timestamp - datadeque[0].timestamp) >= (double)1000000000.0*input_params.Buffer_Depth) {
-	 
-      analysis_params->entries_processed++;
-      
-      //we have started to build
-      analysis_params->event_building_active=true;
-
-      //First write the data to the output binary file if needed
-      if(input_params.Write_Binary==1 && outputbinfile.is_open()) {
-	if(input_params.WF_Integral){      	//if specified in cfg file, writing WF Integral to binaries
-	  devt_out_wf.Ifast = datadeque[0].Ifast;
-	  devt_out_wf.Islow = datadeque[0].Islow;
-       	  devt_out_wf.timestamp = datadeque[0].timestamp;
-	  devt_out_wf.wfintegral = datadeque[0].wfintegral;
-       	  devt_out_wf.ID = datadeque[0].ID;
-          outputbinfile.write(reinterpret_cast<char*>(&devt_out_wf),sizeof(DEVT_STAGE1_WF));
-	}
-	else{                                  //not writing WF Integral to binaries
-	  devt_out.Ifast = datadeque[0].Ifast;
-          devt_out.Islow = datadeque[0].Islow;
-          devt_out.timestamp = datadeque[0].timestamp;
-          devt_out.ID = datadeque[0].ID;
-          outputbinfile.write(reinterpret_cast<char*>(&devt_out),sizeof(DEVT_STAGE1));
-	}
-	analysis_params->entries_written_to_binary++;
-      }    
-      
-      //ID
-      hID_Raw->Fill(datadeque[0].channel+(datadeque[0].board*16));  //Channel + (Board *16)
-      hID->Fill(datadeque[0].ID,1);
+  double position = (log(tof) - table.log_low)*table.inv_step;
+  int bin = (int)position;
+  if(bin >= table.nbins) {
+    bin = table.nbins - 1;
+  }
+  double frac = position - bin;
 
-      Energy_raw_ID->Fill(datadeque[0].Islow,datadeque[0].ID,1);
+  return tof - (table.moderation[bin] + frac*(table.moderation[bin+1] - table.moderation[bin]));
+}
 
-      //Calculate TOF now (difference between this timestamp and the last T0
-      datadeque[0].TOF = datadeque[0].timestamp - analysis_params->last_timestamp[T0_ID];
+//Corrects the TOF of an entry for the moderation time between ~0 and ~10 MeV
+static void Correct_TOF(DEVT_BANK &entry) {
 
-      
-      //Calculate corrected DANCE TOF
-      if(datadeque[0].ID < 162) {
-	//Correct the TOF for moderation time between ~0 and ~10 MeV
-	if( datadeque[0].TOF >= DANCE_TOF_Corr_Limit[0] && datadeque[0].TOF <= DANCE_TOF_Corr_Limit[1]) {
-	  datadeque[0].TOF_Corr = gr_DANCE_TOF_Corr->Eval(datadeque[0].TOF);
-	}
-	else {
-	  datadeque[0].TOF_Corr = -1;
-	}
-      }
+  //Calculate corrected DANCE TOF
+  if(entry.ID < 162) {
+    if(entry.TOF >= DANCE_TOF_Corr_Limit[0] && entry.TOF <= DANCE_TOF_Corr_Limit[1]) {
+      entry.TOF_Corr = Lookup_TOF_Corr(DANCE_TOF_Corr_Table,entry.TOF);
+    }
+    else {
+      entry.TOF_Corr = -1;
+    }
+  }
 
-      //Calculate corrected U235 TOF
-      if(datadeque[0].ID == U235_ID) {
-	//Correct the TOF for moderation time between ~0 and ~10 MeV
-	if( datadeque[0].TOF >= U235_TOF_Corr_Limit[0] && datadeque[0].TOF <= U235_TOF_Corr_Limit[1]) {
-	  datadeque[0].TOF_Corr = gr_U235_TOF_Corr->Eval(datadeque[0].TOF);
-	}
-	else {
-	  datadeque[0].TOF_Corr = -1;
-	}
-      }
+  //Calculate corrected U235 TOF
+  if(entry.ID == U235_ID) {
+    if(entry.TOF >= U235_TOF_Corr_Limit[0] && entry.TOF <= U235_TOF_Corr_Limit[1]) {
+      entry.TOF_Corr = Lookup_TOF_Corr(U235_TOF_Corr_Table,entry.TOF);
+    }
+    else {
+      entry.TOF_Corr = -1;
+    }
+  }
 
-      //Calculate corrected Li6 TOF
-      if(datadeque[0].ID == Li6_ID) {
-	//Correct the TOF for moderation time between ~0 and ~10 MeV
-	if( datadeque[0].TOF >= Li6_TOF_Corr_Limit[0] && datadeque[0].TOF <= Li6_TOF_Corr_Limit[1]) {
-	  datadeque[0].TOF_Corr = gr_Li6_TOF_Corr->Eval(datadeque[0].TOF);
-	}
-	else {
-	  datadeque[0].TOF_Corr = -1;
-	}
-      }
+  //Calculate corrected Li6 TOF
+  if(entry.ID == Li6_ID) {
+    if(entry.TOF >= Li6_TOF_Corr_Limit[0] && entry.TOF <= Li6_TOF_Corr_Limit[1]) {
+      entry.TOF_Corr = Lookup_TOF_Corr(Li6_TOF_Corr_Table,entry.TOF);
+    }
+    else {
+      entry.TOF_Corr = -1;
+    }
+  }
 
-      //Calculate corrected He3 TOF
-      if(datadeque[0].ID == He3_ID) {
-	//Correct the TOF for moderation time between ~0 and ~10 MeV
-	if( datadeque[0].TOF >= He3_TOF_Corr_Limit[0] && datadeque[0].TOF <= He3_TOF_Corr_Limit[1]) {
-	  datadeque[0].TOF_Corr = gr_He3_TOF_Corr->Eval(datadeque[0].TOF);
-	}
-	else {
-	  datadeque[0].TOF_Corr = -1;
-	}
+  //Calculate corrected He3 TOF
+  if(entry.ID == He3_ID) {
+    if(entry.TOF >= He3_TOF_Corr_Limit[0] && entry.TOF <= He3_TOF_Corr_Limit[1]) {
+      entry.TOF_Corr = Lookup_TOF_Corr(He3_TOF_Corr_Table,entry.TOF);
+    }
+    else {
+      entry.TOF_Corr = -1;
+    }
+  }
+
+  //Using the same corrections as DANCE (maybe this is good maybe not. IDK)
+  //Calculate corrected Bkg TOF
+  if(entry.ID == Bkg_ID) {
+    if(entry.TOF >= DANCE_TOF_Corr_Limit[0] && entry.TOF <= DANCE_TOF_Corr_Limit[1]) {
+      entry.TOF_Corr = Lookup_TOF_Corr(DANCE_TOF_Corr_Table,entry.TOF);
+    }
+    else {
+      entry.TOF_Corr = -1;
+    }
+  }
+}
+
+//Timing pass: writes the entries to the output binary, fills the ID histograms and works out the TOF from the last T0 before each entry
+static void Eventbuild_Timing(Sorted_Buffer &datadeque, size_t first, size_t last, const Input_Parameters &input_params, Analysis_Parameters *analysis_params) {
+
+  int64_t last_T0 = analysis_params->last_timestamp[T0_ID];
+
+  for(size_t eye=first; eye<last; eye++) {
+
+    DEVT_BANK &entry = datadeque[eye];
+
+    //First write the data to the output binary file if needed
+    if(input_params.Write_Binary==1 && outputbinfile.is_open()) {
+      if(input_params.WF_Integral){      	//if specified in cfg file, writing WF Integral to binaries
+	devt_out_wf.Ifast = entry.Ifast;
+	devt_out_wf.Islow = entry.Islow;
+	devt_out_wf.timestamp = Time_To_ns(entry.timestamp);
+	devt_out_wf.wfintegral = entry.wfintegral;
+	devt_out_wf.ID = entry.ID;
+	outputbinfile.write(reinterpret_cast<char*>(&devt_out_wf),sizeof(DEVT_STAGE1_WF));
       }
-      
-      //Using the same corrections as DANCE (maybe this is good maybe not. IDK)
-      //Calculate corrected Bkg TOF
-      if(datadeque[0].ID == Bkg_ID) {
-	//Correct the TOF for moderation time between ~0 and ~10 MeV
-	if( datadeque[0].TOF >= DANCE_TOF_Corr_Limit[0] && datadeque[0].TOF <= DANCE_TOF_Corr_Limit[1]) {
-	  datadeque[0].TOF_Corr = gr_DANCE_TOF_Corr->Eval(datadeque[0].TOF);
-	}
-	else {
-	  datadeque[0].TOF_Corr = -1;
-	}
+      else{                                  //not writing WF Integral to binaries
+	devt_out.Ifast = entry.Ifast;
+	devt_out.Islow = entry.Islow;
+	devt_out.timestamp = Time_To_ns(entry.timestamp);
+	devt_out.ID = entry.ID;
+	outputbinfile.write(reinterpret_cast<char*>(&devt_out),sizeof(DEVT_STAGE1));
       }
-      
+      analysis_params->entries_written_to_binary++;
+    }
+
+    //ID
+    hID_Raw->Fill(entry.channel+(entry.board*16));  //Channel + (Board *16)
+    hID->Fill(entry.ID,1);
 
-      //Do the calibrations and validity checks for DANCE
-      if(datadeque[0].ID < 162) {
-	
-	//Calibrate the energy
-	Calibrate_DANCE(&datadeque[0]);
+    Energy_raw_ID->Fill(entry.Islow,entry.ID,1);
 
-	//Check to see crystal blocking time
-	Check_Crystal_Blocking(&datadeque[0],analysis_params,input_params);
-	
-	//The crystal blocking time has to be checked first since it effects the "effective" detector load for the deadtime code. 
-	//This mimics having a longer integration window for the long charge integral
+    //Calculate TOF now (difference between this timestamp and the last T0
+    entry.TOF = Time_To_ns(entry.timestamp - last_T0);
+    if(entry.ID == T0_ID) {
+      last_T0 = entry.timestamp;
+    }
 
-	//Detector load	
+    Correct_TOF(entry);
+  }
+}
+
+//Calibration pass: calibrates the energies of the DANCE crystals
+static void Eventbuild_Calibration(Sorted_Buffer &datadeque, size_t first, size_t last) {
+
+  for(size_t eye=first; eye<last; eye++) {
+    if(datadeque[eye].ID < 162) {
+      Calibrate_DANCE(&datadeque[eye]);
+    }
+  }
+}
+
+//Validation pass: the validity checks in time order against the last hit of each detector, the PSD histograms, and the last hit updates.
+//The sweep variants (NSweep_Variants) are validated without the histograms (fill_histograms false), which are for the cfg file parameters
+static void Eventbuild_Validation(Sorted_Buffer &datadeque, size_t first, size_t last, const Input_Parameters &input_params, Analysis_Parameters *analysis_params,
+				  bool fill_histograms) {
+
+  for(size_t eye=first; eye<last; eye++) {
+
+    DEVT_BANK &entry = datadeque[eye];
+
+    //Do the validity checks for DANCE
+    if(entry.ID < 162) {
+
+      //Check to see crystal blocking time
+      Check_Crystal_Blocking(&entry,analysis_params,input_params);
+
+      //The crystal blocking time has to be checked first since it effects the "effective" detector load for the deadtime code.
+      //This mimics having a longer integration window for the long charge integral
+
+      //Detector load
 #ifdef Histogram_DetectorLoad
-	if(input_params.Read_Simulation==0) {
-	  if(datadeque[0].Valid) {
-	    if(analysis_params->last_timestamp[T0_ID] > 0) {
-	      uint32_t temptof = (uint32_t) gr_DANCE_TOF_Corr->Eval((datadeque[0].timestamp-analysis_params->last_timestamp[T0_ID]));
-	      if(temptof>0) {
-		if(input_params.Crystal_Blocking_Time > input_params.Long_Gate) {
-		  for(int el=(int)temptof; el<((int)(temptof+input_params.Crystal_Blocking_Time)); el++) {
-		    if(el >=0 && el < 100000000) {
-		      Detector_Load[el]+=1.0;
-		    }
+      if(fill_histograms && input_params.Read_Simulation==0) {
+	if(entry.Valid) {
+	  if(analysis_params->last_timestamp[T0_ID] > 0) {
+	    uint32_t temptof = (uint32_t) gr_DANCE_TOF_Corr->Eval(entry.TOF);
+	    if(temptof>0) {
+	      if(input_params.Crystal_Blocking_Time > input_params.Long_Gate) {
+		for(int el=(int)temptof; el<((int)(temptof+input_params.Crystal_Blocking_Time)); el++) {
+		  if(el >=0 && el < 100000000) {
+		    Detector_Load[el]+=1.0;
 		  }
 		}
-		else {
-		  for(int el=(int)temptof; el<((int)(temptof+input_params.Long_Gate)); el++) {
-		    if(el >=0 && el < 100000000) {
-		      Detector_Load[el]+=1.0;
-		    }
+	      }
+	      else {
+		for(int el=(int)temptof; el<((int)(temptof+input_params.Long_Gate)); el++) {
+		  if(el >=0 && el < 100000000) {
+		    Detector_Load[el]+=1.0;
 		  }
 		}
-	      } //end check on temptof
-	    } //end of check on last T0
-	  } //end of check on valid
-	} //end check on simulations
+	      }
+	    } //end check on temptof
+	  } //end of check on last T0
+	} //end of check on valid
+      } //end check on simulations
 #endif
 
-	  
-	//Check Upper Level Discriminator
-	Check_ULD(&datadeque[0]);
-	  
-	//Check Threshold 
-	Check_Threshold(&datadeque[0],input_params);
-
-	//Check to see if it is a Retrigger
-	Check_Retrigger(&datadeque[0],analysis_params);
-
-	//If still Valid
-	if(datadeque[0].Valid == 1) {
-	  
-	  if(datadeque[0].Islow>0) {
-	    //Fill the fast to slow ratio plots now
-	    hFastSlowRatio_ID->Fill((1.0*datadeque[0].Ifast)/(1.0*datadeque[0].Islow),datadeque[0].ID,1);
-	  }
-	  //Fill 2D ADC Calib
-	  ADC_calib->Fill(datadeque[0].Eslow, datadeque[0].Efast,1);
-	  ADC_raw->Fill(datadeque[0].Islow, datadeque[0].Ifast,1);
+      //Check Upper Level Discriminator
+      Check_ULD(&entry);
+
+      //Check Threshold
+      Check_Threshold(&entry,input_params);
+
+      //Check to see if it is a Retrigger
+      Check_Retrigger(&entry,analysis_params);
+
+      //If still Valid
+      if(entry.Valid == 1 && !fill_histograms) {
+	Check_Alpha(&entry);
+	if(!entry.IsAlpha) {
+	  Check_Gamma(&entry);
+	}
+      }
+      else if(entry.Valid == 1) {
+
+	if(entry.Islow>0) {
+	  //Fill the fast to slow ratio plots now
+	  hFastSlowRatio_ID->Fill((1.0*entry.Ifast)/(1.0*entry.Islow),entry.ID,1);
+	}
+	//Fill 2D ADC Calib
+	ADC_calib->Fill(entry.Eslow, entry.Efast,1);
+	ADC_raw->Fill(entry.Islow, entry.Ifast,1);
 #ifdef HighRateDebug
-          SlowID->Fill(datadeque[0].Islow,datadeque[0].ID,1);
-          FastID->Fill(datadeque[0].Ifast,datadeque[0].ID,1);
+	SlowID->Fill(entry.Islow,entry.ID,1);
+	FastID->Fill(entry.Ifast,entry.ID,1);
 #endif
-	  if(datadeque[0].pileup_detected==1) {
-	    ADC_calib_Pileup->Fill(datadeque[0].Eslow, datadeque[0].Efast,1);
-	  }
-	  else {
-	    ADC_calib_Pileup_Removed->Fill(datadeque[0].Eslow, datadeque[0].Efast,1);
-	  }
+	if(entry.pileup_detected==1) {
+	  ADC_calib_Pileup->Fill(entry.Eslow, entry.Efast,1);
+	}
+	else {
+	  ADC_calib_Pileup_Removed->Fill(entry.Eslow, entry.Efast,1);
+	}
 
-	  //Fill 3D ADC Calib vs Detector
+	//Fill 3D ADC Calib vs Detector
 #ifdef TurnOffGoSmall
-	  ADC_calib_ID->Fill(datadeque[0].Eslow, datadeque[0].Efast, datadeque[0].ID,1);
-	  ADC_raw_ID->Fill(datadeque[0].Islow, datadeque[0].Ifast,datadeque[0].ID,1);
-#endif	    
-	  //Check to see if it is an Alpha
-	  Check_Alpha(&datadeque[0]);
-	    
-	  //If it is not an alpha check to see if it is a Gamma
-	  if(!datadeque[0].IsAlpha) {
-	    Check_Gamma(&datadeque[0]);
-	  } //End of check on Alpha
-	   
-	  if(datadeque[0].IsAlpha) {
-	    hAlpha->Fill(datadeque[0].Islow, datadeque[0].ID,1);
-	    if(datadeque[0].pileup_detected==0){
-              hAlpha_noPU->Fill(datadeque[0].Islow,datadeque[0].ID,1);
-	    }
-	    hAlphaCalib->Fill(datadeque[0].Eslow, datadeque[0].ID,1);
-	    ADC_alpha->Fill(datadeque[0].Eslow, datadeque[0].Efast,1);	// JU diagnostic histogram
-	    hID_alpha->Fill(datadeque[0].ID,1);
+	ADC_calib_ID->Fill(entry.Eslow, entry.Efast, entry.ID,1);
+	ADC_raw_ID->Fill(entry.Islow, entry.Ifast,entry.ID,1);
+#endif
+	//Check to see if it is an Alpha
+	Check_Alpha(&entry);
+
+	//If it is not an alpha check to see if it is a Gamma
+	if(!entry.IsAlpha) {
+	  Check_Gamma(&entry);
+	} //End of check on Alpha
+
+	if(entry.IsAlpha) {
+	  hAlpha->Fill(entry.Islow, entry.ID,1);
+	  if(entry.pileup_detected==0){
+	    hAlpha_noPU->Fill(entry.Islow,entry.ID,1);
 	  }
-	  if(datadeque[0].IsGamma) {
-	    hGamma->Fill(datadeque[0].Islow, datadeque[0].ID,1);
-	    if(datadeque[0].pileup_detected==1) {
-	      hGammaCalib_PU->Fill(datadeque[0].Eslow, datadeque[0].ID,1);
-	    }
-	    else {
-	      hGammaCalib->Fill(datadeque[0].Eslow, datadeque[0].ID,1);
-	    }
-	    ADC_gamma->Fill(datadeque[0].Eslow, datadeque[0].Efast,1);	// JU diagnostic histogram
-	    hID_gamma->Fill(datadeque[0].ID,1);
+	  hAlphaCalib->Fill(entry.Eslow, entry.ID,1);
+	  ADC_alpha->Fill(entry.Eslow, entry.Efast,1);	// JU diagnostic histogram
+	  hID_alpha->Fill(entry.ID,1);
+	}
+	if(entry.IsGamma) {
+	  hGamma->Fill(entry.Islow, entry.ID,1);
+	  if(entry.pileup_detected==1) {
+	    hGammaCalib_PU->Fill(entry.Eslow, entry.ID,1);
+	  }
+	  else {
+	    hGammaCalib->Fill(entry.Eslow, entry.ID,1);
 	  }
-	    
+	  ADC_gamma->Fill(entry.Eslow, entry.Efast,1);	// JU diagnostic histogram
+	  hID_gamma->Fill(entry.ID,1);
 	}
-        else {
-          ADC_calib_Invalid->Fill(datadeque[0].Eslow, datadeque[0].Efast,1);
-        }
 
+      }
+      else if(fill_histograms) {
+	ADC_calib_Invalid->Fill(entry.Eslow, entry.Efast,1);
+      }
 
-	//Things that are not gammas are not in DANCE events
-	if(!datadeque[0].IsGamma) {
-	  datadeque[0].Valid = 0;
-	  //Its either an alpha
-	  if(datadeque[0].IsAlpha) {
-	    datadeque[0].InvalidReason |= Invalid::Alpha;
-	  }
-	  //or not an alpha or a gamma
-	  else { 
-            datadeque[0].InvalidReason |= Invalid::UnknownPSD;
-	  }
+      //Things that are not gammas are not in DANCE events
+      if(!entry.IsGamma) {
+	entry.Valid = 0;
+	//Its either an alpha
+	if(entry.IsAlpha) {
+	  entry.InvalidReason |= Invalid::Alpha;
 	}
+	//or not an alpha or a gamma
+	else {
+	  entry.InvalidReason |= Invalid::UnknownPSD;
+	}
+      }
 
-	//Fill some DANCE histograms
+      //Fill some DANCE histograms
+      if(fill_histograms) {
 	//Time between DANCE crystals
-	hTimeBetweenCrystals->Fill((datadeque[0].timestamp-analysis_params->last_timestamp[datadeque[0].ID]),datadeque[0].ID,1);
+	double timebetween = Time_To_ns(entry.timestamp-analysis_params->last_timestamp[entry.ID]);
+	hTimeBetweenCrystals->Fill(timebetween,entry.ID,1);
 
 	//Ratio of Efast of n/(n-1) hits vs time between n and n-1 hit
-	if(analysis_params->last_Efast[datadeque[0].ID] > 0) {
-	  hTimeBetweenCrystals_FastEnergyRatio->Fill((datadeque[0].timestamp-analysis_params->last_timestamp[datadeque[0].ID]),
-						 (datadeque[0].Efast/analysis_params->last_Efast[datadeque[0].ID]),1);
+	if(analysis_params->last_Efast[entry.ID] > 0) {
+	  hTimeBetweenCrystals_FastEnergyRatio->Fill(timebetween,(entry.Efast/analysis_params->last_Efast[entry.ID]),1);
 	}
-        
-        //Ratio of Energy of n/(n-1) hits vs time between n and n-1 hit
-	if(analysis_params->last_Eslow[datadeque[0].ID] > 0) {
-	  hTimeBetweenCrystals_EnergyRatio->Fill((datadeque[0].timestamp-analysis_params->last_timestamp[datadeque[0].ID]),
-						 (datadeque[0].Eslow/analysis_params->last_Eslow[datadeque[0].ID]),1);
+
+	//Ratio of Energy of n/(n-1) hits vs time between n and n-1 hit
+	if(analysis_params->last_Eslow[entry.ID] > 0) {
+	  hTimeBetweenCrystals_EnergyRatio->Fill(timebetween,(entry.Eslow/analysis_params->last_Eslow[entry.ID]),1);
 	}
-	
+
 	//Long/Short ratio vs Time between crystals
-	if(datadeque[0].Ifast > 0) {
-	  hTimeBetweenCrystals_LongShortRatio->Fill((datadeque[0].timestamp-analysis_params->last_timestamp[datadeque[0].ID]),
-						    datadeque[0].Islow/datadeque[0].Ifast,1);
-	}
-	
-	
-      } //End of check on DANCE Ball
-
-      //Check on time between T0s to remove any "junk" T0s.  
-      //Nominal is 20 Hz (50e6 ns) so if they are not at least 1e6 ns apart then they are useless...
-      if(datadeque[0].ID == T0_ID) {
-	if(((datadeque[0].timestamp - analysis_params->last_timestamp[T0_ID]) < 1e6) && (analysis_params->last_timestamp[T0_ID])>0 ) {
-	  datadeque[0].Valid=0;      
+	if(entry.Ifast > 0) {
+	  hTimeBetweenCrystals_LongShortRatio->Fill(timebetween,entry.Islow/entry.Ifast,1);
 	}
       }
+
+    } //End of check on DANCE Ball
+
+    //Check on time between T0s to remove any "junk" T0s.
+    //Nominal is 20 Hz (50e6 ns) so if they are not at least 1e6 ns apart then they are useless...
+    if(entry.ID == T0_ID) {
+      if(((entry.timestamp - analysis_params->last_timestamp[T0_ID]) < Time_From_ns(1e6)) && (analysis_params->last_timestamp[T0_ID])>0 ) {
+	entry.Valid=0;
+      }
+    }
 #ifdef InvalidDetails
-      if (datadeque[0].Valid !=1) {
-	  
-         if (analysis_params->last_Alpha[datadeque[0].ID])
-            hID_alpha_Invalid->Fill(datadeque[0].ID,1);
-         if (analysis_params->last_Gamma[datadeque[0].ID])
-            hID_gamma_Invalid->Fill(datadeque[0].ID,1);
-         if (analysis_params->last_InvalidReason[datadeque[0].ID]>1){
-           hID_invalid_Invalid->Fill(datadeque[0].ID,1);
-         }
-        InvalidReason_ID->Fill(datadeque[0].InvalidReason,datadeque[0].ID,1); 
+    if (fill_histograms && entry.Valid !=1) {
+
+      if (analysis_params->last_Alpha[entry.ID])
+	hID_alpha_Invalid->Fill(entry.ID,1);
+      if (analysis_params->last_Gamma[entry.ID])
+	hID_gamma_Invalid->Fill(entry.ID,1);
+      if (analysis_params->last_InvalidReason[entry.ID]>1){
+	hID_invalid_Invalid->Fill(entry.ID,1);
       }
+      InvalidReason_ID->Fill(entry.InvalidReason,entry.ID,1);
+    }
 #endif
 
-      //Update analysis params
-      if (datadeque[0].ID == T0_ID) {
-        analysis_params->last_last_T0=analysis_params->last_timestamp[T0_ID];
-      }
-      analysis_params->last_timestamp[datadeque[0].ID] = datadeque[0].timestamp;
-      analysis_params->last_Islow[datadeque[0].ID] = datadeque[0].Islow;
-      analysis_params->last_Eslow[datadeque[0].ID] = datadeque[0].Eslow;
-      analysis_params->last_Efast[datadeque[0].ID] = datadeque[0].Efast;
-      analysis_params->last_Alpha[datadeque[0].ID] = datadeque[0].IsAlpha;
-      analysis_params->last_Gamma[datadeque[0].ID] = datadeque[0].IsGamma;
-      analysis_params->last_InvalidReason[datadeque[0].ID] = datadeque[0].InvalidReason;
-
-      //If not valid
-      if(datadeque[0].Valid != 1) {
-	analysis_params->entries_invalid++;
-	hID_Invalid->Fill(datadeque[0].ID);
-        if ((datadeque[0].InvalidReason >= 8 && datadeque[0].InvalidReason <32) || datadeque[0].InvalidReason >= 40) {
-          hID_Invalid_Retrigger->Fill(datadeque[0].ID);
-        }
+    //Update analysis params
+    if (entry.ID == T0_ID) {
+      analysis_params->last_last_T0=analysis_params->last_timestamp[T0_ID];
+    }
+    analysis_params->last_timestamp[entry.ID] = entry.timestamp;
+    analysis_params->last_Islow[entry.ID] = entry.Islow;
+    analysis_params->last_Eslow[entry.ID] = entry.Eslow;
+    analysis_params->last_Efast[entry.ID] = entry.Efast;
+    analysis_params->last_Alpha[entry.ID] = entry.IsAlpha;
+    analysis_params->last_Gamma[entry.ID] = entry.IsGamma;
+    analysis_params->last_InvalidReason[entry.ID] = entry.InvalidReason;
+
+    //If not valid
+    if(entry.Valid != 1) {
+      analysis_params->entries_invalid++;
+      if(fill_histograms) {
+	hID_Invalid->Fill(entry.ID);
+	if ((entry.InvalidReason >= 8 && entry.InvalidReason <32) || entry.InvalidReason >= 40) {
+	  hID_Invalid_Retrigger->Fill(entry.ID);
+	}
 
-	hInvalid_Reason->Fill(datadeque[0].InvalidReason);
+	hInvalid_Reason->Fill(entry.InvalidReason);
+      }
 #ifdef Eventbuilder_Verbose
-	cout<<RED<<"Eventbuilder: throwing away ID "<<datadeque[0].ID<<RESET<<endl;
+      cout<<RED<<"Eventbuilder: throwing away ID "<<entry.ID<<RESET<<endl;
 #endif
-	datadeque.pop_front();  //remove the first entry in the deque
+    }
+    //If valid update the analysis params
+    else {
+      analysis_params->last_valid_timestamp[entry.ID] = entry.timestamp;
+      analysis_params->last_valid_Islow[entry.ID] = entry.Islow;
+      analysis_params->last_valid_Eslow[entry.ID] = entry.Eslow;
+    }
+  }
+}
 
-      }       
-      //Eventbuild the valid entries
-      else {
+//Adds an entry to a DANCE event vector.  It is reused from event to event, so it should only grow for the first events
+static inline void Add_To_DANCE_Event(std::vector<DEVT_BANK> &eventvector, const DEVT_BANK &entry, Analysis_Parameters *counters) {
 
-	//If valid update the analysis params
-	analysis_params->last_valid_timestamp[datadeque[0].ID] = datadeque[0].timestamp;
-	analysis_params->last_valid_Islow[datadeque[0].ID] = datadeque[0].Islow;
-	analysis_params->last_valid_Eslow[datadeque[0].ID] = datadeque[0].Eslow;
-
-	//Handle the DANCE Ball
-	if(datadeque[0].ID < 162) {
-	
-	  //first thing just goes
-	  if(DANCE_eventvector.size() == 0) {
-	    DANCE_eventvector.push_back(datadeque[0]); //put the first event in the events vector
-	    datadeque.pop_front();  //remove the first entry in the deque
-	    analysis_params->entries_built++;
-	  }
-	  //subsequent things are subject to coincidence windows
-	  else{
-	    //In the window
-	    if(datadeque[0].timestamp-DANCE_eventvector[0].timestamp < input_params.Coincidence_Window) {
-	      DANCE_eventvector.push_back(datadeque[0]); //put the first event in the events vector
-	      datadeque.pop_front();  //remove the first entry in the deque     
-	      analysis_params->entries_built++;
-         if (DANCE_eventvector.size()>160) {cout << "event vector is huge " << setprecision(14)<< datadeque[0].timestamp-DANCE_eventvector[0].timestamp<<" " << DANCE_eventvector.size() << endl;} 
-	    }
-	    //Out of the window
-	    else {
-	      //Analyze
-#ifdef Eventbuilder_Verbose
-	      cout<<"Eventbuilder: Processing DANCE Event with Size: "<<DANCE_eventvector.size()<<"  " <<datadeque.size()<<" Entries in the deque"<<endl;
+  if(eventvector.size() == eventvector.capacity()) {
+    counters->event_vector_reallocations++;
+  }
+  eventvector.push_back(entry);
+}
 
+//Events go to the analyzer, or into the event batch with the last T0 and beam monitor times when the analyzer is on its own thread.
+//window is 0 for the Coincidence_Window and the number of the scanned window (from 1) for NCoincidence_Scan
+static inline void Send_Event(const DEVT_BANK *entries, size_t nentries, int window, Event_Batch *batch, const Input_Parameters &input_params,
+			      Analysis_Parameters *analysis_params) {
 
-#endif
-	      //Send it to the analyzer
-	      Analyze_Data(DANCE_eventvector, input_params, analysis_params);
-
-	      //Clear
-	      DANCE_eventvector.clear();
-	    
-	      //Put the entry at the start of the vector
-	      DANCE_eventvector.push_back(datadeque[0]); //put the first event in the events vector
-	      datadeque.pop_front();  //remove the first entry in the deque     
-	      analysis_params->events_built++;
-	      analysis_params->entries_built++;
-          
-  	    }
-	  } 	
-	}
-	
-	else if(datadeque[0].ID == Li6_ID || datadeque[0].ID == He3_ID ||  datadeque[0].ID == U235_ID ||  datadeque[0].ID == Bkg_ID) {
-	
-	  BM_eventvector.push_back(datadeque[0]); //put the first event in the events vector
-	  datadeque.pop_front();  //remove the first entry in the deque
-	  analysis_params->events_built++;
-	  analysis_params->entries_built++;
+  if(batch) {
+    batch->Add_Event(entries,nentries,window,analysis_params);
+  }
+  else {
+    Analyze_Data(entries,nentries,input_params,analysis_params);
+  }
+}
+
+//Grouping pass: puts the valid entries into DANCE, beam monitor and T0 events and sends them to the analyzer.  The analyzer looks at the
+//last T0 and the last hit of the beam monitors as they were when the event was closed, so the last timestamps are put back to how they
+//were before the batch (last_timestamp_start, last_last_T0_start) and brought forward one entry at a time again here.  The pass is run
+//once for each coincidence window: window 0 is the Coincidence_Window, and the scanned windows (from 1) build their own DANCE events and
+//count what they build in scan_params.  eventvector is the DANCE event being built, and the events go into batch (NULL analyzes them)
+static void Eventbuild_Grouping(Sorted_Buffer &datadeque, size_t first, size_t last, std::vector<DEVT_BANK> &eventvector, int window, Event_Batch *batch,
+				const Input_Parameters &input_params, Analysis_Parameters *analysis_params, const int64_t *last_timestamp_start, int64_t last_last_T0_start) {
+
+  int64_t window_ticks = window == 0 ? input_params.Coincidence_Window_Ticks : input_params.Coincidence_Scan_Ticks[window-1];
+  Analysis_Parameters *counters = window == 0 ? analysis_params : &scan_params[window-1];
+
+  memcpy(analysis_params->last_timestamp,last_timestamp_start,sizeof(analysis_params->last_timestamp));
+  analysis_params->last_last_T0 = last_last_T0_start;
+
+  for(size_t eye=first; eye<last; eye++) {
+
+    DEVT_BANK &entry = datadeque[eye];
+
+    if (entry.ID == T0_ID) {
+      analysis_params->last_last_T0=analysis_params->last_timestamp[T0_ID];
+    }
+    analysis_params->last_timestamp[entry.ID] = entry.timestamp;
+
+    //Invalid entries were counted in the validation pass
+    if(entry.Valid != 1) {
+      continue;
+    }
 
+    //Handle the DANCE Ball
+    if(entry.ID < 162) {
+
+      //first thing just goes
+      if(eventvector.size() == 0) {
+	Add_To_DANCE_Event(eventvector,entry,counters); //put the first event in the events vector
+	counters->entries_built++;
+      }
+      //subsequent things are subject to coincidence windows
+      else{
+	//In the window
+	if(entry.timestamp-eventvector[0].timestamp < window_ticks) {
+	  Add_To_DANCE_Event(eventvector,entry,counters); //put the entry in the events vector
+	  counters->entries_built++;
+	  if (eventvector.size()>160) {cout << "event vector is huge " << setprecision(14)<< Time_To_ns(entry.timestamp-eventvector[0].timestamp)<<" " << eventvector.size() << endl;}
+	}
+	//Out of the window
+	else {
+	  //Analyze
 #ifdef Eventbuilder_Verbose
-	  cout<<"Eventbuilder: Processing BM Event with Size: "<<BM_eventvector.size()<<"  " <<datadeque.size()<<" Entries in the deque"<<endl;
+	  cout<<"Eventbuilder: Processing DANCE Event with Size: "<<eventvector.size()<<"  " <<datadeque.size()-eye<<" Entries in the deque"<<endl;
 #endif
 	  //Send it to the analyzer
-	   Analyze_Data(BM_eventvector, input_params, analysis_params);  
-	
+	  Send_Event(eventvector.data(), eventvector.size(), window, batch, input_params, analysis_params);
+
 	  //Clear
-	  BM_eventvector.clear();
+	  eventvector.clear();
+
+	  //Put the entry at the start of the vector
+	  Add_To_DANCE_Event(eventvector,entry,counters); //put the entry in the events vector
+	  counters->events_built++;
+	  counters->entries_built++;
 	}
-       	
-	else if(datadeque[0].ID == T0_ID) {
-	  T0_eventvector.push_back(datadeque[0]); //put the first event in the events vector
-	  datadeque.pop_front();  //remove the first entry in the deque
-	  analysis_params->events_built++;
-	  analysis_params->entries_built++;
+      }
+    }
+
+    else if(entry.ID == Li6_ID || entry.ID == He3_ID ||  entry.ID == U235_ID ||  entry.ID == Bkg_ID) {
+
+      counters->events_built++;
+      counters->entries_built++;
 
 #ifdef Eventbuilder_Verbose
-	  cout<<"Eventbuilder: Processing T0 Event with Size: "<<T0_eventvector.size()<<"  " <<datadeque.size()<<" Entries in the deque"<<endl;
+      cout<<"Eventbuilder: Processing BM Event with Size: 1  " <<datadeque.size()-eye<<" Entries in the deque"<<endl;
 #endif
-	  //Send it to the analyzer
-	  Analyze_Data(T0_eventvector, input_params, analysis_params);   
-	  
-	  //Clear
-	  T0_eventvector.clear();
-	}
+      //Send it to the analyzer straight from the buffer
+      Send_Event(&entry, 1, window, batch, input_params, analysis_params);
+    }
+
+    else if(entry.ID == T0_ID) {
+      counters->events_built++;
+      counters->entries_built++;
 
-	else {
 #ifdef Eventbuilder_Verbose
-	  cout<<RED<<"Eventbuilder: throwing away ID "<<datadeque[0].ID<<RESET<<endl;
+      cout<<"Eventbuilder: Processing T0 Event with Size: 1  " <<datadeque.size()-eye<<" Entries in the deque"<<endl;
 #endif
-	  analysis_params->Unknown_entries++;
-	  datadeque.pop_front();  //remove the first entry in the deque     
-	}
-      } //End of check on valid event
+      //Send it to the analyzer straight from the buffer
+      Send_Event(&entry, 1, window, batch, input_params, analysis_params);
+    }
 
-      if(datadeque.size()==0) {
-	//	event_build=false;
-	break;
-      }
-      
+    else {
+#ifdef Eventbuilder_Verbose
+      cout<<RED<<"Eventbuilder: throwing away ID "<<entry.ID<<RESET<<endl;
+#endif
+      counters->Unknown_entries++;
+    }
+  }
+}
+
+void Set_Event_Batch(Event_Batch *batch) {
+  event_batch = batch;
+}
+
+//Entries and events built with each scanned coincidence window, for the end of the run
+void Report_Coincidence_Scan(const Input_Parameters &input_params) {
+
+  for(int eye=0; eye<input_params.NCoincidence_Scan; eye++) {
+    emsg.str("");
+    emsg<<"Coincidence Window "<<input_params.Coincidence_Scan[eye]<<" ns: "<<scan_params[eye].entries_built<<" Entries Built into "<<scan_params[eye].events_built<<" Events";
+    DANCE_Info("Eventbuilder",emsg.str());
+  }
+}
+
+int Build_Events(Sorted_Buffer &datadeque, Input_Parameters input_params, Analysis_Parameters *analysis_params) {
+
+#ifdef Eventbuilder_Verbose
+  cout<<"Eventbuilder: About to event build deque size: "<<datadeque.size()<<endl;
+#endif
+
+  if(datadeque.size() == 0) {
+    return 0;
+  }
+
+  //Buffer depth in time ticks
+  int64_t buffer_depth = Time_From_ns(1000000000.0*analysis_params->buffer_depth);
+
+  //The entries at least a buffer depth older than the latest entry can be event built.  The buffer is time ordered so they are the
+  //front of it up to the first entry past the release time
+  int64_t release_time = datadeque.back().timestamp - buffer_depth;
+  size_t low = 0;
+  size_t high = datadeque.size();
+  while(low < high) {
+    size_t mid = low + (high - low)/2;
+    if(datadeque[mid].timestamp <= release_time) {
+      low = mid + 1;
     }
     else {
+      high = mid;
+    }
+  }
+  size_t nrelease = low;
+
+  if(nrelease > 0) {
+    //we have started to build
+    analysis_params->event_building_active=true;
+  }
+
+  //Eventbuild the released entries a batch at a time, with each pass going over the whole batch before the next one starts
+  int64_t last_timestamp_start[256];
+  while(nrelease > 0) {
+
+    size_t nbatch = nrelease < Eventbuilder_Batch ? nrelease : Eventbuilder_Batch;
+
+    memcpy(last_timestamp_start,analysis_params->last_timestamp,sizeof(last_timestamp_start));
+    int64_t last_last_T0_start = analysis_params->last_last_T0;
+
+    Eventbuild_Timing(datadeque,0,nbatch,input_params,analysis_params);
+    Eventbuild_Calibration(datadeque,0,nbatch);
+
+    //The sweep variants are validated and grouped on their own analysis workers from the timed and calibrated entries
+    if(event_batch && input_params.NSweep_Variants > 0) {
+      for(size_t eye=0; eye<nbatch; eye++) {
+	event_batch->sweep_entries.push_back(datadeque[eye]);
+      }
+    }
+
+    Eventbuild_Validation(datadeque,0,nbatch,input_params,analysis_params,true);
+    Eventbuild_Grouping(datadeque,0,nbatch,DANCE_eventvector,0,event_batch,input_params,analysis_params,last_timestamp_start,last_last_T0_start);
+
+    //The scanned coincidence windows group the same entries into their own events for the analysis stage of the pipeline
+    if(event_batch) {
+      for(int window=1; window<=input_params.NCoincidence_Scan; window++) {
+	Eventbuild_Grouping(datadeque,0,nbatch,Scan_eventvector[window-1],window,event_batch,input_params,analysis_params,last_timestamp_start,last_last_T0_start);
+      }
+    }
+
+    analysis_params->entries_processed += nbatch;
+    datadeque.pop_front(nbatch);  //remove the batch from the front of the deque
+    nrelease -= nbatch;
+  }
+
 #ifdef Eventbuilder_Verbose
-      cout<<"Eventbuilder: event build complete: "<<datadeque.size()<<endl;
+  cout<<"Eventbuilder: event build complete: "<<datadeque.size()<<endl;
 #endif
+
+  return 0;
+
+}
+
+//Validates, groups and analyzes all of the timed and calibrated entries of a sweep variant (NSweep_Variants) on its analysis worker.
+//input_params has the blocking times and threshold of the variant, and analysis_params, datadeque and eventvector (the DANCE event being
+//built) belong to the variant, so nothing is shared with the eventbuilder of the cfg file parameters
+int Build_Sweep_Events(Sorted_Buffer &datadeque, std::vector<DEVT_BANK> &eventvector, const Input_Parameters &input_params, Analysis_Parameters *analysis_params) {
+
+  int64_t last_timestamp_start[256];
+  while(datadeque.size() > 0) {
+
+    size_t nbatch = datadeque.size() < Eventbuilder_Batch ? datadeque.size() : Eventbuilder_Batch;
+
+    memcpy(last_timestamp_start,analysis_params->last_timestamp,sizeof(last_timestamp_start));
+    int64_t last_last_T0_start = analysis_params->last_last_T0;
+
+    Eventbuild_Validation(datadeque,0,nbatch,input_params,analysis_params,false);
+    Eventbuild_Grouping(datadeque,0,nbatch,eventvector,0,NULL,input_params,analysis_params,last_timestamp_start,last_last_T0_start);
+
+    analysis_params->entries_processed += nbatch;
+    datadeque.pop_front(nbatch);
+  }
+
+  return 0;
+}
+
+//Linear interpolation between the points of a TOF correction (sorted by measured TOF), the same as TGraph::Eval
+static double Interpolate_TOF_Corr(const vector<double> &measured, const vector<double> &corrected, double tof) {
+
+  size_t upper = upper_bound(measured.begin(),measured.end(),tof) - measured.begin();
+  if(upper < 1) {
+    upper = 1;
+  }
+  if(upper > measured.size() - 1) {
+    upper = measured.size() - 1;
+  }
+  size_t lower = upper - 1;
+
+  if(measured[upper] == measured[lower]) {
+    return corrected[lower];
+  }
+  return corrected[lower] + (tof - measured[lower])*(corrected[upper] - corrected[lower])/(measured[upper] - measured[lower]);
+}
+
+//Resamples a TOF correction into a table in log(TOF) between the limits.  The number of bins starts at TOF_Corr_Min_Bins and is doubled
+//until the table is within TOF_Corr_Tolerance (relative to the TOF) of the points, checked at the points themselves and at the middle of
+//every bin, or it reaches TOF_Corr_Max_Bins.  The largest difference from TGraph::Eval at the same TOFs is reported
+static int Make_TOF_Corr_Table(TOF_Corr_Table &table, string name, int npoints, const double *tof_measured, const double *tof, const double *limit, TGraph *graph) {
+
+  if(npoints < 2 || limit[0] <= 0 || limit[1] <= limit[0]) {
+    emsg.str("");
+    emsg<<"The "<<name<<" TOF Correction needs at least 2 points and positive limits, got "<<npoints<<" points from "<<limit[0]<<" to "<<limit[1]<<" ns";
+    DANCE_Error("Eventbuilder",emsg.str());
+    return -1;
+  }
+
+  //Points sorted by measured TOF
+  vector<pair<double,double> > points(npoints);
+  for(int eye=0; eye<npoints; eye++) {
+    points[eye] = make_pair(tof_measured[eye],tof[eye]);
+  }
+  sort(points.begin(),points.end());
+  vector<double> measured(npoints);
+  vector<double> corrected(npoints);
+  for(int eye=0; eye<npoints; eye++) {
+    measured[eye] = points[eye].first;
+    corrected[eye] = points[eye].second;
+  }
+
+  //The TOFs the table is checked at
+  vector<double> check_tof;
+  double max_deviation = 0;
+
+  for(table.nbins = TOF_Corr_Min_Bins; ; table.nbins *= 2) {
+
+    table.log_low = log(limit[0]);
+    table.inv_step = table.nbins/(log(limit[1]) - table.log_low);
+    table.moderation.resize(table.nbins+1);
+
+    for(int eye=0; eye<=table.nbins; eye++) {
+      double node_tof = (eye == table.nbins) ? limit[1] : exp(table.log_low + eye/table.inv_step);
+      table.moderation[eye] = node_tof - Interpolate_TOF_Corr(measured,corrected,node_tof);
+    }
+
+    check_tof.clear();
+    for(int eye=0; eye<npoints; eye++) {
+      if(measured[eye] >= limit[0] && measured[eye] <= limit[1]) {
+	check_tof.push_back(measured[eye]);
+      }
+    }
+    for(int eye=0; eye<table.nbins; eye++) {
+      check_tof.push_back(exp(table.log_low + (eye + 0.5)/table.inv_step));
+    }
+
+    max_deviation = 0;
+    for(size_t eye=0; eye<check_tof.size(); eye++) {
+      double deviation = fabs(Lookup_TOF_Corr(table,check_tof[eye]) - Interpolate_TOF_Corr(measured,corrected,check_tof[eye]))/check_tof[eye];
+      if(deviation > max_deviation) {
+	max_deviation = deviation;
+      }
+    }
+
+    if(max_deviation <= TOF_Corr_Tolerance || table.nbins >= TOF_Corr_Max_Bins) {
       break;
     }
   }
 
+  //Compare to the graph
+  double max_graph_deviation = 0;
+  double max_graph_relative = 0;
+  for(size_t eye=0; eye<check_tof.size(); eye++) {
+    double deviation = fabs(Lookup_TOF_Corr(table,check_tof[eye]) - graph->Eval(check_tof[eye]));
+    if(deviation > max_graph_deviation) {
+      max_graph_deviation = deviation;
+    }
+    if(deviation/check_tof[eye] > max_graph_relative) {
+      max_graph_relative = deviation/check_tof[eye];
+    }
+  }
 
-  return 0;
+  emsg.str("");
+  emsg<<name<<" TOF Correction table: "<<table.nbins<<" bins in log(TOF) from "<<limit[0]<<" to "<<limit[1]<<" ns, largest difference from TGraph::Eval "
+      <<max_graph_deviation<<" ns ("<<max_graph_relative<<" of the TOF)";
+  if(max_deviation > TOF_Corr_Tolerance) {
+    emsg<<", more than the tolerance of "<<TOF_Corr_Tolerance<<" at the largest table size";
+  }
+  DANCE_Info("Eventbuilder",emsg.str());
 
+  return 0;
 }
 
 //This function fetches the TOF Correction plots for the moderation time 
@@ -683,7 +1103,18 @@ int Read_Moderation_Time_Graphs() {
     Li6_TOF_Corr_Limit[1] = Li6_TOF_Measured[0];
     He3_TOF_Corr_Limit[0] = He3_TOF_Measured[N-1];
     He3_TOF_Corr_Limit[1] = He3_TOF_Measured[0];
-       
+
+    //Lookup tables for the eventbuilder
+    int table_ret = 0;
+    table_ret += Make_TOF_Corr_Table(DANCE_TOF_Corr_Table,"DANCE",N,DANCE_TOF_Measured,DANCE_TOF,DANCE_TOF_Corr_Limit,gr_DANCE_TOF_Corr);
+    table_ret += Make_TOF_Corr_Table(U235_TOF_Corr_Table,"U235",N,U235_TOF_Measured,U235_TOF,U235_TOF_Corr_Limit,gr_U235_TOF_Corr);
+    table_ret += Make_TOF_Corr_Table(Li6_TOF_Corr_Table,"Li6",N,Li6_TOF_Measured,Li6_TOF,Li6_TOF_Corr_Limit,gr_Li6_TOF_Corr);
+    table_ret += Make_TOF_Corr_Table(He3_TOF_Corr_Table,"He3",N,He3_TOF_Measured,He3_TOF,He3_TOF_Corr_Limit,gr_He3_TOF_Corr);
+    if(table_ret != 0) {
+      DANCE_Error("Eventbuilder","Faild to make the TOF Correction tables");
+      return -1;
+    }
+
     DANCE_Success("Eventbuilder","Read TOF Corrections");
     return 0;
   }
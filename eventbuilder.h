@@ -52,12 +52,12 @@
 
 //File includes
 #include "structures.h"
+#include "sorted_buffer.h"
 
 //C/C++ includes
 #include <iostream>
 #include <sstream>
 #include <fstream>
-#include <deque>
 #include <vector>
 #include <stdlib.h>
 
@@ -68,12 +68,18 @@
 #include "TMath.h"
 #include "TGraph.h"
 
+//Events built for the analysis stage of the pipeline (pipeline.h)
+struct Event_Batch;
+
 int Open_Binary(Input_Parameters input_params);
 bool Close_Binary();
 
 int Initialize_Eventbuilder(Input_Parameters input_params);
   
-int Build_Events(std::deque<DEVT_BANK> &datadeque, Input_Parameters input_params,Analysis_Parameters *analysis_params);
+int Build_Events(Sorted_Buffer &datadeque, Input_Parameters input_params,Analysis_Parameters *analysis_params);
+void Set_Event_Batch(Event_Batch *batch);
+int Build_Sweep_Events(Sorted_Buffer &datadeque, std::vector<DEVT_BANK> &eventvector, const Input_Parameters &input_params, Analysis_Parameters *analysis_params);
+void Report_Coincidence_Scan(const Input_Parameters &input_params);
 
 int Create_Eventbuilder_Histograms(Input_Parameters input_params);
 int Write_Eventbuilder_Histograms(TFile *fout,Input_Parameters input_params, Analysis_Parameters *analysis_params);
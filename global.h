@@ -63,6 +63,15 @@
 //#define InvalidDetails             // histograms that are separated by event type before the invalid event
 //#define HighRateDebug		    // histograms useful for debugging in weird conditions, normally not so useful
 #define TurnOffGoSmall		    // turns off some of the debugging 3D histos, not super helpful
+//#define Validate_Probe_Unpacker    // checks the vectorized probe unpacking against the scalar decoder for every waveform (slow)
+//#define Validate_ChAgg_Decoders    // checks the specialized channel aggregate decoders against the generic ones at startup
+//#define Validate_Channel_Table     // checks the channel table against the DANCE map and the per ID time offsets at startup
+//#define Validate_X27xx_Decoder     // round trips synthetic events through the x27xx DPP-PSD decoder at startup
+//#define Sort_Merge_Streams         // time orders blocks by merging the channel streams instead of radix sorting the (key, index) pairs
+//#define Validate_Time_Grouping     // checks that event building on the integer time ticks groups synthetic entries like the ns timestamps at startup
+//#define Validate_Window_Sort       // checks the window sort of the stage 1 blocks against the radix sort on every block
+//#define Validate_Analysis_Units    // analyzes every event on the pipeline analysis thread as well and checks every histogram of the analysis workers against it (slow, not with Make_Removed_Spectra)
+//#define Benchmark_Block_Sort       // times heapSort, radixSort, streamMergeSort and the window sort on synthetic blocks of Block_Buffer_Size entries at startup
 
 //Verbosity
 //#define Calibrator_Verbose       //This turns on the messages from the calibrator
@@ -82,10 +91,51 @@
 #define ProgressInterval 1000000  //Progress bar increments
 
 //Some Global Unpacker Variables (DONT CHANGE UNLESS NEEDED)
-//size of the block buffer (this has implications for unpacking speed.  Too many sorts and there will be too much overhead.  Not enough and NlogN is too big.  N*log(N) vs k*n*log(n) where k*n=N)
-#define BlockBufferSize 250000 
-//size of the DEVT array in the unpacker
-#define MaxDEVTArrSize 300000  //this should be a number bigger than the block buffer size but too much bigger or else the RAM load will be high. Enable CheckBufferDepth to see how it is behaving
+//The block size (Block_Buffer_Size) and the size of the DEVT array (DEVT_Array_Size) are set in the cfg file.  The DEVT array has at least this many entries
+//more than a block for the MIDAS event or stage1 read that ends the block
+#define DEVT_Array_Headroom 50000
+//The buffer depth is raised to this many times the lateness of the latest entries seen
+#define Buffer_Depth_Margin 2.0
+//Resolution of the integer times (ticks per ns, see dance_time.h).  Times up to 2^63/Time_Ticks ns (26 days of run) fit in 64 bits
+#define Time_Ticks 4096
+//Ticks by which the ns timestamps can be off from the time ticks (rounding of the time offsets), for Validate_Time_Grouping
+#define Time_Grouping_Tolerance 2
+//Streams merged by the block sort: 256 IDs, one for IDs outside the map, and the entries that come back from the sorted buffer
+#define Sort_Streams 258
+//Smallest block sorted on the sort threads (Sort_Threads in the cfg file), and samples per thread used to split the merge between them
+#define Parallel_Sort_Minimum 65536
+#define Sort_Splitter_Samples 64
+//Farthest an entry can be out of place in its channel stream before the block sort gives up on merging and fully sorts the block
+#define Sort_Stream_Disorder 64
+//Stage 1 blocks are time ordered by the window sort in a window this much wider than the spread of the time offsets (ns), and it gives up
+//and fully sorts the block when it has moved more than Sort_Window_Moves entries per entry
+#define Sort_Window_Margin 16.0
+#define Sort_Window_Moves 16
+//Number of stage1 entries read from the binaries in one go
+#define Stage1ReadSize 4096
+//Number of entries the event builder takes through its passes (timing, calibration, validation, grouping) at a time
+#define Eventbuilder_Batch 4096
+//Events in each unit of events the pipeline gives an analysis worker (Analysis_Threads in the cfg file)
+#define Analysis_Unit_Events 4096
+//Relative difference allowed between the bins of the analysis workers and one analyzer (Validate_Analysis_Units)
+#define Analysis_Units_Tolerance 1e-9
+//Most coincidence windows scanned alongside the Coincidence_Window (NCoincidence_Scan in the cfg file)
+#define Max_Coincidence_Scan 16
+//Most sets of blocking times and thresholds swept alongside the ones of the cfg file (NSweep_Variants in the cfg file)
+#define Max_Sweep_Variants 16
+//Entries the DANCE event vector has room for from the start
+#define DANCE_Event_Reserve 1024
+//The TOF corrections are resampled into tables in log(TOF) with at least TOF_Corr_Min_Bins and at most TOF_Corr_Max_Bins bins, enough to be within
+//TOF_Corr_Tolerance of the TOF_Corrections.txt points relative to the TOF (the neutron energy is off by twice that)
+#define TOF_Corr_Min_Bins 1024
+#define TOF_Corr_Max_Bins 1048576
+#define TOF_Corr_Tolerance 1.0e-5
+//Largest MIDAS event the unpacker takes as a good header when looking for the next event after corrupted data (bytes)
+#define Max_MIDAS_Event_Size 268435456
+//Length of the time bins of the scaler and diagnostics summaries in the root file (seconds)
+#define Diagnostics_Summary_Interval 60
+//Longest waveform kept by the waveform reservoirs (samples)
+#define Waveform_Reservoir_Samples 600
 //Number of Channel aggregates that can be in one channel aggregate unpack
 #define Max_ChAgg_Size 65535  //This is the maximum number of words the channel aggregate can be for the read to work properly
 #define Max_Gamma_Removed 12 //This is how far to make the gamma removed spectra
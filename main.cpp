@@ -53,6 +53,7 @@
 #include "calibrator.h"
 #include "validator.h"
 #include "eventbuilder.h"
+#include "channel_table.h"
 
 //Root include
 #include "TROOT.h"
@@ -141,6 +142,7 @@ int main(int argc, char *argv[]) {
     analysis_params.entries_invalid=0;
     analysis_params.entries_built=0;
     analysis_params.events_built=0;
+    analysis_params.event_vector_reallocations=0;
 
     analysis_params.entries_analyzed=0;
     analysis_params.DANCE_entries_analyzed=0;
@@ -159,11 +161,25 @@ int main(int argc, char *argv[]) {
     analysis_params.Bkg_events_analyzed=0;
     analysis_params.U235_events_analyzed=0;
 
+    analysis_params.corrupt_bytes_skipped=0;
+    analysis_params.corrupt_events_skipped=0;
+    analysis_params.corrupt_banks_skipped=0;
+    analysis_params.corrupt_ranges=0;
+
     analysis_params.max_buffer_utilization=0;
+    analysis_params.blocks_sorted=0;
+    analysis_params.blocks_fully_sorted=0;
+    analysis_params.blocks_window_sorted=0;
+    analysis_params.buffer_depth=0;
+    analysis_params.max_lateness=0;
+    analysis_params.max_lateness_ID=-1;
+    analysis_params.late_entries=0;
+    analysis_params.buffer_depth_raises=0;
+    analysis_params.buffer_memory_limited=false;
     
     analysis_params.first_sort=true;
     analysis_params.event_building_active=false; 
-    analysis_params.smallest_timestamp=2.814749767e14; //this is the largest the clock can be on CAEN boards
+    analysis_params.smallest_timestamp=Time_Max;
     analysis_params.largest_timestamp=0;
     analysis_params.largest_subrun_timestamp=0;
     analysis_params.last_subrun_timestamp=0;
@@ -195,6 +211,19 @@ int main(int argc, char *argv[]) {
   input_params.Use_Firmware_FineTime=false;
   input_params.Analysis_Stage = 0;
   input_params.Buffer_Depth = 10;
+  input_params.Unpacker_Threads = 1;
+  input_params.Sort_Threads = 1;
+  input_params.Pipeline = false;
+  input_params.Pipeline_Queue_Depth = 2;
+  input_params.Analysis_Threads = 1;
+  input_params.Block_Buffer_Size = 250000;
+  input_params.DEVT_Array_Size = 0;
+  input_params.Max_Buffer_Memory = 4096;
+  input_params.Recover_Corrupt_Data = false;
+  input_params.NExcluded_IDs = 0;
+  input_params.NCoincidence_Scan = 0;
+  input_params.NSweep_Variants = 0;
+  input_params.Waveform_Reservoir_Size = 0;
       
   //Control things
   int RunNum=0;
@@ -252,6 +281,15 @@ int main(int argc, char *argv[]) {
       if(item.compare("Coincidence_Window") == 0) {
       	cfgf>>input_params.Coincidence_Window;
       }
+      if(item.compare("NCoincidence_Scan") == 0) {
+	cfgf>>input_params.NCoincidence_Scan;
+	if(input_params.NCoincidence_Scan > Max_Coincidence_Scan) {
+	  input_params.NCoincidence_Scan = Max_Coincidence_Scan;
+	}
+	for(int eye=0; eye<input_params.NCoincidence_Scan; eye++) {
+	  cfgf >> input_params.Coincidence_Scan[eye];
+	}
+      }
       if(item.compare("Read_Binary") == 0) {
       	cfgf>>input_params.Read_Binary;
       }
@@ -279,6 +317,18 @@ int main(int argc, char *argv[]) {
       if(item.compare("Energy_Threshold") == 0) {
 	cfgf>>input_params.Energy_Threshold;
       }  
+      if(item.compare("NSweep_Variants") == 0) {
+	cfgf>>input_params.NSweep_Variants;
+	if(input_params.NSweep_Variants > Max_Sweep_Variants) {
+	  input_params.NSweep_Variants = Max_Sweep_Variants;
+	}
+	for(int eye=0; eye<input_params.NSweep_Variants; eye++) {
+	  cfgf >> input_params.Sweep_Variants[eye].Crystal_Blocking_Time;
+	  cfgf >> input_params.Sweep_Variants[eye].DEvent_Blocking_Time;
+	  cfgf >> input_params.Sweep_Variants[eye].Energy_Threshold;
+	  cfgf >> input_params.Sweep_Variants[eye].HAVE_Threshold;
+	}
+      }
       if(item.compare("FitTimeDev") == 0) {
 	cfgf>>input_params.FitTimeDev;
       } 
@@ -343,9 +393,101 @@ int main(int argc, char *argv[]) {
       if(item.compare("Buffer_Depth") == 0) {
 	cfgf>>input_params.Buffer_Depth;
       } 
+      if(item.compare("Unpacker_Threads") == 0) {
+	cfgf>>input_params.Unpacker_Threads;
+      } 
+      if(item.compare("Sort_Threads") == 0) {
+	cfgf>>input_params.Sort_Threads;
+      } 
+      if(item.compare("Pipeline") == 0) {
+	cfgf>>input_params.Pipeline;
+      } 
+      if(item.compare("Pipeline_Queue_Depth") == 0) {
+	cfgf>>input_params.Pipeline_Queue_Depth;
+      } 
+      if(item.compare("Analysis_Threads") == 0) {
+	cfgf>>input_params.Analysis_Threads;
+      } 
+      if(item.compare("Block_Buffer_Size") == 0) {
+	cfgf>>input_params.Block_Buffer_Size;
+      } 
+      if(item.compare("DEVT_Array_Size") == 0) {
+	cfgf>>input_params.DEVT_Array_Size;
+      } 
+      if(item.compare("Max_Buffer_Memory") == 0) {
+	cfgf>>input_params.Max_Buffer_Memory;
+      } 
+      if(item.compare("Recover_Corrupt_Data") == 0) {
+	cfgf>>input_params.Recover_Corrupt_Data;
+      }
+      if(item.compare("Waveform_Reservoir_Size") == 0) {
+	cfgf>>input_params.Waveform_Reservoir_Size;
+      }
+      if(item.compare("NExcluded_IDs") == 0) {
+	cfgf>>input_params.NExcluded_IDs;
+	if(input_params.NExcluded_IDs > 256) {
+	  input_params.NExcluded_IDs = 256;
+	}
+	for(int eye=0; eye<input_params.NExcluded_IDs; eye++) {
+	  cfgf >> input_params.Excluded_IDs[eye];
+	}
+      }
    
     }
 
+    //The unsorted array needs room for the block plus the record that ends it
+    if(input_params.Block_Buffer_Size < 1) {
+      input_params.Block_Buffer_Size = 250000;
+    }
+    if(input_params.DEVT_Array_Size < input_params.Block_Buffer_Size + DEVT_Array_Headroom) {
+      if(input_params.DEVT_Array_Size > 0) {
+        mmsg.str("");
+        mmsg<<"DEVT_Array_Size "<<input_params.DEVT_Array_Size<<" is too small for Block_Buffer_Size "<<input_params.Block_Buffer_Size<<".  Using "<<input_params.Block_Buffer_Size + DEVT_Array_Headroom;
+        DANCE_Info("Main",mmsg.str());
+      }
+      input_params.DEVT_Array_Size = input_params.Block_Buffer_Size + DEVT_Array_Headroom;
+    }
+
+    if(input_params.Pipeline_Queue_Depth < 1) {
+      input_params.Pipeline_Queue_Depth = 1;
+    }
+
+    //The analysis workers are part of the pipeline, and ROOT has to know there are threads making histograms
+    if(input_params.Analysis_Threads < 1) {
+      input_params.Analysis_Threads = 1;
+    }
+    if(input_params.Analysis_Threads > 1 && !input_params.Pipeline) {
+      DANCE_Info("Main","Analysis_Threads above 1 runs the analysis workers in the pipeline.  Turning on the Pipeline");
+      input_params.Pipeline = true;
+    }
+    //Each scanned coincidence window is analyzed on its own analysis worker
+    if(input_params.NCoincidence_Scan < 0) {
+      input_params.NCoincidence_Scan = 0;
+    }
+    if(input_params.NCoincidence_Scan > 0 && !input_params.Pipeline) {
+      DANCE_Info("Main","The coincidence windows of NCoincidence_Scan are analyzed in the pipeline.  Turning on the Pipeline");
+      input_params.Pipeline = true;
+    }
+    //Each sweep variant is validated, event built and analyzed on its own analysis worker
+    if(input_params.NSweep_Variants < 0) {
+      input_params.NSweep_Variants = 0;
+    }
+    if(input_params.NSweep_Variants > 0 && !input_params.Pipeline) {
+      DANCE_Info("Main","The sweep variants of NSweep_Variants are analyzed in the pipeline.  Turning on the Pipeline");
+      input_params.Pipeline = true;
+    }
+    if(input_params.Pipeline) {
+      ROOT::EnableThreadSafety();
+    }
+
+    //The eventbuilder and analyzer compare times in time ticks
+    input_params.Crystal_Blocking_Ticks = Time_From_ns(input_params.Crystal_Blocking_Time);
+    input_params.DEvent_Blocking_Ticks = Time_From_ns(input_params.DEvent_Blocking_Time);
+    input_params.Coincidence_Window_Ticks = Time_From_ns(input_params.Coincidence_Window);
+    for(int eye=0; eye<input_params.NCoincidence_Scan; eye++) {
+      input_params.Coincidence_Scan_Ticks[eye] = Time_From_ns(input_params.Coincidence_Scan[eye]);
+    }
+
     //Set the bool for QGates
     if(input_params.NQGates>0) {
       input_params.QGatedSpectra = true;
@@ -381,6 +523,13 @@ int main(int argc, char *argv[]) {
 
     cout<<"Analysis Stage: "<<input_params.Analysis_Stage<<endl;
     cout<<"Coincidence Window: "<<input_params.Coincidence_Window<<endl;
+    if(input_params.NCoincidence_Scan > 0) {
+      cout<<"Coincidence Scan:";
+      for(int eye=0; eye<input_params.NCoincidence_Scan; eye++) {
+	cout<<" "<<input_params.Coincidence_Scan[eye];
+      }
+      cout<<" ns"<<endl;
+    }
     cout<<"Read Binary: "<<input_params.Read_Binary<<endl;
     cout<<"Write Binary: "<<input_params.Write_Binary<<endl;
     cout<<"Read/Write WF Integral: "<<input_params.WF_Integral<<endl;
@@ -390,11 +539,36 @@ int main(int argc, char *argv[]) {
     }
  
     cout<<"Buffer Depth: "<<input_params.Buffer_Depth<<" seconds"<<endl;
+    cout<<"Unpacker Threads: "<<input_params.Unpacker_Threads<<endl;
+    cout<<"Sort Threads: "<<input_params.Sort_Threads<<endl;
+    cout<<"Pipeline: "<<input_params.Pipeline<<endl;
+    if(input_params.Pipeline) {
+      cout<<"Pipeline Queue Depth: "<<input_params.Pipeline_Queue_Depth<<" blocks"<<endl;
+      cout<<"Analysis Threads: "<<input_params.Analysis_Threads<<endl;
+    }
+    cout<<"Block Buffer Size: "<<input_params.Block_Buffer_Size<<" entries"<<endl;
+    cout<<"DEVT Array Size: "<<input_params.DEVT_Array_Size<<" entries"<<endl;
+    cout<<"Max Buffer Memory: "<<input_params.Max_Buffer_Memory<<" MB"<<endl;
+    cout<<"Recover Corrupt Data: "<<input_params.Recover_Corrupt_Data<<endl;
+    cout<<"Waveform Reservoir Size: "<<input_params.Waveform_Reservoir_Size<<endl;
+    if(input_params.NExcluded_IDs > 0) {
+      cout<<"Excluded IDs:";
+      for(int eye=0; eye<input_params.NExcluded_IDs; eye++) {
+	cout<<" "<<input_params.Excluded_IDs[eye];
+      }
+      cout<<endl;
+    }
      
     cout<<"Crystal Blocking Time: "<<input_params.Crystal_Blocking_Time<<endl;
     cout<<"DANCE Event Blocking Time: "<<input_params.DEvent_Blocking_Time<<endl;
     cout<<"Have Threshold: "<<input_params.HAVE_Threshold<<endl;
     cout<<"Energy Threshold: "<<input_params.Energy_Threshold<<endl;
+    for(int eye=0; eye<input_params.NSweep_Variants; eye++) {
+      cout<<"Sweep Variant "<<eye+1<<": Crystal Blocking Time "<<input_params.Sweep_Variants[eye].Crystal_Blocking_Time;
+      cout<<" DANCE Event Blocking Time "<<input_params.Sweep_Variants[eye].DEvent_Blocking_Time;
+      cout<<" Have Threshold "<<input_params.Sweep_Variants[eye].HAVE_Threshold;
+      cout<<" Energy Threshold "<<input_params.Sweep_Variants[eye].Energy_Threshold<<endl;
+    }
     cout<<"Fit Time Deviations: "<<input_params.FitTimeDev<<endl;
     cout<<"Data Format: "<<input_params.DataFormat<<endl;
     cout<<"Number of Q-Value Gates: "<<input_params.NQGates<<endl;
@@ -743,6 +917,17 @@ int main(int argc, char *argv[]) {
   if(func_ret) {
     return func_ret;
   }
+  //Build the per channel constants from the map, time deviations, calibrations, and gates
+  func_ret = Initialize_Channel_Table(input_params);
+  if(func_ret) {
+    return func_ret;
+  }
+#ifdef Validate_Channel_Table
+  func_ret = Check_Channel_Table(input_params);
+  if(func_ret) {
+    return func_ret;
+  }
+#endif
 
   //Launch the unpacker
   int events_analyzed=  Unpack_Data(gz_queue, begin, input_params, &analysis_params);
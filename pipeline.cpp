@@ -0,0 +1,857 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+
+
+
+//***************************//
+//*  pipeline.cpp           *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+//File includes
+#include "pipeline.h"
+#include "global.h"
+#include "message.h"
+#include "sort_functions.h"
+#include "eventbuilder.h"
+#include "analyzer.h"
+#include "unpacker.h"
+
+//C/C++ includes
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string.h>
+
+using namespace std;
+
+//There is one pipeline for the run
+static Unpack_Pipeline pipeline;
+
+//Counters kept by the unpacker (the decoder)
+static void Copy_Unpack_Counters(Analysis_Parameters *dest, const Analysis_Parameters *src) {
+  dest->entries_unpacked = src->entries_unpacked;
+  dest->entries_awaiting_timesort = src->entries_awaiting_timesort;
+  dest->corrupt_bytes_skipped = src->corrupt_bytes_skipped;
+  dest->corrupt_events_skipped = src->corrupt_events_skipped;
+  dest->corrupt_banks_skipped = src->corrupt_banks_skipped;
+  dest->corrupt_ranges = src->corrupt_ranges;
+  dest->smallest_timestamp = src->smallest_timestamp;
+  dest->largest_timestamp = src->largest_timestamp;
+  dest->largest_subrun_timestamp = src->largest_subrun_timestamp;
+  dest->last_subrun_timestamp = src->last_subrun_timestamp;
+  dest->wf_integral = src->wf_integral;
+}
+
+//Counters kept by the analyzer
+static void Copy_Analyzer_Counters(Analysis_Parameters *dest, const Analysis_Parameters *src) {
+  dest->entries_analyzed = src->entries_analyzed;
+  dest->DANCE_entries_analyzed = src->DANCE_entries_analyzed;
+  dest->T0_entries_analyzed = src->T0_entries_analyzed;
+  dest->He3_entries_analyzed = src->He3_entries_analyzed;
+  dest->Li6_entries_analyzed = src->Li6_entries_analyzed;
+  dest->U235_entries_analyzed = src->U235_entries_analyzed;
+  dest->Bkg_entries_analyzed = src->Bkg_entries_analyzed;
+  dest->events_analyzed = src->events_analyzed;
+  dest->DANCE_events_analyzed = src->DANCE_events_analyzed;
+  dest->T0_events_analyzed = src->T0_events_analyzed;
+  dest->He3_events_analyzed = src->He3_events_analyzed;
+  dest->Li6_events_analyzed = src->Li6_events_analyzed;
+  dest->Bkg_events_analyzed = src->Bkg_events_analyzed;
+  dest->U235_events_analyzed = src->U235_events_analyzed;
+}
+
+//Adds the analyzer counters of an analysis worker
+static void Add_Analyzer_Counters(Analysis_Parameters *dest, const Analysis_Parameters *src) {
+  dest->entries_analyzed += src->entries_analyzed;
+  dest->DANCE_entries_analyzed += src->DANCE_entries_analyzed;
+  dest->T0_entries_analyzed += src->T0_entries_analyzed;
+  dest->He3_entries_analyzed += src->He3_entries_analyzed;
+  dest->Li6_entries_analyzed += src->Li6_entries_analyzed;
+  dest->U235_entries_analyzed += src->U235_entries_analyzed;
+  dest->Bkg_entries_analyzed += src->Bkg_entries_analyzed;
+  dest->events_analyzed += src->events_analyzed;
+  dest->DANCE_events_analyzed += src->DANCE_events_analyzed;
+  dest->T0_events_analyzed += src->T0_events_analyzed;
+  dest->He3_events_analyzed += src->He3_events_analyzed;
+  dest->Li6_events_analyzed += src->Li6_events_analyzed;
+  dest->Bkg_events_analyzed += src->Bkg_events_analyzed;
+  dest->U235_events_analyzed += src->U235_events_analyzed;
+}
+
+//Runs the analyzer on events with the last times they were built with.  The analyzer counters are kept in analysis_params
+static void Analyze_Events(const vector<DEVT_BANK> &entries, const vector<Event_Record> &events, const Input_Parameters &input_params, Analysis_Parameters *analysis_params) {
+
+  for(size_t eye=0; eye<events.size(); eye++) {
+    const Event_Record &event = events[eye];
+    const DEVT_BANK *event_entries = &entries[event.first];
+
+    analysis_params->last_timestamp[event_entries[0].ID] = event.last_own;
+    analysis_params->last_timestamp[T0_ID] = event.last_T0;
+    analysis_params->last_last_T0 = event.last_last_T0;
+
+    Analyze_Data(event_entries, event.nentries, input_params, analysis_params);
+  }
+}
+
+
+//****************** Event_Batch ******************//
+
+//Copies an event into the batch with the last times the analyzer looks at.  window is 0 for the Coincidence_Window and the scanned
+//coincidence window (from 1) otherwise.  The batches are reused, so they should only grow for the first blocks
+void Event_Batch::Add_Event(const DEVT_BANK *event_entries, size_t nentries, int window, Analysis_Parameters *analysis_params) {
+
+  std::vector<Event_Record> &window_events = window == 0 ? events : scan_events[window-1];
+  if(entries.size() + nentries > entries.capacity() || window_events.size() == window_events.capacity()) {
+    analysis_params->event_vector_reallocations++;
+  }
+
+  Event_Record event;
+  event.first = entries.size();
+  event.nentries = nentries;
+  event.last_T0 = analysis_params->last_timestamp[T0_ID];
+  event.last_last_T0 = analysis_params->last_last_T0;
+  event.last_own = analysis_params->last_timestamp[event_entries[0].ID];
+  window_events.push_back(event);
+  entries.insert(entries.end(), event_entries, event_entries + nentries);
+}
+
+
+//****************** Unpack_Pipeline ******************//
+
+Unpack_Pipeline::Unpack_Pipeline() {
+  datadeque = NULL;
+  full_blocks = NULL;
+  free_blocks = NULL;
+  full_batches = NULL;
+  free_batches = NULL;
+  current = NULL;
+  unit = NULL;
+  next_worker = 0;
+  failed = false;
+  running = false;
+  start_time = 0;
+}
+
+int Unpack_Pipeline::Start(Input_Parameters input_params, Analysis_Parameters *analysis_params) {
+
+  if(running) {
+    return 0;
+  }
+  this->input_params = input_params;
+  build_params = *analysis_params;
+  analyze_params = *analysis_params;
+
+  //One block being unpacked, one being sorted and event built and Pipeline_Queue_Depth waiting in between, and the same for the event batches
+  int nslots = input_params.Pipeline_Queue_Depth + 2;
+
+  datadeque = new Sorted_Buffer(2*input_params.DEVT_Array_Size);
+  for(int eye=0; eye<nslots; eye++) {
+    Hit_Block *block = new Hit_Block;
+    block->entries = new DEVT_BANK[input_params.DEVT_Array_Size];
+    block->nentries = 0;
+    block->last = false;
+    block->progress = false;
+    block->bytes_read = 0;
+    blocks.push_back(block);
+
+    Event_Batch *batch = new Event_Batch;
+    batch->entries.reserve(input_params.DEVT_Array_Size);
+    batch->events.reserve(input_params.DEVT_Array_Size);
+    batch->scan_events.resize(input_params.NCoincidence_Scan);
+    if(input_params.NSweep_Variants > 0) {
+      batch->sweep_entries.reserve(input_params.DEVT_Array_Size);
+    }
+    batch->last = false;
+    batch->progress = false;
+    batches.push_back(batch);
+  }
+
+  //The queues have room for every block and batch, so only taking an empty one from the free queues ever waits
+  full_blocks = new SPSC_Queue<Hit_Block*>(nslots);
+  free_blocks = new SPSC_Queue<Hit_Block*>(nslots);
+  full_batches = new SPSC_Queue<Event_Batch*>(nslots);
+  free_batches = new SPSC_Queue<Event_Batch*>(nslots);
+  current = blocks[0];
+  for(int eye=1; eye<nslots; eye++) {
+    free_blocks->Try_Push(blocks[eye]);
+  }
+  for(int eye=0; eye<nslots; eye++) {
+    free_batches->Try_Push(batches[eye]);
+  }
+
+  //Analysis workers, and one for each scanned coincidence window that gets all the events of the window
+  if(input_params.Analysis_Threads > 1) {
+    for(int eye=0; eye<input_params.Analysis_Threads; eye++) {
+      workers.push_back(Make_Worker(eye, 0, 0));
+    }
+    Get_Analyzer_State(&dispatch_state);
+    next_worker = 0;
+  }
+  for(int eye=0; eye<input_params.NCoincidence_Scan; eye++) {
+    Analysis_Worker *worker = Make_Worker(eye, eye+1, 0);
+    worker->free_units->Try_Pop(worker->filling);
+    scan_workers.push_back(worker);
+  }
+  //The sweep variants start from the same validator state as the build stage
+  for(int eye=0; eye<input_params.NSweep_Variants; eye++) {
+    Analysis_Worker *worker = Make_Worker(eye, 0, eye+1);
+    worker->analyze_params = *analysis_params;
+    worker->free_units->Try_Pop(worker->filling);
+    sweep_workers.push_back(worker);
+  }
+
+  memset(&unpack_times, 0, sizeof(unpack_times));
+  memset(&build_times, 0, sizeof(build_times));
+  memset(&analysis_times, 0, sizeof(analysis_times));
+  failed = false;
+  running = true;
+  start_time = Pipeline_Time();
+
+  build_thread = std::thread(&Unpack_Pipeline::Build_Loop, this);
+  analysis_thread = std::thread(&Unpack_Pipeline::Analysis_Loop, this);
+  for(size_t eye=0; eye<workers.size(); eye++) {
+    workers[eye]->thread = std::thread(&Unpack_Pipeline::Worker_Loop, this, workers[eye]);
+  }
+  for(size_t eye=0; eye<scan_workers.size(); eye++) {
+    scan_workers[eye]->thread = std::thread(&Unpack_Pipeline::Worker_Loop, this, scan_workers[eye]);
+  }
+  for(size_t eye=0; eye<sweep_workers.size(); eye++) {
+    sweep_workers[eye]->thread = std::thread(&Unpack_Pipeline::Worker_Loop, this, sweep_workers[eye]);
+  }
+
+  stringstream pmsg;
+  pmsg<<"Unpacking, time sorting and event building, and analysis on their own threads with "<<input_params.Pipeline_Queue_Depth<<" Blocks between them";
+  DANCE_Info("Pipeline",pmsg.str());
+  if(workers.size() > 0) {
+    pmsg.str("");
+    pmsg<<"Analysis on "<<workers.size()<<" Analysis Workers in units of "<<Analysis_Unit_Events<<" Events";
+    DANCE_Info("Pipeline",pmsg.str());
+  }
+  if(scan_workers.size() > 0) {
+    pmsg.str("");
+    pmsg<<"Analysis of "<<scan_workers.size()<<" Scanned Coincidence Windows on their own Analysis Workers";
+    DANCE_Info("Pipeline",pmsg.str());
+  }
+  if(sweep_workers.size() > 0) {
+    pmsg.str("");
+    pmsg<<"Validation, event building and analysis of "<<sweep_workers.size()<<" Sweep Variants on their own Analysis Workers";
+    DANCE_Info("Pipeline",pmsg.str());
+  }
+  return 0;
+}
+
+//Analysis worker with its queues and two units, one it can be analyzing while the analysis stage fills the other
+Analysis_Worker* Unpack_Pipeline::Make_Worker(int index, int window, int variant) {
+
+  Analysis_Worker *worker = new Analysis_Worker;
+  worker->index = index;
+  worker->window = window;
+  worker->variant = variant;
+  worker->input_params = input_params;
+  if(window > 0) {
+    worker->input_params.Coincidence_Window = input_params.Coincidence_Scan[window-1];
+    worker->input_params.Coincidence_Window_Ticks = input_params.Coincidence_Scan_Ticks[window-1];
+  }
+  worker->sweep_buffer = NULL;
+  if(variant > 0) {
+    const Sweep_Variant &sweep = input_params.Sweep_Variants[variant-1];
+    worker->input_params.Crystal_Blocking_Time = sweep.Crystal_Blocking_Time;
+    worker->input_params.DEvent_Blocking_Time = sweep.DEvent_Blocking_Time;
+    worker->input_params.Energy_Threshold = sweep.Energy_Threshold;
+    worker->input_params.HAVE_Threshold = sweep.HAVE_Threshold;
+    worker->input_params.Crystal_Blocking_Ticks = Time_From_ns(sweep.Crystal_Blocking_Time);
+    worker->input_params.DEvent_Blocking_Ticks = Time_From_ns(sweep.DEvent_Blocking_Time);
+    worker->sweep_buffer = new Sorted_Buffer(2*Analysis_Unit_Events);
+    worker->sweep_event.reserve(DANCE_Event_Reserve);
+  }
+  worker->filling = NULL;
+  worker->full_units = new SPSC_Queue<Analysis_Unit*>(2);
+  worker->free_units = new SPSC_Queue<Analysis_Unit*>(2);
+  memset(&worker->analyze_params, 0, sizeof(worker->analyze_params));
+  memset(&worker->counters, 0, sizeof(worker->counters));
+  memset(&worker->times, 0, sizeof(worker->times));
+  for(int jay=0; jay<2; jay++) {
+    Analysis_Unit *new_unit = new Analysis_Unit;
+    new_unit->entries.reserve(2*Analysis_Unit_Events);
+    new_unit->events.reserve(Analysis_Unit_Events);
+    new_unit->last = false;
+    new_unit->analyzed = false;
+    worker->units.push_back(new_unit);
+    worker->free_units->Try_Push(new_unit);
+  }
+  return worker;
+}
+
+//Hands the block the unpacker filled to the build stage and takes the next empty one.  Returns -1 if a stage has failed
+int Unpack_Pipeline::Send_Block(uint32_t nentries, bool progress, const Analysis_Parameters *analysis_params, uint64_t bytes_read) {
+
+  current->nentries = nentries;
+  current->last = false;
+  current->progress = progress;
+  if(progress) {
+    current->unpack_counters = *analysis_params;
+  }
+  current->bytes_read = bytes_read;
+
+  full_blocks->Push(current, &unpack_times.blocked);
+  free_blocks->Pop(current, &unpack_times.blocked);
+
+  return failed ? -1 : 0;
+}
+
+//Sorts and event builds each block, and puts the events into a batch for the analysis stage
+void Unpack_Pipeline::Build_Loop() {
+
+  while(true) {
+    Hit_Block *block;
+    Event_Batch *batch;
+    full_blocks->Pop(block, &build_times.idle);
+    free_batches->Pop(batch, &build_times.blocked);
+    double busy_start = Pipeline_Time();
+
+    batch->entries.clear();
+    batch->events.clear();
+    batch->sweep_entries.clear();
+    for(size_t eye=0; eye<batch->scan_events.size(); eye++) {
+      batch->scan_events[eye].clear();
+    }
+    batch->last = block->last;
+    batch->progress = block->progress;
+
+    if(!failed && block->nentries > 0) {
+      if(sort_array(block->entries, *datadeque, block->nentries, input_params, &build_params)) {
+	DANCE_Error("Pipeline","Problem with sort_array");
+	failed = true;
+      }
+    }
+
+    if(!failed) {
+      //The rest of the buffer is event built after the last block, but the buffer depth it got to is kept for the end of run report
+      double buffer_depth = build_params.buffer_depth;
+      if(block->last) {
+	build_params.buffer_depth = 0;
+      }
+
+      Set_Event_Batch(batch);
+      if(Build_Events(*datadeque, input_params, &build_params)) {
+	DANCE_Error("Pipeline","Problem with build_events");
+	failed = true;
+      }
+      Set_Event_Batch(NULL);
+
+      if(block->last) {
+	build_params.buffer_depth = buffer_depth;
+      }
+    }
+
+    if(batch->progress) {
+      batch->counters = build_params;
+      Copy_Unpack_Counters(&batch->counters, &block->unpack_counters);
+      batch->buffer_entries = datadeque->size();
+      batch->oldest_timestamp = datadeque->size() > 0 ? datadeque->front().timestamp : 0;
+      batch->newest_timestamp = datadeque->size() > 0 ? datadeque->back().timestamp : 0;
+      batch->bytes_read = block->bytes_read;
+    }
+
+    bool last = block->last;
+    build_times.busy += Pipeline_Time() - busy_start;
+    free_blocks->Push(block, &build_times.blocked);
+    full_batches->Push(batch, &build_times.blocked);
+    if(last) {
+      return;
+    }
+  }
+}
+
+//Analyzes the events of each batch, or deals them out to the analysis workers.  The analyzer counters are kept in analyze_params
+void Unpack_Pipeline::Analysis_Loop() {
+
+  //The histograms are thread_local, so the analysis thread fills its own when there are no analysis workers
+  if(workers.size() > 0) {
+    Take_Unit();
+  }
+  else if(Create_Analyzer_Worker_Histograms(input_params, 0)) {
+    DANCE_Error("Pipeline","Problem making the histograms of the analysis thread");
+    failed = true;
+  }
+#ifdef Validate_Analysis_Units
+  //With analysis workers the analysis thread analyzes every event in order as well, to check the workers against
+  Analysis_Parameters validate_params = analyze_params;
+  if(workers.size() > 0 && Create_Validation_Histograms(input_params)) {
+    failed = true;
+  }
+#endif
+
+  while(true) {
+    Event_Batch *batch;
+    full_batches->Pop(batch, &analysis_times.idle);
+    double busy_start = Pipeline_Time();
+
+    if(!failed) {
+      if(workers.size() > 0) {
+	Dispatch_Batch(batch);
+#ifdef Validate_Analysis_Units
+	Analyze_Events(batch->entries, batch->events, input_params, &validate_params);
+#endif
+      }
+      else {
+	Analyze_Events(batch->entries, batch->events, input_params, &analyze_params);
+      }
+      if(scan_workers.size() > 0) {
+	Dispatch_Scan(batch);
+      }
+      if(sweep_workers.size() > 0) {
+	Dispatch_Sweep(batch);
+      }
+
+      if(batch->progress) {
+	//With analysis workers the counters are from the units they have given back, so they are behind by a unit or two
+	if(workers.size() > 0) {
+	  memset(&analyze_params, 0, sizeof(analyze_params));
+	  for(size_t eye=0; eye<workers.size(); eye++) {
+	    Add_Analyzer_Counters(&analyze_params, &workers[eye]->counters);
+	  }
+	}
+	Copy_Analyzer_Counters(&batch->counters, &analyze_params);
+	Print_Progress(input_params, &batch->counters, batch->buffer_entries, batch->oldest_timestamp, batch->newest_timestamp, batch->bytes_read);
+      }
+    }
+
+    bool last = batch->last;
+    analysis_times.busy += Pipeline_Time() - busy_start;
+    free_batches->Push(batch, &analysis_times.blocked);
+    if(last) {
+      //Every worker gets a last unit, even after a failure, so that they all finish
+      for(size_t eye=0; eye<workers.size(); eye++) {
+	if(eye > 0) {
+	  Take_Unit();
+	}
+	Send_Unit(true);
+      }
+      for(size_t eye=0; eye<scan_workers.size(); eye++) {
+	Send_Filling(scan_workers[eye], true);
+      }
+      for(size_t eye=0; eye<sweep_workers.size(); eye++) {
+	Send_Filling(sweep_workers[eye], true);
+      }
+      return;
+    }
+  }
+}
+
+//Copies the events of a batch into units for the analysis workers.  A unit is sent once it has Analysis_Unit_Events events, right after a
+//T0 when there are isomer spectra: the isomer TOFs are kept from one T0 to the next and paired up at the T0 that closes them, so that T0
+//has to be in the unit with them.  The state the analyzer would have at the first event of the next unit is worked out as the events go by
+void Unpack_Pipeline::Dispatch_Batch(Event_Batch *batch) {
+
+  for(size_t eye=0; eye<batch->events.size(); eye++) {
+    Event_Record event = batch->events[eye];
+    const DEVT_BANK *entries = &batch->entries[event.first];
+
+    if(unit->events.size() >= Analysis_Unit_Events && (!input_params.IsomerSpectra || unit->entries[unit->events.back().first].ID == T0_ID)) {
+      Send_Unit(false);
+    }
+
+    event.first = unit->entries.size();
+    unit->events.push_back(event);
+    unit->entries.insert(unit->entries.end(), entries, entries + event.nentries);
+    Advance_Analyzer_State(entries, event.nentries, input_params, event.last_T0, &dispatch_state);
+  }
+}
+
+//Sends the unit to its worker and, unless it is the last one for the worker, takes an empty one from the worker after it
+void Unpack_Pipeline::Send_Unit(bool last) {
+
+  unit->last = last;
+  workers[next_worker]->full_units->Push(unit, &analysis_times.blocked);
+  unit = NULL;
+  next_worker = (next_worker + 1) % workers.size();
+  if(!last) {
+    Take_Unit();
+  }
+}
+
+//Takes an empty unit from the worker it is for, with the counters of the worker if it has been analyzed
+void Unpack_Pipeline::Take_Unit() {
+
+  workers[next_worker]->free_units->Pop(unit, &analysis_times.blocked);
+  if(unit->analyzed) {
+    workers[next_worker]->counters = unit->counters;
+  }
+  unit->entries.clear();
+  unit->events.clear();
+  unit->last = false;
+  unit->analyzed = false;
+  unit->state = dispatch_state;
+}
+
+//Copies the events of each scanned coincidence window into the unit of its analysis worker.  The worker gets every event of the window
+//in order, so it carries the analyzer state from one unit to the next itself
+void Unpack_Pipeline::Dispatch_Scan(Event_Batch *batch) {
+
+  for(size_t window=0; window<scan_workers.size(); window++) {
+    Analysis_Worker *worker = scan_workers[window];
+    const std::vector<Event_Record> &events = batch->scan_events[window];
+
+    for(size_t eye=0; eye<events.size(); eye++) {
+      Event_Record event = events[eye];
+      const DEVT_BANK *entries = &batch->entries[event.first];
+
+      if(worker->filling->events.size() >= Analysis_Unit_Events) {
+	Send_Filling(worker, false);
+      }
+
+      event.first = worker->filling->entries.size();
+      worker->filling->events.push_back(event);
+      worker->filling->entries.insert(worker->filling->entries.end(), entries, entries + event.nentries);
+    }
+  }
+}
+
+//Copies the timed and calibrated entries of a batch into the unit of each sweep variant.  The variant validates them itself, so every
+//variant needs a copy of its own
+void Unpack_Pipeline::Dispatch_Sweep(Event_Batch *batch) {
+
+  for(size_t variant=0; variant<sweep_workers.size(); variant++) {
+    Analysis_Worker *worker = sweep_workers[variant];
+    worker->filling->entries.insert(worker->filling->entries.end(), batch->sweep_entries.begin(), batch->sweep_entries.end());
+    if(worker->filling->entries.size() >= Analysis_Unit_Events) {
+      Send_Filling(worker, false);
+    }
+  }
+}
+
+//Sends the unit being filled for a scanned coincidence window or sweep variant to its worker and, unless it is the last one, takes an
+//empty one back
+void Unpack_Pipeline::Send_Filling(Analysis_Worker *worker, bool last) {
+
+  worker->filling->last = last;
+  worker->full_units->Push(worker->filling, &analysis_times.blocked);
+  worker->filling = NULL;
+  if(!last) {
+    worker->free_units->Pop(worker->filling, &analysis_times.blocked);
+    worker->filling->entries.clear();
+    worker->filling->events.clear();
+    worker->filling->last = false;
+    worker->filling->analyzed = false;
+  }
+}
+
+//Analysis worker.  It analyzes its units into its own histograms.  The workers sharing the Coincidence_Window start each unit from the
+//state the analyzer has at its first event.  The worker of a sweep variant event builds its units first
+void Unpack_Pipeline::Worker_Loop(Analysis_Worker *worker) {
+
+  int func_ret = 0;
+  if(worker->variant > 0) {
+    func_ret = Create_Sweep_Variant_Histograms(worker->input_params, worker->variant);
+  }
+  else if(worker->window == 0) {
+    func_ret = Create_Analyzer_Worker_Histograms(worker->input_params, worker->index);
+  }
+  else {
+    func_ret = Create_Coincidence_Scan_Histograms(worker->input_params, worker->window);
+  }
+  if(func_ret) {
+    DANCE_Error("Pipeline","Problem making the histograms of an Analysis Worker");
+    failed = true;
+  }
+
+  while(true) {
+    Analysis_Unit *work;
+    worker->full_units->Pop(work, &worker->times.idle);
+    double busy_start = Pipeline_Time();
+
+    if(!failed && worker->variant > 0) {
+      for(size_t eye=0; eye<work->entries.size(); eye++) {
+	worker->sweep_buffer->push_back(work->entries[eye]);
+      }
+      if(Build_Sweep_Events(*worker->sweep_buffer, worker->sweep_event, worker->input_params, &worker->analyze_params)) {
+	DANCE_Error("Pipeline","Problem event building a Sweep Variant");
+	failed = true;
+      }
+      work->counters = worker->analyze_params;
+      work->analyzed = true;
+    }
+    else if(!failed) {
+      if(worker->window == 0) {
+	Set_Analyzer_State(work->state);
+      }
+      Analyze_Events(work->entries, work->events, worker->input_params, &worker->analyze_params);
+      work->counters = worker->analyze_params;
+      work->analyzed = true;
+    }
+
+    bool last = work->last;
+    worker->times.busy += Pipeline_Time() - busy_start;
+    if(last) {
+      return;
+    }
+    worker->free_units->Push(work, &worker->times.blocked);
+  }
+}
+
+//Sends the last block (the rest of the buffer is event built after it) and waits for the stages to finish
+void Unpack_Pipeline::Finish(uint32_t nentries) {
+
+  current->nentries = nentries;
+  current->last = true;
+  current->progress = false;
+  full_blocks->Push(current, &unpack_times.blocked);
+  unpack_times.busy = Pipeline_Time() - start_time - unpack_times.blocked;
+
+  build_thread.join();
+  analysis_thread.join();
+  for(size_t eye=0; eye<workers.size(); eye++) {
+    workers[eye]->thread.join();
+  }
+  for(size_t eye=0; eye<scan_workers.size(); eye++) {
+    scan_workers[eye]->thread.join();
+  }
+  for(size_t eye=0; eye<sweep_workers.size(); eye++) {
+    sweep_workers[eye]->thread.join();
+  }
+  running = false;
+
+  delete full_blocks;
+  delete free_blocks;
+  delete full_batches;
+  delete free_batches;
+  for(size_t eye=0; eye<blocks.size(); eye++) {
+    delete [] blocks[eye]->entries;
+    delete blocks[eye];
+  }
+  for(size_t eye=0; eye<batches.size(); eye++) {
+    delete batches[eye];
+  }
+  blocks.clear();
+  batches.clear();
+  current = NULL;
+}
+
+//Frees the analysis workers once their counters and times are taken
+void Unpack_Pipeline::Free_Workers() {
+
+  workers.insert(workers.end(), scan_workers.begin(), scan_workers.end());
+  workers.insert(workers.end(), sweep_workers.begin(), sweep_workers.end());
+  for(size_t eye=0; eye<workers.size(); eye++) {
+    delete workers[eye]->full_units;
+    delete workers[eye]->free_units;
+    delete workers[eye]->sweep_buffer;
+    for(size_t jay=0; jay<workers[eye]->units.size(); jay++) {
+      delete workers[eye]->units[jay];
+    }
+    delete workers[eye];
+  }
+  workers.clear();
+  scan_workers.clear();
+  sweep_workers.clear();
+  unit = NULL;
+}
+
+//Sends the last nentries entries, waits for the stages to finish and puts the counters of the three stages together in analysis_params
+int Unpack_Pipeline::Stop(uint32_t nentries, Analysis_Parameters *analysis_params) {
+
+  if(!running) {
+    return 0;
+  }
+  Finish(nentries);
+  double run_time = Pipeline_Time() - start_time;
+
+  Analysis_Parameters unpack_counters = *analysis_params;
+  *analysis_params = build_params;
+  Copy_Unpack_Counters(analysis_params, &unpack_counters);
+  Copy_Analyzer_Counters(analysis_params, &analyze_params);
+
+  //The analysis workers counted their own events.  Their histograms, or the ones of the analysis thread, go into the ones of the main thread.
+  //The workers of the scanned coincidence windows and sweep variants only fill their own histograms
+  int nworkers = workers.size();
+  int nscan_workers = scan_workers.size();
+  int nsweep_workers = sweep_workers.size();
+  Stage_Times worker_times = Average_Times(workers);
+  Stage_Times scan_times = Average_Times(scan_workers);
+  Stage_Times sweep_times = Average_Times(sweep_workers);
+  std::vector<Analysis_Parameters> sweep_counters;
+  for(int eye=0; eye<nsweep_workers; eye++) {
+    sweep_counters.push_back(sweep_workers[eye]->analyze_params);
+  }
+  if(nworkers > 0) {
+    memset(&analyze_params, 0, sizeof(analyze_params));
+    for(int eye=0; eye<nworkers; eye++) {
+      Add_Analyzer_Counters(&analyze_params, &workers[eye]->analyze_params);
+    }
+    Copy_Analyzer_Counters(analysis_params, &analyze_params);
+  }
+  Free_Workers();
+
+  size_t buffer_left = datadeque->size();
+  delete datadeque;
+  datadeque = NULL;
+
+  if(failed) {
+    return -1;
+  }
+  if(Merge_Analyzer_Histograms()) {
+    return -1;
+  }
+#ifdef Validate_Analysis_Units
+  if(Check_Analysis_Units(input_params)) {
+    return -1;
+  }
+#endif
+  if(buffer_left == 0) {
+    DANCE_Success("Unpacker","Buffer empty, unpacking complete.");
+  }
+
+  //Time in each stage, and the stage that held up the others
+  Report_Stage("Unpacking", unpack_times, run_time);
+  Report_Stage("Sort and Eventbuild", build_times, run_time);
+  Report_Stage("Analysis", analysis_times, run_time);
+  if(nworkers > 0) {
+    Report_Stage("Analysis Workers", worker_times, run_time);
+  }
+  if(nscan_workers > 0) {
+    Report_Stage("Coincidence Scan", scan_times, run_time);
+  }
+  if(nsweep_workers > 0) {
+    Report_Stage("Sweep Variants", sweep_times, run_time);
+  }
+
+  const char *bottleneck = "Unpacking";
+  double most_busy = unpack_times.busy;
+  if(build_times.busy > most_busy) {
+    bottleneck = "Sort and Eventbuild";
+    most_busy = build_times.busy;
+  }
+  if(analysis_times.busy > most_busy) {
+    bottleneck = "Analysis";
+    most_busy = analysis_times.busy;
+  }
+  if(nworkers > 0 && worker_times.busy > most_busy) {
+    bottleneck = "Analysis Workers";
+    most_busy = worker_times.busy;
+  }
+  if(nscan_workers > 0 && scan_times.busy > most_busy) {
+    bottleneck = "Coincidence Scan";
+    most_busy = scan_times.busy;
+  }
+  if(nsweep_workers > 0 && sweep_times.busy > most_busy) {
+    bottleneck = "Sweep Variants";
+    most_busy = sweep_times.busy;
+  }
+  stringstream pmsg;
+  pmsg<<"Slowest Stage: "<<bottleneck<<" (busy "<<100.0*most_busy/run_time<<" % of "<<run_time<<" seconds)";
+  DANCE_Info("Pipeline",pmsg.str());
+  Report_Coincidence_Scan(input_params);
+  Report_Sweep_Variants(sweep_counters);
+
+  return 0;
+}
+
+//Stops the stages without finishing the event building and analysis, after an error in the unpacker
+void Unpack_Pipeline::Abort() {
+
+  if(!running) {
+    return;
+  }
+  failed = true;
+  Finish(0);
+  Free_Workers();
+  delete datadeque;
+  datadeque = NULL;
+}
+
+//Time the workers spent in each state, averaged over the workers
+Stage_Times Unpack_Pipeline::Average_Times(const std::vector<Analysis_Worker*> &stage_workers) {
+
+  Stage_Times times;
+  memset(&times, 0, sizeof(times));
+  for(size_t eye=0; eye<stage_workers.size(); eye++) {
+    times.busy += stage_workers[eye]->times.busy/stage_workers.size();
+    times.idle += stage_workers[eye]->times.idle/stage_workers.size();
+    times.blocked += stage_workers[eye]->times.blocked/stage_workers.size();
+  }
+  return times;
+}
+
+//Entries thrown away, events built and DANCE events analyzed with each sweep variant, for the end of the run
+void Unpack_Pipeline::Report_Sweep_Variants(const std::vector<Analysis_Parameters> &sweep_counters) {
+
+  for(size_t eye=0; eye<sweep_counters.size(); eye++) {
+    const Sweep_Variant &sweep = input_params.Sweep_Variants[eye];
+    stringstream pmsg;
+    pmsg<<"Sweep Variant "<<eye+1<<" (Crystal_Blocking_Time "<<sweep.Crystal_Blocking_Time<<" ns DEvent_Blocking_Time "<<sweep.DEvent_Blocking_Time;
+    pmsg<<" ns Energy_Threshold "<<sweep.Energy_Threshold<<" MeV HAVE_Threshold "<<sweep.HAVE_Threshold<<"): ";
+    pmsg<<sweep_counters[eye].entries_invalid<<" Entries Invalid, "<<sweep_counters[eye].events_built<<" Events Built, ";
+    pmsg<<sweep_counters[eye].DANCE_events_analyzed<<" DANCE Events Analyzed";
+    DANCE_Info("Pipeline",pmsg.str());
+  }
+}
+
+void Unpack_Pipeline::Report_Stage(const char *name, const Stage_Times &times, double run_time) {
+
+  stringstream pmsg;
+  pmsg<<setw(20)<<left<<name<<"Busy: "<<times.busy<<" s ("<<100.0*times.busy/run_time<<" %)  ";
+  pmsg<<"Idle: "<<times.idle<<" s ("<<100.0*times.idle/run_time<<" %)  ";
+  pmsg<<"Blocked: "<<times.blocked<<" s ("<<100.0*times.blocked/run_time<<" %)";
+  DANCE_Info("Pipeline",pmsg.str());
+}
+
+
+//****************** Pipeline functions ******************//
+
+int Start_Pipeline(Input_Parameters input_params, Analysis_Parameters *analysis_params) {
+  return pipeline.Start(input_params, analysis_params);
+}
+
+//Block of entries for the unpacker to fill
+DEVT_BANK* Pipeline_Block() {
+  return pipeline.Block();
+}
+
+int Send_Pipeline_Block(uint32_t nentries, bool progress, const Analysis_Parameters *analysis_params, uint64_t bytes_read) {
+  return pipeline.Send_Block(nentries, progress, analysis_params, bytes_read);
+}
+
+int Stop_Pipeline(uint32_t nentries, Analysis_Parameters *analysis_params) {
+  return pipeline.Stop(nentries, analysis_params);
+}
+
+void Abort_Pipeline() {
+  pipeline.Abort();
+}
@@ -0,0 +1,208 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+
+
+
+//***************************//
+//*  pipeline.h             *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+//C/C++ includes
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+//File includes
+#include "structures.h"
+#include "analyzer.h"
+#include "sorted_buffer.h"
+#include "spsc_queue.h"
+
+//With Pipeline on in the cfg file, unpacking runs in three stages on their own threads: the unpacker reads and decodes blocks of entries
+//(on the calling thread, with Unpacker_Threads decoding the boards), the build stage time sorts them into the buffer (with Sort_Threads)
+//and event builds, and the analysis stage runs the analyzer on the events.  Blocks of entries and batches of events go between the stages
+//in bounded single producer single consumer queues.  Each stage gets the next empty block or batch back from the stage after it, so a
+//stage that gets ahead waits (is blocked) until the next one catches up.  With Analysis_Threads above 1 the analysis stage deals the events
+//out to that many analysis workers in units of about Analysis_Unit_Events, one worker after the other, and each worker fills its own
+//histograms.  The events of each scanned coincidence window (NCoincidence_Scan) all go to an analysis worker of their own.  Each sweep variant
+//(NSweep_Variants) gets the timed and calibrated entries on an analysis worker of its own, which validates, groups and analyzes them with the
+//blocking times and threshold of the variant, so the unpacking, sorting and timing are done once for all of them.
+
+//Block of unsorted entries from the unpacker
+struct Hit_Block {
+  DEVT_BANK *entries;                   //DEVT_Array_Size entries
+  uint32_t nentries;
+  bool last;                            //The last block: the buffer is event built to the end after it
+  bool progress;                        //A progress statement is due after this block
+  Analysis_Parameters unpack_counters;  //Counters of the unpacker for the progress statement
+  uint64_t bytes_read;
+};
+
+//Event in an event batch, with the last T0 and last hit times the analyzer looks at as they were when the event was built
+struct Event_Record {
+  uint32_t first;                       //First entry of the event in the batch
+  uint32_t nentries;
+  int64_t last_T0;                      //last_timestamp[T0_ID]
+  int64_t last_last_T0;
+  int64_t last_own;                     //last_timestamp[] of the ID of the first entry
+};
+
+//Events built from one block, for the analysis stage
+struct Event_Batch {
+  std::vector<DEVT_BANK> entries;
+  std::vector<Event_Record> events;
+  std::vector< std::vector<Event_Record> > scan_events;  //Events of each scanned coincidence window
+  std::vector<DEVT_BANK> sweep_entries;  //Timed and calibrated entries before validation, for the sweep variants
+  bool last;
+  bool progress;
+  Analysis_Parameters counters;         //Counters of the unpacker and the build stage for the progress statement
+  size_t buffer_entries;                //Entries in the buffer after the block
+  int64_t oldest_timestamp;
+  int64_t newest_timestamp;
+  uint64_t bytes_read;
+
+  void Add_Event(const DEVT_BANK *event_entries, size_t nentries, int window, Analysis_Parameters *analysis_params);
+};
+
+//Events for one analysis worker, with the analyzer state at the first one (or the entries for a sweep variant)
+struct Analysis_Unit {
+  std::vector<DEVT_BANK> entries;
+  std::vector<Event_Record> events;
+  Analyzer_State state;
+  bool last;                            //The last unit for the worker
+  bool analyzed;                        //counters are from the worker
+  Analysis_Parameters counters;         //Analyzer counters of the worker after the unit, for the progress statement
+};
+
+//Time each stage spent working, waiting for something to do (idle), and waiting on the stage after it (blocked), in seconds
+struct Stage_Times {
+  double busy;
+  double idle;
+  double blocked;
+};
+
+//Analysis worker.  It gets its units from the analysis stage and gives them back empty
+struct Analysis_Worker {
+  std::thread thread;
+  int index;
+  int window;                              //0 for the Coincidence_Window, or the scanned coincidence window (from 1) it analyzes all the events of
+  int variant;                             //0, or the sweep variant (from 1) it validates, groups and analyzes all the entries of
+  Input_Parameters input_params;           //With the Coincidence_Window, or blocking times and threshold, of the worker
+  Analysis_Unit *filling;                  //Unit the analysis stage is filling for a scanned coincidence window or sweep variant
+  Sorted_Buffer *sweep_buffer;             //Entries of the sweep variant being event built
+  std::vector<DEVT_BANK> sweep_event;      //DANCE event the sweep variant is building
+  std::vector<Analysis_Unit*> units;
+  SPSC_Queue<Analysis_Unit*> *full_units;  //analysis stage to the worker
+  SPSC_Queue<Analysis_Unit*> *free_units;  //worker back to the analysis stage
+  Analysis_Parameters analyze_params;      //Analysis parameters of the worker (the analyzer counters, and the validator state of a sweep variant)
+  Analysis_Parameters counters;            //Analyzer counters from the last unit the worker gave back
+  Stage_Times times;
+};
+
+class Unpack_Pipeline {
+
+ public:
+  Unpack_Pipeline();
+
+  int Start(Input_Parameters input_params, Analysis_Parameters *analysis_params);
+  DEVT_BANK* Block() { return current->entries; }
+  int Send_Block(uint32_t nentries, bool progress, const Analysis_Parameters *analysis_params, uint64_t bytes_read);
+  int Stop(uint32_t nentries, Analysis_Parameters *analysis_params);
+  void Abort();
+
+ private:
+  void Build_Loop();
+  void Analysis_Loop();
+  void Dispatch_Batch(Event_Batch *batch);
+  void Send_Unit(bool last);
+  void Take_Unit();
+  void Dispatch_Scan(Event_Batch *batch);
+  void Dispatch_Sweep(Event_Batch *batch);
+  void Send_Filling(Analysis_Worker *worker, bool last);
+  Analysis_Worker* Make_Worker(int index, int window, int variant);
+  void Worker_Loop(Analysis_Worker *worker);
+  void Finish(uint32_t nentries);
+  void Free_Workers();
+  Stage_Times Average_Times(const std::vector<Analysis_Worker*> &stage_workers);
+  void Report_Stage(const char *name, const Stage_Times &times, double run_time);
+  void Report_Sweep_Variants(const std::vector<Analysis_Parameters> &sweep_counters);
+
+  Input_Parameters input_params;
+  Analysis_Parameters build_params;      //Analysis parameters of the build stage (sort and eventbuilder)
+  Analysis_Parameters analyze_params;    //Analysis parameters of the analysis stage (the analyzer counters)
+  Sorted_Buffer *datadeque;
+
+  std::vector<Hit_Block*> blocks;
+  std::vector<Event_Batch*> batches;
+  SPSC_Queue<Hit_Block*> *full_blocks;   //unpacker to build stage
+  SPSC_Queue<Hit_Block*> *free_blocks;   //build stage back to the unpacker
+  SPSC_Queue<Event_Batch*> *full_batches;  //build stage to analysis stage
+  SPSC_Queue<Event_Batch*> *free_batches;  //analysis stage back to the build stage
+  Hit_Block *current;                    //Block the unpacker is filling
+
+  std::vector<Analysis_Worker*> workers;
+  std::vector<Analysis_Worker*> scan_workers;  //One for each scanned coincidence window
+  std::vector<Analysis_Worker*> sweep_workers; //One for each sweep variant
+  Analysis_Unit *unit;                   //Unit the analysis stage is filling
+  int next_worker;                       //Worker the unit is for
+  Analyzer_State dispatch_state;         //Analyzer state after the events dealt out so far
+
+  std::thread build_thread;
+  std::thread analysis_thread;
+  std::atomic<bool> failed;
+  bool running;
+
+  double start_time;
+  Stage_Times unpack_times;
+  Stage_Times build_times;
+  Stage_Times analysis_times;
+};
+
+//Function prototypes
+int Start_Pipeline(Input_Parameters input_params, Analysis_Parameters *analysis_params);
+DEVT_BANK* Pipeline_Block();
+int Send_Pipeline_Block(uint32_t nentries, bool progress, const Analysis_Parameters *analysis_params, uint64_t bytes_read);
+int Stop_Pipeline(uint32_t nentries, Analysis_Parameters *analysis_params);
+void Abort_Pipeline();
+
+#endif
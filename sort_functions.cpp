@@ -41,12 +41,25 @@
 //*  Christopher J. Prokop  *//
 //*  cprokop@lanl.gov       *//
 //*  sort_functions.cpp     *// 
-//*  Last Edit: 11/06/18    *//  
+//*  Last Edit: 10/19/26    *//  
 //***************************//
 
 //File includes
 #include "sort_functions.h"
 #include "global.h"
+#include "message.h"
+#include "thread_pool.h"
+#include "channel_table.h"
+
+//C/C++ includes
+#include <string.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+//Bytes of entries, keys and indices copied by the sorts (reported by benchmark_sort)
+static std::atomic<uint64_t> sort_bytes_copied(0);
 
 
 // To heapify a subtree rooted with node i which is
@@ -57,16 +70,17 @@ void heapify(DEVT_BANK arr[], int n, int i) {
   int r = 2*i + 2;  // right = 2*i + 2
   
   // If left child is larger than root
-  if (l < n && arr[l].TOF > arr[largest].TOF)
+  if (l < n && arr[l].timestamp > arr[largest].timestamp)
     largest = l;
   
   // If right child is larger than largest so far
-  if (r < n && arr[r].TOF > arr[largest].TOF)
+  if (r < n && arr[r].timestamp > arr[largest].timestamp)
     largest = r;
   
   // If largest is not root
   if (largest != i) {
     std::swap(arr[i], arr[largest]);
+    sort_bytes_copied += 3*sizeof(DEVT_BANK);
     
     // Recursively heapify the affected sub-tree
     heapify(arr, n, largest);
@@ -83,6 +97,7 @@ void heapSort(DEVT_BANK arr[], int n) {
   for (int i=n-1; i>=0; i--) {
     // Move current root to end
     std::swap(arr[0], arr[i]);
+    sort_bytes_copied += 3*sizeof(DEVT_BANK);
     
     // call max heapify on the reduced heap
     heapify(arr, i, 0);
@@ -90,93 +105,845 @@ void heapSort(DEVT_BANK arr[], int n) {
 }
 
 
-int sort_array(DEVT_BANK db_arr[], deque<DEVT_BANK> &datadeque, uint32_t EVTS, Input_Parameters input_params, Analysis_Parameters *analysis_params) {
+//Sort key of an entry: its timestamp (time ticks) with the sign bit flipped so negative times order before positive ones
+static inline uint64_t sort_key(int64_t timestamp) {
+  return (uint64_t)timestamp ^ 0x8000000000000000ULL;
+}
 
-  
-  int EVT_SORT=EVTS;
-  int deque_size=datadeque.size();
-  
-#ifdef EventSort_Verbose
-  cout<<endl<<"total events at start: "<<EVTS+datadeque.size()<<" deque size: "<<datadeque.size()<<endl;
-#endif
-  
-  //the first time through we want to sort and push everything from the first "block" onto the buffer
-  if(!analysis_params->first_sort) {
-    
-    //check to see if there are any timestamps that originate before the first one in the buffer.  If so event building is broken and the analysis is wrong
-    if(analysis_params->event_building_active) {
-      if(analysis_params->smallest_timestamp < datadeque[0].TOF) {
-	cout<<RED<<"WARNING THE SMALLEST TIMESTAMP IS LOWER THAN THE SMALLEST ONE IN THE DEQUE!!"<<endl;
-	cout<<"smallest: "<<analysis_params->smallest_timestamp<<"  smallest in deque: "<<datadeque[0].TOF<<" largest in deque: "<<datadeque[datadeque.size()-1].TOF<<endl;
-	cout<<"Deque Depth: "<<(datadeque[datadeque.size()-1].TOF - datadeque[0].TOF)/(1.0e9)<<" seconds"<<endl;
-	cout<<"Make the deque: "<<(datadeque[0].TOF-analysis_params->smallest_timestamp)/(1.0e9)<<" seconds deeper"<<endl;
-	cout<<"Exiting"<<RESET<<endl;
-	ofstream failfile;
-	failfile.open("Failed_Analysis.txt", ios::out | ios::app);
-	failfile << "Run: "<<input_params.RunNumber<<" Failed due to insufficient buffer depth...  Add: "<<(datadeque[0].TOF-analysis_params->smallest_timestamp)/(1.0e9)<<" seconds\n";
-	failfile.close();
-        return -1;
-      }   
+//Scratch space of the sorts.  It grows to the largest block sorted and is reused for every block after that.
+//The sorts only move (key, index) pairs, the entries themselves are moved once in the order they give
+static vector<uint64_t> radix_keys;
+static vector<uint64_t> radix_scratch_keys;
+static vector<uint32_t> radix_scratch_index;
+static vector<DEVT_BANK> permute_scratch;
+static vector<uint32_t> block_order;
+
+// LSD radix sort of n (key, index) pairs, 8 bits per pass.  It is stable (pairs with the same key keep their order), passes where every
+// key has the same byte (the upper bytes within one block) are skipped, and the sorted pairs end up back in keys and index
+static void radix_sort_pairs(uint64_t *keys, uint32_t *index, uint64_t *scratch_keys, uint32_t *scratch_index, int n) {
+
+  if(n < 2) {
+    return;
+  }
+
+  //Histograms of all 8 bytes in one pass over the keys
+  uint32_t counts[8][256];
+  memset(counts, 0, sizeof(counts));
+  for(int eye=0; eye<n; eye++) {
+    uint64_t key = keys[eye];
+    for(int pass=0; pass<8; pass++) {
+      counts[pass][(key >> (8*pass)) & 0xFF]++;
     }
-    
-    //location where the smallest timestamp sits in the sorted data
-    int first_index=0;
-    
-    //find where the smallest time stamp sits in the already time sorted data
-    for(int k=datadeque.size()-1; k>=0; k--) {
-      if(analysis_params->smallest_timestamp >= datadeque[k].TOF) {
-	first_index=k-1;
-	break;
+  }
+
+  uint64_t *src_keys = keys;
+  uint64_t *dst_keys = scratch_keys;
+  uint32_t *src_index = index;
+  uint32_t *dst_index = scratch_index;
+
+  for(int pass=0; pass<8; pass++) {
+    int shift = 8*pass;
+
+    //every key has the same byte so this pass would not move anything
+    if(counts[pass][(src_keys[0] >> shift) & 0xFF] == (uint32_t)n) {
+      continue;
+    }
+
+    //starting position of each byte value
+    uint32_t offsets[256];
+    uint32_t total = 0;
+    for(int bin=0; bin<256; bin++) {
+      offsets[bin] = total;
+      total += counts[pass][bin];
+    }
+
+    for(int eye=0; eye<n; eye++) {
+      uint32_t pos = offsets[(src_keys[eye] >> shift) & 0xFF]++;
+      dst_keys[pos] = src_keys[eye];
+      dst_index[pos] = src_index[eye];
+    }
+    sort_bytes_copied += (uint64_t)n*(sizeof(uint64_t) + sizeof(uint32_t));
+
+    std::swap(src_keys, dst_keys);
+    std::swap(src_index, dst_index);
+  }
+
+  //an odd number of passes leaves the pairs in the scratch space
+  if(src_index != index) {
+    memcpy(index, src_index, n*sizeof(uint32_t));
+    memcpy(keys, src_keys, n*sizeof(uint64_t));
+    sort_bytes_copied += (uint64_t)n*(sizeof(uint64_t) + sizeof(uint32_t));
+  }
+}
+
+//Makes sure the scratch space of the radix sorts holds n pairs
+static void radix_reserve(int n) {
+  if((int)radix_keys.size() < n) {
+    radix_keys.resize(n);
+    radix_scratch_keys.resize(n);
+    radix_scratch_index.resize(n);
+  }
+}
+
+// Time order of the entries of arr as indices into arr from the radix sort of their timestamp keys.  Entries with the same key keep their order
+void radixSortOrder(DEVT_BANK arr[], int n, uint32_t order[]) {
+
+  radix_reserve(n);
+  if(n < 1) {
+    return;
+  }
+
+  uint64_t *keys = &radix_keys[0];
+  for(int eye=0; eye<n; eye++) {
+    keys[eye] = sort_key(arr[eye].timestamp);
+    order[eye] = eye;
+  }
+
+  radix_sort_pairs(keys, order, &radix_scratch_keys[0], &radix_scratch_index[0], n);
+}
+
+//Threads of the block sort (Sort_Threads in the cfg file).  NULL when the blocks are sorted on one thread
+static Thread_Pool *sort_pool = NULL;
+static vector<uint32_t> parallel_index;
+
+int Start_Sort_Threads(Input_Parameters input_params) {
+  if(input_params.Sort_Threads > 1 && sort_pool == NULL) {
+    sort_pool = new Thread_Pool(input_params.Sort_Threads);
+    std::stringstream smsg;
+    smsg<<"Sorting blocks of more than "<<Parallel_Sort_Minimum<<" entries on "<<sort_pool->Size()<<" threads";
+    DANCE_Info("Unpacker",smsg.str());
+  }
+  return 0;
+}
+
+void Stop_Sort_Threads() {
+  delete sort_pool;
+  sort_pool = NULL;
+}
+
+//Runs task(first, last) over pieces of 0 to n, one per sort thread, or all at once on this thread for small n or without the sort threads
+static void sort_parallel_for(int n, std::function<void(int,int)> task) {
+  if(sort_pool == NULL || n < Parallel_Sort_Minimum) {
+    task(0, n);
+    return;
+  }
+  int npieces = sort_pool->Size();
+  sort_pool->Run(npieces, [&](int piece, int worker) {
+    task((int)((int64_t)n*piece/npieces), (int)((int64_t)n*(piece+1)/npieces));
+  });
+}
+
+// Parallel version of radixSortOrder that gives the same order.  The block is cut into one piece per sort thread and the pieces are
+// radix sorted at the same time.  Then the sorted pieces are cut into key ranges at splitters picked from samples of the pieces, and
+// each thread merges one range of all the pieces.  Equal keys are taken from the earlier piece first, so they stay in block order.
+void parallelSortOrder(DEVT_BANK arr[], int n, uint32_t order[]) {
+
+  if(sort_pool == NULL || n < Parallel_Sort_Minimum) {
+    radixSortOrder(arr, n, order);
+    return;
+  }
+
+  int npieces = sort_pool->Size();
+  radix_reserve(n);
+  if((int)parallel_index.size() < n) {
+    parallel_index.resize(n);
+  }
+  uint64_t *keys = &radix_keys[0];
+  uint32_t *index = &parallel_index[0];
+  uint64_t *scratch_keys = &radix_scratch_keys[0];
+  uint32_t *scratch_index = &radix_scratch_index[0];
+
+  vector<int> piece_start(npieces+1);
+  for(int piece=0; piece<=npieces; piece++) {
+    piece_start[piece] = (int)((int64_t)n*piece/npieces);
+  }
+
+  //Sort the pieces
+  sort_pool->Run(npieces, [&](int piece, int worker) {
+    int first = piece_start[piece];
+    int last = piece_start[piece+1];
+    for(int eye=first; eye<last; eye++) {
+      keys[eye] = sort_key(arr[eye].timestamp);
+      index[eye] = eye;
+    }
+    radix_sort_pairs(keys+first, index+first, scratch_keys+first, scratch_index+first, last-first);
+  });
+
+  //Splitters between the key ranges from evenly spaced samples of the sorted pieces
+  vector<uint64_t> samples;
+  for(int piece=0; piece<npieces; piece++) {
+    int length = piece_start[piece+1] - piece_start[piece];
+    for(int sample=0; sample<Sort_Splitter_Samples && length>0; sample++) {
+      samples.push_back(keys[piece_start[piece] + (int)((int64_t)length*(2*sample+1)/(2*Sort_Splitter_Samples))]);
+    }
+  }
+  std::sort(samples.begin(), samples.end());
+
+  //bounds[piece*(npieces+1) + range] is where key range 'range' starts in the piece (the first key not below its splitter)
+  vector<int> bounds(npieces*(npieces+1));
+  vector<int> range_start(npieces+1, 0);
+  for(int piece=0; piece<npieces; piece++) {
+    bounds[piece*(npieces+1)] = piece_start[piece];
+    bounds[piece*(npieces+1) + npieces] = piece_start[piece+1];
+    for(int range=1; range<npieces; range++) {
+      uint64_t splitter = samples[samples.size()*range/npieces];
+      bounds[piece*(npieces+1) + range] = std::lower_bound(keys + piece_start[piece], keys + piece_start[piece+1], splitter) - keys;
+    }
+  }
+  for(int range=0; range<npieces; range++) {
+    range_start[range+1] = range_start[range];
+    for(int piece=0; piece<npieces; piece++) {
+      range_start[range+1] += bounds[piece*(npieces+1) + range+1] - bounds[piece*(npieces+1) + range];
+    }
+  }
+
+  //Merge each key range of the pieces (there are only a few pieces so the smallest head is found by looking at all of them)
+  sort_pool->Run(npieces, [&](int range, int worker) {
+    vector<int> head(npieces);
+    vector<int> end(npieces);
+    for(int piece=0; piece<npieces; piece++) {
+      head[piece] = bounds[piece*(npieces+1) + range];
+      end[piece] = bounds[piece*(npieces+1) + range+1];
+    }
+    for(int out=range_start[range]; out<range_start[range+1]; out++) {
+      int best = -1;
+      for(int piece=0; piece<npieces; piece++) {
+        if(head[piece] < end[piece] && (best < 0 || keys[head[piece]] < keys[head[best]])) {
+          best = piece;
+        }
+      }
+      order[out] = index[head[best]++];
+    }
+  });
+  sort_bytes_copied += (uint64_t)n*sizeof(uint32_t);
+}
+
+//Puts the entries of arr in the given order
+static void permute_block(DEVT_BANK arr[], int n, const uint32_t order[]) {
+  if((int)permute_scratch.size() < n) {
+    permute_scratch.resize(n);
+  }
+  for(int eye=0; eye<n; eye++) {
+    permute_scratch[eye] = arr[order[eye]];
+  }
+  if(n > 0) {
+    memcpy(arr, &permute_scratch[0], n*sizeof(DEVT_BANK));
+  }
+  sort_bytes_copied += 2*(uint64_t)n*sizeof(DEVT_BANK);
+}
+
+//Time orders arr in place with the radix sort
+void radixSort(DEVT_BANK arr[], int n) {
+  if((int)block_order.size() < n) {
+    block_order.resize(n);
+  }
+  if(n < 2) {
+    return;
+  }
+  radixSortOrder(arr, n, &block_order[0]);
+  permute_block(arr, n, &block_order[0]);
+}
+
+//Widest a block can be out of time order in stage 1 as a key distance (0 when the blocks are not sorted by the window sort)
+static uint64_t sort_window = 0;
+
+//The stage 0 binaries are written in time order, so the entries of a stage 1 block are only out of order by the time deviations and delays
+//added to them.  No entry can be later than an entry after it by more than the spread of those offsets, which is the window of the sort.
+//Stage 1 runs on MIDAS files are not in that order, so they keep the radix sort
+int Set_Sort_Window(Input_Parameters input_params) {
+
+  sort_window = 0;
+  if(input_params.Analysis_Stage != 1 || input_params.Read_Simulation || !input_params.Read_Binary) {
+    return 0;
+  }
+
+  int64_t smallest_offset = 0;
+  int64_t largest_offset = 0;
+  for(int eye=0; eye<Table_IDs; eye++) {
+    int64_t offset = channel_table.detector[eye].time_offset_ticks;
+    if(eye == 0 || offset < smallest_offset) {
+      smallest_offset = offset;
+    }
+    if(eye == 0 || offset > largest_offset) {
+      largest_offset = offset;
+    }
+  }
+  sort_window = largest_offset - smallest_offset + Time_From_ns(Sort_Window_Margin);
+
+  std::stringstream smsg;
+  smsg<<"Stage 1 blocks are time ordered in a window of "<<Time_To_ns(sort_window)<<" ns (the spread of the time offsets)";
+  DANCE_Info("Unpacker",smsg.str());
+  return 0;
+}
+
+// Time order of the entries of arr as indices into arr from an insertion sort of their timestamp keys for blocks that are in time order except
+// for entries at most window keys later than an entry after them.  Each entry moves back past the few entries within the window of it,
+// so a block in order costs one pass.  Returns 1 (and the order is not set) if an entry is further out of order than the window or the
+// entries moved more than Sort_Window_Moves times per entry, since the radix sort is then the faster one.  Entries with the same key keep
+// their order, so the order is the same as the one from radixSortOrder
+int windowSortOrder(DEVT_BANK arr[], int n, uint64_t window, uint32_t order[]) {
+
+  radix_reserve(n);
+  if(n < 1) {
+    return 0;
+  }
+
+  uint64_t *keys = &radix_keys[0];
+  uint64_t moves = 0;
+  uint64_t max_moves = (uint64_t)Sort_Window_Moves*n;
+  for(int eye=0; eye<n; eye++) {
+    uint64_t key = sort_key(arr[eye].timestamp);
+    int jay = eye;
+    //keys[eye-1] is the latest key so far
+    if(eye > 0 && key < keys[eye-1]) {
+      if(keys[eye-1] - key > window) {
+        return 1;
+      }
+      while(jay > 0 && keys[jay-1] > key) {
+        keys[jay] = keys[jay-1];
+        order[jay] = order[jay-1];
+        jay--;
+      }
+      moves += eye - jay;
+      if(moves > max_moves) {
+        return 1;
+      }
+    }
+    keys[jay] = key;
+    order[jay] = eye;
+  }
+  return 0;
+}
+
+//Scratch space of the stream merge, reused from block to block like the radix sort's
+static vector<uint64_t> merge_keys;
+static vector<uint32_t> merge_index;
+static vector<uint32_t> merge_stream_start;
+static vector<uint32_t> merge_stream_end;
+static vector<uint32_t> merge_tree;
+
+//Stream of an entry in the merge: its ID, with IDs outside the DANCE map sharing the last one
+static inline int merge_stream(const DEVT_BANK &entry) {
+  return entry.ID < Sort_Streams - 2 ? entry.ID : Sort_Streams - 2;
+}
+
+static vector<uint64_t> merge_head_keys;
+
+//Key at the head of stream slot s (empty streams lose every comparison)
+static inline uint64_t merge_head(uint32_t s) {
+  return merge_stream_start[s] < merge_stream_end[s] ? merge_keys[merge_stream_start[s]] : 0xFFFFFFFFFFFFFFFFULL;
+}
+
+//Winner of two slots of the tournament tree
+static inline uint32_t merge_winner(const uint64_t *head_keys, uint32_t a, uint32_t b) {
+  return head_keys[b] < head_keys[a] ? b : a;
+}
+
+// Time orders a block by merging the streams that come out of the digitizers already in order, giving the order as indices into arr.
+// Each ID (one digitizer channel) is a stream and the entries from sorted_from to n, which came back from the sorted buffer, are another.
+// The (key, index) pairs are split into their streams (stable), small local disorder in a stream is repaired with insertion runs, and the
+// streams are merged with a tournament tree.  If an entry sits more than Sort_Stream_Disorder places from where it belongs in its stream
+// 1 is returned so the block can be fully sorted instead.
+int streamMergeOrder(DEVT_BANK arr[], int n, int sorted_from, uint32_t order[]) {
+
+  if(n < 2) {
+    for(int eye=0; eye<n; eye++) {
+      order[eye] = eye;
+    }
+    return 0;
+  }
+
+  if((int)merge_keys.size() < n) {
+    merge_keys.resize(n);
+    merge_index.resize(n);
+  }
+  //room for the empty leaves that fill the tree out to a power of two
+  merge_stream_start.resize(2*Sort_Streams);
+  merge_stream_end.resize(2*Sort_Streams);
+
+  //Size of each stream
+  uint32_t counts[Sort_Streams];
+  memset(counts, 0, sizeof(counts));
+  for(int eye=0; eye<n; eye++) {
+    counts[eye < sorted_from ? merge_stream(arr[eye]) : Sort_Streams-1]++;
+  }
+  uint32_t total = 0;
+  for(int s=0; s<Sort_Streams; s++) {
+    merge_stream_start[s] = total;
+    merge_stream_end[s] = total;
+    total += counts[s];
+  }
+
+  //Split the block into its streams, repairing the order of each stream as it goes
+  uint64_t *keys = &merge_keys[0];
+  uint32_t *index = &merge_index[0];
+  for(int eye=0; eye<n; eye++) {
+    int s = eye < sorted_from ? merge_stream(arr[eye]) : Sort_Streams-1;
+    uint64_t key = sort_key(arr[eye].timestamp);
+    uint32_t first = merge_stream_start[s];
+    uint32_t pos = merge_stream_end[s]++;
+
+    //insertion run: walk back over the entries of the stream that are later than this one
+    uint32_t back = pos;
+    while(back > first && keys[back-1] > key) {
+      if(pos - back >= Sort_Stream_Disorder) {
+        return 1;
+      }
+      keys[back] = keys[back-1];
+      index[back] = index[back-1];
+      back--;
+    }
+    keys[back] = key;
+    index[back] = eye;
+    sort_bytes_copied += (uint64_t)(pos - back + 1)*(sizeof(uint64_t) + sizeof(uint32_t));
+  }
+
+  //The non empty streams are the leaves of the tournament tree
+  uint32_t nslots = 0;
+  for(int s=0; s<Sort_Streams; s++) {
+    if(counts[s] > 0) {
+      merge_stream_start[nslots] = merge_stream_start[s];
+      merge_stream_end[nslots] = merge_stream_end[s];
+      nslots++;
+    }
+  }
+  uint32_t leaves = 1;
+  while(leaves < nslots) {
+    leaves *= 2;
+  }
+  for(uint32_t s=nslots; s<leaves; s++) {
+    merge_stream_start[s] = 0;
+    merge_stream_end[s] = 0;
+  }
+
+  //Loser tree: node k has children 2k and 2k+1, the leaves sit at leaves+slot, and each node keeps the loser of the match played there
+  merge_tree.resize(2*leaves);
+  merge_head_keys.resize(leaves);
+  uint32_t *tree = &merge_tree[0];
+  uint64_t *head_keys = &merge_head_keys[0];
+  for(uint32_t s=0; s<leaves; s++) {
+    tree[leaves+s] = s;
+    head_keys[s] = merge_head(s);
+  }
+  //the first round is played with the winners in the upper half of the array until each node is replaced by its loser
+  vector<uint32_t> winners(merge_tree);
+  for(uint32_t node=leaves-1; node>=1; node--) {
+    uint32_t a = winners[2*node];
+    uint32_t b = winners[2*node+1];
+    winners[node] = merge_winner(head_keys, a, b);
+    tree[node] = winners[node] == a ? b : a;
+  }
+  uint32_t winner = leaves > 1 ? winners[1] : 0;
+
+  //Take the winner and replay its path to the root against the losers
+  for(int eye=0; eye<n; eye++) {
+    order[eye] = index[merge_stream_start[winner]++];
+    head_keys[winner] = merge_head(winner);
+    for(uint32_t node=(leaves+winner)/2; node>=1; node/=2) {
+      //written without a branch since which stream wins is not predictable
+      uint32_t loser = tree[node];
+      bool swap = head_keys[loser] < head_keys[winner];
+      tree[node] = swap ? winner : loser;
+      winner = swap ? loser : winner;
+    }
+  }
+  sort_bytes_copied += (uint64_t)n*sizeof(uint32_t);
+
+  return 0;
+}
+
+//Time orders arr in place with the stream merge, returning 1 (and leaving arr alone) if the streams are too far out of order
+int streamMergeSort(DEVT_BANK arr[], int n, int sorted_from) {
+  if((int)block_order.size() < n) {
+    block_order.resize(n);
+  }
+  if(n < 2) {
+    return 0;
+  }
+  if(streamMergeOrder(arr, n, sorted_from, &block_order[0])) {
+    return 1;
+  }
+  permute_block(arr, n, &block_order[0]);
+  return 0;
+}
+
+//Time order of a block as indices into db_arr: radix sorted (on the sort threads for big blocks), or with Sort_Merge_Streams merged from the
+//streams unless they are too far out of order.  Stage 1 blocks are window sorted unless they are out of order by more than the window
+static uint32_t* block_time_order(DEVT_BANK db_arr[], int n, int sorted_from, Analysis_Parameters *analysis_params) {
+  if((int)block_order.size() < n) {
+    block_order.resize(n);
+  }
+  uint32_t *order = n > 0 ? &block_order[0] : NULL;
+  analysis_params->blocks_sorted++;
+  if(sort_window > 0 && windowSortOrder(db_arr, n, sort_window, order) == 0) {
+    analysis_params->blocks_window_sorted++;
+#ifdef Validate_Window_Sort
+    vector<uint32_t> window_order(order, order+n);
+    radixSortOrder(db_arr, n, order);
+    for(int eye=0; eye<n; eye++) {
+      if(order[eye] != window_order[eye]) {
+        std::stringstream smsg;
+        smsg<<"The window sort put entry "<<window_order[eye]<<" where the radix sort put entry "<<order[eye]<<" (position "<<eye<<" of "<<n<<")";
+        DANCE_Error("Unpacker",smsg.str());
+        break;
       }
     }
-#ifdef EventSort_Verbose
-    cout<<"start at "<<first_index<<" of "<<datadeque.size()<<endl;
 #endif
-    
-    //place everything after that onto the unsorted array
-    for(uint k=first_index; k<datadeque.size(); k++) {
-#ifdef EventSort_Verbose
-      cout<<"EVT_SORT: "<<EVT_SORT<<"  k: "<<k<<endl;
+    return order;
+  }
+#ifdef Sort_Merge_Streams
+  if(streamMergeOrder(db_arr, n, sorted_from, order)) {
+    parallelSortOrder(db_arr, n, order);
+    analysis_params->blocks_fully_sorted++;
+  }
+#else
+  parallelSortOrder(db_arr, n, order);
+  analysis_params->blocks_fully_sorted++;
 #endif
-      db_arr[EVT_SORT]=datadeque[k];
-      EVT_SORT++;
+  return order;
+}
 
-#ifdef CheckBufferDepth
-      if(EVT_SORT > MaxDEVTArrSize) {
-	DANCE_Error("Unpacker","Size of the buffer has exceeded MaxDEVTArrSize.  Change MaxDEVTArrSiz to a higher value");
-	return -1;
+//xorshift for the synthetic blocks of the sort benchmark
+static uint64_t benchmark_random(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+//Fill a block with n synthetic entries over one second.  ordered_streams=0 gives random times and IDs.  Otherwise each of the
+//ordered_streams IDs is in time order and the block comes in bank sized pieces of every ID in turn, like the blocks read from
+//the digitizers.  Every jitter-th entry (0 for none) is swapped with the one before it in its stream.  offset_spread above 0 gives a
+//stage 1 block instead: entries of random IDs in time order, each moved by a time offset of its ID of up to offset_spread ns.
+static void benchmark_block(DEVT_BANK arr[], int n, int ordered_streams, int jitter, double offset_spread, uint64_t seed) {
+  uint64_t state = seed;
+  memset(arr, 0, n*sizeof(DEVT_BANK));
+  if(offset_spread > 0) {
+    double TOF = 1.0e12;
+    for(int eye=0; eye<n; eye++) {
+      TOF += (benchmark_random(&state) % (2000000000ULL/n)) + 0.001*(benchmark_random(&state) % 1000);
+      arr[eye].ID = benchmark_random(&state) % 162;
+      arr[eye].TOF = TOF + offset_spread*((arr[eye].ID*37) % 100)/100.0;
+    }
+  }
+  else if(ordered_streams == 0) {
+    for(int eye=0; eye<n; eye++) {
+      arr[eye].TOF = 1.0e12 + (benchmark_random(&state) % 1000000000ULL) + 0.001*(benchmark_random(&state) % 1000);
+      arr[eye].ID = benchmark_random(&state) % 162;
+    }
+  }
+  else {
+    const int bank = 64;
+    int per_stream = (n + ordered_streams - 1)/ordered_streams;
+    vector<double> TOFs(ordered_streams, 1.0e12);
+    vector<int> last(ordered_streams, -1);
+    int eye = 0;
+    while(eye < n) {
+      for(int s=0; s<ordered_streams && eye<n; s++) {
+        for(int kay=0; kay<bank && eye<n; kay++, eye++) {
+          TOFs[s] += (benchmark_random(&state) % (2000000000ULL/per_stream)) + 0.001*(benchmark_random(&state) % 1000);
+          arr[eye].TOF = TOFs[s];
+          arr[eye].ID = s;
+          if(jitter > 0 && last[s] >= 0 && eye % jitter == 0) {
+            std::swap(arr[eye].TOF, arr[last[s]].TOF);
+          }
+          last[s] = eye;
+        }
+      }
+    }
+  }
+  for(int eye=0; eye<n; eye++) {
+    arr[eye].timestamp = Time_From_ns(arr[eye].TOF);
+    arr[eye].Islow = eye & 0xFFFF;
+  }
+}
+
+static double benchmark_seconds(struct timeval *start) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (now.tv_sec - start->tv_sec) + 1.0e-6*(now.tv_usec - start->tv_usec);
+}
+
+//Sorts synthetic blocks of Block_Buffer_Size entries with heapSort, radixSort, the stream merge and the window sort, checks that they give the same time order and
+//reports the times and the bytes copied.  The bytes include the copy of every entry into the sorted buffer that sort_array makes, which the
+//merge (used the way sort_array uses it, as an index order) does in place of moving the entries while sorting
+int benchmark_sort(Input_Parameters input_params) {
+
+  const int n = input_params.Block_Buffer_Size;
+  const int nblocks = 10;
+  int failures = 0;
+
+  DEVT_BANK *heap_arr = new DEVT_BANK[n];
+  DEVT_BANK *radix_arr = new DEVT_BANK[n];
+  DEVT_BANK *merge_src = new DEVT_BANK[n];
+  DEVT_BANK *merge_arr = new DEVT_BANK[n];
+  uint32_t *order = new uint32_t[n];
+
+  //random order, 162 time ordered channels, the same with some neighbours swapped, and a stage 1 block with 500 ns of time offsets.
+  //The window sort is given the window of the stage 1 block
+  int streams[4] = {0, 162, 162, 0};
+  int jitters[4] = {0, 0, 50, 0};
+  double spreads[4] = {0, 0, 0, 500.0};
+  const char *names[4] = {"random", "162 ordered channels", "162 nearly ordered channels", "stage 1"};
+  uint64_t window = Time_From_ns(500.0 + Sort_Window_Margin);
+
+  for(int kind=0; kind<4; kind++) {
+    double heap_time = 0;
+    double radix_time = 0;
+    double merge_time = 0;
+    uint64_t heap_bytes = 0;
+    uint64_t radix_bytes = 0;
+    uint64_t merge_bytes = 0;
+    double parallel_time = 0;
+    double window_time = 0;
+    vector<uint32_t> reference;
+    int fallbacks = 0;
+    int window_fallbacks = 0;
+    for(int block=0; block<nblocks; block++) {
+      benchmark_block(heap_arr, n, streams[kind], jitters[kind], spreads[kind], 0x9E3779B97F4A7C15ULL + block);
+      memcpy(radix_arr, heap_arr, n*sizeof(DEVT_BANK));
+      memcpy(merge_src, heap_arr, n*sizeof(DEVT_BANK));
+
+      struct timeval start;
+      gettimeofday(&start, NULL);
+      sort_bytes_copied = 0;
+      heapSort(heap_arr, n);
+      heap_time += benchmark_seconds(&start);
+      heap_bytes += sort_bytes_copied + (uint64_t)n*sizeof(DEVT_BANK);
+
+      gettimeofday(&start, NULL);
+      sort_bytes_copied = 0;
+      radixSort(radix_arr, n);
+      radix_time += benchmark_seconds(&start);
+      radix_bytes += sort_bytes_copied + (uint64_t)n*sizeof(DEVT_BANK);
+
+      //the merge as sort_array uses it: fall back to the full sort on disorder and copy the entries once in the order found
+      gettimeofday(&start, NULL);
+      sort_bytes_copied = 0;
+      if(streamMergeOrder(merge_src, n, n, order)) {
+        fallbacks++;
+        radixSortOrder(merge_src, n, order);
+      }
+      for(int eye=0; eye<n; eye++) {
+        merge_arr[eye] = merge_src[order[eye]];
+      }
+      merge_time += benchmark_seconds(&start);
+      merge_bytes += sort_bytes_copied + (uint64_t)n*sizeof(DEVT_BANK);
+
+      //the window sort and the sort on the sort threads have to give exactly the order of radixSortOrder
+      radixSortOrder(merge_src, n, order);
+      reference.assign(order, order+n);
+      gettimeofday(&start, NULL);
+      int window_ret = windowSortOrder(merge_src, n, window, order);
+      window_time += benchmark_seconds(&start);
+      if(window_ret) {
+        window_fallbacks++;
       }
       else {
-	double temp = (1.0*EVTS/(1.0*MaxDEVTArrSize));
-	if(temp>analysis_params->max_buffer_utilization) {
-	  analysis_params->max_buffer_utilization = temp;
-	}
+        for(int eye=0; eye<n; eye++) {
+          if(order[eye] != reference[eye]) {
+            failures++;
+          }
+        }
+      }
+      if(sort_pool != NULL) {
+        gettimeofday(&start, NULL);
+        parallelSortOrder(merge_src, n, order);
+        parallel_time += benchmark_seconds(&start);
+        for(int eye=0; eye<n; eye++) {
+          if(order[eye] != reference[eye]) {
+            failures++;
+          }
+        }
+      }
+
+      for(int eye=0; eye<n; eye++) {
+        if(heap_arr[eye].timestamp != radix_arr[eye].timestamp || heap_arr[eye].timestamp != merge_arr[eye].timestamp) {
+          failures++;
+        }
+        //stable: entries with the same key stay in the order they were made
+        if(eye>0 && sort_key(radix_arr[eye].timestamp) == sort_key(radix_arr[eye-1].timestamp) && radix_arr[eye].Islow < radix_arr[eye-1].Islow) {
+          failures++;
+        }
       }
-#endif	
     }
-    
-    //remove the ones put onto the array so we dont double things
-    for(int k=0; k<(deque_size-first_index); k++) {
-      datadeque.pop_back();
+
+    std::stringstream smsg;
+    smsg<<"Sorting "<<nblocks<<" blocks of "<<n<<" entries ("<<names[kind]<<"): heapSort "<<1000.0*heap_time/nblocks<<" ms/block, radixSort "<<1000.0*radix_time/nblocks<<" ms/block, ";
+    smsg<<"stream merge "<<1000.0*merge_time/nblocks<<" ms/block ("<<fallbacks<<" full sorts), ";
+    smsg<<"window sort order "<<1000.0*window_time/nblocks<<" ms/block ("<<window_fallbacks<<" blocks out of the window)";
+    if(sort_pool != NULL) {
+      smsg<<", radix sort order on "<<sort_pool->Size()<<" threads "<<1000.0*parallel_time/nblocks<<" ms/block";
+    }
+    DANCE_Info("Unpacker",smsg.str());
+    smsg.str("");
+    smsg<<"Bytes copied per block ("<<names[kind]<<"): heapSort "<<heap_bytes/nblocks/1.0e6<<" MB, radixSort "<<radix_bytes/nblocks/1.0e6<<" MB, ";
+    smsg<<"stream merge "<<merge_bytes/nblocks/1.0e6<<" MB ("<<n*sizeof(DEVT_BANK)/1.0e6<<" MB is one copy of the block)";
+    DANCE_Info("Unpacker",smsg.str());
+  }
+
+  delete [] heap_arr;
+  delete [] radix_arr;
+  delete [] merge_src;
+  delete [] merge_arr;
+  delete [] order;
+
+  std::stringstream smsg;
+  if(failures > 0) {
+    smsg<<"The block sorts disagree on "<<failures<<" entries of the benchmark blocks";
+    DANCE_Error("Unpacker",smsg.str());
+    return -1;
+  }
+  smsg<<"heapSort, radixSort, the stream merge, the window sort and the radix sort on the sort threads agree on the benchmark blocks";
+  DANCE_Success("Unpacker",smsg.str());
+  return 0;
+}
+
+
+//Measures how late the entries of a block are: how far the earliest entry of each ID is behind the newest entry already in the buffer.
+//Entries later than the buffer depth would arrive after their time was event built, so the depth is raised to Buffer_Depth_Margin times
+//the lateness as soon as it is seen, as far as Max_Buffer_Memory allows.  Entries that are already too late are counted and merged anyway.
+static void check_lateness(DEVT_BANK db_arr[], int n, Sorted_Buffer &datadeque, const Input_Parameters &input_params, Analysis_Parameters *analysis_params) {
+
+  if(datadeque.size() == 0 || n == 0) {
+    return;
+  }
+
+  int64_t newest = datadeque.back().timestamp;
+  int64_t oldest = datadeque.front().timestamp;
+
+  //earliest entry of each ID of the DANCE map (the rest share the last one)
+  int64_t earliest[256];
+  for(int id=0; id<256; id++) {
+    earliest[id] = newest;
+  }
+  for(int eye=0; eye<n; eye++) {
+    int64_t timestamp = db_arr[eye].timestamp;
+    int id = db_arr[eye].ID < 256 ? db_arr[eye].ID : 255;
+    if(timestamp < earliest[id]) {
+      earliest[id] = timestamp;
+    }
+    if(analysis_params->event_building_active && timestamp < oldest) {
+      analysis_params->late_entries++;
+    }
+  }
+
+  int64_t lateness_ticks = 0;
+  int block_ID = -1;
+  for(int id=0; id<256; id++) {
+    if(newest - earliest[id] > lateness_ticks) {
+      lateness_ticks = newest - earliest[id];
+      block_ID = id;
+    }
+  }
+  double block_lateness = Time_To_ns(lateness_ticks);
+  if(block_lateness > analysis_params->max_lateness) {
+    analysis_params->max_lateness = block_lateness;
+    analysis_params->max_lateness_ID = block_ID;
+  }
+
+  double new_depth = Buffer_Depth_Margin*block_lateness/1.0e9;
+  if(new_depth <= analysis_params->buffer_depth) {
+    return;
+  }
+
+  //Deepest buffer that fits in Max_Buffer_Memory at the rate entries fill the buffer now, along with the DEVT array.
+  //The ring buffer doubles when it grows so it can take up to twice the memory of the entries in it
+  double span = Time_To_ns(newest - oldest)/1.0e9;
+  if(span > 0) {
+    double rate = datadeque.size()/span;
+    double max_entries = input_params.Max_Buffer_Memory*1024.0*1024.0/(2.0*sizeof(DEVT_BANK)) - input_params.DEVT_Array_Size;
+    double max_depth = max_entries/rate;
+    if(new_depth > max_depth) {
+      new_depth = max_depth;
+      analysis_params->buffer_memory_limited = true;
     }
   }
+  if(new_depth <= analysis_params->buffer_depth) {
+    return;
+  }
+
+  std::stringstream smsg;
+  smsg<<"Raised the Buffer Depth from "<<analysis_params->buffer_depth<<" to "<<new_depth<<" seconds: ID "<<block_ID<<" arrived "<<block_lateness/1.0e9<<" seconds behind the newest entry in the buffer";
+  DANCE_Info("Unpacker",smsg.str());
+  analysis_params->buffer_depth = new_depth;
+  analysis_params->buffer_depth_raises++;
+}
+
+
+int sort_array(DEVT_BANK db_arr[], Sorted_Buffer &datadeque, uint32_t EVTS, Input_Parameters input_params, Analysis_Parameters *analysis_params) {
+
+  
+  int EVT_SORT=EVTS;
   
 #ifdef EventSort_Verbose
-  cout<<"Deque Size after reduction: "<<datadeque.size()<<"  About to sort "<<EVT_SORT<<" events"<<endl;
+  cout<<endl<<"total events at start: "<<EVTS+datadeque.size()<<" deque size: "<<datadeque.size()<<endl;
+#endif
+  
+  //how late the entries are and the buffer depth they need
+  check_lateness(db_arr, EVT_SORT, datadeque, input_params, analysis_params);
+
+#ifdef CheckBufferDepth
+  double temp = (1.0*EVTS/(1.0*input_params.DEVT_Array_Size));
+  if(temp>analysis_params->max_buffer_utilization) {
+    analysis_params->max_buffer_utilization = temp;
+  }
+#endif
+  
+#ifdef EventSort_Verbose
+  cout<<"About to sort "<<EVT_SORT<<" events"<<endl;
 #endif
   
   //the first sort is over
   analysis_params->first_sort=false;
   
   //sort the unsorted data
-  heapSort(db_arr, EVT_SORT);
+  uint32_t *order = block_time_order(db_arr, EVT_SORT, EVT_SORT, analysis_params);
   
-  //push the now sorted data onto the sorted buffer
-  for(int j=0; j<EVT_SORT; j++) {
-    //Update and push it onto the deque if valid
-    datadeque.push_back(db_arr[j]);
+  //merge the sorted block into the buffer.  The part of the block later than everything in the buffer is copied straight to the back (split
+  //over the sort threads).  The rest is merged with the end of the buffer from the back: entries of the buffer later than it move up to make
+  //room and entries of the buffer with the same key stay ahead of the new ones.  Each entry of the block is copied once, straight into its place
+  size_t old_size = datadeque.size();
+  int first_after = 0;
+  if(old_size > 0) {
+    uint64_t back_key = sort_key(datadeque.back().timestamp);
+    int high = EVT_SORT;
+    while(first_after < high) {
+      int middle = (first_after + high)/2;
+      if(sort_key(db_arr[order[middle]].timestamp) > back_key) {
+        high = middle;
+      }
+      else {
+        first_after = middle + 1;
+      }
+    }
+  }
+  datadeque.Extend(EVT_SORT);
+  sort_parallel_for(EVT_SORT - first_after, [&](int first, int last) {
+    for(int j=first_after+first; j<first_after+last; j++) {
+      datadeque[old_size + j] = db_arr[order[j]];
+    }
+  });
+
+  int64_t buffer_index = (int64_t)old_size - 1;
+  uint64_t buffer_key = buffer_index >= 0 ? sort_key(datadeque[buffer_index].timestamp) : 0;
+  size_t write_index = old_size + first_after;
+  for(int j=first_after-1; j>=0; j--) {
+    const DEVT_BANK &entry = db_arr[order[j]];
+    uint64_t key = sort_key(entry.timestamp);
+    while(buffer_index >= 0 && buffer_key > key) {
+      datadeque[--write_index] = datadeque[buffer_index--];
+      if(buffer_index >= 0) {
+        buffer_key = sort_key(datadeque[buffer_index].timestamp);
+      }
+    }
+    datadeque[--write_index] = entry;
   }
   
+#ifdef EventSort_Verbose
+  cout<<"Merged "<<old_size+first_after-write_index<<" entries with the end of the buffer"<<endl;
+#endif
+  
 #ifdef CheckTheDeque
   cout<<"Checking deque"<<endl;
   for(int k=0; k<(int)datadeque.size()-1; k++) {
@@ -42,7 +42,7 @@
 //*  Christopher J. Prokop  *//
 //*  cprokop@lanl.gov       *//
 //*  sort_functions.h       *// 
-//*  Last Edit: 01/23/18    *//  
+//*  Last Edit: 10/19/26    *//  
 //***************************//
 
 #ifndef SORT_FUNCTIONS_H
@@ -50,12 +50,12 @@
 
 //File includes
 #include "structures.h"
+#include "sorted_buffer.h"
 
 //C/C++ includes
 #include <iostream>
 #include <sstream>
 #include <fstream>
-#include <deque>
 #include <vector>
 #include <stdlib.h>
 
@@ -65,7 +65,17 @@ using namespace std;
 void heapify(DEVT_BANK arr[], int n, int i);
 void heapSort(DEVT_BANK arr[], int n);
 void printArray(DEVT_BANK arr[], int n);
+void radixSortOrder(DEVT_BANK arr[], int n, uint32_t order[]);
+void radixSort(DEVT_BANK arr[], int n);
+int streamMergeOrder(DEVT_BANK arr[], int n, int sorted_from, uint32_t order[]);
+int streamMergeSort(DEVT_BANK arr[], int n, int sorted_from);
+int windowSortOrder(DEVT_BANK arr[], int n, uint64_t window, uint32_t order[]);
+int Set_Sort_Window(Input_Parameters input_params);
+void parallelSortOrder(DEVT_BANK arr[], int n, uint32_t order[]);
+int Start_Sort_Threads(Input_Parameters input_params);
+void Stop_Sort_Threads();
+int benchmark_sort(Input_Parameters input_params);
 
-int sort_array(DEVT_BANK db_arr[], deque<DEVT_BANK> &datadeque, uint32_t EVTS, Input_Parameters input_params, Analysis_Parameters *analysis_params);
+int sort_array(DEVT_BANK db_arr[], Sorted_Buffer &datadeque, uint32_t EVTS, Input_Parameters input_params, Analysis_Parameters *analysis_params);
 
 #endif
@@ -0,0 +1,84 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+
+
+//***************************//
+//*  sorted_buffer.cpp      *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+//File includes
+#include "sorted_buffer.h"
+
+//C/C++ includes
+#include <string.h>
+
+Sorted_Buffer::Sorted_Buffer(size_t initial_entries) {
+  capacity = 1;
+  while(capacity < initial_entries) {
+    capacity *= 2;
+  }
+  mask = capacity - 1;
+  data = new DEVT_BANK[capacity];
+  head = 0;
+  count = 0;
+}
+
+Sorted_Buffer::~Sorted_Buffer() {
+  delete [] data;
+}
+
+//Doubles the array until needed entries fit and unwraps the entries to the start of it
+void Sorted_Buffer::Grow(size_t needed) {
+  size_t new_capacity = capacity;
+  while(new_capacity < needed) {
+    new_capacity *= 2;
+  }
+  DEVT_BANK *new_data = new DEVT_BANK[new_capacity];
+
+  //the entries from the head to the end of the array and then the ones that wrapped around to the start
+  size_t first = count < capacity - head ? count : capacity - head;
+  memcpy(new_data, data + head, first*sizeof(DEVT_BANK));
+  memcpy(new_data + first, data, (count - first)*sizeof(DEVT_BANK));
+
+  delete [] data;
+  data = new_data;
+  capacity = new_capacity;
+  mask = capacity - 1;
+  head = 0;
+}
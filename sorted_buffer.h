@@ -0,0 +1,105 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//***************************//
+//*  sorted_buffer.h        *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+#ifndef SORTED_BUFFER_H
+#define SORTED_BUFFER_H
+
+//File includes
+#include "structures.h"
+
+//C/C++ includes
+#include <stddef.h>
+
+//Time sorted entries waiting for event building.  A growable ring buffer: the entries sit in one array
+//(a power of two long) and the front is taken off by moving the head, so nothing is freed or allocated
+//as the event builder consumes entries and sort_array adds blocks.
+class Sorted_Buffer {
+
+ public:
+  Sorted_Buffer(size_t initial_entries);
+  ~Sorted_Buffer();
+
+  size_t size() const { return count; }
+  size_t Capacity() const { return capacity; }
+
+  DEVT_BANK& operator[](size_t index) { return data[(head + index) & mask]; }
+  DEVT_BANK& front() { return data[head]; }
+  DEVT_BANK& back() { return data[(head + count - 1) & mask]; }
+
+  void pop_front() {
+    head = (head + 1) & mask;
+    count--;
+  }
+
+  //Takes n entries off the front at once
+  void pop_front(size_t n) {
+    head = (head + n) & mask;
+    count -= n;
+  }
+
+  void push_back(const DEVT_BANK &entry) {
+    if(count == capacity) {
+      Grow(count + 1);
+    }
+    data[(head + count) & mask] = entry;
+    count++;
+  }
+
+  //Adds n entries to the back to be filled in by the caller
+  void Extend(size_t n) {
+    if(count + n > capacity) {
+      Grow(count + n);
+    }
+    count += n;
+  }
+
+ private:
+  void Grow(size_t needed);
+
+  DEVT_BANK *data;
+  size_t capacity;
+  size_t mask;
+  size_t head;
+  size_t count;
+};
+
+#endif
@@ -0,0 +1,135 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+
+
+
+//***************************//
+//*  spsc_queue.h           *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+//C/C++ includes
+#include <stddef.h>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+//Seconds on a steady clock, for the time the pipeline stages spend waiting
+inline double Pipeline_Time() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Bounded queue between one producer thread and one consumer thread.  The items sit in a ring (a power of two long) and each end is only
+//moved by its own thread, so pushing and popping take no locks.  Push and Pop wait while the queue is full or empty, first yielding and
+//then in short sleeps, and add the time waited to *waited
+template <class T>
+class SPSC_Queue {
+
+ public:
+  SPSC_Queue(size_t capacity) : head(0), tail(0) {
+    size_t size = 2;
+    while(size < capacity) {
+      size *= 2;
+    }
+    items.resize(size);
+    mask = size - 1;
+  }
+
+  bool Try_Push(const T &item) {
+    size_t back = tail.load(std::memory_order_relaxed);
+    if(back - head.load(std::memory_order_acquire) > mask) {
+      return false;
+    }
+    items[back & mask] = item;
+    tail.store(back + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Try_Pop(T &item) {
+    size_t front = head.load(std::memory_order_relaxed);
+    if(front == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = items[front & mask];
+    head.store(front + 1, std::memory_order_release);
+    return true;
+  }
+
+  void Push(const T &item, double *waited) {
+    if(Try_Push(item)) {
+      return;
+    }
+    double start = Pipeline_Time();
+    for(int tries=0; !Try_Push(item); tries++) {
+      Back_Off(tries);
+    }
+    *waited += Pipeline_Time() - start;
+  }
+
+  void Pop(T &item, double *waited) {
+    if(Try_Pop(item)) {
+      return;
+    }
+    double start = Pipeline_Time();
+    for(int tries=0; !Try_Pop(item); tries++) {
+      Back_Off(tries);
+    }
+    *waited += Pipeline_Time() - start;
+  }
+
+ private:
+  static void Back_Off(int tries) {
+    if(tries < 64) {
+      std::this_thread::yield();
+    }
+    else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+  std::vector<T> items;
+  size_t mask;
+  alignas(64) std::atomic<size_t> head;   //next item to pop (moved by the consumer)
+  alignas(64) std::atomic<size_t> tail;   //next slot to push (moved by the producer)
+};
+
+#endif
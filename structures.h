@@ -53,6 +53,7 @@
 //File includes
 #include "global.h"
 #include "message.h"
+#include "dance_time.h"
 
 // C/C++ includes 
 #include <stdint.h>  //uint16_t, uint32_t, uint64_t
@@ -149,7 +150,7 @@ typedef struct{
 } test_struct_cevt;
 
 typedef struct {
-  double timestamp;        // timestamp
+  int64_t timestamp;         // Full timestamp in time ticks (Time_Ticks per ns)
   double wfintegral;          //wfratio added
   uint16_t Ns;               // number of samples in waveform
   uint16_t Ifast;            // short integral
@@ -191,7 +192,7 @@ typedef struct {
 typedef struct{
   double En[162];                 //Neutron energy from TOF
   double En_corr[162];            //Neutron energy from TOF corrected for moderator function
-  double timestamp[162];     //Timestamp of the crystal
+  int64_t timestamp[162];    //Timestamp of the crystal in time ticks
   double tof[162];           //Neutron Time-Of-Flight from each crystal
   double tof_corr[162];      //Neutron Time-Of-Flight from each crystal corrected for moderator function
   uint16_t Crystal_mult;     //DANCE crystal multiplicity 
@@ -252,12 +253,28 @@ typedef struct{
 } Bkg_Event;
 
 
+//Blocking times and thresholds of a sweep variant (NSweep_Variants in the cfg file)
+typedef struct{
+  double Crystal_Blocking_Time;
+  double DEvent_Blocking_Time;
+  double Energy_Threshold; //MeV
+  bool HAVE_Threshold;
+} Sweep_Variant;
+
 //Input parameters 
 typedef struct{
   double Crystal_Blocking_Time;
   double DEvent_Blocking_Time;
   double Coincidence_Window;
+  int64_t Crystal_Blocking_Ticks;   //The blocking times and coincidence window in time ticks
+  int64_t DEvent_Blocking_Ticks;
+  int64_t Coincidence_Window_Ticks;
+  int NCoincidence_Scan;
+  double Coincidence_Scan[Max_Coincidence_Scan];         //Coincidence windows built and analyzed alongside Coincidence_Window (ns)
+  int64_t Coincidence_Scan_Ticks[Max_Coincidence_Scan];
   double Energy_Threshold; //MeV
+  int NSweep_Variants;
+  Sweep_Variant Sweep_Variants[Max_Sweep_Variants];      //Validated, event built and analyzed alongside the blocking times and threshold above
   //Bools
   bool Read_Binary;
   bool Write_Binary;
@@ -301,6 +318,18 @@ typedef struct{
 
   //Unpacker variables
   double Buffer_Depth;
+  int Unpacker_Threads;      //Threads decoding the boards of a caen2018 MIDAS event
+  int Sort_Threads;          //Threads sorting each block of entries
+  bool Pipeline;             //Unpack, sort and eventbuild, and analyze on their own threads (pipeline.h)
+  int Pipeline_Queue_Depth;  //Blocks of entries and batches of events waiting between the pipeline stages
+  int Analysis_Threads;      //Analysis workers in the pipeline, each with its own histograms
+  int Block_Buffer_Size;     //Entries unpacked before each time sort
+  int DEVT_Array_Size;       //Size of the array of unsorted entries (at least Block_Buffer_Size + DEVT_Array_Headroom)
+  double Max_Buffer_Memory;  //Largest the sorted buffer can grow to when the buffer depth is raised (MB)
+  bool Recover_Corrupt_Data; //Skip to the next good MIDAS event on corrupted data instead of stopping
+  int NExcluded_IDs;
+  int Excluded_IDs[256];     //IDs skipped by the unpacker (dead crystals)
+  int Waveform_Reservoir_Size; //Waveforms sampled per ID and pileup category for the waveform histograms (0 is off)
 
 
 
@@ -309,17 +338,17 @@ typedef struct{
 
 //Analysis parameters
 typedef struct{
-  double last_timestamp[256];
+  int64_t last_timestamp[256];         //Times in time ticks
   double last_Islow[256];
   double last_Eslow[256];
   double last_Efast[256];
   uint16_t last_Alpha[256];
   uint16_t last_Gamma[256];
   uint8_t last_InvalidReason[256];
-  double last_valid_timestamp[256];
+  int64_t last_valid_timestamp[256];
   double last_valid_Islow[256];
   double last_valid_Eslow[256];
-  double last_last_T0;
+  int64_t last_last_T0;
 
   uint32_t entries_unpacked;            //Entries that have been unpacked
   uint32_t entries_awaiting_timesort;   //Entries in the devt array waiting for timesort
@@ -328,6 +357,7 @@ typedef struct{
   uint32_t entries_invalid;             //Entries invalid before analysis
   uint32_t entries_built;               //Entries built into events
   uint32_t events_built;                //Events built
+  uint32_t event_vector_reallocations;  //Times the DANCE event vector had to grow (only for the first events)
 
   uint32_t entries_analyzed;
   uint32_t DANCE_entries_analyzed;
@@ -346,14 +376,32 @@ typedef struct{
   uint32_t Bkg_events_analyzed;
   uint32_t U235_events_analyzed;
 
+  //Corrupted data skipped by the unpacker in recovery mode
+  uint64_t corrupt_bytes_skipped;       //Bytes scanned over to find the next MIDAS event
+  uint32_t corrupt_events_skipped;      //MIDAS events dropped
+  uint32_t corrupt_banks_skipped;       //Board banks cut short by a bad header or aggregate size
+  uint32_t corrupt_ranges;              //Stretches of corrupted data
+
   double max_buffer_utilization;
 
+  uint32_t blocks_sorted;               //Blocks time ordered by sort_array
+  uint32_t blocks_fully_sorted;         //Blocks too far out of order in a channel to merge
+  uint32_t blocks_window_sorted;        //Stage 1 blocks time ordered by the window sort
+
+  //Buffer depth, raised while unpacking when entries arrive late
+  double buffer_depth;                  //Current buffer depth (seconds)
+  double max_lateness;                  //Farthest an ID's entry has been behind the newest entry in the buffer (ns)
+  int max_lateness_ID;                  //ID of that entry
+  uint32_t late_entries;                //Entries older than the start of the buffer, after their time was already event built
+  uint32_t buffer_depth_raises;         //Times the buffer depth was raised
+  bool buffer_memory_limited;           //The buffer depth could not be raised as far as needed because of Max_Buffer_Memory
+
   bool first_sort;
   bool event_building_active;  //this says whether or not we are event building yet
-  double smallest_timestamp;
-  double largest_timestamp;
-  double largest_subrun_timestamp;
-  double last_subrun_timestamp;
+  int64_t smallest_timestamp;          //Times in time ticks
+  int64_t largest_timestamp;
+  int64_t largest_subrun_timestamp;
+  int64_t last_subrun_timestamp;
   double wf_integral;
 
 } Analysis_Parameters;
@@ -0,0 +1,144 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//***************************//
+//*  thread_pool.cpp        *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+//File includes
+#include "thread_pool.h"
+
+Thread_Pool::Thread_Pool(int nthreads) {
+
+  nworkers = nthreads < 1 ? 1 : nthreads;
+  batch_size = 0;
+  next_task = 0;
+  tasks_done = 0;
+  active_workers = 0;
+  batch_number = 0;
+  stop = false;
+
+  //worker 0 is whoever calls Run()
+  for(int eye=1; eye<nworkers; eye++) {
+    workers.push_back(std::thread(&Thread_Pool::Worker_Loop, this, eye));
+  }
+}
+
+Thread_Pool::~Thread_Pool() {
+
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    stop = true;
+  }
+  start_cv.notify_all();
+  for(size_t eye=0; eye<workers.size(); eye++) {
+    workers[eye].join();
+  }
+}
+
+//ntasks and task are the worker's own copies of the batch it took, so a batch started after this one is never mixed in
+void Thread_Pool::Work_On_Batch(int worker, int ntasks, const std::function<void(int,int)> &task) {
+
+  int finished = 0;
+  int task_number;
+  while((task_number = next_task.fetch_add(1)) < ntasks) {
+    task(task_number, worker);
+    finished++;
+  }
+
+  std::lock_guard<std::mutex> lock(pool_mutex);
+  tasks_done += finished;
+  if(worker != 0) {
+    active_workers--;
+  }
+  done_cv.notify_all();
+}
+
+void Thread_Pool::Worker_Loop(int worker) {
+
+  uint64_t last_batch = 0;
+  while(true) {
+    int ntasks;
+    std::function<void(int,int)> task;
+    {
+      std::unique_lock<std::mutex> lock(pool_mutex);
+      start_cv.wait(lock, [&] { return stop || batch_number != last_batch; });
+      if(stop) {
+	return;
+      }
+      last_batch = batch_number;
+      ntasks = batch_size;
+      task = batch_task;
+      active_workers++;
+    }
+    Work_On_Batch(worker, ntasks, task);
+  }
+}
+
+void Thread_Pool::Run(int ntasks, std::function<void(int,int)> task) {
+
+  if(ntasks <= 0) {
+    return;
+  }
+
+  //nothing to hand out
+  if(nworkers == 1 || ntasks == 1) {
+    for(int eye=0; eye<ntasks; eye++) {
+      task(eye, 0);
+    }
+    return;
+  }
+
+  {
+    //A worker that took the last batch late may still be claiming (past the end of) its tasks
+    std::unique_lock<std::mutex> lock(pool_mutex);
+    done_cv.wait(lock, [&] { return active_workers == 0; });
+    batch_task = task;
+    batch_size = ntasks;
+    tasks_done = 0;
+    next_task = 0;
+    batch_number++;
+  }
+  start_cv.notify_all();
+
+  Work_On_Batch(0, ntasks, task);
+
+  //Done once every task has been run and every worker that took the batch has left it
+  std::unique_lock<std::mutex> lock(pool_mutex);
+  done_cv.wait(lock, [&] { return tasks_done == ntasks && active_workers == 0; });
+}
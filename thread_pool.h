@@ -0,0 +1,86 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//***************************//
+//*  thread_pool.h          *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+//C/C++ includes
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+//Fixed set of worker threads that run a batch of independent tasks.
+//Run() hands out task numbers 0 to ntasks-1 and returns when all of them are done.
+//The calling thread works on the batch as well and is always worker 0.
+class Thread_Pool {
+
+ public:
+  Thread_Pool(int nthreads);
+  ~Thread_Pool();
+
+  //task function gets (task number, worker number)
+  void Run(int ntasks, std::function<void(int,int)> task);
+  int Size() { return nworkers; }
+
+ private:
+  void Worker_Loop(int worker);
+  void Work_On_Batch(int worker, int ntasks, const std::function<void(int,int)> &task);
+
+  int nworkers;
+  std::vector<std::thread> workers;
+  std::mutex pool_mutex;
+  std::condition_variable start_cv;
+  std::condition_variable done_cv;
+
+  std::function<void(int,int)> batch_task;
+  int batch_size;
+  std::atomic<int> next_task;
+  int tasks_done;
+  int active_workers;    //Workers (not the caller) between taking a batch and counting what they did
+  uint64_t batch_number;
+  bool stop;
+};
+
+#endif
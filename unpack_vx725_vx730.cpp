@@ -45,6 +45,34 @@
 //***************************//
 
 #include "unpack_vx725_vx730.h"
+#include "global.h"
+#include "message.h"
+
+//C/C++ includes
+#include <string.h>
+#include <sstream>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define Vx725_Vx730_X86_SIMD
+#include <immintrin.h>
+#endif
+
+//PSD digital probes: DP1 in bits 14/30 and DP2 in bits 15/31
+const Vx725_Vx730_Probe_Layout_t vx725_vx730_psd_probe_layout = {
+  Vx725_Vx730_PSD_DP1_0_MASK, 14,
+  Vx725_Vx730_PSD_DP2_0_MASK, 15,
+  Vx725_Vx730_PSD_DP1_1_MASK, 30,
+  Vx725_Vx730_PSD_DP2_1_MASK, 31
+};
+
+//PHA digital probes (trigger and DP) with the shifts used since version 7.2.2
+const Vx725_Vx730_Probe_Layout_t vx725_vx730_pha_probe_layout = {
+  Vx725_Vx730_PHA_T_0_MASK, 14,
+  Vx725_Vx730_PHA_DP_0_MASK, 15,
+  Vx725_Vx730_PHA_T_1_MASK, 30,
+  Vx725_Vx730_PHA_DP_1_MASK, 31
+};
 
 
 int unpack_vx725_vx730_board_data(V1730_Header_t *v1730_header, Vx725_Vx730_Board_Data_t *vx725_vx730_board_data) {
@@ -68,6 +96,234 @@ int unpack_vx725_vx730_board_data(V1730_Header_t *v1730_header, Vx725_Vx730_Boar
 }
 
 
+int unpack_vx725_vx730_probes_scalar(const uint32_t *probe_data, uint32_t probe_words, uint8_t dual_trace, const Vx725_Vx730_Probe_Layout_t *layout,
+				     uint16_t *analog_probe1, uint16_t *analog_probe2, uint8_t *digital_probe1, uint8_t *digital_probe2) {
+
+  //Dual trace off
+  if(dual_trace == 0) {
+    for(uint32_t kay=0; kay<probe_words; kay++) {
+      uint32_t word = probe_data[kay];
+      
+      //analog probes
+      analog_probe1[2*kay] = (word & Vx725_Vx730_PSD_AP_0_MASK);
+      analog_probe2[2*kay] = 0;
+      analog_probe1[2*kay+1] = (word & Vx725_Vx730_PSD_AP_1_MASK) >> 16;
+      analog_probe2[2*kay+1] = 0;
+      
+      //digital probes
+      digital_probe1[2*kay] = (word & layout->dp1_0_mask) >> layout->dp1_0_shift;
+      digital_probe2[2*kay] = (word & layout->dp2_0_mask) >> layout->dp2_0_shift;
+      digital_probe1[2*kay+1] = (word & layout->dp1_1_mask) >> layout->dp1_1_shift;
+      digital_probe2[2*kay+1] = (word & layout->dp2_1_mask) >> layout->dp2_1_shift;
+    }
+  } //End dual trace off
+  
+  //Dual trace on
+  else if(dual_trace == 1) {
+    for(uint32_t kay=0; kay<probe_words; kay++) {
+      uint32_t word = probe_data[kay];
+      
+      //analog probes
+      analog_probe1[kay] = (word & Vx725_Vx730_PSD_AP_0_MASK);
+      analog_probe2[kay] = (word & Vx725_Vx730_PSD_AP_1_MASK) >> 16;
+      
+      //digital probes
+      digital_probe1[2*kay] = (word & layout->dp1_0_mask) >> layout->dp1_0_shift;
+      digital_probe2[2*kay] = (word & layout->dp2_0_mask) >> layout->dp2_0_shift;
+      digital_probe1[2*kay+1] = (word & layout->dp1_1_mask) >> layout->dp1_1_shift;
+      digital_probe2[2*kay+1] = (word & layout->dp2_1_mask) >> layout->dp2_1_shift;
+    }
+  } //End dual trace on
+  
+  //Dual trace is messed up
+  else {
+    return -1;
+  }
+  
+  return probe_words;
+}
+
+
+#ifdef Vx725_Vx730_X86_SIMD
+
+//SSE4.1 version: 8 probe words per pass
+__attribute__((target("sse4.1")))
+static int unpack_vx725_vx730_probes_sse4(const uint32_t *probe_data, uint32_t probe_words, uint8_t dual_trace, const Vx725_Vx730_Probe_Layout_t *layout,
+					  uint16_t *analog_probe1, uint16_t *analog_probe2, uint8_t *digital_probe1, uint8_t *digital_probe2) {
+  
+  if(dual_trace > 1) {
+    return -1;
+  }
+
+  const __m128i ap_mask = _mm_set1_epi32(Vx725_Vx730_PSD_AP_0_MASK);
+  const __m128i ap_pair_mask = _mm_set1_epi32(Vx725_Vx730_PSD_AP_0_MASK | Vx725_Vx730_PSD_AP_1_MASK);
+  const __m128i dp1_0_mask = _mm_set1_epi32(layout->dp1_0_mask);
+  const __m128i dp2_0_mask = _mm_set1_epi32(layout->dp2_0_mask);
+  const __m128i dp1_1_mask = _mm_set1_epi32(layout->dp1_1_mask);
+  const __m128i dp2_1_mask = _mm_set1_epi32(layout->dp2_1_mask);
+  const __m128i dp1_0_shift = _mm_cvtsi32_si128(layout->dp1_0_shift);
+  const __m128i dp2_0_shift = _mm_cvtsi32_si128(layout->dp2_0_shift);
+  const __m128i dp1_1_shift = _mm_cvtsi32_si128(layout->dp1_1_shift);
+  const __m128i dp2_1_shift = _mm_cvtsi32_si128(layout->dp2_1_shift);
+  const __m128i zero = _mm_setzero_si128();
+
+  uint32_t kay=0;
+  for(; kay+8<=probe_words; kay+=8) {
+    __m128i word_a = _mm_loadu_si128((const __m128i*)(probe_data+kay));
+    __m128i word_b = _mm_loadu_si128((const __m128i*)(probe_data+kay+4));
+
+    //analog probes
+    if(dual_trace == 0) {
+      //the two 14-bit samples are already in sample order once the digital bits are masked off
+      _mm_storeu_si128((__m128i*)(analog_probe1+2*kay), _mm_and_si128(word_a,ap_pair_mask));
+      _mm_storeu_si128((__m128i*)(analog_probe1+2*kay+8), _mm_and_si128(word_b,ap_pair_mask));
+      _mm_storeu_si128((__m128i*)(analog_probe2+2*kay), zero);
+      _mm_storeu_si128((__m128i*)(analog_probe2+2*kay+8), zero);
+    }
+    else {
+      //de-interleave the low samples into probe 1 and the high samples into probe 2
+      __m128i lo = _mm_packus_epi32(_mm_and_si128(word_a,ap_mask), _mm_and_si128(word_b,ap_mask));
+      __m128i hi = _mm_packus_epi32(_mm_and_si128(_mm_srli_epi32(word_a,16),ap_mask), _mm_and_si128(_mm_srli_epi32(word_b,16),ap_mask));
+      _mm_storeu_si128((__m128i*)(analog_probe1+kay), lo);
+      _mm_storeu_si128((__m128i*)(analog_probe2+kay), hi);
+    }
+
+    //digital probes: sample 0 goes to byte 0 and sample 1 to byte 1 of each 16-bit lane
+    __m128i dp1_a = _mm_or_si128(_mm_srl_epi32(_mm_and_si128(word_a,dp1_0_mask),dp1_0_shift), _mm_slli_epi32(_mm_srl_epi32(_mm_and_si128(word_a,dp1_1_mask),dp1_1_shift),8));
+    __m128i dp1_b = _mm_or_si128(_mm_srl_epi32(_mm_and_si128(word_b,dp1_0_mask),dp1_0_shift), _mm_slli_epi32(_mm_srl_epi32(_mm_and_si128(word_b,dp1_1_mask),dp1_1_shift),8));
+    __m128i dp2_a = _mm_or_si128(_mm_srl_epi32(_mm_and_si128(word_a,dp2_0_mask),dp2_0_shift), _mm_slli_epi32(_mm_srl_epi32(_mm_and_si128(word_a,dp2_1_mask),dp2_1_shift),8));
+    __m128i dp2_b = _mm_or_si128(_mm_srl_epi32(_mm_and_si128(word_b,dp2_0_mask),dp2_0_shift), _mm_slli_epi32(_mm_srl_epi32(_mm_and_si128(word_b,dp2_1_mask),dp2_1_shift),8));
+    _mm_storeu_si128((__m128i*)(digital_probe1+2*kay), _mm_packus_epi32(dp1_a,dp1_b));
+    _mm_storeu_si128((__m128i*)(digital_probe2+2*kay), _mm_packus_epi32(dp2_a,dp2_b));
+  }
+
+  //remaining words
+  if(kay < probe_words) {
+    uint32_t ap_offset = (dual_trace == 0) ? 2*kay : kay;
+    unpack_vx725_vx730_probes_scalar(probe_data+kay, probe_words-kay, dual_trace, layout,
+				     analog_probe1+ap_offset, analog_probe2+ap_offset, digital_probe1+2*kay, digital_probe2+2*kay);
+  }
+  
+  return probe_words;
+}
+
+
+//AVX2 version: 16 probe words per pass
+__attribute__((target("avx2")))
+static int unpack_vx725_vx730_probes_avx2(const uint32_t *probe_data, uint32_t probe_words, uint8_t dual_trace, const Vx725_Vx730_Probe_Layout_t *layout,
+					  uint16_t *analog_probe1, uint16_t *analog_probe2, uint8_t *digital_probe1, uint8_t *digital_probe2) {
+  
+  if(dual_trace > 1) {
+    return -1;
+  }
+
+  const __m256i ap_mask = _mm256_set1_epi32(Vx725_Vx730_PSD_AP_0_MASK);
+  const __m256i ap_pair_mask = _mm256_set1_epi32(Vx725_Vx730_PSD_AP_0_MASK | Vx725_Vx730_PSD_AP_1_MASK);
+  const __m256i dp1_0_mask = _mm256_set1_epi32(layout->dp1_0_mask);
+  const __m256i dp2_0_mask = _mm256_set1_epi32(layout->dp2_0_mask);
+  const __m256i dp1_1_mask = _mm256_set1_epi32(layout->dp1_1_mask);
+  const __m256i dp2_1_mask = _mm256_set1_epi32(layout->dp2_1_mask);
+  const __m128i dp1_0_shift = _mm_cvtsi32_si128(layout->dp1_0_shift);
+  const __m128i dp2_0_shift = _mm_cvtsi32_si128(layout->dp2_0_shift);
+  const __m128i dp1_1_shift = _mm_cvtsi32_si128(layout->dp1_1_shift);
+  const __m128i dp2_1_shift = _mm_cvtsi32_si128(layout->dp2_1_shift);
+  const __m256i zero = _mm256_setzero_si256();
+
+  uint32_t kay=0;
+  for(; kay+16<=probe_words; kay+=16) {
+    __m256i word_a = _mm256_loadu_si256((const __m256i*)(probe_data+kay));
+    __m256i word_b = _mm256_loadu_si256((const __m256i*)(probe_data+kay+8));
+
+    //analog probes
+    if(dual_trace == 0) {
+      _mm256_storeu_si256((__m256i*)(analog_probe1+2*kay), _mm256_and_si256(word_a,ap_pair_mask));
+      _mm256_storeu_si256((__m256i*)(analog_probe1+2*kay+16), _mm256_and_si256(word_b,ap_pair_mask));
+      _mm256_storeu_si256((__m256i*)(analog_probe2+2*kay), zero);
+      _mm256_storeu_si256((__m256i*)(analog_probe2+2*kay+16), zero);
+    }
+    else {
+      //packus works within 128-bit lanes so the 64-bit quarters are put back in order afterwards
+      __m256i lo = _mm256_packus_epi32(_mm256_and_si256(word_a,ap_mask), _mm256_and_si256(word_b,ap_mask));
+      __m256i hi = _mm256_packus_epi32(_mm256_and_si256(_mm256_srli_epi32(word_a,16),ap_mask), _mm256_and_si256(_mm256_srli_epi32(word_b,16),ap_mask));
+      _mm256_storeu_si256((__m256i*)(analog_probe1+kay), _mm256_permute4x64_epi64(lo,0xD8));
+      _mm256_storeu_si256((__m256i*)(analog_probe2+kay), _mm256_permute4x64_epi64(hi,0xD8));
+    }
+
+    //digital probes
+    __m256i dp1_a = _mm256_or_si256(_mm256_srl_epi32(_mm256_and_si256(word_a,dp1_0_mask),dp1_0_shift), _mm256_slli_epi32(_mm256_srl_epi32(_mm256_and_si256(word_a,dp1_1_mask),dp1_1_shift),8));
+    __m256i dp1_b = _mm256_or_si256(_mm256_srl_epi32(_mm256_and_si256(word_b,dp1_0_mask),dp1_0_shift), _mm256_slli_epi32(_mm256_srl_epi32(_mm256_and_si256(word_b,dp1_1_mask),dp1_1_shift),8));
+    __m256i dp2_a = _mm256_or_si256(_mm256_srl_epi32(_mm256_and_si256(word_a,dp2_0_mask),dp2_0_shift), _mm256_slli_epi32(_mm256_srl_epi32(_mm256_and_si256(word_a,dp2_1_mask),dp2_1_shift),8));
+    __m256i dp2_b = _mm256_or_si256(_mm256_srl_epi32(_mm256_and_si256(word_b,dp2_0_mask),dp2_0_shift), _mm256_slli_epi32(_mm256_srl_epi32(_mm256_and_si256(word_b,dp2_1_mask),dp2_1_shift),8));
+    _mm256_storeu_si256((__m256i*)(digital_probe1+2*kay), _mm256_permute4x64_epi64(_mm256_packus_epi32(dp1_a,dp1_b),0xD8));
+    _mm256_storeu_si256((__m256i*)(digital_probe2+2*kay), _mm256_permute4x64_epi64(_mm256_packus_epi32(dp2_a,dp2_b),0xD8));
+  }
+
+  //remaining words
+  if(kay < probe_words) {
+    uint32_t ap_offset = (dual_trace == 0) ? 2*kay : kay;
+    unpack_vx725_vx730_probes_sse4(probe_data+kay, probe_words-kay, dual_trace, layout,
+				   analog_probe1+ap_offset, analog_probe2+ap_offset, digital_probe1+2*kay, digital_probe2+2*kay);
+  }
+  
+  return probe_words;
+}
+
+#endif
+
+
+typedef int (*Vx725_Vx730_Probe_Unpacker_t)(const uint32_t*, uint32_t, uint8_t, const Vx725_Vx730_Probe_Layout_t*, uint16_t*, uint16_t*, uint8_t*, uint8_t*);
+
+static const char *probe_isa = "scalar";
+
+//Pick the widest probe unpacker the CPU supports
+static Vx725_Vx730_Probe_Unpacker_t select_probe_unpacker() {
+#ifdef Vx725_Vx730_X86_SIMD
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")) {
+    probe_isa = "avx2";
+    return &unpack_vx725_vx730_probes_avx2;
+  }
+  if(__builtin_cpu_supports("sse4.1")) {
+    probe_isa = "sse4.1";
+    return &unpack_vx725_vx730_probes_sse4;
+  }
+#endif
+  probe_isa = "scalar";
+  return &unpack_vx725_vx730_probes_scalar;
+}
+
+static Vx725_Vx730_Probe_Unpacker_t probe_unpacker = select_probe_unpacker();
+
+const char* unpack_vx725_vx730_probe_isa() {
+  return probe_isa;
+}
+
+
+int unpack_vx725_vx730_probes(const uint32_t *probe_data, uint32_t probe_words, uint8_t dual_trace, const Vx725_Vx730_Probe_Layout_t *layout,
+			      uint16_t *analog_probe1, uint16_t *analog_probe2, uint8_t *digital_probe1, uint8_t *digital_probe2) {
+
+  int ret = probe_unpacker(probe_data, probe_words, dual_trace, layout, analog_probe1, analog_probe2, digital_probe1, digital_probe2);
+
+#ifdef Validate_Probe_Unpacker
+  //Compare against the scalar reference bit for bit
+  if(ret >= 0) {
+    uint32_t ap_length = (dual_trace == 0) ? 2*probe_words : probe_words;
+    std::vector<uint16_t> ref_ap1(ap_length+1), ref_ap2(ap_length+1);
+    std::vector<uint8_t> ref_dp1(2*probe_words+1), ref_dp2(2*probe_words+1);
+    unpack_vx725_vx730_probes_scalar(probe_data, probe_words, dual_trace, layout, &ref_ap1[0], &ref_ap2[0], &ref_dp1[0], &ref_dp2[0]);
+    if(memcmp(&ref_ap1[0], analog_probe1, ap_length*sizeof(uint16_t)) != 0 ||
+       memcmp(&ref_ap2[0], analog_probe2, ap_length*sizeof(uint16_t)) != 0 ||
+       memcmp(&ref_dp1[0], digital_probe1, 2*probe_words) != 0 ||
+       memcmp(&ref_dp2[0], digital_probe2, 2*probe_words) != 0) {
+      DANCE_Error("Unpacker", std::string("Probe unpacker (") + probe_isa + ") does not match the scalar decoder");
+    }
+  }
+#endif
+
+  return ret;
+}
+
+
 int unpack_vx725_vx730_psd_chagg_header(V1730_ChAgg_Header_t *v1730_chagg_header, Vx725_Vx730_PSD_Data_t *vx725_vx730_psd_data) {
   
   //WORD 1
@@ -114,6 +370,126 @@ int unpack_vx725_vx730_pha_chagg_header(V1730_ChAgg_Header_t *v1730_chagg_header
 }
 
 
+//Decode the PSD extras word (kept inline so the specialized decoders fold the switch away)
+static inline void decode_vx725_vx730_psd_extras(int extras_option, Vx725_Vx730_PSD_Data_t *vx725_vx730_psd_data) {
+  switch(extras_option) {
+  case 0:
+    vx725_vx730_psd_data->extended_time_stamp = (vx725_vx730_psd_data->extras & 0xFFFF0000) >> 16;
+    vx725_vx730_psd_data->baseline_timesfour = (vx725_vx730_psd_data->extras & 0x0000FFFF);
+    vx725_vx730_psd_data->flags = 0;
+    vx725_vx730_psd_data->fine_time_stamp = 0;
+    vx725_vx730_psd_data->lost_trigger_counter = 0;
+    vx725_vx730_psd_data->total_trigger_counter = 0;
+    vx725_vx730_psd_data->cfd_sazc = 0;
+    vx725_vx730_psd_data->cfd_sbzc = 0;	
+    break;
+  case 1:
+    vx725_vx730_psd_data->extended_time_stamp = (vx725_vx730_psd_data->extras & 0xFFFF0000) >> 16;
+    vx725_vx730_psd_data->baseline_timesfour = 0;
+    vx725_vx730_psd_data->flags = (vx725_vx730_psd_data->extras & 0x0000FFFF);
+    vx725_vx730_psd_data->fine_time_stamp =0;
+    vx725_vx730_psd_data->lost_trigger_counter = 0;
+    vx725_vx730_psd_data->total_trigger_counter = 0;
+    vx725_vx730_psd_data->cfd_sazc = 0;
+    vx725_vx730_psd_data->cfd_sbzc = 0;
+    break;
+  case 2:
+    vx725_vx730_psd_data->extended_time_stamp = (vx725_vx730_psd_data->extras & 0xFFFF0000) >> 16;
+    vx725_vx730_psd_data->baseline_timesfour = 0;
+    vx725_vx730_psd_data->flags = (vx725_vx730_psd_data->extras & 0x0000FC00) >> 10;
+    vx725_vx730_psd_data->fine_time_stamp = (vx725_vx730_psd_data->extras & 0x000003FF);
+    vx725_vx730_psd_data->lost_trigger_counter = 0;
+    vx725_vx730_psd_data->total_trigger_counter = 0;
+    vx725_vx730_psd_data->cfd_sazc = 0;
+    vx725_vx730_psd_data->cfd_sbzc = 0;
+    break;
+  case 4:
+    vx725_vx730_psd_data->extended_time_stamp = 0;
+    vx725_vx730_psd_data->baseline_timesfour = 0;
+    vx725_vx730_psd_data->flags = 0;
+    vx725_vx730_psd_data->fine_time_stamp = 0;
+    vx725_vx730_psd_data->lost_trigger_counter = (vx725_vx730_psd_data->extras & 0xFFFF0000) >> 16;
+    vx725_vx730_psd_data->total_trigger_counter = (vx725_vx730_psd_data->extras & 0x0000FFFF);
+    vx725_vx730_psd_data->cfd_sazc = 0;
+    vx725_vx730_psd_data->cfd_sbzc = 0;
+    break;
+  case 5:
+    vx725_vx730_psd_data->extended_time_stamp = 0;
+    vx725_vx730_psd_data->baseline_timesfour = 0;
+    vx725_vx730_psd_data->flags = 0;
+    vx725_vx730_psd_data->fine_time_stamp = 0;
+    vx725_vx730_psd_data->lost_trigger_counter = 0;
+    vx725_vx730_psd_data->total_trigger_counter = 0;
+    vx725_vx730_psd_data->cfd_sazc = (vx725_vx730_psd_data->extras & 0xFFFF0000) >> 16;
+    vx725_vx730_psd_data->cfd_sbzc = (vx725_vx730_psd_data->extras & 0x0000FFFF);
+    break;
+  default:
+    vx725_vx730_psd_data->extended_time_stamp = 0;
+    vx725_vx730_psd_data->baseline_timesfour = 0;
+    vx725_vx730_psd_data->flags = 0;
+    vx725_vx730_psd_data->lost_trigger_counter = 0;
+    vx725_vx730_psd_data->total_trigger_counter = 0;
+    vx725_vx730_psd_data->cfd_sazc = 0;
+    vx725_vx730_psd_data->cfd_sbzc = 0;
+    vx725_vx730_psd_data->fine_time_stamp = 0;
+    break;   
+  }
+}
+
+
+//Decode the PHA extras word
+static inline void decode_vx725_vx730_pha_extras(int extras2_option, Vx725_Vx730_PHA_Data_t *vx725_vx730_pha_data) {
+  switch(extras2_option) {
+    
+  case 0:
+    vx725_vx730_pha_data->extended_time_stamp = (vx725_vx730_pha_data->extras2 & 0xFFFF0000) >> 16;
+    vx725_vx730_pha_data->baseline_timesfour = (vx725_vx730_pha_data->extras2 & 0x0000FFFF);
+    vx725_vx730_pha_data->lost_trigger_counter = 0;
+    vx725_vx730_pha_data->total_trigger_counter = 0;
+    vx725_vx730_pha_data->fine_time_stamp = 0;
+    vx725_vx730_pha_data->sample_before_zc = 0;
+    vx725_vx730_pha_data->sample_after_zc = 0;
+    break;
+  case 2:
+    vx725_vx730_pha_data->extended_time_stamp = (vx725_vx730_pha_data->extras2 & 0xFFFF0000) >> 16;
+    vx725_vx730_pha_data->baseline_timesfour = 0;
+    vx725_vx730_pha_data->lost_trigger_counter = 0;
+    vx725_vx730_pha_data->total_trigger_counter = 0;
+    vx725_vx730_pha_data->fine_time_stamp = (vx725_vx730_pha_data->extras2 & 0x0000FFFF);
+    vx725_vx730_pha_data->sample_before_zc = 0;
+    vx725_vx730_pha_data->sample_after_zc = 0;
+    break;
+  case 4:
+    vx725_vx730_pha_data->extended_time_stamp = 0;
+    vx725_vx730_pha_data->baseline_timesfour = 0;
+    vx725_vx730_pha_data->lost_trigger_counter = (vx725_vx730_pha_data->extras2 & 0xFFFF0000) >> 16;
+    vx725_vx730_pha_data->total_trigger_counter = (vx725_vx730_pha_data->extras2 & 0x0000FFFF);
+    vx725_vx730_pha_data->fine_time_stamp = 0;
+    vx725_vx730_pha_data->sample_before_zc = 0;
+    vx725_vx730_pha_data->sample_after_zc = 0;
+    break;
+  case 5:
+    vx725_vx730_pha_data->extended_time_stamp = 0;
+    vx725_vx730_pha_data->baseline_timesfour = 0;
+    vx725_vx730_pha_data->lost_trigger_counter = 0;
+    vx725_vx730_pha_data->total_trigger_counter = 0;
+    vx725_vx730_pha_data->fine_time_stamp = 0;
+    vx725_vx730_pha_data->sample_before_zc = (vx725_vx730_pha_data->extras2 & 0xFFFF0000) >> 16;
+    vx725_vx730_pha_data->sample_after_zc = (vx725_vx730_pha_data->extras2 & 0x0000FFFF);
+    break;
+  default:
+    vx725_vx730_pha_data->extended_time_stamp = 0;
+    vx725_vx730_pha_data->baseline_timesfour = 0;
+    vx725_vx730_pha_data->lost_trigger_counter = 0;
+    vx725_vx730_pha_data->total_trigger_counter = 0;
+    vx725_vx730_pha_data->fine_time_stamp = 0;
+    vx725_vx730_pha_data->sample_before_zc = 0;
+    vx725_vx730_pha_data->sample_after_zc = 0;
+    break;
+  }
+}
+
+
 int unpack_vx725_vx730_psd_chagg(uint32_t *v1730_chagg_data, Vx725_Vx730_PSD_Data_t *vx725_vx730_psd_data) {
   
   int word_counter=0;
@@ -129,50 +505,13 @@ int unpack_vx725_vx730_psd_chagg(uint32_t *v1730_chagg_data, Vx725_Vx730_PSD_Dat
     //Determine how many 32-bit words are there
     uint32_t probe_words = 4.0*vx725_vx730_psd_data->nsdb8; 
     
-    //Dual trace off
-    if(vx725_vx730_psd_data->dual_trace == 0) {
-      for(uint32_t kay=0; kay<probe_words; kay++) {
-	uint32_t probe_data = v1730_chagg_data[word_counter];
-	word_counter++;
-	
-	//analog probes
-	vx725_vx730_psd_data->analog_probe1[(int)(2*kay)] = (probe_data & Vx725_Vx730_PSD_AP_0_MASK);
-	vx725_vx730_psd_data->analog_probe2[(int)(2*kay)] = 0;
-	vx725_vx730_psd_data->analog_probe1[(int)(2*kay+1)] = (probe_data & Vx725_Vx730_PSD_AP_1_MASK) >> 16;
-	vx725_vx730_psd_data->analog_probe2[(int)(2*kay+1)] = 0;
-	
-	//digital probes
-	vx725_vx730_psd_data->digital_probe1[(int)(2*kay)] = (probe_data & Vx725_Vx730_PSD_DP1_0_MASK) >> 14;
-	vx725_vx730_psd_data->digital_probe2[(int)(2*kay)] = (probe_data & Vx725_Vx730_PSD_DP2_0_MASK) >> 15;
-	vx725_vx730_psd_data->digital_probe1[(int)(2*kay+1)] = (probe_data & Vx725_Vx730_PSD_DP1_1_MASK) >> 30;
-	vx725_vx730_psd_data->digital_probe2[(int)(2*kay+1)] = (probe_data & Vx725_Vx730_PSD_DP2_1_MASK) >> 31;
-	
-      } //End loop over probe words
-    } //End dual trace off
-    
-    //Dual trace on
-    else if(vx725_vx730_psd_data->dual_trace == 1) {
-      for(uint32_t kay=0; kay<probe_words; kay++) {
-	uint32_t probe_data = v1730_chagg_data[word_counter];
-	word_counter++;
-	
-	//analog probes
-	vx725_vx730_psd_data->analog_probe1[kay] = (probe_data & Vx725_Vx730_PSD_AP_0_MASK);
-	vx725_vx730_psd_data->analog_probe2[kay] = (probe_data & Vx725_Vx730_PSD_AP_1_MASK) >> 16;
-	
-	//digital probes
-	vx725_vx730_psd_data->digital_probe1[(int)(2*kay)] = (probe_data & Vx725_Vx730_PSD_DP1_0_MASK) >> 14;
-	vx725_vx730_psd_data->digital_probe2[(int)(2*kay)] = (probe_data & Vx725_Vx730_PSD_DP2_0_MASK) >> 15;
-	vx725_vx730_psd_data->digital_probe1[(int)(2*kay+1)] = (probe_data & Vx725_Vx730_PSD_DP1_1_MASK) >> 30;
-	vx725_vx730_psd_data->digital_probe2[(int)(2*kay+1)] = (probe_data & Vx725_Vx730_PSD_DP2_1_MASK) >> 31;
-	
-      } //End loop over probe words
-    } //End dual trace on
-  
     //Dual trace is messed up and need to exit
-    else {
+    if(unpack_vx725_vx730_probes(&v1730_chagg_data[word_counter], probe_words, vx725_vx730_psd_data->dual_trace, &vx725_vx730_psd_probe_layout,
+				 vx725_vx730_psd_data->analog_probe1, vx725_vx730_psd_data->analog_probe2,
+				 vx725_vx730_psd_data->digital_probe1, vx725_vx730_psd_data->digital_probe2) < 0) {
       return -1;
     }
+    word_counter += probe_words;
   } //End of check on waveforms
   
   //WORD N-1 (or N if no extras) (Extras)
@@ -182,66 +521,7 @@ int unpack_vx725_vx730_psd_chagg(uint32_t *v1730_chagg_data, Vx725_Vx730_PSD_Dat
     word_counter++;
       
     //Decode the extras
-    switch(vx725_vx730_psd_data->extras_option) {
-    case 0:
-      vx725_vx730_psd_data->extended_time_stamp = (vx725_vx730_psd_data->extras & 0xFFFF0000) >> 16;
-      vx725_vx730_psd_data->baseline_timesfour = (vx725_vx730_psd_data->extras & 0x0000FFFF);
-      vx725_vx730_psd_data->flags = 0;
-      vx725_vx730_psd_data->fine_time_stamp = 0;
-      vx725_vx730_psd_data->lost_trigger_counter = 0;
-      vx725_vx730_psd_data->total_trigger_counter = 0;
-      vx725_vx730_psd_data->cfd_sazc = 0;
-      vx725_vx730_psd_data->cfd_sbzc = 0;	
-      break;
-    case 1:
-      vx725_vx730_psd_data->extended_time_stamp = (vx725_vx730_psd_data->extras & 0xFFFF0000) >> 16;
-      vx725_vx730_psd_data->baseline_timesfour = 0;
-      vx725_vx730_psd_data->flags = (vx725_vx730_psd_data->extras & 0x0000FFFF);
-      vx725_vx730_psd_data->fine_time_stamp =0;
-      vx725_vx730_psd_data->lost_trigger_counter = 0;
-      vx725_vx730_psd_data->total_trigger_counter = 0;
-      vx725_vx730_psd_data->cfd_sazc = 0;
-      vx725_vx730_psd_data->cfd_sbzc = 0;
-      break;
-    case 2:
-      vx725_vx730_psd_data->extended_time_stamp = (vx725_vx730_psd_data->extras & 0xFFFF0000) >> 16;
-      vx725_vx730_psd_data->baseline_timesfour = 0;
-      vx725_vx730_psd_data->flags = (vx725_vx730_psd_data->extras & 0x0000FC00) >> 10;
-      vx725_vx730_psd_data->fine_time_stamp = (vx725_vx730_psd_data->extras & 0x000003FF);
-      vx725_vx730_psd_data->lost_trigger_counter = 0;
-      vx725_vx730_psd_data->total_trigger_counter = 0;
-      vx725_vx730_psd_data->cfd_sazc = 0;
-      vx725_vx730_psd_data->cfd_sbzc = 0;
-      break;
-    case 4:
-      vx725_vx730_psd_data->extended_time_stamp = 0;
-      vx725_vx730_psd_data->baseline_timesfour = 0;
-      vx725_vx730_psd_data->flags = 0;
-      vx725_vx730_psd_data->fine_time_stamp = 0;
-      vx725_vx730_psd_data->lost_trigger_counter = (vx725_vx730_psd_data->extras & 0xFFFF0000) >> 16;
-      vx725_vx730_psd_data->total_trigger_counter = (vx725_vx730_psd_data->extras & 0x0000FFFF);
-      vx725_vx730_psd_data->cfd_sazc = 0;
-      vx725_vx730_psd_data->cfd_sbzc = 0;
-    case 5:
-      vx725_vx730_psd_data->extended_time_stamp = 0;
-      vx725_vx730_psd_data->baseline_timesfour = 0;
-      vx725_vx730_psd_data->flags = 0;
-      vx725_vx730_psd_data->fine_time_stamp = 0;
-      vx725_vx730_psd_data->lost_trigger_counter = 0;
-      vx725_vx730_psd_data->total_trigger_counter = 0;
-      vx725_vx730_psd_data->cfd_sazc = (vx725_vx730_psd_data->extras & 0xFFFF0000) >> 16;
-      vx725_vx730_psd_data->cfd_sbzc = (vx725_vx730_psd_data->extras & 0x0000FFFF);
-    default:
-      vx725_vx730_psd_data->extended_time_stamp = 0;
-      vx725_vx730_psd_data->baseline_timesfour = 0;
-      vx725_vx730_psd_data->flags = 0;
-      vx725_vx730_psd_data->lost_trigger_counter = 0;
-      vx725_vx730_psd_data->total_trigger_counter = 0;
-      vx725_vx730_psd_data->cfd_sazc = 0;
-      vx725_vx730_psd_data->cfd_sbzc = 0;
-      vx725_vx730_psd_data->fine_time_stamp = 0;
-      break;   
-    }
+    decode_vx725_vx730_psd_extras(vx725_vx730_psd_data->extras_option, vx725_vx730_psd_data);
   } //End of check on extras enabled
     
   //WORD N (PSD islow,pur,ifast)
@@ -269,50 +549,13 @@ int unpack_vx725_vx730_pha_chagg(uint32_t *v1730_chagg_data, Vx725_Vx730_PHA_Dat
     //Determine how many 32-bit words are there
     uint32_t probe_words = 4.0*vx725_vx730_pha_data->nsdb8; 
     
-    //Dual trace off
-    if(vx725_vx730_pha_data->dual_trace == 0) {
-      for(uint32_t kay=0; kay<probe_words; kay++) {
-	uint32_t probe_data = v1730_chagg_data[word_counter];
-	word_counter++;
-	
-	//analog probes
-	vx725_vx730_pha_data->analog_probe1[(int)(2*kay)] = (probe_data & Vx725_Vx730_PHA_AP_0_MASK);
-	vx725_vx730_pha_data->analog_probe2[(int)(2*kay)] = 0;
-	vx725_vx730_pha_data->analog_probe1[(int)(2*kay+1)] = (probe_data & Vx725_Vx730_PHA_AP_1_MASK) >> 16;
-	vx725_vx730_pha_data->analog_probe2[(int)(2*kay+1)] = 0;
-	
-	//digital probes
-	vx725_vx730_pha_data->digital_probe1[(int)(2*kay)] = (probe_data & Vx725_Vx730_PHA_T_0_MASK) >> 14;
-	vx725_vx730_pha_data->digital_probe2[(int)(2*kay)] = (probe_data & Vx725_Vx730_PHA_DP_0_MASK) >> 15;
-	vx725_vx730_pha_data->digital_probe1[(int)(2*kay+1)] = (probe_data & Vx725_Vx730_PHA_T_1_MASK) >> 30;
-	vx725_vx730_pha_data->digital_probe2[(int)(2*kay+1)] = (probe_data & Vx725_Vx730_PHA_DP_1_MASK) >> 31;
-	
-      } //End loop over probe words
-    } //End dual trace off
-    
-    //Dual trace on
-    else if(vx725_vx730_pha_data->dual_trace == 1) {
-      for(uint32_t kay=0; kay<probe_words; kay++) {
-	uint32_t probe_data = v1730_chagg_data[word_counter];
-	word_counter++;
-	
-	//analog probes
-	vx725_vx730_pha_data->analog_probe1[kay] = (probe_data & Vx725_Vx730_PHA_AP_0_MASK);
-	vx725_vx730_pha_data->analog_probe2[kay] = (probe_data & Vx725_Vx730_PHA_AP_1_MASK) >> 16;
-	
-	//digital probes
-	vx725_vx730_pha_data->digital_probe1[(int)(2*kay)] = (probe_data & Vx725_Vx730_PHA_T_0_MASK) >> 14;
-	vx725_vx730_pha_data->digital_probe2[(int)(2*kay)] = (probe_data & Vx725_Vx730_PHA_DP_0_MASK) >> 15;
-	vx725_vx730_pha_data->digital_probe1[(int)(2*kay+1)] = (probe_data & Vx725_Vx730_PHA_T_1_MASK) >> 30;
-	vx725_vx730_pha_data->digital_probe2[(int)(2*kay+1)] = (probe_data & Vx725_Vx730_PHA_DP_1_MASK) >> 31;
-	
-      } //End loop over probe words
-    } //End dual trace on
-  
     //Dual trace is messed up and need to exit
-    else {
+    if(unpack_vx725_vx730_probes(&v1730_chagg_data[word_counter], probe_words, vx725_vx730_pha_data->dual_trace, &vx725_vx730_pha_probe_layout,
+				 vx725_vx730_pha_data->analog_probe1, vx725_vx730_pha_data->analog_probe2,
+				 vx725_vx730_pha_data->digital_probe1, vx725_vx730_pha_data->digital_probe2) < 0) {
       return -1;
     }
+    word_counter += probe_words;
   } //End of check on waveforms
   
   //WORD N-1 (or N if no extras) (Extras)
@@ -322,52 +565,7 @@ int unpack_vx725_vx730_pha_chagg(uint32_t *v1730_chagg_data, Vx725_Vx730_PHA_Dat
     word_counter++;
       
     //Decode the extras
-    switch(vx725_vx730_pha_data->extras2_option) {
-      
-    case 0:
-      vx725_vx730_pha_data->extended_time_stamp = (vx725_vx730_pha_data->extras2 & 0xFFFF0000) >> 16;
-      vx725_vx730_pha_data->baseline_timesfour = (vx725_vx730_pha_data->extras2 & 0x0000FFFF);
-      vx725_vx730_pha_data->lost_trigger_counter = 0;
-      vx725_vx730_pha_data->total_trigger_counter = 0;
-      vx725_vx730_pha_data->fine_time_stamp = 0;
-      vx725_vx730_pha_data->sample_before_zc = 0;
-      vx725_vx730_pha_data->sample_after_zc = 0;
-      break;
-    case 2:
-      vx725_vx730_pha_data->extended_time_stamp = (vx725_vx730_pha_data->extras2 & 0xFFFF0000) >> 16;
-      vx725_vx730_pha_data->baseline_timesfour = 0;
-      vx725_vx730_pha_data->lost_trigger_counter = 0;
-      vx725_vx730_pha_data->total_trigger_counter = 0;
-      vx725_vx730_pha_data->fine_time_stamp = (vx725_vx730_pha_data->extras2 & 0x0000FFFF);
-      vx725_vx730_pha_data->sample_before_zc = 0;
-      vx725_vx730_pha_data->sample_after_zc = 0;
-      break;
-    case 4:
-      vx725_vx730_pha_data->extended_time_stamp = 0;
-      vx725_vx730_pha_data->baseline_timesfour = 0;
-      vx725_vx730_pha_data->lost_trigger_counter = (vx725_vx730_pha_data->extras2 & 0xFFFF0000) >> 16;
-      vx725_vx730_pha_data->total_trigger_counter = (vx725_vx730_pha_data->extras2 & 0x0000FFFF);
-      vx725_vx730_pha_data->fine_time_stamp = 0;
-      vx725_vx730_pha_data->sample_before_zc = 0;
-      vx725_vx730_pha_data->sample_after_zc = 0;
-    case 5:
-      vx725_vx730_pha_data->extended_time_stamp = 0;
-      vx725_vx730_pha_data->baseline_timesfour = 0;
-      vx725_vx730_pha_data->lost_trigger_counter = 0;
-      vx725_vx730_pha_data->total_trigger_counter = 0;
-      vx725_vx730_pha_data->fine_time_stamp = 0;
-      vx725_vx730_pha_data->sample_before_zc = (vx725_vx730_pha_data->extras2 & 0xFFFF0000) >> 16;
-      vx725_vx730_pha_data->sample_after_zc = (vx725_vx730_pha_data->extras2 & 0x0000FFFF);
-    default:
-      vx725_vx730_pha_data->extended_time_stamp = 0;
-      vx725_vx730_pha_data->baseline_timesfour = 0;
-      vx725_vx730_pha_data->lost_trigger_counter = 0;
-      vx725_vx730_pha_data->total_trigger_counter = 0;
-      vx725_vx730_pha_data->fine_time_stamp = 0;
-      vx725_vx730_pha_data->sample_before_zc = 0;
-      vx725_vx730_pha_data->sample_after_zc = 0;
-      break;
-    }
+    decode_vx725_vx730_pha_extras(vx725_vx730_pha_data->extras2_option, vx725_vx730_pha_data);
   } //End of check on extras enabled
     
   //WORD N (PHA extras,pur,energy)	
@@ -378,3 +576,222 @@ int unpack_vx725_vx730_pha_chagg(uint32_t *v1730_chagg_data, Vx725_Vx730_PHA_Dat
   
   return word_counter;
 }
+
+
+//The header flags are fixed for a whole channel aggregate, so these versions of the decoders are
+//built for each combination of them and picked once per aggregate by the select functions below.
+//The charge (and energy) word is always present in the aggregate so it is not a template parameter.
+template<bool Waveform, bool DualTrace, bool Extras, int ExtrasOption>
+static int unpack_vx725_vx730_psd_chagg_t(uint32_t *v1730_chagg_data, Vx725_Vx730_PSD_Data_t *vx725_vx730_psd_data) {
+
+  int word_counter=0;
+  
+  //WORD 1 (TTT)
+  vx725_vx730_psd_data->channel = (v1730_chagg_data[word_counter] & Vx725_Vx730_PSD_CH_MASK) >> 31;
+  vx725_vx730_psd_data->trigger_time_tag = (v1730_chagg_data[word_counter] & Vx725_Vx730_PSD_TTT_MASK);
+  word_counter++;
+  
+  //WORD 2 to N-2 (or N-1 if no extras)  (Analog and Digital Probes)
+  if(Waveform) {
+    uint32_t probe_words = 4*vx725_vx730_psd_data->nsdb8; 
+    unpack_vx725_vx730_probes(&v1730_chagg_data[word_counter], probe_words, DualTrace, &vx725_vx730_psd_probe_layout,
+			      vx725_vx730_psd_data->analog_probe1, vx725_vx730_psd_data->analog_probe2,
+			      vx725_vx730_psd_data->digital_probe1, vx725_vx730_psd_data->digital_probe2);
+    word_counter += probe_words;
+  }
+  
+  //WORD N-1 (or N if no extras) (Extras)
+  if(Extras) {
+    vx725_vx730_psd_data->extras = v1730_chagg_data[word_counter];
+    word_counter++;
+    decode_vx725_vx730_psd_extras(ExtrasOption, vx725_vx730_psd_data);
+  }
+    
+  //WORD N (PSD islow,pur,ifast)
+  vx725_vx730_psd_data->qlong = ( v1730_chagg_data[word_counter] & Vx725_Vx730_PSD_QLONG_MASK) >> 16;
+  vx725_vx730_psd_data->pur = ( v1730_chagg_data[word_counter] & Vx725_Vx730_PSD_PUR_MASK) >> 15;
+  vx725_vx730_psd_data->qshort = ( v1730_chagg_data[word_counter] & Vx725_Vx730_PSD_QSHORT_MASK);
+  word_counter++;
+    
+  return word_counter;
+}
+
+
+template<bool Waveform, bool DualTrace, bool Extras, int ExtrasOption>
+static int unpack_vx725_vx730_pha_chagg_t(uint32_t *v1730_chagg_data, Vx725_Vx730_PHA_Data_t *vx725_vx730_pha_data) {
+
+  int word_counter=0;
+  
+  //WORD 1 (TTT)
+  vx725_vx730_pha_data->channel = (v1730_chagg_data[word_counter] & Vx725_Vx730_PHA_CH_MASK) >> 31;
+  vx725_vx730_pha_data->trigger_time_tag = (v1730_chagg_data[word_counter] & Vx725_Vx730_PHA_TTT_MASK);
+  word_counter++;
+  
+  //WORD 2 to N-2 (or N-1 if no extras)  (Analog and Digital Probes)
+  if(Waveform) {
+    uint32_t probe_words = 4*vx725_vx730_pha_data->nsdb8; 
+    unpack_vx725_vx730_probes(&v1730_chagg_data[word_counter], probe_words, DualTrace, &vx725_vx730_pha_probe_layout,
+			      vx725_vx730_pha_data->analog_probe1, vx725_vx730_pha_data->analog_probe2,
+			      vx725_vx730_pha_data->digital_probe1, vx725_vx730_pha_data->digital_probe2);
+    word_counter += probe_words;
+  }
+  
+  //WORD N-1 (or N if no extras) (Extras)
+  if(Extras) {
+    vx725_vx730_pha_data->extras2 = v1730_chagg_data[word_counter];
+    word_counter++;
+    decode_vx725_vx730_pha_extras(ExtrasOption, vx725_vx730_pha_data);
+  }
+    
+  //WORD N (PHA extras,pur,energy)	
+  vx725_vx730_pha_data->extras = (v1730_chagg_data[word_counter] & Vx725_Vx730_PHA_EXTRAS_MASK) >> 16;
+  vx725_vx730_pha_data->pur = (v1730_chagg_data[word_counter] & Vx725_Vx730_PHA_PUR_MASK) >> 15;
+  vx725_vx730_pha_data->energy = (v1730_chagg_data[word_counter] & Vx725_Vx730_PHA_ENERGY_MASK);
+  word_counter++;
+  
+  return word_counter;
+}
+
+
+//Options without a decoding (3, 6, 7) all zero the extras and share one instantiation
+template<bool Waveform, bool DualTrace>
+static Vx725_Vx730_PSD_Decoder_t select_psd_decoder(bool extras, uint8_t extras_option) {
+  if(!extras) {
+    return &unpack_vx725_vx730_psd_chagg_t<Waveform,DualTrace,false,-1>;
+  }
+  switch(extras_option) {
+  case 0: return &unpack_vx725_vx730_psd_chagg_t<Waveform,DualTrace,true,0>;
+  case 1: return &unpack_vx725_vx730_psd_chagg_t<Waveform,DualTrace,true,1>;
+  case 2: return &unpack_vx725_vx730_psd_chagg_t<Waveform,DualTrace,true,2>;
+  case 4: return &unpack_vx725_vx730_psd_chagg_t<Waveform,DualTrace,true,4>;
+  case 5: return &unpack_vx725_vx730_psd_chagg_t<Waveform,DualTrace,true,5>;
+  default: return &unpack_vx725_vx730_psd_chagg_t<Waveform,DualTrace,true,-1>;
+  }
+}
+
+
+template<bool Waveform, bool DualTrace>
+static Vx725_Vx730_PHA_Decoder_t select_pha_decoder(bool extras2, uint8_t extras2_option) {
+  if(!extras2) {
+    return &unpack_vx725_vx730_pha_chagg_t<Waveform,DualTrace,false,-1>;
+  }
+  switch(extras2_option) {
+  case 0: return &unpack_vx725_vx730_pha_chagg_t<Waveform,DualTrace,true,0>;
+  case 2: return &unpack_vx725_vx730_pha_chagg_t<Waveform,DualTrace,true,2>;
+  case 4: return &unpack_vx725_vx730_pha_chagg_t<Waveform,DualTrace,true,4>;
+  case 5: return &unpack_vx725_vx730_pha_chagg_t<Waveform,DualTrace,true,5>;
+  default: return &unpack_vx725_vx730_pha_chagg_t<Waveform,DualTrace,true,-1>;
+  }
+}
+
+
+Vx725_Vx730_PSD_Decoder_t select_vx725_vx730_psd_decoder(const Vx725_Vx730_PSD_Data_t *vx725_vx730_psd_data) {
+
+  bool extras = vx725_vx730_psd_data->extras_enabled;
+  uint8_t option = vx725_vx730_psd_data->extras_option;
+
+  if(!vx725_vx730_psd_data->waveform_enabled) {
+    return select_psd_decoder<false,false>(extras, option);
+  }
+  if(vx725_vx730_psd_data->dual_trace == 0) {
+    return select_psd_decoder<true,false>(extras, option);
+  }
+  if(vx725_vx730_psd_data->dual_trace == 1) {
+    return select_psd_decoder<true,true>(extras, option);
+  }
+  //Dual trace is messed up so use the generic decoder which reports it
+  return &unpack_vx725_vx730_psd_chagg;
+}
+
+
+Vx725_Vx730_PHA_Decoder_t select_vx725_vx730_pha_decoder(const Vx725_Vx730_PHA_Data_t *vx725_vx730_pha_data) {
+
+  bool extras2 = vx725_vx730_pha_data->extras2_enabled;
+  uint8_t option = vx725_vx730_pha_data->extras2_option;
+
+  if(!vx725_vx730_pha_data->waveform_enabled) {
+    return select_pha_decoder<false,false>(extras2, option);
+  }
+  if(vx725_vx730_pha_data->dual_trace == 0) {
+    return select_pha_decoder<true,false>(extras2, option);
+  }
+  if(vx725_vx730_pha_data->dual_trace == 1) {
+    return select_pha_decoder<true,true>(extras2, option);
+  }
+  return &unpack_vx725_vx730_pha_chagg;
+}
+
+
+//Run the specialized and the generic decoders over random aggregates for every header flag combination
+int test_vx725_vx730_decoders() {
+
+  const int trials = 4;
+  const uint16_t nsdb8 = 3;
+  uint32_t chagg_data[4*nsdb8 + 3];
+  int failures = 0;
+  int combinations = 0;
+  
+  uint32_t seed = 0x2545F491;
+  
+  //The structs hold the probe arrays so they are too big for the stack
+  Vx725_Vx730_PSD_Data_t *psd_generic = new Vx725_Vx730_PSD_Data_t;
+  Vx725_Vx730_PSD_Data_t *psd_special = new Vx725_Vx730_PSD_Data_t;
+  Vx725_Vx730_PHA_Data_t *pha_generic = new Vx725_Vx730_PHA_Data_t;
+  Vx725_Vx730_PHA_Data_t *pha_special = new Vx725_Vx730_PHA_Data_t;
+
+  //7 flag bits: dual trace (bit 31), charge/energy (30), extras (28), waveform (27), extras option (24-26)
+  for(uint32_t flags=0; flags<(1<<7); flags++) {
+    
+    V1730_ChAgg_Header_t header;
+    header.dataword_1 = 0x80000000;
+    header.dataword_2 = ((flags & 0x1) << 31) | (((flags >> 1) & 0x1) << 30) | (((flags >> 2) & 0x1) << 28) |
+      (((flags >> 3) & 0x1) << 27) | (((flags >> 4) & 0x7) << 24) | nsdb8;
+    combinations++;
+    
+    for(int trial=0; trial<trials; trial++) {
+      
+      //xorshift fill of the aggregate
+      for(uint32_t kay=0; kay<sizeof(chagg_data)/sizeof(uint32_t); kay++) {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	chagg_data[kay] = seed;
+      }
+      
+      memset(psd_generic, 0, sizeof(Vx725_Vx730_PSD_Data_t));
+      memset(psd_special, 0, sizeof(Vx725_Vx730_PSD_Data_t));
+      unpack_vx725_vx730_psd_chagg_header(&header, psd_generic);
+      unpack_vx725_vx730_psd_chagg_header(&header, psd_special);
+      int generic_words = unpack_vx725_vx730_psd_chagg(chagg_data, psd_generic);
+      int special_words = select_vx725_vx730_psd_decoder(psd_special)(chagg_data, psd_special);
+      if(generic_words != special_words || memcmp(psd_generic, psd_special, sizeof(Vx725_Vx730_PSD_Data_t)) != 0) {
+	failures++;
+      }
+      
+      memset(pha_generic, 0, sizeof(Vx725_Vx730_PHA_Data_t));
+      memset(pha_special, 0, sizeof(Vx725_Vx730_PHA_Data_t));
+      unpack_vx725_vx730_pha_chagg_header(&header, pha_generic);
+      unpack_vx725_vx730_pha_chagg_header(&header, pha_special);
+      generic_words = unpack_vx725_vx730_pha_chagg(chagg_data, pha_generic);
+      special_words = select_vx725_vx730_pha_decoder(pha_special)(chagg_data, pha_special);
+      if(generic_words != special_words || memcmp(pha_generic, pha_special, sizeof(Vx725_Vx730_PHA_Data_t)) != 0) {
+	failures++;
+      }
+    }
+  }
+
+  delete psd_generic;
+  delete psd_special;
+  delete pha_generic;
+  delete pha_special;
+
+  std::stringstream vmsg;
+  if(failures > 0) {
+    vmsg<<"Specialized channel aggregate decoders disagree with the generic decoder in "<<failures<<" cases";
+    DANCE_Error("Unpacker",vmsg.str());
+    return -1;
+  }
+  vmsg<<"Specialized channel aggregate decoders match the generic decoder for "<<combinations<<" header combinations";
+  DANCE_Success("Unpacker",vmsg.str());
+  return 0;
+}
@@ -249,6 +249,28 @@ struct Vx725_Vx730_PHA_Data_t {
 };
 
 
+//Location of the digital probe bits in a probe word (sample 0 is bits 0-15, sample 1 is bits 16-31)
+struct Vx725_Vx730_Probe_Layout_t {
+  uint32_t dp1_0_mask;
+  uint32_t dp1_0_shift;
+  uint32_t dp2_0_mask;
+  uint32_t dp2_0_shift;
+  uint32_t dp1_1_mask;
+  uint32_t dp1_1_shift;
+  uint32_t dp2_1_mask;
+  uint32_t dp2_1_shift;
+};
+
+extern const Vx725_Vx730_Probe_Layout_t vx725_vx730_psd_probe_layout;
+extern const Vx725_Vx730_Probe_Layout_t vx725_vx730_pha_probe_layout;
+
+//Probe unpacking (the scalar version is the reference, the other is chosen at runtime by CPUID)
+int unpack_vx725_vx730_probes_scalar(const uint32_t *probe_data, uint32_t probe_words, uint8_t dual_trace, const Vx725_Vx730_Probe_Layout_t *layout,
+				     uint16_t *analog_probe1, uint16_t *analog_probe2, uint8_t *digital_probe1, uint8_t *digital_probe2);
+int unpack_vx725_vx730_probes(const uint32_t *probe_data, uint32_t probe_words, uint8_t dual_trace, const Vx725_Vx730_Probe_Layout_t *layout,
+			      uint16_t *analog_probe1, uint16_t *analog_probe2, uint8_t *digital_probe1, uint8_t *digital_probe2);
+const char* unpack_vx725_vx730_probe_isa();
+
 //PSD unpacking
 int unpack_vx725_vx730_psd_chagg_header(V1730_ChAgg_Header_t *v1730_chagg_header, Vx725_Vx730_PSD_Data_t *vx725_vx730_psd_data);
 int unpack_vx725_vx730_psd_chagg(uint32_t v1730_chagg[], Vx725_Vx730_PSD_Data_t *vx725_vx730_psd_data);
@@ -257,6 +279,15 @@ int unpack_vx725_vx730_psd_chagg(uint32_t v1730_chagg[], Vx725_Vx730_PSD_Data_t
 int unpack_vx725_vx730_pha_chagg_header(V1730_ChAgg_Header_t *v1730_chagg_header, Vx725_Vx730_PHA_Data_t *vx725_vx730_pha_data);
 int unpack_vx725_vx730_pha_chagg(uint32_t v1730_chagg[], Vx725_Vx730_PHA_Data_t *vx725_vx730_pha_data);
 
+//Channel aggregate decoders specialized on the header flags (select once per channel aggregate)
+typedef int (*Vx725_Vx730_PSD_Decoder_t)(uint32_t *v1730_chagg, Vx725_Vx730_PSD_Data_t *vx725_vx730_psd_data);
+typedef int (*Vx725_Vx730_PHA_Decoder_t)(uint32_t *v1730_chagg, Vx725_Vx730_PHA_Data_t *vx725_vx730_pha_data);
+Vx725_Vx730_PSD_Decoder_t select_vx725_vx730_psd_decoder(const Vx725_Vx730_PSD_Data_t *vx725_vx730_psd_data);
+Vx725_Vx730_PHA_Decoder_t select_vx725_vx730_pha_decoder(const Vx725_Vx730_PHA_Data_t *vx725_vx730_pha_data);
+
+//Checks the specialized decoders against the generic ones for every header flag combination
+int test_vx725_vx730_decoders();
+
 
 
 
@@ -0,0 +1,304 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+//***************************//
+//*  unpack_x27xx.cpp       *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+#include "unpack_x27xx.h"
+#include "global.h"
+#include "message.h"
+
+//C/C++ includes
+#include <string.h>
+#include <sstream>
+#include <vector>
+
+
+int unpack_x27xx_aggregate_header(const uint32_t *data, X27xx_Aggregate_Data_t *x27xx_aggregate_data) {
+
+  uint64_t word = x27xx_word(data, 0);
+
+  x27xx_aggregate_data->format = (word & X27xx_FORMAT_MASK) >> 60;
+  x27xx_aggregate_data->board_fail = (word & X27xx_BOARDFAIL_MASK) >> 56;
+  x27xx_aggregate_data->aggcounter = (word & X27xx_AGGCOUNTER_MASK) >> 32;
+  x27xx_aggregate_data->aggsize = (word & X27xx_AGGSIZE_MASK);
+
+  return 0;
+}
+
+int unpack_x27xx_psd_event(const uint32_t *data, uint32_t nwords, X27xx_PSD_Data_t *x27xx_psd_data) {
+
+  if(nwords < 2) {
+    return -1;
+  }
+
+  //WORD 1
+  uint64_t word = x27xx_word(data, 0);
+  x27xx_psd_data->channel = (word & X27xx_PSD_CH_MASK) >> 56;
+  x27xx_psd_data->timestamp = (word & X27xx_PSD_TIMESTAMP_MASK);
+
+  //WORD 2
+  word = x27xx_word(data, 1);
+  x27xx_psd_data->last_word = (word & X27xx_PSD_LAST_MASK) >> 63;
+  x27xx_psd_data->waveform_enabled = (word & X27xx_PSD_WF_MASK) >> 62;
+  x27xx_psd_data->flags_low = (word & X27xx_PSD_FLAGSLOW_MASK) >> 50;
+  x27xx_psd_data->flags_high = (word & X27xx_PSD_FLAGSHIGH_MASK) >> 42;
+  x27xx_psd_data->fine_time_stamp = (word & X27xx_PSD_FINETIME_MASK) >> 32;
+  x27xx_psd_data->energy_short = (word & X27xx_PSD_ESHORT_MASK) >> 16;
+  x27xx_psd_data->energy_long = (word & X27xx_PSD_ELONG_MASK);
+
+  //No waveform
+  if(!x27xx_psd_data->waveform_enabled) {
+    x27xx_psd_data->waveform_header = 0;
+    x27xx_psd_data->waveform_words = 0;
+    x27xx_psd_data->probe_data = 0;
+    x27xx_psd_data->event_size = 2;
+    return x27xx_psd_data->last_word ? 2 : -1;
+  }
+
+  if(x27xx_psd_data->last_word || nwords < 4) {
+    return -1;
+  }
+
+  //WORD 3
+  x27xx_psd_data->waveform_header = (x27xx_word(data, 2) & X27xx_PSD_WFHEADER_MASK);
+
+  //WORD 4
+  word = x27xx_word(data, 3);
+  x27xx_psd_data->waveform_words = (word & X27xx_PSD_WFWORDS_MASK);
+  x27xx_psd_data->probe_data = &data[8];
+  x27xx_psd_data->event_size = 4 + x27xx_psd_data->waveform_words;
+
+  if(!(word & X27xx_PSD_LASTWF_MASK) || x27xx_psd_data->event_size > nwords) {
+    return -1;
+  }
+  return x27xx_psd_data->event_size;
+}
+
+//Each 32-bit half of a waveform word is one sample
+int unpack_x27xx_psd_probes(X27xx_PSD_Data_t *x27xx_psd_data) {
+
+  const uint32_t *probe_data = x27xx_psd_data->probe_data;
+  uint32_t nsamples = 2*x27xx_psd_data->waveform_words;
+
+  for(uint32_t kay=0; kay<nsamples; kay++) {
+    uint32_t sample = probe_data[kay];
+    x27xx_psd_data->analog_probe1[kay] = (sample & X27xx_PSD_AP1_MASK);
+    x27xx_psd_data->digital_probe1[kay] = (sample & X27xx_PSD_DP1_MASK) >> 14;
+    x27xx_psd_data->digital_probe2[kay] = (sample & X27xx_PSD_DP2_MASK) >> 15;
+    x27xx_psd_data->analog_probe2[kay] = (sample & X27xx_PSD_AP2_MASK) >> 16;
+  }
+
+  return nsamples;
+}
+
+static inline void x27xx_put_word(uint32_t *data, uint32_t k, uint64_t word) {
+  data[2*k] = (uint32_t)word;
+  data[2*k+1] = (uint32_t)(word >> 32);
+}
+
+int pack_x27xx_psd_event(const X27xx_PSD_Data_t *x27xx_psd_data, uint32_t *data) {
+
+  //WORD 1
+  x27xx_put_word(data, 0, (((uint64_t)x27xx_psd_data->channel << 56) & X27xx_PSD_CH_MASK) |
+		 (x27xx_psd_data->timestamp & X27xx_PSD_TIMESTAMP_MASK));
+
+  //WORD 2
+  uint64_t word = 0;
+  word |= ((uint64_t)(x27xx_psd_data->waveform_enabled ? 0 : 1) << 63);
+  word |= ((uint64_t)(x27xx_psd_data->waveform_enabled ? 1 : 0) << 62);
+  word |= ((uint64_t)x27xx_psd_data->flags_low << 50) & X27xx_PSD_FLAGSLOW_MASK;
+  word |= ((uint64_t)x27xx_psd_data->flags_high << 42) & X27xx_PSD_FLAGSHIGH_MASK;
+  word |= ((uint64_t)x27xx_psd_data->fine_time_stamp << 32) & X27xx_PSD_FINETIME_MASK;
+  word |= ((uint64_t)x27xx_psd_data->energy_short << 16) & X27xx_PSD_ESHORT_MASK;
+  word |= ((uint64_t)x27xx_psd_data->energy_long) & X27xx_PSD_ELONG_MASK;
+  x27xx_put_word(data, 1, word);
+
+  if(!x27xx_psd_data->waveform_enabled) {
+    return 2;
+  }
+
+  //WORDS 3 and 4
+  x27xx_put_word(data, 2, x27xx_psd_data->waveform_header & X27xx_PSD_WFHEADER_MASK);
+  x27xx_put_word(data, 3, X27xx_PSD_LASTWF_MASK | (x27xx_psd_data->waveform_words & X27xx_PSD_WFWORDS_MASK));
+
+  //WORDS 5 to N
+  uint32_t nsamples = 2*x27xx_psd_data->waveform_words;
+  for(uint32_t kay=0; kay<nsamples; kay++) {
+    data[8+kay] = (x27xx_psd_data->analog_probe1[kay] & X27xx_PSD_AP1_MASK) |
+      ((uint32_t)(x27xx_psd_data->digital_probe1[kay] & 0x1) << 14) |
+      ((uint32_t)(x27xx_psd_data->digital_probe2[kay] & 0x1) << 15) |
+      (((uint32_t)x27xx_psd_data->analog_probe2[kay] << 16) & X27xx_PSD_AP2_MASK);
+  }
+
+  return 4 + x27xx_psd_data->waveform_words;
+}
+
+static inline uint32_t test_x27xx_random(uint32_t *seed) {
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+  return *seed;
+}
+
+//Compares everything the decoder fills
+static int test_x27xx_compare(const X27xx_PSD_Data_t *encoded, const X27xx_PSD_Data_t *decoded) {
+
+  if(encoded->channel != decoded->channel || encoded->timestamp != decoded->timestamp ||
+     encoded->waveform_enabled != decoded->waveform_enabled || encoded->flags_low != decoded->flags_low ||
+     encoded->flags_high != decoded->flags_high || encoded->fine_time_stamp != decoded->fine_time_stamp ||
+     encoded->energy_short != decoded->energy_short || encoded->energy_long != decoded->energy_long) {
+    return 1;
+  }
+  if(!encoded->waveform_enabled) {
+    return 0;
+  }
+  uint32_t nsamples = 2*encoded->waveform_words;
+  if(encoded->waveform_header != decoded->waveform_header || encoded->waveform_words != decoded->waveform_words ||
+     memcmp(encoded->analog_probe1, decoded->analog_probe1, nsamples*sizeof(uint16_t)) != 0 ||
+     memcmp(encoded->analog_probe2, decoded->analog_probe2, nsamples*sizeof(uint16_t)) != 0 ||
+     memcmp(encoded->digital_probe1, decoded->digital_probe1, nsamples*sizeof(uint8_t)) != 0 ||
+     memcmp(encoded->digital_probe2, decoded->digital_probe2, nsamples*sizeof(uint8_t)) != 0) {
+    return 1;
+  }
+  return 0;
+}
+
+//Synthetic event number eye (the same every time it is made)
+static void test_x27xx_make_event(int eye, X27xx_PSD_Data_t *event) {
+
+  uint32_t seed = 0x2545F491 ^ (0x9E3779B9*(uint32_t)(eye+1));
+  if(seed == 0) {
+    seed = 1;
+  }
+
+  event->channel = test_x27xx_random(&seed) & 0x3F;
+  event->timestamp = (((uint64_t)test_x27xx_random(&seed) << 16) | (test_x27xx_random(&seed) & 0xFFFF)) & X27xx_PSD_TIMESTAMP_MASK;
+  event->waveform_enabled = (eye % 3 == 0);
+  event->flags_low = test_x27xx_random(&seed) & 0xFFF;
+  event->flags_high = test_x27xx_random(&seed) & 0xFF;
+  event->fine_time_stamp = test_x27xx_random(&seed) & 0x3FF;
+  event->energy_short = test_x27xx_random(&seed) & 0xFFFF;
+  event->energy_long = test_x27xx_random(&seed) & 0xFFFF;
+  event->waveform_header = 0;
+  event->waveform_words = 0;
+  if(!event->waveform_enabled) {
+    return;
+  }
+
+  event->waveform_header = (((uint64_t)test_x27xx_random(&seed) << 32) | test_x27xx_random(&seed)) & X27xx_PSD_WFHEADER_MASK;
+  //Mostly DANCE length waveforms, sometimes the longest
+  event->waveform_words = (eye % 300 == 0) ? 4095 : 1 + test_x27xx_random(&seed) % 64;
+  for(uint32_t kay=0; kay<2u*event->waveform_words; kay++) {
+    uint32_t random = test_x27xx_random(&seed);
+    event->analog_probe1[kay] = random & 0x3FFF;
+    event->analog_probe2[kay] = (random >> 14) & 0x3FFF;
+    event->digital_probe1[kay] = (random >> 28) & 0x1;
+    event->digital_probe2[kay] = (random >> 29) & 0x1;
+  }
+}
+
+int test_x27xx_psd_decoder() {
+
+  const int nevents = 2000;
+  int failures = 0;
+
+  //The structs hold the probe arrays so they are too big for the stack
+  X27xx_PSD_Data_t *encoded = new X27xx_PSD_Data_t;
+  X27xx_PSD_Data_t *decoded = new X27xx_PSD_Data_t;
+
+  //One aggregate holding all of the events
+  std::vector<uint32_t> data(2);
+  for(int eye=0; eye<nevents; eye++) {
+    test_x27xx_make_event(eye, encoded);
+    size_t start = data.size();
+    data.resize(start + 2*(4 + encoded->waveform_words));
+    int size = pack_x27xx_psd_event(encoded, &data[start]);
+    data.resize(start + 2*size);
+  }
+  uint64_t aggregate_words = data.size()/2;
+  x27xx_put_word(&data[0], 0, (0x2ULL << 60) | (0x123ULL << 32) | aggregate_words);
+
+  //Decode them back
+  X27xx_Aggregate_Data_t aggregate;
+  unpack_x27xx_aggregate_header(&data[0], &aggregate);
+  if(aggregate.format != 2 || aggregate.aggcounter != 0x123 || aggregate.aggsize != aggregate_words) {
+    failures++;
+  }
+
+  uint32_t pos = 1;
+  int ndecoded = 0;
+  while(pos < aggregate.aggsize && ndecoded < nevents) {
+    int size = unpack_x27xx_psd_event(&data[2*pos], aggregate.aggsize - pos, decoded);
+    if(size < 0) {
+      failures++;
+      break;
+    }
+    if(decoded->waveform_enabled) {
+      unpack_x27xx_psd_probes(decoded);
+    }
+    test_x27xx_make_event(ndecoded, encoded);
+    failures += test_x27xx_compare(encoded, decoded);
+    pos += size;
+    ndecoded++;
+  }
+  if(ndecoded != nevents || pos != aggregate.aggsize) {
+    failures++;
+  }
+
+  //An event cut short by the end of the aggregate is not decoded
+  test_x27xx_make_event(0, encoded);
+  std::vector<uint32_t> event(2*(4 + encoded->waveform_words));
+  int size = pack_x27xx_psd_event(encoded, &event[0]);
+  if(unpack_x27xx_psd_event(&event[0], size-1, decoded) != -1) {
+    failures++;
+  }
+
+  delete encoded;
+  delete decoded;
+
+  std::stringstream xmsg;
+  if(failures > 0) {
+    xmsg<<"x27xx DPP-PSD decoder failed "<<failures<<" checks of the synthetic events";
+    DANCE_Error("Unpacker",xmsg.str());
+    return -1;
+  }
+  xmsg<<"x27xx DPP-PSD decoder reproduced "<<nevents<<" synthetic events";
+  DANCE_Success("Unpacker",xmsg.str());
+  return 0;
+}
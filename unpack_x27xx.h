@@ -0,0 +1,144 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+//***************************//
+//*  unpack_x27xx.h         *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+#ifndef UNPACK_X27XX_H
+#define UNPACK_X27XX_H
+
+#include <stdint.h>
+
+//x27xx (V2740/V2745/VX2740) 64-channel digitizers.  The data are 64-bit words that the MIDAS bank
+//holds as pairs of 32-bit words (low half first).  Masks are for the 64-bit word
+
+//Longest waveform (4095 waveform words of 2 samples)
+#define X27xx_MAX_PROBE_LENGTH 8192
+
+//Clock tick of the timestamp (ns)
+#define X27xx_Tick 8.0
+
+//Number of 16 channel table boards a 64 channel board takes
+#define X27xx_Table_Boards 4
+
+//x27xx aggregate header masks
+#define X27xx_FORMAT_MASK                 0xF000000000000000ULL  //bits 60 to 63 inclusive (0x2)
+#define X27xx_BOARDFAIL_MASK              0x0100000000000000ULL  //bit 56
+#define X27xx_AGGCOUNTER_MASK             0x00FFFFFF00000000ULL  //bits 32 to 55 inclusive
+#define X27xx_AGGSIZE_MASK                0x00000000FFFFFFFFULL  //bits 0 to 31 inclusive (64-bit words including the header)
+
+//x27xx aggregate header data
+struct X27xx_Aggregate_Data_t {
+  uint8_t format;                                       //bits 60 to 63 inclusive
+  uint8_t board_fail;                                   //bit 56
+  uint32_t aggcounter;                                  //bits 32 to 55 inclusive
+  uint32_t aggsize;                                     //bits 0 to 31 inclusive
+};
+
+//x27xx DPP-PSD masks
+//WORD 1
+#define X27xx_PSD_CH_MASK                 0x7F00000000000000ULL  //bits 56 to 62 inclusive
+#define X27xx_PSD_TIMESTAMP_MASK          0x0000FFFFFFFFFFFFULL  //bits 0 to 47 inclusive
+//WORD 2
+#define X27xx_PSD_LAST_MASK               0x8000000000000000ULL  //bit 63 (no waveform follows)
+#define X27xx_PSD_WF_MASK                 0x4000000000000000ULL  //bit 62
+#define X27xx_PSD_FLAGSLOW_MASK           0x3FFC000000000000ULL  //bits 50 to 61 inclusive
+#define X27xx_PSD_FLAGSHIGH_MASK          0x0003FC0000000000ULL  //bits 42 to 49 inclusive
+#define X27xx_PSD_FINETIME_MASK           0x000003FF00000000ULL  //bits 32 to 41 inclusive (1/1024 of a tick)
+#define X27xx_PSD_ESHORT_MASK             0x00000000FFFF0000ULL  //bits 16 to 31 inclusive
+#define X27xx_PSD_ELONG_MASK              0x000000000000FFFFULL  //bits 0 to 15 inclusive
+//WORD 3 (waveform header)
+#define X27xx_PSD_WFHEADER_MASK           0x7FFFFFFFFFFFFFFFULL  //bits 0 to 62 inclusive (probe types and resolution)
+//WORD 4
+#define X27xx_PSD_LASTWF_MASK             0x8000000000000000ULL  //bit 63
+#define X27xx_PSD_WFWORDS_MASK            0x0000000000000FFFULL  //bits 0 to 11 inclusive
+//WORDS 5 to N (two samples per word, sample 0 in bits 0 to 31)
+#define X27xx_PSD_AP1_MASK                0x00003FFF             //bits 0 to 13 inclusive
+#define X27xx_PSD_DP1_MASK                0x00004000             //bit 14
+#define X27xx_PSD_DP2_MASK                0x00008000             //bit 15
+#define X27xx_PSD_AP2_MASK                0x3FFF0000             //bits 16 to 29 inclusive
+
+//DPP-PSD x27xx
+struct X27xx_PSD_Data_t {
+  //WORD 1
+  uint8_t channel;                                      //bits 56 to 62 inclusive
+  uint64_t timestamp;                                   //bits 0 to 47 inclusive
+  //WORD 2
+  uint8_t last_word;                                    //bit 63
+  uint8_t waveform_enabled;                             //bit 62
+  uint16_t flags_low;                                   //bits 50 to 61 inclusive
+  uint8_t flags_high;                                   //bits 42 to 49 inclusive
+  uint16_t fine_time_stamp;                             //bits 32 to 41 inclusive
+  uint16_t energy_short;                                //bits 16 to 31 inclusive
+  uint16_t energy_long;                                 //bits 0 to 15 inclusive
+  //WORD 3
+  uint64_t waveform_header;                             //bits 0 to 62 inclusive
+  //WORD 4
+  uint16_t waveform_words;                              //bits 0 to 11 inclusive
+  //WORDS 5 to N (filled by unpack_x27xx_psd_probes)
+  uint16_t analog_probe1[X27xx_MAX_PROBE_LENGTH];
+  uint16_t analog_probe2[X27xx_MAX_PROBE_LENGTH];
+  uint8_t digital_probe1[X27xx_MAX_PROBE_LENGTH];
+  uint8_t digital_probe2[X27xx_MAX_PROBE_LENGTH];
+
+  uint32_t event_size;                                  //size of the event (in 64-bit words)
+  const uint32_t *probe_data;                           //first waveform word of the event in the bank
+};
+
+//64-bit word k of data held as 32-bit pairs
+static inline uint64_t x27xx_word(const uint32_t *data, uint32_t k) {
+  return (uint64_t)data[2*k] | ((uint64_t)data[2*k+1] << 32);
+}
+
+//Aggregate header
+int unpack_x27xx_aggregate_header(const uint32_t *data, X27xx_Aggregate_Data_t *x27xx_aggregate_data);
+
+//Unpacks the event at data (nwords 64-bit words left in the aggregate) except for the waveform.  Returns the
+//event size in 64-bit words or -1 if the event does not fit or its last word flags disagree with its size
+int unpack_x27xx_psd_event(const uint32_t *data, uint32_t nwords, X27xx_PSD_Data_t *x27xx_psd_data);
+
+//Unpacks the waveform of the last event (only done when the waveform is used)
+int unpack_x27xx_psd_probes(X27xx_PSD_Data_t *x27xx_psd_data);
+
+//Encodes an event the way the firmware writes it.  Returns the event size in 64-bit words (used by the self test)
+int pack_x27xx_psd_event(const X27xx_PSD_Data_t *x27xx_psd_data, uint32_t *data);
+
+//Round trips synthetic events through pack_x27xx_psd_event and the decoder
+int test_x27xx_psd_decoder();
+
+#endif
@@ -50,17 +50,22 @@
 #include "global.h"
 #include "unpacker.h"
 #include "unpack_vx725_vx730.h"
+#include "unpack_x27xx.h"
 #include "sort_functions.h"
+#include "pipeline.h"
 #include "eventbuilder.h"
 #include "structures.h"
 #include "analyzer.h"
 #include "validator.h"
+#include "thread_pool.h"
+#include "channel_table.h"
+#include "diagnostics.h"
+#include "waveform_reservoir.h"
 
 //C/C++ includes
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <deque>
 #include <vector>
 #include <stdlib.h>
 #include <sys/time.h>
@@ -79,15 +84,15 @@ using namespace std;
 
 stringstream umsg;
 
-//output diagnostics file
-ofstream outputdiagnosticsfile;
-
 //global unpacker variables
 double TimeDeviations[200];
 
 //holds the id of each detector from dancemap
 int MapID[20][20];
 
+//waveform ratio gates for pileup
+double wf_ratio_low, wf_ratio_high;
+
 //function return
 int func_ret = 0;
 
@@ -205,7 +210,10 @@ int Write_Unpacker_Histograms(TFile *fout, Input_Parameters input_params) {
      hTimestampsID->Write();
 #endif
 
+    Write_Diagnostics(fout, hScalers);
     hScalers->Write();
+
+    Write_Waveform_Reservoir(fout);
   }
   
   DANCE_Success("Unpacker","Wrote Unpacker Histograms");
@@ -263,6 +271,12 @@ int Write_Root_File(Input_Parameters input_params, Analysis_Parameters *analysis
   Write_PI_Gates(fout);
   Write_Eventbuilder_Histograms(fout, input_params, analysis_params);
   Write_Analyzer_Histograms(fout, input_params);
+  if(Write_Coincidence_Scan_Histograms(fout)) {
+    return -1;
+  }
+  if(Write_Sweep_Variant_Histograms(fout)) {
+    return -1;
+  }
 
   //Write the root file
   fout->Write();
@@ -280,11 +294,11 @@ int Make_DANCE_Map() {
   int m1,m2,m3;
   
   if(map.is_open()) {
-    while(!map.eof()){
-      map>>m1>>m2>>m3;
+    while(map>>m1>>m2>>m3){
       MapID[m2][m1]=m3;
-      if(map.eof()) {
-        break;
+      if(Set_Channel_ID(m1,m2,m3)) {
+        map.close();
+        return -1;
       }
     }
     map.close();
@@ -301,33 +315,6 @@ int Make_DANCE_Map() {
   }  
 }
 
-//This function makes the output binary file for stage 0 or 1 filled with time-ordered devt_bank structures
-int Make_Output_Diagnostics_File(int RunNumber) {
-  
-  stringstream outfilename;
-  outfilename.str();
-  
-  outfilename << DIAGNOSTICS;
-  outfilename <<"/diagnostics_run";
-  outfilename << RunNumber;
-  outfilename << ".txt";
-  
-  outputdiagnosticsfile.open(outfilename.str().c_str(), ios::out);
-  
-  if(outputdiagnosticsfile.is_open()) {
-    DANCE_Success("Unpacker","Created Output Diagnostics File");
-    return 0;
-  }
-  else {
-    stringstream umsg;
-    umsg.str("");
-    umsg<<"Could not Create Output Diagnostics File: "<<outfilename.str();
-    DANCE_Error("Unpacker",umsg.str());
-
-    return -1;
-  }
-}
-
 int Read_TimeDeviations(Input_Parameters input_params) {
 
   DANCE_Info("Unpacker","Reading Time Deviations");
@@ -357,6 +344,7 @@ int Read_TimeDeviations(Input_Parameters input_params) {
       while(!fdata.eof()) {
         fdata >> tempid >> tempoffset; 
         TimeDeviations[tempid] = tempoffset;
+        Set_Time_Deviation(tempid, tempoffset);
         if(fdata.eof()) {
           break;
         }
@@ -381,7 +369,32 @@ int Read_TimeDeviations(Input_Parameters input_params) {
 }
 
 
-double Calculate_Fractional_Time(uint16_t waveform[], uint32_t Ns, uint8_t dual_trace, uint16_t model, Analysis_Parameters *analysis_params) {
+//Leading edge time of the waveform (ns) and the average of the tail of the waveform (wf_integral).  The tail starts 10 samples after the
+//leading edge, and wf_tail is false (with wf_integral 0) when the waveform ends before that
+double Calculate_Fractional_Time(uint16_t waveform[], uint32_t Ns, uint8_t dual_trace, uint16_t model, double *wf_integral, bool *wf_tail) {
+
+  //Time between samples (ns)
+  double sample_ns=0;
+  //When there is no dual trace there is 2 ns between samples
+  if(!dual_trace && model == 730) {
+    sample_ns=2.;
+  }
+  //When dual trace is on there is 4 ns between samples
+  else if((!dual_trace && model == 725) || (dual_trace && model ==730)) {
+    sample_ns=4.;
+  }
+  //Dual trace Vx725, and the x27xx boards (model 2740 for any of them, they all sample every 8 ns)
+  else if((dual_trace && model == 725) || model == 2740) {
+    sample_ns=8.;
+  }
+  else {
+    stringstream umsg;
+    umsg.str("");
+    umsg<<"Not sure what to do with dual trace: "<<dual_trace<<"  and model: "<<model;
+    DANCE_Error("Unpacker",umsg.str());
+
+    return -1;
+  }
 
   // CALCULATE THE LEADING EDGE using constant fraction "frac"
   uint32_t imin=0;
@@ -430,1918 +443,2119 @@ double Calculate_Fractional_Time(uint16_t waveform[], uint32_t Ns, uint8_t dual_
       //difference in the signal height about the crossing of the threshold
       double dSig=(1.*waveform[kay-1]-1.*waveform[kay]);
       
-      //When there is no dual trace there is 
-      if(!dual_trace && model == 730) {
-        if(dSig!=0) dT=(1.*waveform[kay-1]-thr)/dSig*2.+(kay-1)*2.;  // this is in ns
-        else dT=(kay-1)*2.;
-      }
-      //When dual trace is on there is 4 ns between samples
-      else if((!dual_trace && model == 725) || (dual_trace && model ==730)) {              
-        if(dSig!=0) dT=(1.*waveform[kay-1]-thr)/dSig*4.+(kay-1)*4.;  // this is in ns
-        else dT=(kay-1)*4.;
-      }
-      else if(dual_trace && model == 725) {
-        if(dSig!=0) dT=(1.*waveform[kay-1]-thr)/dSig*8.+(kay-1)*8.;  // this is in ns
-        else dT=(kay-1)*8.;
-      }
-      else {
-        stringstream umsg;
-        umsg.str("");
-        umsg<<"Not sure what to do with dual trace: "<<dual_trace<<"  and model: "<<model;
-        DANCE_Error("Unpacker",umsg.str());
-
-        return -1;
-      }
+      if(dSig!=0) dT=(1.*waveform[kay-1]-thr)/dSig*sample_ns+(kay-1)*sample_ns;  // this is in ns
+      else dT=(kay-1)*sample_ns;
       iLD=kay;
     }                
   }      
 
-  //Use dT to calculate the integral of the end of the waveform
+  //Use dT (in samples) to calculate the integral of the end of the waveform
   double wf_counter=0.0;
   double integral=0.0;
-  for(int kay=(int)dT/2.0+10; kay<(int)Ns; kay++) {
+  for(int kay=(int)(dT/sample_ns)+10; kay<(int)Ns; kay++) {
     integral += base-waveform[kay];    
     wf_counter += 1.0;
   }
-  integral /= wf_counter;
+  if(wf_counter > 0) {
+    integral /= wf_counter;
+  }
 
-  analysis_params->wf_integral=integral;
+  *wf_integral=integral;
+  *wf_tail=(wf_counter > 0);
 
   return dT;
 }
 
-int Unpack_Data(queue<gzFile> &gz_queue, double begin, Input_Parameters input_params, Analysis_Parameters *analysis_params) {
+//Time deviations and detector delays from comparisons on the ID.  The unpacker uses the
+//channel table instead, this is kept as the reference for Check_Channel_Table.  Returns the offset of the ID in ns
+static double Time_Offset(int ID) {
 
-  gzFile gz_in=gz_queue.front();
-  ofstream faillog;
-  faillog.open("Readout_Status_Failures.txt", ios::app);
+  double offset = 0;
 
-  //Boolean control variables
-  bool run=true; 
-  bool subrun=true;
-  //Structures to put data in
-  deque<DEVT_BANK> datadeque;                         //Storage container for time sorted data
-  
-  //CAEN 2015 unpacking
-  long devt_padding = 0;                              // padding between banks not divisible by 64 bits
-  short imported_peaks[256][16384];                   // this is actually supported channels / supported length of PXXX bank
-  unsigned short int wf1[15000];
-  CEVT_BANK *evinfo = new CEVT_BANK();                //caen event info
-  test_struct_cevt *evaggr = new test_struct_cevt();  //event aggregate
-  DEVT_BANK *db_arr = new DEVT_BANK[MaxDEVTArrSize];  //Storage array for entries
-  DEVT_STAGE1 devt_stage1;                            //Stage1 format for reading binary
-
-  //CAEN 2018 unpacking
-  User_Data_t user_data;                              //This is the fw version and user extra word storage
-  Vx725_Vx730_Board_Data_t vx725_vx730_board_data;    //This is the board header data for the Vx725 and Vx730 boards
-  Vx725_Vx730_PSD_Data_t vx725_vx730_psd_data;        //This is the PSD data for the Vx725 and Vx730 boards
-  Vx725_Vx730_PHA_Data_t vx725_vx730_pha_data;        //This is the PHA data for the Vx725 and Vx730 boards
+  //Add the time deviations
+  if(ID < 200) {
+    offset += TimeDeviations[ID];
+  }
 
-  //Counters
-  uint32_t EVTS=0;              //Total number of entries unpacked since last time sort
-  uint64_t BYTES_READ=0;        //Total number of Bytes read since last time sort
-  uint64_t TOTAL_BYTES=0;       //Total number of Bytes read 
-  uint32_t progresscounter=1;   //Keep track of how many progress statements have been made
-  int gzret=1;                  //number of bytes read by gzread
-  
+  //Add the DANCE delay
+  if(ID < 162) {
+    offset += DANCE_Delay;
+  }
 
-  //Some CAEN structures to optimize reads
-  V1730_Header_t v1730_header;
-  V1730_ChAgg_Header_t v1730_chagg_header;
-  uint32_t v1730_chagg_data[Max_ChAgg_Size];
+  //Add the He3 delay
+  if(ID == He3_ID) {
+    offset += He3_Delay;
+  }
 
-  //MIDAS Bank Stuff
-  EventHeader_t head;           //MIDAS event header
-  BankHeader_t bhead;           //MIDAS bank header
-  Bank32_t bank32;              //MIDAS 32-bit bank
-  Bank_t bank;                  //MIDAS 16-bit bank
+  //Add the U235 delay
+  if(ID == U235_ID) {
+    offset += U235_Delay;
+  }
 
-  uint32_t TotalDataSize=0;     // head.fDataSize;
-  uint32_t TotalBankSize=0;     // bhead.fDataSize;
-  uint32_t EventBankSize=0;     // bank32fDataSize;
+  //Add the Li6 delay
+  if(ID == Li6_ID) {
+    offset += Li6_Delay;
+  }
 
-  //Scalers
-  Sclr_Totals_t sclr_totals;    //Scaler Totals
-  Sclr_Rates_t sclr_rates;      //Scaler Rates
-  
-  //time profiling for performance
-  struct timeval tv;              //Real time  
-  double time_elapsed;     //Elapsed time
-  double time_elapsed_old; //Previous elapsed time
-  
-  //Scaler Variables for caen2018 format
-  struct timeval timevalue;          //Time at which scalers were recorded
-  uint32_t Digitizer_Rates[20];      //Digitizer read rates in bytes per second
-  uint16_t ADC_Temp[20][16];         //0x1nA8 ADC Temps in degrees C
-  uint32_t Channel_Status[20][16];   //0x1n88 Channel status registers
-  uint32_t Acquisition_Status[20];   //0x8104 Acquisition Status
-  uint32_t Failure_Status[20];       //0x8178 Board Failure Status
-  uint32_t Readout_Status[20];       //0xEF04 Readout Status
-  uint32_t Register_0x8504n[20][8];  //0x8500 + 4n (Tells how many buffers are left to readout in each pair)
-  uint32_t Register_0x1n2C[20][16];
+  return offset;
+}
 
-  //waveform ratio gates
-  char gatename[200]; 
-  double wf_ratio_low, wf_ratio_high;
-  sprintf(gatename,"Gates/%s",PILEUPGATE);
-  ifstream pileupcutin(gatename);
-  if(pileupcutin.is_open()){
-    pileupcutin >> wf_ratio_low >> wf_ratio_high;
+//Compares the channel table with the DANCE map and the time offset comparisons for every board, channel, and ID
+int Check_Channel_Table(Input_Parameters input_params) {
+
+  DANCE_Info("Unpacker","Checking the Channel Table");
+
+  int nbad=0;
+
+  for(int eye=0; eye<Table_IDs; eye++) {
+
+    const Detector_Descriptor_t &detector = channel_table.detector[eye];
+
+    //Time offsets
+    double offset = 0;
+    if(input_params.Analysis_Stage > 0) {
+      offset = Time_Offset(eye);
+    }
+    if(offset != detector.time_offset) {
+      umsg.str("");
+      umsg<<"ID "<<eye<<" time offset "<<detector.time_offset<<" should be "<<offset;
+      DANCE_Error("Unpacker",umsg.str());
+      nbad++;
+    }
+
+    //Detector classes as the eventbuilder sorts them
+    uint8_t detector_class = Detector::Unknown;
+    if(eye < 162) {
+      detector_class = Detector::DANCE;
+    }
+    else if(eye == T0_ID) {
+      detector_class = Detector::T0;
+    }
+    else if(eye == Li6_ID) {
+      detector_class = Detector::Li6;
+    }
+    else if(eye == He3_ID) {
+      detector_class = Detector::He3;
+    }
+    else if(eye == U235_ID) {
+      detector_class = Detector::U235;
+    }
+    else if(eye == Bkg_ID) {
+      detector_class = Detector::Bkg;
+    }
+    if(detector_class != detector.detector_class) {
+      umsg.str("");
+      umsg<<"ID "<<eye<<" detector class "<<(int)detector.detector_class<<" should be "<<(int)detector_class;
+      DANCE_Error("Unpacker",umsg.str());
+      nbad++;
+    }
   }
-  else {
+
+  //Map (MapID only covers 20 boards and 20 channels)
+  for(int bee=0; bee<20; bee++) {
+    for(int cee=0; cee<Table_Channels; cee++) {
+
+      const Channel_Entry_t &entry = channel_table.channel[bee][cee];
+
+      int64_t offset = 0;
+      if(input_params.Analysis_Stage > 0) {
+        offset = Time_From_ns(Time_Offset(MapID[cee][bee]));
+      }
+
+      if(entry.ID != MapID[cee][bee] || entry.time_offset_ticks != offset || entry.detector_class != channel_table.detector[entry.ID].detector_class) {
+        umsg.str("");
+        umsg<<"Board "<<bee<<" Channel "<<cee<<" has ID "<<entry.ID<<" and time offset "<<entry.time_offset_ticks<<" but the map gives ID "<<MapID[cee][bee]<<" and time offset "<<offset<<" (time ticks)";
+        DANCE_Error("Unpacker",umsg.str());
+        nbad++;
+      }
+    }
+  }
+
+  if(nbad > 0) {
     umsg.str("");
-    umsg<<"Failed to Load waveform ratio Cut " << gatename;
+    umsg<<"Channel Table has "<<nbad<<" bad entries";
     DANCE_Error("Unpacker",umsg.str());
     return -1;
   }
-  pileupcutin.close();  
 
+  DANCE_Success("Unpacker","Channel Table matches the DANCE map and time offsets");
+  return 0;
+}
 
-  //channel vector
-  vector<int> channels;
+//Stops decoding a board bank at word pos.  The entries decoded before pos are kept
+static inline int Board_Bank_Error(Board_Bank_t *board_bank, int status, uint32_t pos) {
+  board_bank->status = status;
+  board_bank->error_pos = pos;
+  return status;
+}
 
-  //Start of the unpacking process 
-  gettimeofday(&tv,NULL);  
-  double unpack_begin = tv.tv_sec+(tv.tv_usec/1000000.0);
+//Reads the firmware and user extra words at the start of a caen2018 board bank
+static int Start_Board_Bank(Board_Bank_t *board_bank, User_Data_t *user_data) {
+
+  const uint32_t *words = &board_bank->words[0];
+
+  board_bank->hits.clear();
+  board_bank->status = 0;
+  board_bank->smallest_timestamp = Time_Max;
+  board_bank->largest_timestamp = 0;
+  board_bank->error_pos = 0;
+  board_bank->boardid = 0;
+  memset(board_bank->rejected, 0, sizeof(board_bank->rejected));
+
+  if(board_bank->nwords < 2) {
+    return Board_Bank_Error(board_bank, -2, 0);
+  }
+
+  //Read the firmware version and board ID
+  user_data->fw_majrev = (words[0] & MAJREV_MASK);
+  user_data->fw_minrev = (words[0] & MINREV_MASK) >> 8;
+  user_data->modtype = (words[0] & MODTYPE_MASK) >> 14;
+  user_data->modtype = 730;
+  user_data->boardid = (words[0] & BOARDID_MASK) >> 26;
+  board_bank->boardid = user_data->boardid;
+
+  //Read the user extras word
+  user_data->user_extra = words[1];
 
-  DANCE_Info("Unpacker","Started Unpacking");
-  
-  while (!gz_queue.empty()) { 
-    //Stage 0 unpacking/stage 1 from midas
-    if(input_params.Read_Binary==0 && input_params.Read_Simulation==0) {
- 
-      stringstream umsg;
-      umsg.str("");
-      umsg<<"Data Format: "<<input_params.DataFormat;
-      DANCE_Info("Unpacker",umsg.str());
-      
-      while(run) {
-        while(subrun) {
-       
-        if(analysis_params->entries_unpacked > EventLimit) {
-          run=false;
-          while (!gz_queue.empty()){gz_queue.pop();}
-        }
-        
-        //Progess indicator
-        if(analysis_params->entries_unpacked > progresscounter*ProgressInterval) {
-          progresscounter++;
-          cout<<"Processing Run Number: "<<input_params.RunNumber<<endl;
-          
-          if(datadeque.size()>0) {
-            cout<<"datadeque size non-zero: " << datadeque.size() <<endl;
-            cout<<"Oldest Time in the Buffer: "<<datadeque[0].TOF<<endl;
-            cout<<"Newest Time in the Buffer: "<<datadeque[datadeque.size()-1].TOF<<endl;
-          }
-          
-          cout<<analysis_params->entries_unpacked<<" Entries Unpacked "<<endl;
-          cout<<analysis_params->entries_awaiting_timesort<<" Entries Awaiting timesort"<<endl;
-          cout<<datadeque.size()<<" Entries Sorted and in the Buffer"<<endl;
-#ifdef CheckBufferDepth
-          if(analysis_params->max_buffer_utilization < 0.75) {
-            cout<<GREEN<<" Max Buffer Utilization: "<<100.0*analysis_params->max_buffer_utilization<<" %"<<RESET<<endl;
-          }
-          else if(analysis_params->max_buffer_utilization < 0.90) {
-            cout<<YELLOW<<" Max Buffer Utilization: "<<100.0*analysis_params->max_buffer_utilization<<" %"<<RESET<<endl;
-          }
-          else {
-            cout<<RED<<" Max Buffer Utilization: "<<100.0*analysis_params->max_buffer_utilization<<" %"<<RESET<<endl;
-          }
-#endif
-          cout<<analysis_params->entries_written_to_binary<<" Entries Written to Binary"<<endl;
-          cout<<analysis_params->entries_invalid<<" Entries Invalid ("<<100.0*analysis_params->entries_invalid/analysis_params->entries_processed<<" %)"<<endl;
-          cout<<analysis_params->entries_built<<" Entries Built into "<<analysis_params->events_built<<" Events"<<endl;
-          cout<<"Analyzed "<<analysis_params->entries_analyzed<<" Entries from "<<analysis_params->events_analyzed<<" Events"<<endl;
- 
-          cout<<setw(20)<<left<<"Breakdown:"<<setw(12)<<left<<"DANCE"<<setw(12)<<left<<"T0"<<setw(12)<<left<<"Li6"<<setw(12)<<left<<"U235"<<setw(12)<<left<<"He3"<<setw(12)<<left<<"Background"<<setw(12)<<left<<"Unknown"<<setw(12)<<left<<endl;
- 
-          cout<<setw(20)<<left<<"Entries:"<<setw(12)<<left<<analysis_params->DANCE_entries_analyzed;
-          cout<<setw(12)<<left<<analysis_params->T0_entries_analyzed;
-          cout<<setw(12)<<left<<analysis_params->Li6_entries_analyzed;
-          cout<<setw(12)<<left<<analysis_params->U235_entries_analyzed;
-          cout<<setw(12)<<left<<analysis_params->He3_entries_analyzed;
-          cout<<setw(12)<<left<<analysis_params->Bkg_entries_analyzed;
-          cout<<setw(12)<<left<<analysis_params->Unknown_entries<<endl;
- 
-          cout<<setw(20)<<left<<"Events:"<<setw(12)<<left<<analysis_params->DANCE_events_analyzed;
-          cout<<setw(12)<<left<<analysis_params->T0_events_analyzed;
-          cout<<setw(12)<<left<<analysis_params->Li6_events_analyzed;
-          cout<<setw(12)<<left<<analysis_params->U235_events_analyzed;
-          cout<<setw(12)<<left<<analysis_params->He3_events_analyzed;
-          cout<<setw(12)<<left<<analysis_params->Bkg_events_analyzed<<endl;
- 
-          if(analysis_params->DANCE_events_analyzed > 0) {
-            cout<<setw(20)<<left<<"Average Mult:"<<setw(12)<<left<<(1.0*analysis_params->DANCE_entries_analyzed)/(1.0*analysis_params->DANCE_events_analyzed)<<endl;
-          }
-          cout<<endl;
- 
-          gettimeofday(&tv,NULL); 
-          time_elapsed=tv.tv_sec+(tv.tv_usec/1000000.0);
-        
-          cout << "Average Entry Processing Rate: "<<(double)analysis_params->entries_unpacked/(time_elapsed-unpack_begin)<<" Entries per second "<<endl;
-          cout << "Average Data Read Rate: "<<(double)TOTAL_BYTES/(time_elapsed-unpack_begin)/(1024.0*1024.0)<<" MB/s"<<endl;
-          cout << "Instantaneous Data Read Rate: "<<(double)BYTES_READ/(time_elapsed-time_elapsed_old)/(1024.0*1024.0)<<" MB/s"<<endl;
-          cout << (double)TOTAL_BYTES/(1024.0*1024.0*1024.0)<<" GiB Read"<<endl<<endl<<endl;
- 
-          BYTES_READ=0;
-          time_elapsed_old = time_elapsed;
-        } //end progress indicator
-      
- 
-        //This is the unpacker for the caen2015 data format
-        if(strcmp(input_params.DataFormat.c_str(),"caen2015") == 0) {
- 
-          //Read in the event header
-          gzret=gzread(gz_in,&head,sizeof(EventHeader_t));
-        
-          //As long as gzread reads something start doing unpacking
-          if(gzret!=0) {
-          
-            TotalDataSize = head.fDataSize;
-            BYTES_READ += TotalDataSize;
-            TOTAL_BYTES += TotalDataSize;
- 
-#ifdef Unpacker_Verbose
-            cout<<"Type: "<<head.fEventId<<endl;
-            cout<<"Size: "<<head.fDataSize<<endl;     ///< event size in bytes
-            cout<<"TimeStamp "<<head.fTimeStamp<<endl;    ///< event timestamp in nseconds
-#endif
-           hEventID->Fill(head.fEventId);
-           //cout << head.fTimeStamp << endl;
-             //Data
-            if(head.fEventId==1){
-              gzret=gzread(gz_in,&bhead,sizeof(BankHeader_t));        
-          
 #ifdef Unpacker_Verbose
-              cout << "Bank_HEADER " << endl;
-              cout << dec <<"TotalBankSize (bytes): " << bhead.fDataSize << endl;
-              cout << dec << bhead.fFlags << endl;
+  cout<< "board: "<< (int)user_data->boardid <<" is a "<< (int)user_data->modtype <<" with Firmware: "<<(int)user_data->fw_majrev<< "."<<(int)user_data->fw_minrev<<"  "<<user_data->user_extra<<endl;
 #endif
-          
-              TotalBankSize = bhead.fDataSize;
-          
-              while(TotalBankSize>0) {
-                gzret=gzread(gz_in,&bank32,sizeof(Bank32_t));
-                TotalBankSize-=sizeof(Bank32_t);
+
+  return 0;
+}
+
+//Reads the header of the board aggregate at pos and the channels it holds.  Returns the end of the board aggregate
+static int Start_Board_Aggregate(Board_Bank_t *board_bank, uint32_t pos, uint32_t *board_end, int channels[8], uint32_t *nchannels) {
+
+  Vx725_Vx730_Board_Data_t vx725_vx730_board_data;
+
+  //Unpack the Vx725_Vx730 header information
+  unpack_vx725_vx730_board_data((V1730_Header_t*)&board_bank->words[pos], &vx725_vx730_board_data);
+
 #ifdef Unpacker_Verbose
-                cout << "BANK " << endl;
-                cout << bank32.fName[0] << bank32.fName[1] << bank32.fName[2]<< bank32.fName[3] << endl;
-                cout << dec << bank32.fType << endl;
-                cout << dec << bank32.fDataSize << endl;
-#endif
-                EventBankSize = bank32.fDataSize;
-                if (bank32.fName[0]=='C' && bank32.fName[1]=='E') {        // name starts as CE VT_BANK
-                  int EVTS_batch=0;
-              
-                  evaggr->N = 0; // reset how many events we've processed this event
-              
-                  int number_cevt_events = bank32.fDataSize/sizeof(CEVT_BANK);
-              
-                  for (int eye = 0; eye < number_cevt_events; ++eye) {
-                    gzret=gzread(gz_in,evinfo,sizeof(CEVT_BANK));
-                    gzseek(gz_in,devt_padding,SEEK_CUR);
- 
-#ifdef Unpacker_Verbose 
-                    cout<<"cevt event number: "<<eye<<endl;
-                    cout<<"position: "<<evinfo->position<<endl;
-                    cout<<"extras: "<<evinfo->extras<<endl;
-                    cout<<"width: "<<evinfo->width<<endl;
-                    cout<<"detector_id: "<<evinfo->detector_id<<endl;
-                    cout<<evinfo->integral[0]<<"  "<<evinfo->integral[1]<<endl;
-                    cout<<"padding: "<<devt_padding<<endl<<endl;;
-#endif
-                    TotalBankSize-=sizeof(CEVT_BANK)+devt_padding;
-                    EventBankSize-=sizeof(CEVT_BANK)+devt_padding;          
-                
-                    evaggr->P[evaggr->N] = *evinfo;
-                    evaggr->N++;
-                    EVTS_batch += 1;
-                
-#ifdef Unpacker_Verbose 
-                    cout << "evaggr->N: " << evaggr->N << endl;
-#endif
-                  }
-                          
-                  // snag the trig bank
-                  gzret=gzread(gz_in,&bank32,sizeof(Bank32_t));
-                  TotalBankSize-=sizeof(Bank32_t);
-                  EventBankSize = bank32.fDataSize;
-              
-                  char *fData;
-                  fData=(char*)malloc(bank32.fDataSize);
-                  gzret=gzread(gz_in,fData,bank32.fDataSize);
-                  TotalBankSize -= EventBankSize;
-                  free (fData);        
-              
-#ifdef Unpacker_Verbose 
-                  cout<<"Before trig bank"<<endl;
-#endif
- 
-                  // begin funny place between peaks and cpu
-                  while (true) {
-                    // the peaks bank should be here
-                    gzret=gzread(gz_in,&bank32,sizeof(Bank32_t));
-                    TotalBankSize-=sizeof(Bank32_t);
-                    EventBankSize = bank32.fDataSize;
- 
-#ifdef Unpacker_Verbose 
-                    cout<<"Peak bank"<<endl;
-                    cout<<"Name: "<<bank32.fName[0]<<"  Total Bank Size: "<<TotalBankSize<<"  EventBankSize: "<<EventBankSize<<endl;
-#endif
-                
-                    if(bank32.fName[0]=='p') {
-                      int whichpeak = atoi(&bank32.fName[1]);
-#ifdef Unpacker_Verbose 
-                      cout << "whichpeak: " << whichpeak << endl;
-#endif
-                      gzret=gzread(gz_in,imported_peaks[whichpeak],bank32.fDataSize);
-#ifdef Unpacker_Verbose 
-                      cout<<"After Read"<<endl;
-#endif
-                      //gzread(in,waveform,bank32.fDataSize);
-                      TotalBankSize -= EventBankSize;
-                    } 
-                    else {
-#ifdef Unpacker_Verbose 
-                      cout<<"CPU Bank"<<endl;
-#endif
-                      // get the cpu bank information
-                      char *fData=(char*)malloc(bank32.fDataSize);
-                      gzret=gzread(gz_in,fData,bank32.fDataSize);
-                      TotalBankSize -= EventBankSize;
-                      free (fData);
-                     // gz_queue.pop();
-                     // subrun=false;
-                     // run=false;
-                      break; // you break here because the cpu comes last
-                    }
-                  }
-#ifdef Unpacker_Verbose 
-                  cout<<"After trig bank"<<endl;
+  cout<<"header: "<<(int)vx725_vx730_board_data.header<<"  ";
+  cout<<"nwords: "<<vx725_vx730_board_data.boardaggsize<<"  ";
+  cout<<"boardid: "<<(int)vx725_vx730_board_data.boardid<<"  ";
+  cout<<"pattern: "<<vx725_vx730_board_data.pattern<<"  ";
+  cout<<"channelmask: "<<(int)vx725_vx730_board_data.channelmask<<"  ";
+  cout<<"boardaggcounter: "<<vx725_vx730_board_data.boardaggcounter<<"  ";
+  cout<<"boardaggtime: "<<vx725_vx730_board_data.boardaggtime<<endl;
+#endif
+
+  //Make sure the board header ID is 10 before proceeding
+  if(vx725_vx730_board_data.header != 10) {
+    return Board_Bank_Error(board_bank, -1, pos);
+  }
+
+  //Make sure the board aggregate fits in the bank
+  *board_end = pos + vx725_vx730_board_data.boardaggsize;
+  if(vx725_vx730_board_data.boardaggsize < 4 || *board_end > board_bank->nwords) {
+    return Board_Bank_Error(board_bank, -2, pos);
+  }
+
+  //interpret the channel mask
+  *nchannels = 0;
+  for(int m=0; m<8; m++) {
+    if((( vx725_vx730_board_data.channelmask >> m) & 0x1)) {
+      channels[(*nchannels)++] = 2*m;
+    }
+  }
+
+  return 0;
+}
+
+//Keeps track of the time range of the entries of a board bank
+static inline void Add_Board_Hit(Board_Bank_t *board_bank, DEVT_BANK &hit) {
+
+  //keep track of the smallest timestamp
+  if(hit.timestamp<board_bank->smallest_timestamp) {
+    board_bank->smallest_timestamp=hit.timestamp;
+  }
+  //keep track of the largest timestamp
+  if(hit.timestamp>board_bank->largest_timestamp) {
+    board_bank->largest_timestamp=hit.timestamp;
+  }
+
+  board_bank->hits.push_back(hit);
+}
+
+//Hit decoding of a caen2018 board bank from DPP-PSD firmware (firmware word, user extra word, board aggregates).
+//Banks from different boards are independent until the time sort so these can run in parallel.
+int Decode_PSD_Board_Bank(Board_Bank_t *board_bank, Board_Decoder_t *decoder, Input_Parameters *input_params) {
+
+  const uint32_t *words = &board_bank->words[0];
+  uint32_t nwords = board_bank->nwords;
+  uint32_t pos = 2;
+  uint32_t board_end = 0;
+
+  Vx725_Vx730_PSD_Data_t &vx725_vx730_psd_data = decoder->psd_data;
+  Vx725_Vx730_PSD_Decoder_t psd_decoder;
+  User_Data_t user_data;
+  int channels[8];
+  uint32_t nchannels = 0;
+
+  bool firmware_finetime = input_params->Use_Firmware_FineTime;
+
+  if(Start_Board_Bank(board_bank, &user_data)) {
+    return board_bank->status;
+  }
+
+  //Channels of this board that are unpacked
+  uint16_t accept_mask = channel_table.accept_mask[user_data.boardid];
+
+  while(pos + 4 <= nwords) {
+
+    if(Start_Board_Aggregate(board_bank, pos, &board_end, channels, &nchannels)) {
+      return board_bank->status;
+    }
+    pos += 4;
+
+    //Number of channel aggregates unpacked
+    uint32_t chaggcounter = 0;
+
+    while(pos + 2 <= board_end) {
+
+      if(chaggcounter >= nchannels) {
+	return Board_Bank_Error(board_bank, -2, pos);
+      }
+
+      unpack_vx725_vx730_psd_chagg_header((V1730_ChAgg_Header_t*)&words[pos], &vx725_vx730_psd_data);
+      psd_decoder = select_vx725_vx730_psd_decoder(&vx725_vx730_psd_data);
+
+      //Words in the channel aggregate
+      uint32_t chagg_end = pos + vx725_vx730_psd_data.chagg_size;
+      if(vx725_vx730_psd_data.chagg_size < 2 || chagg_end > board_end) {
+	return Board_Bank_Error(board_bank, -2, pos);
+      }
+      pos += 2;
+
+      //Unpack the channel aggregate
+      while(pos + vx725_vx730_psd_data.individual_chagg_size <= chagg_end) {
+
+	//Skip channels that are not accepted without decoding them (the odd channel flag is bit 31 of the first word)
+	uint32_t channel = channels[chaggcounter] + (words[pos] >> 31);
+	if(!((accept_mask >> channel) & 0x1)) {
+	  board_bank->rejected[channel]++;
+	  pos += vx725_vx730_psd_data.individual_chagg_size;
+	  continue;
+	}
+
+	//unpack the channel agregate
+	psd_decoder((uint32_t*)&words[pos], &vx725_vx730_psd_data);
+	pos += vx725_vx730_psd_data.individual_chagg_size;
+
+	DEVT_BANK hit;
+	memset(&hit, 0, sizeof(DEVT_BANK));
+
+	//Set the remaining analysis variables
+	hit.Valid = 1;                                                             //Everything starts valid
+	hit.board = user_data.boardid;                                             //Board ID
+	hit.channel = vx725_vx730_psd_data.channel + channels[chaggcounter];       //Channel ID
+	hit.Ifast =  vx725_vx730_psd_data.qshort;                                  //Fast Integral
+	hit.Islow =  vx725_vx730_psd_data.qlong - vx725_vx730_psd_data.qshort;     //Slow Integral (minus the fast)
+	hit.InvalidReason = 0;
+
+	//Map it
+	const Channel_Entry_t &entry = channel_table.channel[hit.board][hit.channel];
+	hit.ID = entry.ID;
+
+	//Do waveform analysis and calculate times
+	if(vx725_vx730_psd_data.dual_trace) {
+	  hit.Ns = 4.0*vx725_vx730_psd_data.nsdb8;                                  //Dual trace effectively reduces the sampling frequency
+	}
+	else {
+	  hit.Ns = 8.0*vx725_vx730_psd_data.nsdb8;
+	}
+
+	double dT=0;
+	double wf_integral=0;
+	bool wf_tail=true;
+
+	//If the detector is not a DANCE crystal or the use fine time is off
+	if ( ! firmware_finetime || hit.ID >= 162) {
+	  dT = Calculate_Fractional_Time(vx725_vx730_psd_data.analog_probe1,                 //Function that calculates the fine time stamp
+					 hit.Ns,
+					 vx725_vx730_psd_data.dual_trace,
+					 user_data.modtype,
+					 &wf_integral,
+					 &wf_tail);
+	}
+	else {
+	  dT = 2.* vx725_vx730_psd_data.fine_time_stamp/1024.;
+	}
+
+	//Set the timestamps
+	hit.timestamp = vx725_vx730_psd_data.trigger_time_tag;                       //31-bit time in clock ticks
+	hit.timestamp += 2147483648*vx725_vx730_psd_data.extended_time_stamp;        //16-bit extended time in clock ticks
+	hit.timestamp *= 2*Time_Ticks;                                               //timestamp now in time ticks (2 ns clock)
+	hit.timestamp += Time_From_ns(dT);                                           //Full timestamp in time ticks
+	hit.wfintegral = wf_integral;
+
+	//No pileup check on a waveform that ends before its tail
+	if(wf_tail && (wf_integral/(1.0*hit.Islow) < wf_ratio_low || wf_integral/(1.0*hit.Islow) > wf_ratio_high)) {
+	  hit.pileup_detected=1;
+	}
+	else {
+	  hit.pileup_detected=0;
+	}
+
+	//Waveform diagnostics
+	Sample_Waveform(hit.ID,
+			wf_integral < 0 ? Waveform_Negative : (hit.pileup_detected ? Waveform_Pileup : Waveform_Good),
+			vx725_vx730_psd_data.analog_probe1, hit.Ns, hit.Ifast, hit.Islow, wf_integral);
+
+	//Time deviations and delays
+	hit.timestamp += entry.time_offset_ticks;
+
+#ifdef MakeTimeStampHistogram
+	if (hit.ID<162){
+	  hTimestamps->Fill(Time_To_ns(hit.timestamp)*1.0e-9);
+	  hTimestampsID->Fill(Time_To_ns(hit.timestamp)*1.0e-9,hit.ID);
+	}
+	if (hit.ID==T0_ID){
+	  hTimestampsT0->Fill(Time_To_ns(hit.timestamp)*1.0e-9);
+	}
+	if (hit.ID==He3_ID || hit.ID==Li6_ID || hit.ID==U235_ID || hit.ID==Bkg_ID ){
+	  hTimestampsBM->Fill(Time_To_ns(hit.timestamp)*1.0e-9);
+	}
 #endif
- 
-                  int last_detnum = evaggr->P[0].detector_id;
-                  int where_in_peakbank = 0;
-                  for (uint32_t evtnum=0;evtnum<evaggr->N;++evtnum) {
-                    int current_detnum = evaggr->P[evtnum].detector_id;
-                    if (current_detnum != last_detnum) {
-                      where_in_peakbank = 0;
-                    }
-                    uint32_t wflen = evaggr->P[evtnum].width;        // CEVT_BANK variable
-                    analysis_params->wf_integral=0; 
-                    for (uint wfindex=where_in_peakbank;wfindex<where_in_peakbank+wflen;++wfindex) {
-                      // at this point we have reserved only 40 samples in db_arr waveform !!
-                      evaggr->wavelets[evtnum][wfindex-where_in_peakbank] = imported_peaks[current_detnum][wfindex];
-                    }        
-                    where_in_peakbank += wflen;
-                    last_detnum = current_detnum;
-                
-                    uint64_t timestamp_raw = (evaggr->P[evtnum].position & 0x7FFFFFFFFFFF);                // 47 bits for timestamp
- 
-#ifdef Unpacker_Verbose 
-                    cout<<"timestamp_raw: "<<timestamp_raw<<endl;
+
+#ifdef Histogram_Digital_Probes
+	//Fill probe histograms
+	if(hit.ID<256) {
+	  for(int kay=0;kay<hit.Ns;kay++) {
+	    //digital probes
+	    hDigital_Probe1_ID->Fill(kay,hit.ID,vx725_vx730_psd_data.digital_probe1[kay]);
+	    hDigital_Probe2_ID->Fill(kay,hit.ID,vx725_vx730_psd_data.digital_probe2[kay]);
+	  }
+	}
 #endif
-                              
-                    db_arr[EVTS].timestamp        = (double)(timestamp_raw);                                     //Digitizer timestamp
-                    db_arr[EVTS].TOF               = (double)(timestamp_raw);                                     //Time of Flight (Currently in 2ns increments)
-                    db_arr[EVTS].Ns                = evaggr->P[evtnum].width;                                     //Number of samples of the waveform
-                    db_arr[EVTS].Ifast        = evaggr->P[evtnum].integral[0];                               //Fast integral
-                    db_arr[EVTS].Islow        = evaggr->P[evtnum].integral[1]-evaggr->P[evtnum].integral[0]; //Slow integral
-                    db_arr[EVTS].board        = (int)((1.*((int)evaggr->P[evtnum].detector_id)-1)/16.);      //Board number
-                    db_arr[EVTS].channel        = (1*evaggr->P[evtnum].detector_id-1)-16*db_arr[EVTS].board;   //Channel number
-                    db_arr[EVTS].ID             = MapID[db_arr[EVTS].channel][db_arr[EVTS].board];             //ID from DANCE map
-                    db_arr[EVTS].Valid = 1;                                                                //Everything starts valid     
-                    db_arr[EVTS].InvalidReason = 0;                                                            
- 
- 
-#ifdef Unpacker_Verbose 
-                    cout<<(int)db_arr[EVTS].board<<"  "<<(int)db_arr[EVTS].channel<<endl;
+
+#ifdef Histogram_Waveforms
+	//Fill waveform histograms
+	if(hit.ID<162) {
+
+	  hID_vs_WFRatio->Fill(wf_integral/(1.0*hit.Islow),hit.ID);
+	  hID_vs_WFInt_vs_Islow->Fill(wf_integral,hit.Islow,hit.ID);
+	  hID_vs_WFRatio_vs_Islow->Fill(wf_integral/(1.0*hit.Islow),hit.Islow,hit.ID);
+
+	  if(waveform_counter < 20) {
+	    if(hit.Islow > 5000 && hit.Ifast >500 && hit.Ifast <1000) {
+	      for(int kay=0; kay<hit.Ns; kay++) {
+		hWaveforms[waveform_counter]->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay]);
+	      }
+	      waveform_counter++;
+	    }
+	  }
+
+	  if(wf_integral<0) {
+	    for(int kay=0; kay<hit.Ns; kay++) {
+	      hWaveform_ID_NR->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay],hit.ID);
+	    }
+	  }
+	  else {
+	    for(int kay=0; kay<hit.Ns; kay++) {
+	      hWaveform_ID->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay],hit.ID);
+	    }
+	  }
+	}
+
+	if(hit.ID == He3_ID) {
+	  for(int kay=0;kay<hit.Ns;kay++) {
+	    hWaveform_He3->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay]);
+	  }
+	}
+	if(hit.ID == Bkg_ID) {
+	  for(int kay=0;kay<hit.Ns;kay++) {
+	    hWaveform_Bkg->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay]);
+	  }
+	}
+	if(hit.ID == U235_ID) {
+	  for(int kay=0;kay<hit.Ns;kay++) {
+	    hWaveform_U235->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay]);
+	  }
+	}
+	if(hit.ID == Li6_ID) {
+	  for(int kay=0;kay<hit.Ns;kay++) {
+	    hWaveform_Li6->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay]);
+	  }
+	}
+	if(hit.ID==T0_ID) {
+	  for(int kay=0;kay<hit.Ns;kay++) {
+	    hWaveform_T0->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay]);
+	  }
+	}
+#endif
+
+	Add_Board_Hit(board_bank, hit);
+      } //End of check on chagg words to read
+
+      pos = chagg_end;
+
+      //increment the chagg counter
+      chaggcounter++;
+
+    } //End of loop over channel aggregates
+
+    pos = board_end;
+  } //End of loop over board aggregates
+
+  return 0;
+}
+
+//Hit decoding of a caen2018 board bank from DPP-PHA firmware
+int Decode_PHA_Board_Bank(Board_Bank_t *board_bank, Board_Decoder_t *decoder, Input_Parameters *input_params) {
+
+  const uint32_t *words = &board_bank->words[0];
+  uint32_t nwords = board_bank->nwords;
+  uint32_t pos = 2;
+  uint32_t board_end = 0;
+
+  Vx725_Vx730_PHA_Data_t &vx725_vx730_pha_data = decoder->pha_data;
+  Vx725_Vx730_PHA_Decoder_t pha_decoder;
+  User_Data_t user_data;
+  int channels[8];
+  uint32_t nchannels = 0;
+
+  bool firmware_finetime = input_params->Use_Firmware_FineTime;
+
+  if(Start_Board_Bank(board_bank, &user_data)) {
+    return board_bank->status;
+  }
+
+  //Channels of this board that are unpacked
+  uint16_t accept_mask = channel_table.accept_mask[user_data.boardid];
+
+  while(pos + 4 <= nwords) {
+
+    if(Start_Board_Aggregate(board_bank, pos, &board_end, channels, &nchannels)) {
+      return board_bank->status;
+    }
+    pos += 4;
+
+    //Number of channel aggregates unpacked
+    uint32_t chaggcounter = 0;
+
+    while(pos + 2 <= board_end) {
+
+      if(chaggcounter >= nchannels) {
+	return Board_Bank_Error(board_bank, -2, pos);
+      }
+
+      unpack_vx725_vx730_pha_chagg_header((V1730_ChAgg_Header_t*)&words[pos], &vx725_vx730_pha_data);
+      pha_decoder = select_vx725_vx730_pha_decoder(&vx725_vx730_pha_data);
+
+      //Words in the channel aggregate
+      uint32_t chagg_end = pos + vx725_vx730_pha_data.chagg_size;
+      if(vx725_vx730_pha_data.chagg_size < 2 || chagg_end > board_end) {
+	return Board_Bank_Error(board_bank, -2, pos);
+      }
+      pos += 2;
+
+      //Unpack the channel aggreate
+      while(pos + vx725_vx730_pha_data.individual_chagg_size <= chagg_end) {
+
+	//Skip channels that are not accepted without decoding them (the odd channel flag is bit 31 of the first word)
+	uint32_t channel = channels[chaggcounter] + (words[pos] >> 31);
+	if(!((accept_mask >> channel) & 0x1)) {
+	  board_bank->rejected[channel]++;
+	  pos += vx725_vx730_pha_data.individual_chagg_size;
+	  continue;
+	}
+
+	//unpack the channel agregate
+	pha_decoder((uint32_t*)&words[pos], &vx725_vx730_pha_data);
+	pos += vx725_vx730_pha_data.individual_chagg_size;
+
+	DEVT_BANK hit;
+	memset(&hit, 0, sizeof(DEVT_BANK));
+
+	//Set the remaining analysis variables
+	hit.Valid = 1;
+	hit.board = user_data.boardid;
+	hit.channel = vx725_vx730_pha_data.channel + channels[chaggcounter];
+	hit.Ifast =  vx725_vx730_pha_data.energy;
+	hit.Islow =  vx725_vx730_pha_data.energy;
+	hit.InvalidReason = 0;
+
+	//Map it
+	const Channel_Entry_t &entry = channel_table.channel[hit.board][hit.channel];
+	hit.ID = entry.ID;
+
+	//Do waveform analysis and calculate times
+	if(vx725_vx730_pha_data.dual_trace) {
+	  hit.Ns = 4.0*vx725_vx730_pha_data.nsdb8;
+	}
+	else {
+	  hit.Ns = 8.0*vx725_vx730_pha_data.nsdb8;
+	}
+
+	double dT=0;
+	double wf_integral=0;
+	bool wf_tail=true;
+	if ( ! firmware_finetime ) {
+	  dT = Calculate_Fractional_Time(vx725_vx730_pha_data.analog_probe1,
+					 hit.Ns,
+					 vx725_vx730_pha_data.dual_trace,
+					 user_data.modtype,
+					 &wf_integral,
+					 &wf_tail);
+	}
+	else {
+	  dT = 2.*vx725_vx730_pha_data.fine_time_stamp/65356.;
+	}
+
+	hit.timestamp = vx725_vx730_pha_data.trigger_time_tag;                       //31-bit time in clock ticks
+	hit.timestamp += 2147483648*vx725_vx730_pha_data.extended_time_stamp;        //16-bit extended time in clock ticks
+	hit.timestamp *= 2*Time_Ticks;                                               //timestamp now in time ticks (2 ns clock)
+	hit.timestamp += Time_From_ns(dT);                                           //Full timestamp in time ticks
+
+	//Time deviations and delays
+	hit.timestamp += entry.time_offset_ticks;
+
+	//Waveform diagnostics (no waveform integral ratio for PHA)
+	Sample_Waveform(hit.ID, Waveform_Good, vx725_vx730_pha_data.analog_probe1, hit.Ns, hit.Ifast, hit.Islow, wf_integral);
+
+#ifdef Histogram_Digital_Probes
+	//Fill probe histograms
+	if(hit.ID<256) {
+	  for(int kay=0;kay<hit.Ns;kay++) {
+	    //digital probes
+	    hDigital_Probe1_ID->Fill(kay,hit.ID,vx725_vx730_pha_data.digital_probe1[kay]);
+	    hDigital_Probe2_ID->Fill(kay,hit.ID,vx725_vx730_pha_data.digital_probe2[kay]);
+	  }
+	}
 #endif
-                    // CALCULATE THE LEADING EDGE using constant fraction "frac"
-                    int imin=0;
-                    double sigmin=1e9;
-                    double frac=0.04;
-                    double base=0;
-                    double secmom=0.;        
-                    int NNN=10;
-                    // int id=db_arr[EVTS].ID;
- 
-                    double dT = 0;
-                    
-                    //Beam monitor waveforms for caen2015 data are ostensibly useless
-                    if(db_arr[EVTS].ID <= 200) { 
-                      if(db_arr[EVTS].ID<162) frac=0.04;
-                      else frac=0.1;
-                      
-                      frac=0.2;
-                      
-                      for(int i=0;i<db_arr[EVTS].Ns;i++) {
-                        wf1[i]=evaggr->wavelets[evtnum][i]+8192;
-                        
-                        if(i<NNN) {
-                          base+=(1.*wf1[i]);
-                          secmom+=(1.*wf1[i]*1.*wf1[i]);
-                        }                  
-                        if((1.*wf1[i])<sigmin) {
-                          sigmin=1.*wf1[i];
-                          imin=i;
-                        }
-                      }
-                      
-                      double thr=(sigmin-base/(1.*NNN))*frac+base/(1.*NNN);
-                      int iLD=0;
-                      for(int i=imin;i>1;i--){
-                        if((1.*wf1[i])<thr && (1.*wf1[i-1])>thr){
-                          double dSig=(1.*wf1[i-1]-1.*wf1[i]);
-                          if(dSig!=0) dT=(1.*wf1[i-1]-thr)/dSig*2.+(i-1)*2.;  // this is in ns
-                          else dT=(i-1)*2.;
-                          iLD=i;
-                        }                
-                      }
-                    } //end loop over ID <= 200
-                    
-                    //Fill raw IDs
- 
+
 #ifdef Histogram_Waveforms
+	//Fill waveform histograms
+	if(hit.ID<162) {
+	  for(int kay=0; kay<hit.Ns; kay++) {
+	    hWaveform_ID->Fill(kay,vx725_vx730_pha_data.analog_probe1[kay],hit.ID);
+	  }
+	}
+
+	if(hit.ID == He3_ID) {
+	  for(int kay=0;kay<hit.Ns;kay++) {
+	    hWaveform_He3->Fill(kay,vx725_vx730_pha_data.analog_probe1[kay]);
+	  }
+	}
+	if(hit.ID == Bkg_ID) {
+	  for(int kay=0;kay<hit.Ns;kay++) {
+	    hWaveform_Bkg->Fill(kay,vx725_vx730_pha_data.analog_probe1[kay]);
+	  }
+	}
+	if(hit.ID == U235_ID) {
+	  for(int kay=0;kay<hit.Ns;kay++) {
+	    hWaveform_U235->Fill(kay,vx725_vx730_pha_data.analog_probe1[kay]);
+	  }
+	}
+	if(hit.ID == Li6_ID) {
+	  for(int kay=0;kay<hit.Ns;kay++) {
+	    hWaveform_Li6->Fill(kay,vx725_vx730_pha_data.analog_probe1[kay]);
+	  }
+	}
+	if(hit.ID == T0_ID) {
+	  for(int kay=0;kay<hit.Ns;kay++) {
+	    hWaveform_T0->Fill(kay,vx725_vx730_pha_data.analog_probe1[kay]);
+	  }
+	}
+#endif
+
+	Add_Board_Hit(board_bank, hit);
+      } //End of check on chagg words to read
+
+      pos = chagg_end;
+
+      //increment the chagg counter
+      chaggcounter++;
+
+    } //End of loop over channel aggregates
+
+    pos = board_end;
+  } //End of loop over board aggregates
 
-                    //Fill waveform histogram
-                    if(input_params.Read_Binary==0) {
-                      if(db_arr[EVTS].ID<162) {
-                        for(int i=0;i<db_arr[EVTS].Ns;i++) {
-                          hWaveform_ID->Fill(i,wf1[i],db_arr[EVTS].ID);
-                        }
-                      } 
-                     
-                      if(db_arr[EVTS].ID == He3_ID) {
-                        for(int i=0;i<db_arr[EVTS].Ns;i++) {
-                          hWaveform_He3->Fill(i,wf1[i]);
-                        }                          
-                      } 
-                      if(db_arr[EVTS].ID == Bkg_ID) {
-                        for(int i=0;i<db_arr[EVTS].Ns;i++) {
-                          hWaveform_Bkg->Fill(i,wf1[i]);
-                        } 
-                      }
-                      if(db_arr[EVTS].ID == U235_ID) {
-                        for(int i=0;i<db_arr[EVTS].Ns;i++) {
-                          hWaveform_U235->Fill(i,wf1[i]);
-                        }
-                      } 
-                      if(db_arr[EVTS].ID == Li6_ID) {
-                        for(int i=0;i<db_arr[EVTS].Ns;i++) {
-                          hWaveform_Li6->Fill(i,wf1[i]);
-                        } 
-                      }
-                      if(db_arr[EVTS].ID == T0_ID) {
-                        for(int i=0;i<db_arr[EVTS].Ns;i++) {
-                          hWaveform_T0->Fill(i,wf1[i]);
-                        } 
-                      }
-                    }
+  return 0;
+}
+
+//Board banks from firmware other than DPP-PSD and DPP-PHA are checked but give no entries
+static int Decode_Unknown_Board_Bank(Board_Bank_t *board_bank, Board_Decoder_t *decoder, Input_Parameters *input_params) {
+
+  uint32_t pos = 2;
+  uint32_t board_end = 0;
+  User_Data_t user_data;
+  int channels[8];
+  uint32_t nchannels = 0;
+
+  if(Start_Board_Bank(board_bank, &user_data)) {
+    return board_bank->status;
+  }
+
+  while(pos + 4 <= board_bank->nwords) {
+    if(Start_Board_Aggregate(board_bank, pos, &board_end, channels, &nchannels)) {
+      return board_bank->status;
+    }
+    pos = board_end;
+  }
+
+  return 0;
+}
+
+//The firmware of a board is fixed for the run so the decoder is picked once per bank from the firmware word
+Board_Bank_Decoder_t Select_Board_Bank_Decoder(uint32_t firmware_word) {
+
+  uint8_t fw_majrev = (firmware_word & MAJREV_MASK);
+
+  if(fw_majrev == 136) {
+    return &Decode_PSD_Board_Bank;
+  }
+  else if(fw_majrev == 139) {
+    return &Decode_PHA_Board_Bank;
+  }
+  return &Decode_Unknown_Board_Bank;
+}
+
+//Hit decoding of an x27xx board bank from DPP-PSD firmware (firmware word, user extra word, 64-bit aggregates).
+//The 64 channels are four boards of 16 in the channel table and DANCE map (board 4*boardid + channel/16)
+int Decode_X27xx_PSD_Board_Bank(Board_Bank_t *board_bank, Board_Decoder_t *decoder, Input_Parameters *input_params) {
+
+  const uint32_t *words = &board_bank->words[0];
+  uint32_t nwords = board_bank->nwords;
+  uint32_t pos = 2;
+
+  X27xx_PSD_Data_t &x27xx_psd_data = decoder->x27xx_psd_data;
+  X27xx_Aggregate_Data_t x27xx_aggregate_data;
+  User_Data_t user_data;
+
+  bool firmware_finetime = input_params->Use_Firmware_FineTime;
+
+  if(Start_Board_Bank(board_bank, &user_data)) {
+    return board_bank->status;
+  }
+  //The model only picks the 8 ns sample period of the waveform timing, which is the same for the V2740, VX2740 and V2745
+  user_data.modtype = 2740;
+
+  //Channels of this board that are unpacked
+  uint8_t first_board = X27xx_Table_Boards*user_data.boardid;
+  board_bank->boardid = first_board;
+  uint64_t accept_mask = 0;
+  for(int eye=0; eye<X27xx_Table_Boards; eye++) {
+    accept_mask |= (uint64_t)channel_table.accept_mask[first_board + eye] << (Table_Channels*eye);
+  }
+
+  //Aggregates are whole 64-bit words
+  while(pos + 2 <= nwords) {
 
+    unpack_x27xx_aggregate_header(&words[pos], &x27xx_aggregate_data);
+
+#ifdef Unpacker_Verbose
+    cout<<"format: "<<(int)x27xx_aggregate_data.format<<"  ";
+    cout<<"board fail: "<<(int)x27xx_aggregate_data.board_fail<<"  ";
+    cout<<"aggcounter: "<<x27xx_aggregate_data.aggcounter<<"  ";
+    cout<<"aggsize: "<<x27xx_aggregate_data.aggsize<<endl;
 #endif
- 
-                    db_arr[EVTS].timestamp *= 2.0;                                                        //timestamp now in ns                 
-                    db_arr[EVTS].timestamp += dT;                                                         //Full timestamp in ns
- 
-                  
-                    if(input_params.Analysis_Stage > 0) {
-                      //need to add the time deviations before time sorting
-                      if(db_arr[EVTS].ID < 200) {
-                        db_arr[EVTS].timestamp += TimeDeviations[db_arr[EVTS].ID];
-                      }
-                      
-                      //Add the DANCE delay
-                      if(db_arr[EVTS].ID < 162) {
-                        db_arr[EVTS].timestamp += DANCE_Delay;
-                      }
-            
-                      //Add the He3 delay
-                      if(db_arr[EVTS].ID == He3_ID) {
-                        db_arr[EVTS].timestamp += He3_Delay;
-                      } 
-                      
-                      //Add the U235 delay
-                      if(db_arr[EVTS].ID == U235_ID) {
-                        db_arr[EVTS].timestamp += U235_Delay;
-                      } 
-                      
-                      //Add the Li6 delay
-                      if(db_arr[EVTS].ID == Li6_ID) {
-                        db_arr[EVTS].timestamp += Li6_Delay;
-                      }
-                    }
- 
-                    db_arr[EVTS].TOF = db_arr[EVTS].timestamp;                                            //Start with TOF as Full timestamp in ns + time dev
- 
-                    
-                    //keep track of the smallest timestamp
-                    if(db_arr[EVTS].TOF<analysis_params->smallest_timestamp) {
-                      analysis_params->smallest_timestamp=db_arr[EVTS].TOF;
-                    }    
-                    //keep track of the largest timestamp
-                    if(db_arr[EVTS].TOF>analysis_params->largest_timestamp) {
-                      analysis_params->largest_timestamp=db_arr[EVTS].TOF;
-                    }  
-                    
-                    EVTS++;
-            
-                    analysis_params->entries_unpacked++;
-                    analysis_params->entries_awaiting_timesort++;
- 
-                    
-#ifdef Unpacker_Verbose 
-                    cout<<EVTS<<"  "<<analysis_params->entries_unpacked<<endl;
-#endif
-                  }         //End of loop on eventnum                            
-                }  //End of if on CEVT bank
-                break;
-              } //End of loop on EventBankSize
-           
-            } //End of event type 1
-            
- 
-            
-            //Scalers
-            else if(head.fEventId==2) {
-                
-              TotalBankSize  = head.fDataSize;
- 
-#ifdef Scaler_Verbose
-              cout << dec <<"TotalBankSize (bytes): " << TotalBankSize << endl;
-#endif
-              gzread(gz_in,&bhead,sizeof(BankHeader_t));
-              TotalBankSize -= sizeof( BankHeader_t );
-              
-#ifdef Scaler_Verbose
-              cout << "Bank_HEADER " << endl;
-              cout << dec <<"TotalBankSize (bytes): " << bhead.fDataSize << endl;
-              cout << dec << bhead.fFlags << endl;
-#endif
-              while (TotalBankSize > 0) {
- 
-                //MLTM
-                gzread( gz_in, &bank32, sizeof( Bank32_t ) );
-                TotalBankSize -= sizeof( Bank32_t );
- 
-#ifdef Scaler_Verbose
-                cout << "BANK " << endl;
-                cout << bank32.fName[0] << bank32.fName[1] << bank32.fName[2]<< bank32.fName[3] << endl;
-                cout << dec << bank32.fType << endl;
-                cout << "Size: "<<dec << bank32.fDataSize << endl;
-#endif
-                //see if data is on an 8-byte boundary
-                bool readextra = false;
-                if(bank32.fDataSize%8 !=0) {
-                  readextra = true; 
-                }
-                
-                if (bank32.fName[0]=='M' && bank32.fName[1]=='L' && bank32.fName[2]== 'T' && bank32.fName[3]=='M') {
-                  
-                  uint32_t time_seconds;
-                  gzret=gzread(gz_in,&time_seconds,sizeof(time_seconds));
-                  TotalBankSize-=sizeof(time_seconds);
- 
-#ifdef Scaler_Verbose
-                  cout << time_seconds<<"\n";
-#endif
-                }
-                if (bank32.fName[0]=='S' && bank32.fName[1]=='C' && bank32.fName[2]== 'L' && bank32.fName[3]=='R') {
- 
-                  gzret=gzread(gz_in,&sclr_totals,sizeof(sclr_totals));
-                  TotalBankSize-=sizeof(sclr_totals);
-          
-                  for(int kay=0; kay<N_SCLR; kay++) {
-                    hScalers->SetBinContent(kay+1,sclr_totals.totals[kay]);
-#ifdef Scaler_Verbose
-                    cout<<kay<<"  "<<sclr_totals.totals[kay]<<endl;
-#endif
-                  }
-                }
-                
-                if (bank32.fName[0]=='R' && bank32.fName[1]=='A' && bank32.fName[2]== 'T' && bank32.fName[3]=='E') {
-                 
-                  gzret=gzread(gz_in,&sclr_rates,sizeof(sclr_rates));
-                  TotalBankSize-=sizeof(sclr_rates);
- 
-#ifdef Scaler_Verbose
-                  for(int kay=0; kay<N_SCLR; kay++) {
-                    cout<<kay<<"  "<<sclr_rates.rates[kay]<<endl;
-                  }
-#endif
-                }
-                
-                if(readextra) {
-                  uint32_t extra = 0;
-                  gzret=gzread(gz_in,&extra,sizeof(extra));
-                  TotalBankSize -= sizeof(extra);
-                }        
-                
-#ifdef Scaler_Verbose
-                cout << dec <<"TotalBankSize (bytes): " << TotalBankSize << endl;
-#endif
- 
-              } //End of while(TotalBankSize > 0)
-            
-            } //end of scalers
- 
-            else if(head.fEventId==0x8000 || head.fEventId==0x8001 || head.fEventId==0x8002 ){
- 
-              //End of Run
-              if(head.fEventId==0x8001)  {
-                run=false;
-                break;
-              }
-          
-              char *fData;
-              fData=(char*)malloc(head.fDataSize);
-              gzret=gzread(gz_in,fData,head.fDataSize);        
-              free (fData);        
-            }
-            
-            else { // other crap
-              char *fData;
-              fData=(char*)malloc(head.fDataSize);
-              gzret=gzread(gz_in,fData,head.fDataSize);
-              free (fData);
-            } //end of crap
-          }  //checking to see if gzret > 0
-          /*else {
-            gz_queue.pop();
-          }*/
-        } //end of caen2015
- 
-        else if(strcmp(input_params.DataFormat.c_str(),"caen2018") == 0) {
- 
-          //variables
-          bool readextra = false;
-          
-          //counters
-          uint32_t dataword =0;
-          uint32_t BytesRead =0;
-          uint32_t wordstoread = 0;
-          uint32_t chaggcounter = 0;
-          uint32_t chaggwordstoread = 0;
- 
-          //Start reading the file
-          gzret=gzread(gz_in,&head,sizeof(EventHeader_t));
-          
-          if(gzret!=0) {
-            
-            TotalDataSize=head.fDataSize;
-            
-            BYTES_READ += head.fDataSize;
-            TOTAL_BYTES += head.fDataSize;
-            
+
+    if(x27xx_aggregate_data.format != 2) {
+      return Board_Bank_Error(board_bank, -1, pos);
+    }
+
+    //Make sure the aggregate fits in the bank (sizes are in 64-bit words)
+    uint64_t aggregate_end = pos + 2*(uint64_t)x27xx_aggregate_data.aggsize;
+    if(x27xx_aggregate_data.aggsize < 1 || aggregate_end > nwords) {
+      return Board_Bank_Error(board_bank, -2, pos);
+    }
+    pos += 2;
+
+    while(pos < aggregate_end) {
+
+      int event_size = unpack_x27xx_psd_event(&words[pos], (aggregate_end - pos)/2, &x27xx_psd_data);
+      if(event_size < 0 || x27xx_psd_data.channel >= Bank_Channels) {
+	return Board_Bank_Error(board_bank, -2, pos);
+      }
+      pos += 2*event_size;
+
+      //Skip channels that are not accepted before the waveform is touched
+      uint32_t channel = x27xx_psd_data.channel;
+      if(!((accept_mask >> channel) & 0x1)) {
+	board_bank->rejected[channel]++;
+	continue;
+      }
+
+      DEVT_BANK hit;
+      memset(&hit, 0, sizeof(DEVT_BANK));
+
+      //Set the remaining analysis variables
+      hit.Valid = 1;                                                             //Everything starts valid
+      hit.board = first_board + channel/Table_Channels;                          //Channel table board
+      hit.channel = channel%Table_Channels;                                      //Channel table channel
+      hit.Ifast = x27xx_psd_data.energy_short;                                   //Fast Integral
+      hit.Islow = x27xx_psd_data.energy_long - x27xx_psd_data.energy_short;      //Slow Integral (minus the fast)
+      hit.InvalidReason = 0;
+
+      //Map it
+      const Channel_Entry_t &entry = channel_table.channel[hit.board][hit.channel];
+      hit.ID = entry.ID;
+
+      //The waveform is only unpacked when something uses it
+      hit.Ns = 2*x27xx_psd_data.waveform_words;
+      bool waveform_timing = x27xx_psd_data.waveform_enabled && (!firmware_finetime || hit.ID >= 162);
+      if(waveform_timing || (x27xx_psd_data.waveform_enabled && waveform_reservoir_size > 0)) {
+	unpack_x27xx_psd_probes(&x27xx_psd_data);
+      }
+
+      double dT=0;
+      double wf_integral=0;
+      bool wf_tail=true;
+
+      //If the detector is not a DANCE crystal or the use fine time is off
+      if(waveform_timing) {
+	dT = Calculate_Fractional_Time(x27xx_psd_data.analog_probe1,
+				       hit.Ns,
+				       0,
+				       user_data.modtype,
+				       &wf_integral,
+				       &wf_tail);
+      }
+      else {
+	dT = X27xx_Tick*x27xx_psd_data.fine_time_stamp/1024.;
+      }
+
+      //Set the timestamps
+      hit.timestamp = x27xx_psd_data.timestamp;                                  //48-bit time in clock ticks
+      hit.timestamp *= (int64_t)(X27xx_Tick*Time_Ticks);                         //timestamp now in time ticks
+      hit.timestamp += Time_From_ns(dT);                                         //Full timestamp in time ticks
+      hit.wfintegral = wf_integral;
+
+      //No pileup check on a waveform that ends before its tail
+      if(waveform_timing && wf_tail && (wf_integral/(1.0*hit.Islow) < wf_ratio_low || wf_integral/(1.0*hit.Islow) > wf_ratio_high)) {
+	hit.pileup_detected=1;
+      }
+      else {
+	hit.pileup_detected=0;
+      }
+
+      //Waveform diagnostics
+      if(x27xx_psd_data.waveform_enabled) {
+	Sample_Waveform(hit.ID,
+			wf_integral < 0 ? Waveform_Negative : (hit.pileup_detected ? Waveform_Pileup : Waveform_Good),
+			x27xx_psd_data.analog_probe1, hit.Ns, hit.Ifast, hit.Islow, wf_integral);
+      }
+
+      //Time deviations and delays
+      hit.timestamp += entry.time_offset_ticks;
+
+      Add_Board_Hit(board_bank, hit);
+    } //End of loop over the events of the aggregate
+
+    pos = aggregate_end;
+  } //End of loop over aggregates
+
+  return 0;
+}
+
+//The x27xx banks have the firmware word of the caen2018 banks, and only DPP-PSD is decoded
+Board_Bank_Decoder_t Select_X27xx_Board_Bank_Decoder(uint32_t firmware_word) {
+
+  uint8_t fw_majrev = (firmware_word & MAJREV_MASK);
+
+  if(fw_majrev == 136) {
+    return &Decode_X27xx_PSD_Board_Bank;
+  }
+  return &Decode_Unknown_Board_Bank;
+}
+
+int Decode_Board_Bank(Board_Bank_t *board_bank, Board_Decoder_t *decoder, Input_Parameters *input_params) {
+
+  if(board_bank->nwords < 1) {
+    board_bank->hits.clear();
+    board_bank->boardid = 0;
+    memset(board_bank->rejected, 0, sizeof(board_bank->rejected));
+    return Board_Bank_Error(board_bank, -2, 0);
+  }
+  return Select_Board_Bank_Decoder(board_bank->words[0])(board_bank, decoder, input_params);
+}
+
+//Events with nothing to unpack (begin of run, ASCII messages, unknown IDs)
+static void Skip_MIDAS_Event(gzFile gz_in, EventHeader_t *head) {
+  gzseek(gz_in,head->fDataSize,SEEK_CUR);
+}
+
+Data_Decoder::Data_Decoder(Input_Parameters *input_params) {
+  this->input_params = input_params;
+  bytes_read = 0;
+}
+
+
+//****************** MIDAS ******************//
+
+MIDAS_Decoder::MIDAS_Decoder(Input_Parameters *input_params) : Data_Decoder(input_params) {
+  resync_pending = false;
+  have_serial = false;
+  last_serial = 0;
+  last_time = 0;
+  in_corrupt_range = false;
+  corrupt_begin = 0;
+  corrupt_begin_time = 0;
+  range_bytes = 0;
+  range_events = 0;
+}
+
+//Checks that an event header is one the unpackers know.  Data events also have to agree with their bank header
+bool MIDAS_Decoder::Valid_Event_Header(const EventHeader_t &head, const BankHeader_t &bhead) {
+
+  if(head.fDataSize > Max_MIDAS_Event_Size) {
+    return false;
+  }
+
+  switch(head.fEventId) {
+  case 1:
+    //32-bit banks (0x10) with a bank header version (0x1)
+    return (bhead.fFlags & 0x11) == 0x11 && bhead.fFlags < 0x40 && (uint64_t)bhead.fDataSize + sizeof(BankHeader_t) == head.fDataSize;
+  case 2:
+  case 8:
+  case 0x8000:
+  case 0x8001:
+  case 0x8002:
+    return true;
+  default:
+    return false;
+  }
+}
+
+int MIDAS_Decoder::Read_Event_Header(gzFile gz_in, EventHeader_t *head, BankHeader_t *bhead, Analysis_Parameters *analysis_params) {
+
+  //Header found while recovering from corrupted data
+  if(resync_pending) {
+    *head = resync_head;
+    *bhead = resync_bhead;
+    resync_pending = false;
+  }
+  else {
+    int gzret = gzread(gz_in, head, sizeof(EventHeader_t));
+
+    //Nothing left in this file
+    if(gzret <= 0) {
+      End_Corrupt_Range(-1, analysis_params);
+      return 0;
+    }
+    if(gzret < (int)sizeof(EventHeader_t)) {
+      return Truncated_Event(gz_in, gzret, analysis_params);
+    }
+
+    int nheader = sizeof(EventHeader_t);
+    if(head->fEventId == 1) {
+      gzret = gzread(gz_in, bhead, sizeof(BankHeader_t));
+      if(gzret < (int)sizeof(BankHeader_t)) {
+        return Truncated_Event(gz_in, nheader + (gzret > 0 ? gzret : 0), analysis_params);
+      }
+      nheader += sizeof(BankHeader_t);
+    }
+
+    if(input_params->Recover_Corrupt_Data && !Valid_Event_Header(*head, *bhead)) {
+
+      //Look for the next header starting inside the bad one
+      unsigned char seed[sizeof(EventHeader_t) + sizeof(BankHeader_t)];
+      memcpy(seed, head, sizeof(EventHeader_t));
+      memcpy(seed + sizeof(EventHeader_t), bhead, sizeof(BankHeader_t));
+
+      Skip_Corrupt_Data(gz_in, "Bad MIDAS event header", 0, 0, 0, analysis_params);
+      if(Resync(gz_in, seed, nheader, head, bhead, analysis_params) == 0) {
+        return 0;
+      }
+    }
+  }
+
+  bytes_read += head->fDataSize;
+
+  if(head->fEventId == 1) {
+    have_serial = true;
+    last_serial = head->fSerialNumber;
+    last_time = head->fTimeStamp;
+  }
+
+  return 1;
+}
+
+//Scans forward one byte at a time to the next data event header.  The first nseed bytes come from
+//the bad header.  Returns 1 with the header in head and bhead, or 0 if the file ends first
+int MIDAS_Decoder::Resync(gzFile gz_in, const unsigned char *seed, int nseed, EventHeader_t *head, BankHeader_t *bhead, Analysis_Parameters *analysis_params) {
+
+  const int window_size = sizeof(EventHeader_t) + sizeof(BankHeader_t);
+  unsigned char window[window_size];
+  int nwindow = 0;
+  uint64_t nscanned = (nseed > 0) ? 1 : 0;
+  int next = 1;   //The bad header itself does not start at seed[0]
+
+  while(true) {
+
+    int c;
+    if(next < nseed) {
+      c = seed[next++];
+    }
+    else {
+      c = gzgetc(gz_in);
+      if(c == -1) {
+        break;
+      }
+    }
+    nscanned++;
+
+    if(nwindow < window_size) {
+      window[nwindow++] = c;
+    }
+    else {
+      memmove(window, window + 1, window_size - 1);
+      window[window_size - 1] = c;
+    }
+
+    //Data events (fEventId 1) with a serial number after the last good one
+    if(nwindow == window_size && window[0] == 1 && window[1] == 0) {
+      memcpy(head, window, sizeof(EventHeader_t));
+      memcpy(bhead, window + sizeof(EventHeader_t), sizeof(BankHeader_t));
+      if(Valid_Event_Header(*head, *bhead) && (!have_serial || head->fSerialNumber > last_serial)) {
+        nscanned -= window_size;
+        range_bytes += nscanned;
+        analysis_params->corrupt_bytes_skipped += nscanned;
+
+        umsg.str("");
+        umsg<<"Found MIDAS event "<<head->fSerialNumber<<" after skipping "<<nscanned<<" Bytes";
+        DANCE_Info("Unpacker",umsg.str());
+        return 1;
+      }
+    }
+  }
+
+  //The partial window is skipped too
+  range_bytes += nscanned;
+  analysis_params->corrupt_bytes_skipped += nscanned;
+
+  umsg.str("");
+  umsg<<"Subrun "<<input_params->SubRunNumber<<" ended while looking for the next MIDAS event after skipping "<<nscanned<<" Bytes";
+  DANCE_Error("Unpacker",umsg.str());
+
+  End_Corrupt_Range(-1, analysis_params);
+  return 0;
+}
+
+void MIDAS_Decoder::Skip_Corrupt_Data(gzFile gz_in, const char *reason, uint64_t nbytes, uint32_t nevents, uint32_t nbanks, Analysis_Parameters *analysis_params) {
+
+  if(!in_corrupt_range) {
+    in_corrupt_range = true;
+    corrupt_begin = analysis_params->largest_timestamp;
+    corrupt_begin_time = last_time;
+    range_bytes = 0;
+    range_events = 0;
+    analysis_params->corrupt_ranges++;
+  }
+
+  range_bytes += nbytes;
+  range_events += nevents;
+  analysis_params->corrupt_bytes_skipped += nbytes;
+  analysis_params->corrupt_events_skipped += nevents;
+  analysis_params->corrupt_banks_skipped += nbanks;
+
+  umsg.str("");
+  umsg<<reason<<" in Subrun "<<input_params->SubRunNumber<<" at Byte "<<gztell(gz_in)<<" (after MIDAS event "<<last_serial<<")";
+  DANCE_Error("Unpacker",umsg.str());
+}
+
+int MIDAS_Decoder::Corrupt_Event(gzFile gz_in, const char *reason, uint64_t nbytes, Analysis_Parameters *analysis_params) {
+
+  if(!input_params->Recover_Corrupt_Data) {
+    cout<<RED<<"Unpacker [ERROR] "<<reason<<endl;
+    cout<<"Unpacker [ERROR] Data beyond this point would be corrupt and thus I am exiting to analysis!  Set Recover_Corrupt_Data to skip it"<<RESET<<endl;
+    return -1;
+  }
+
+  //The event is dropped.  Its header is not scanned again
+  Skip_Corrupt_Data(gz_in, reason, nbytes, 1, 0, analysis_params);
+
+  int ret = Resync(gz_in, NULL, 0, &resync_head, &resync_bhead, analysis_params);
+  resync_pending = (ret == 1);
+  return ret;
+}
+
+int MIDAS_Decoder::Truncated_Event(gzFile gz_in, uint64_t nbytes, Analysis_Parameters *analysis_params) {
+
+  Skip_Corrupt_Data(gz_in, "Subrun ends in the middle of a MIDAS event", nbytes, 1, 0, analysis_params);
+  End_Corrupt_Range(-1, analysis_params);
+  return 0;
+}
+
+//The range also goes to the diagnostics file as a Corrupt_Range record
+void MIDAS_Decoder::End_Corrupt_Range(int64_t first_timestamp, Analysis_Parameters *analysis_params) {
+
+  if(!in_corrupt_range) {
+    return;
+  }
+  in_corrupt_range = false;
+
+  umsg.str("");
+  umsg<<"Lost data in Subrun "<<input_params->SubRunNumber<<" from "<<Time_To_ns(corrupt_begin)*1.0e-9<<" s to ";
+  if(first_timestamp < 0) {
+    umsg<<"the end of the subrun";
+  }
+  else {
+    umsg<<Time_To_ns(first_timestamp)*1.0e-9<<" s";
+  }
+  umsg<<" ("<<range_bytes<<" Bytes and "<<range_events<<" MIDAS Events skipped)";
+  DANCE_Info("Unpacker",umsg.str());
+
+  Post_Corrupt_Range(input_params->SubRunNumber, Time_To_ns(corrupt_begin), first_timestamp < 0 ? -1 : Time_To_ns(first_timestamp), corrupt_begin_time, last_time, range_bytes, range_events);
+}
+
+//Scaler and diagnostics events are read whole and handed to the diagnostics consumer
+int MIDAS_Decoder::Post_Side_Event(gzFile gz_in, EventHeader_t *head, Analysis_Parameters *analysis_params) {
+
+  if(head->fDataSize > Max_MIDAS_Event_Size) {
+    return Corrupt_Event(gz_in, "MIDAS event larger than Max_MIDAS_Event_Size", sizeof(EventHeader_t), analysis_params);
+  }
+
+  vector<char> payload(head->fDataSize);
+  int gzret = gzread(gz_in, payload.data(), head->fDataSize);
+  if(gzret < (int)head->fDataSize) {
+    return Truncated_Event(gz_in, sizeof(EventHeader_t) + (gzret > 0 ? gzret : 0), analysis_params);
+  }
+  Post_Diagnostics_Event(head->fEventId, head->fTimeStamp, input_params->SubRunNumber, payload);
+  return 1;
+}
+
+
+//****************** caen2015 ******************//
+
+CAEN2015_Decoder::CAEN2015_Decoder(Input_Parameters *input_params) : MIDAS_Decoder(input_params) {
+  devt_padding = 0;
+  imported_peaks = new short[256][16384];
+  evinfo = new CEVT_BANK();
+  evaggr = new test_struct_cevt();
+}
+
+CAEN2015_Decoder::~CAEN2015_Decoder() {
+  delete [] imported_peaks;
+  delete evinfo;
+  delete evaggr;
+}
+
+int CAEN2015_Decoder::Read_Record(gzFile gz_in, DEVT_BANK *db_arr, uint32_t &EVTS, Analysis_Parameters *analysis_params) {
+
+  EventHeader_t head;           //MIDAS event header
+  BankHeader_t bhead;           //MIDAS bank header
+  Bank32_t bank32;              //MIDAS 32-bit bank
+  uint32_t TotalBankSize=0;     // bhead.fDataSize;
+  uint32_t EventBankSize=0;     // bank32fDataSize;
+  int gzret=0;
+
+  //Read in the event header
+  if(Read_Event_Header(gz_in, &head, &bhead, analysis_params) == 0) {
+    return 0;
+  }
+
 #ifdef Unpacker_Verbose
-            cout<<"Type: "<<head.fEventId<<"  TotalDataSize  "<<TotalDataSize<<endl;
+  cout<<"Type: "<<head.fEventId<<endl;
+  cout<<"Size: "<<head.fDataSize<<endl;     ///< event size in bytes
+  cout<<"TimeStamp "<<head.fTimeStamp<<endl;    ///< event timestamp in nseconds
 #endif
-           hEventID->Fill(head.fEventId);                          
-            //Data
-            if(head.fEventId==1){
-              
-              TotalBankSize=0;
-              EventBankSize=0;
-              
-              gzret=gzread(gz_in,&bhead,sizeof(BankHeader_t));
+  hEventID->Fill(head.fEventId);
+
+  //Scalers
+  if(head.fEventId==2) {
+    return Post_Side_Event(gz_in, &head, analysis_params);
+  }
+
+  //End of Run
+  if(head.fEventId==0x8001) {
+    return 0;
+  }
+
+  //Begin of run, messages and other crap
+  if(head.fEventId!=1) {
+    Skip_MIDAS_Event(gz_in, &head);
+    return 1;
+  }
+
+  //Data (the bank header is read with the event header)
 #ifdef Unpacker_Verbose
-              cout<<"Event Data"<<endl;
-              cout << "Bank_HEADER " << endl;
-              cout <<"TotalBankSize (bytes): " << bhead.fDataSize << endl;
-              cout << bhead.fFlags << endl;
+  cout << "Bank_HEADER " << endl;
+  cout << dec <<"TotalBankSize (bytes): " << bhead.fDataSize << endl;
+  cout << dec << bhead.fFlags << endl;
 #endif
-              
-              TotalBankSize = bhead.fDataSize;
-              
-              while(TotalBankSize>0) {
-                
-                gzret=gzread(gz_in,&bank32,sizeof(Bank32_t));
-                TotalBankSize -= sizeof(Bank32_t);
-                
+
+  TotalBankSize = bhead.fDataSize;
+
+  while(TotalBankSize>0) {
+    if(TotalBankSize < sizeof(Bank32_t)) {
+      return Corrupt_Event(gz_in, "MIDAS bank header does not fit in the event", bhead.fDataSize - TotalBankSize, analysis_params);
+    }
+    gzret=gzread(gz_in,&bank32,sizeof(Bank32_t));
+    if(gzret < (int)sizeof(Bank32_t)) {
+      return Truncated_Event(gz_in, bhead.fDataSize - TotalBankSize + (gzret > 0 ? gzret : 0), analysis_params);
+    }
+    TotalBankSize-=sizeof(Bank32_t);
 #ifdef Unpacker_Verbose
-                cout<<"TotalBankSize after Bank Header Read "<<TotalBankSize<<endl;    
-                cout << "BANK  " << bank32.fName[0] << bank32.fName[1] << bank32.fName[2]<< bank32.fName[3] << endl;
-                cout << dec << bank32.fType << endl;
-                cout << dec << bank32.fDataSize << endl;
+    cout << "BANK " << endl;
+    cout << bank32.fName[0] << bank32.fName[1] << bank32.fName[2]<< bank32.fName[3] << endl;
+    cout << dec << bank32.fType << endl;
+    cout << dec << bank32.fDataSize << endl;
 #endif
-          
-                EventBankSize = bank32.fDataSize;
-                
-                //the data lie on 8 byte boundaries so there will be an extra 4 bytes at the end of the data that is "unaccounted" for in the header
-                readextra = false;
-                if(EventBankSize%8 !=0) {
-                  readextra = true; 
-                }
-                
-                //Read the firmware version and board ID
-                gzret=gzread(gz_in,&dataword,sizeof(dataword));
-                TotalBankSize -= sizeof(dataword);
-                EventBankSize -=  sizeof(dataword);
-                user_data.fw_majrev = (dataword & MAJREV_MASK);
-                user_data.fw_minrev = (dataword & MINREV_MASK) >> 8;
-                user_data.modtype = (dataword & MODTYPE_MASK) >> 14;
-                user_data.modtype = 730;
-                user_data.boardid = (dataword & BOARDID_MASK) >> 26;
-                              
-                //Read the user extras word
-                gzret=gzread(gz_in,&dataword,sizeof(dataword));
-                TotalBankSize -= sizeof(dataword);
-                EventBankSize -=  sizeof(dataword);
- 
-                user_data.user_extra = dataword;
-                
+    EventBankSize = bank32.fDataSize;
+    if (bank32.fName[0]=='C' && bank32.fName[1]=='E') {        // name starts as CE VT_BANK
+
+      evaggr->N = 0; // reset how many events we've processed this event
+
+      if(bank32.fDataSize > TotalBankSize) {
+        return Corrupt_Event(gz_in, "MIDAS bank size does not fit in the event", bhead.fDataSize - TotalBankSize, analysis_params);
+      }
+
+      int number_cevt_events = bank32.fDataSize/sizeof(CEVT_BANK);
+      if(number_cevt_events > MaxHitsPerT0 || EVTS + number_cevt_events > (uint32_t)input_params->DEVT_Array_Size) {
+        DANCE_Error("Unpacker","CEVT bank does not fit in the DEVT array. Increase DEVT_Array_Size in the cfg file");
+        return -1;
+      }
+
+      for (int eye = 0; eye < number_cevt_events; ++eye) {
+        gzret=gzread(gz_in,evinfo,sizeof(CEVT_BANK));
+        gzseek(gz_in,devt_padding,SEEK_CUR);
+
 #ifdef Unpacker_Verbose
-                cout<< "board: "<< (int)user_data.boardid <<" is a "<< (int)user_data.modtype <<" with Firmware: "<<(int)user_data.fw_majrev<< "."<<(int)user_data.fw_minrev<<"  "<<user_data.user_extra<<endl;
+        cout<<"cevt event number: "<<eye<<endl;
+        cout<<"position: "<<evinfo->position<<endl;
+        cout<<"extras: "<<evinfo->extras<<endl;
+        cout<<"width: "<<evinfo->width<<endl;
+        cout<<"detector_id: "<<evinfo->detector_id<<endl;
+        cout<<evinfo->integral[0]<<"  "<<evinfo->integral[1]<<endl;
+        cout<<"padding: "<<devt_padding<<endl<<endl;;
 #endif
-                
-                while(EventBankSize>0) {
-                  
-                  BytesRead =0;
-                  
-                  //Make sure its a Vx725 or Vx730 
-                  if(user_data.modtype == 725 || user_data.modtype == 730) {
- 
-                    //Read in the Vx725_Vx730 header
-                    gzret=gzread(gz_in,&v1730_header,sizeof(v1730_header));
-                    BytesRead += gzret;
- 
-                    //Unpack the header information
-                    func_ret = unpack_vx725_vx730_board_data(&v1730_header, &vx725_vx730_board_data);
-                    
+        TotalBankSize-=sizeof(CEVT_BANK)+devt_padding;
+        EventBankSize-=sizeof(CEVT_BANK)+devt_padding;
+
+        evaggr->P[evaggr->N] = *evinfo;
+        evaggr->N++;
+
 #ifdef Unpacker_Verbose
-                    cout<<"header: "<<(int)vx725_vx730_board_data.header<<"  ";
-                    cout<<"nwords: "<<vx725_vx730_board_data.boardaggsize<<"  ";
-                    cout<<"boardid: "<<(int)vx725_vx730_board_data.boardid<<"  ";
-                    cout<<"pattern: "<<vx725_vx730_board_data.pattern<<"  ";
-                    cout<<"channelmask: "<<(int)vx725_vx730_board_data.channelmask<<"  ";
-                    cout<<"boardaggcounter: "<<vx725_vx730_board_data.boardaggcounter<<"  ";
-                    cout<<"boardaggtime: "<<vx725_vx730_board_data.boardaggtime<<endl;
+        cout << "evaggr->N: " << evaggr->N << endl;
 #endif
- 
-                    //Make sure the board header ID is 10 before proceeding
-                    if(vx725_vx730_board_data.header != 10) {
-                      cout<<RED<<"Unpacker [ERROR] CAEN Data Header is NOT 10!"<<endl;
-                      cout<<"Entries: "<<EVTS<<" Total Entries: "<<analysis_params->entries_unpacked<<endl;
-                      cout<<"Unpacker [ERROR] Data beyond this point would be corrupt and thus I am exiting to analysis!"<<RESET<<endl;
-                      run = false;
-                      return -1;
-                      break;
-                    }
-                    
-                    //interpret the channel mask 
-                    channels.clear();
-                    for(int m=0; m<8; m++) {
+      }
+
+      // snag the trig bank
+      gzret=gzread(gz_in,&bank32,sizeof(Bank32_t));
+      TotalBankSize-=sizeof(Bank32_t);
+      EventBankSize = bank32.fDataSize;
+
+      gzseek(gz_in,bank32.fDataSize,SEEK_CUR);
+      TotalBankSize -= EventBankSize;
+
 #ifdef Unpacker_Verbose
-                      cout<<m<<"  "<<(( vx725_vx730_board_data.channelmask >> m) & 0x1)<<endl;
+      cout<<"Before trig bank"<<endl;
 #endif
-                      if((( vx725_vx730_board_data.channelmask >> m) & 0x1)) {
-                        channels.push_back(2*m);
-                      }
-                    }
-                    
-                    //Number of words left in the CAEN data 
-                    wordstoread = vx725_vx730_board_data.boardaggsize-4;
-                    
-                    //Number of channel aggregates unpacked
-                    chaggcounter = 0;
-                    
-                    while (wordstoread>0) {
- 
-                      //Read the Vx725_Vx730 channel aggregate header
-                      gzret=gzread(gz_in,&v1730_chagg_header,sizeof(v1730_chagg_header));
-                      BytesRead += gzret;
-                      wordstoread -= 2;            
-                      
-                      
-                      //************  PSD ************//
-                      if(user_data.fw_majrev == 136) {
-                        
-                        func_ret = unpack_vx725_vx730_psd_chagg_header(&v1730_chagg_header, &vx725_vx730_psd_data);
-                        
+
+      // begin funny place between peaks and cpu
+      while (true) {
+        // the peaks bank should be here
+        gzret=gzread(gz_in,&bank32,sizeof(Bank32_t));
+        if(gzret<=0) {
+          return 0;
+        }
+        TotalBankSize-=sizeof(Bank32_t);
+        EventBankSize = bank32.fDataSize;
+
 #ifdef Unpacker_Verbose
-                        cout<<"PSD   DT: "<<(int)vx725_vx730_psd_data.dual_trace<<"  ";
-                        cout<<"EQ: "<<(int)vx725_vx730_psd_data.charge_enabled<<"  ";
-                        cout<<"ET: "<<(int)vx725_vx730_psd_data.time_enabled<<"  ";
-                        cout<<"EE: "<<(int)vx725_vx730_psd_data.extras_enabled<<"  ";
-                        cout<<"ES: "<<(int)vx725_vx730_psd_data.waveform_enabled<<"  ";
-                        cout<<"EX Opt: "<<(int)vx725_vx730_psd_data.extras_option<<"  ";
-                        cout<<"AP: "<<(int)vx725_vx730_psd_data.ap<<"  ";
-                        cout<<"DP1: "<<(int)vx725_vx730_psd_data.dp1<<"  ";
-                        cout<<"DP2: "<<(int)vx725_vx730_psd_data.dp2<<"  ";
-                        cout<<"NSDB8: "<<vx725_vx730_psd_data.nsdb8<<endl;
+        cout<<"Peak bank"<<endl;
+        cout<<"Name: "<<bank32.fName[0]<<"  Total Bank Size: "<<TotalBankSize<<"  EventBankSize: "<<EventBankSize<<endl;
 #endif
-                        
-                        //Number of words in the channel aggregate left to read
-                        chaggwordstoread = vx725_vx730_psd_data.chagg_size - 2;
- 
-                        //Unpack the channel aggregate
-                        while (chaggwordstoread>0) {
- 
-                          //Read the Vx725_Vx730 PSD channel aggregate
-                          gzret=gzread(gz_in,&v1730_chagg_data,vx725_vx730_psd_data.individual_chagg_size*sizeof(uint32_t));
-                          BytesRead += gzret;
-                          wordstoread -= vx725_vx730_psd_data.individual_chagg_size;
-                          chaggwordstoread -= vx725_vx730_psd_data.individual_chagg_size;
-			 
-                          //unpack the channel agregate
-                          func_ret = unpack_vx725_vx730_psd_chagg(v1730_chagg_data, &vx725_vx730_psd_data);
- 
-                          //Set the remaining analysis variables
-                          db_arr[EVTS].Valid = 1;                                                             //Everything starts valid
-                          db_arr[EVTS].board = user_data.boardid;                                             //Board ID
-                          db_arr[EVTS].channel = vx725_vx730_psd_data.channel + channels[chaggcounter];       //Channel ID
-                          db_arr[EVTS].Ifast =  vx725_vx730_psd_data.qshort;                                  //Fast Integral
-                          db_arr[EVTS].Islow =  vx725_vx730_psd_data.qlong - vx725_vx730_psd_data.qshort;     //Slow Integral (minus the fast)
-                          db_arr[EVTS].InvalidReason = 0;                                                         
-			 
-                          //Map it
-                          db_arr[EVTS].ID = MapID[db_arr[EVTS].channel][db_arr[EVTS].board];  
-				
-                               //Do waveform analysis and calculate times
-                          if(vx725_vx730_psd_data.dual_trace) {
-                            db_arr[EVTS].Ns = 4.0*vx725_vx730_psd_data.nsdb8;                                  //Dual trace effectively reduces the sampling frequency
-                          }
-                          else {
-                            db_arr[EVTS].Ns = 8.0*vx725_vx730_psd_data.nsdb8;                                 
-                          }
-                          
-                          double dT=0;
-                          
-                          analysis_params->wf_integral=0;
- 
-                          //If the detector is not a DANCE crystal or the use fine time is off
-                          if ( ! input_params.Use_Firmware_FineTime || db_arr[EVTS].ID >= 162) {
-                            dT = Calculate_Fractional_Time(vx725_vx730_psd_data.analog_probe1,                 //Function that calculates the fine time stamp
-                                                             db_arr[EVTS].Ns, 
-                                                           vx725_vx730_psd_data.dual_trace, 
-                                                           user_data.modtype,
-                                                           analysis_params);
-                          }
-                          else {
-                            dT = 2.* vx725_vx730_psd_data.fine_time_stamp/1024.;
-                          }
-                           
-                          //Set the timestamps
-                          db_arr[EVTS].timestamp = vx725_vx730_psd_data.trigger_time_tag;                       //31-bit time in clock ticks
-                          db_arr[EVTS].timestamp += 2147483648*vx725_vx730_psd_data.extended_time_stamp;        //16-bit extended time in clock ticks
-                          db_arr[EVTS].timestamp *= 2.0;                                                        //timestamp now in ns                 
-                          db_arr[EVTS].timestamp += dT;                                                         //Full timestamp in ns
- 
-                          if(analysis_params->wf_integral/(1.0*db_arr[EVTS].Islow) < wf_ratio_low || analysis_params->wf_integral/(1.0*db_arr[EVTS].Islow) > wf_ratio_high ) { 
-                            db_arr[EVTS].pileup_detected=1;                                                         //Full timestamp in ns
-                          } 
-                          else {
-                            db_arr[EVTS].pileup_detected=0;                                                         //Full timestamp in ns
-                          }
-                          
-                          if(input_params.Analysis_Stage > 0) {
-                            //need to add the time deviations before time sorting
-                            if(db_arr[EVTS].ID < 200) {
-                              db_arr[EVTS].timestamp += TimeDeviations[db_arr[EVTS].ID];
-                            }
-                            
-                            //Add the DANCE delay
-                            if(db_arr[EVTS].ID < 162) {
-                              db_arr[EVTS].timestamp += DANCE_Delay;
-                            }
-                
-                            //Add the He3 delay
-                            if(db_arr[EVTS].ID == He3_ID) {
-                              db_arr[EVTS].timestamp += He3_Delay;
-                            } 
-                            
-                            //Add the U235 delay
-                            if(db_arr[EVTS].ID == U235_ID) {
-                              db_arr[EVTS].timestamp += U235_Delay;
-                            } 
-                            
-                            //Add the Li6 delay
-                            if(db_arr[EVTS].ID == Li6_ID) {
-                              db_arr[EVTS].timestamp += Li6_Delay;
-                            }
-                          }
- 
-                          db_arr[EVTS].TOF = db_arr[EVTS].timestamp;                                            //TOF start as Full timestamp in ns
- 
-                        
-                 
- 
+
+        if(bank32.fName[0]=='p') {
+          int whichpeak = atoi(&bank32.fName[1]);
 #ifdef Unpacker_Verbose
-                          //cout<<"Valid: "<<(int)db_arr[EVTS].Valid<<"  ";
-                          //cout<<"Board: "<<(int)db_arr[EVTS].board<<"  ";
-                          //cout<<"Channel: "<<(int)db_arr[EVTS].channel<<"  ";
-                          //cout<<"NS: "<<db_arr[EVTS].Ns<<"  ";
-                          //cout<<"Timestamp: "<<db_arr[EVTS].timestamp<<"  ";
-                          //cout<<"TOF: "<<db_arr[EVTS].TOF<<"  ";
-                          //cout<<"Ifast: "<<db_arr[EVTS].Ifast<<"  ";
-                          //cout<<"ISlow: "<<db_arr[EVTS].Islow<<endl;
+          cout << "whichpeak: " << whichpeak << endl;
 #endif
- 
-#ifdef MakeTimeStampHistogram
-                          if (db_arr[EVTS].ID<162){
-                            hTimestamps->Fill(db_arr[EVTS].timestamp*1.0e-9);
-                            hTimestampsID->Fill(db_arr[EVTS].timestamp*1.0e-9,db_arr[EVTS].ID);
-                          }
-                          if (db_arr[EVTS].ID==T0_ID){
-                            hTimestampsT0->Fill(db_arr[EVTS].timestamp*1.0e-9);
-                          }
-                          if (db_arr[EVTS].ID==He3_ID || db_arr[EVTS].ID==Li6_ID || db_arr[EVTS].ID==U235_ID || db_arr[EVTS].ID==Bkg_ID ){
-                            hTimestampsBM->Fill(db_arr[EVTS].timestamp*1.0e-9);
-                          }
-#endif                           
-                                  
-#ifdef Histogram_Digital_Probes
-                          //Fill probe histograms
-                          if(input_params.Read_Binary==0) {
-                            if(db_arr[EVTS].ID<256) {
-                              for(int kay=0;kay<db_arr[EVTS].Ns;kay++) {
-                                //digital probes
-                                hDigital_Probe1_ID->Fill(kay,db_arr[EVTS].ID,vx725_vx730_psd_data.digital_probe1[kay]);
-                                hDigital_Probe2_ID->Fill(kay,db_arr[EVTS].ID,vx725_vx730_psd_data.digital_probe2[kay]);
-                              }
-                            }
-                          }
-#endif
-                          
-#ifdef Histogram_Waveforms
- 
-                          //Fill waveform histograms
-                          if(input_params.Read_Binary==0) {
-                            if(db_arr[EVTS].ID<162) {
- 
-                          hID_vs_WFRatio->Fill(analysis_params->wf_integral/(1.0*db_arr[EVTS].Islow),db_arr[EVTS].ID);
- 
-                          hID_vs_WFInt_vs_Islow->Fill(analysis_params->wf_integral,db_arr[EVTS].Islow,db_arr[EVTS].ID);
- 
-			  hID_vs_WFRatio_vs_Islow->Fill(analysis_params->wf_integral/(1.0*db_arr[EVTS].Islow),db_arr[EVTS].Islow,db_arr[EVTS].ID);
-                          //        cout<<db_arr[EVTS].ID<<"  "<<analysis_params->wf_integral/(1.0*db_arr[EVTS].Islow)<<endl;
- 
-                              if(waveform_counter < 20) {
-                                if(db_arr[EVTS].Islow > 5000 && db_arr[EVTS].Ifast >500 && db_arr[EVTS].Ifast <1000) {
-                                  for(int kay=0; kay<db_arr[EVTS].Ns; kay++) {
-                                    hWaveforms[waveform_counter]->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay]);
-                                  }
-                                  waveform_counter++;
-                                }
-                              }
-                           
-                              if(analysis_params->wf_integral<0) {
-                                for(int kay=0; kay<db_arr[EVTS].Ns; kay++) {
-                                  hWaveform_ID_NR->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay],db_arr[EVTS].ID);
-                                }                              
-                              }
-                              else {
-                                for(int kay=0; kay<db_arr[EVTS].Ns; kay++) {
-                                  hWaveform_ID->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay],db_arr[EVTS].ID);
-                                }
-                              }
-                              
-                            }                        
-     
-                            if(db_arr[EVTS].ID == He3_ID) {
-                              for(int kay=0;kay<db_arr[EVTS].Ns;kay++) {
-                                hWaveform_He3->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay]);
-                              } 
-                            }
-                            if(db_arr[EVTS].ID == Bkg_ID) {
-                              for(int kay=0;kay<db_arr[EVTS].Ns;kay++) {
-                                hWaveform_Bkg->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay]);
-                              }
-                            } 
-                            if(db_arr[EVTS].ID == U235_ID) {
-                              for(int kay=0;kay<db_arr[EVTS].Ns;kay++) {
-                                hWaveform_U235->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay]);
-                              } 
-                            }
-                            if(db_arr[EVTS].ID == Li6_ID) {
-                              for(int kay=0;kay<db_arr[EVTS].Ns;kay++) {
-                                hWaveform_Li6->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay]);
-                              } 
-                            }
-                            
-                            if(db_arr[EVTS].ID==T0_ID) {
-                              for(int kay=0;kay<db_arr[EVTS].Ns;kay++) {
-                                hWaveform_T0->Fill(kay,vx725_vx730_psd_data.analog_probe1[kay]);
-                              }
-                            }
-                          }
-#endif
- 
-          
-                          //keep track of the smallest timestamp
-                          if(db_arr[EVTS].TOF<analysis_params->smallest_timestamp) {
-                            analysis_params->smallest_timestamp=db_arr[EVTS].TOF;
-                          }    
-                          //keep track of the largest timestamp
-                          if(db_arr[EVTS].TOF>analysis_params->largest_timestamp) {
-                            analysis_params->largest_timestamp=db_arr[EVTS].TOF;
-                          }  
-                      
-                          EVTS++;
-                  
-                          analysis_params->entries_unpacked++;
-                          analysis_params->entries_awaiting_timesort++;
- 
-                       
-                          
+          gzret=gzread(gz_in,imported_peaks[whichpeak],bank32.fDataSize);
 #ifdef Unpacker_Verbose
-                          //cout<<"chaggwordstoread: "<<chaggwordstoread<<"  wordstoread: "<<wordstoread<<endl;
+          cout<<"After Read"<<endl;
 #endif
-                        } //End of check on chagg words to read
-                        
-                        //increment the chagg counter
-                        chaggcounter++;
- 
-                      } //End of check on PSD
-                      
- 
-                      //*********** PHA ***********//
-                      else if(user_data.fw_majrev == 139) {
-                        
-                        func_ret = unpack_vx725_vx730_pha_chagg_header(&v1730_chagg_header, &vx725_vx730_pha_data);
-                        
+          TotalBankSize -= EventBankSize;
+        }
+        else {
 #ifdef Unpacker_Verbose
-                        //cout<<"PHA   DT: "<<(int)vx725_vx730_pha_data.dual_trace<<"  ";
-                        //cout<<"EE: "<<(int)vx725_vx730_pha_data.energy_enabled<<"  ";
-                        //cout<<"ET: "<<(int)vx725_vx730_pha_data.time_enabled<<"  ";
-                        //cout<<"E2: "<<(int)vx725_vx730_pha_data.extras2_enabled<<"  ";
-                        //cout<<"ES: "<<(int)vx725_vx730_pha_data.waveform_enabled<<"  ";
-                        //cout<<"EX Opt: "<<(int)vx725_vx730_pha_data.extras2_option<<"  ";
-                        //cout<<"AP1: "<<(int)vx725_vx730_pha_data.ap1<<"  ";
-                        //cout<<"AP2: "<<(int)vx725_vx730_pha_data.ap2<<"  ";
-                        //cout<<"DP: "<<(int)vx725_vx730_pha_data.dp<<"  ";
-                        //cout<<"NSDB8: "<<vx725_vx730_pha_data.nsdb8<<endl;
+          cout<<"CPU Bank"<<endl;
 #endif
-                        
-                        
-                        //Number of words in the channel aggregate left to read
-                        chaggwordstoread = vx725_vx730_pha_data.chagg_size - 2;
- 
-                        //Unpack the channel aggreate
-                        while (chaggwordstoread>0) {
-                          
-                          //Read the Vx725_Vx730 PSD channel aggregate
-                          gzret=gzread(gz_in,&v1730_chagg_data,vx725_vx730_pha_data.individual_chagg_size*sizeof(uint32_t));
-                          BytesRead += gzret;
-                          wordstoread -= vx725_vx730_pha_data.individual_chagg_size;
-                          chaggwordstoread -= vx725_vx730_pha_data.individual_chagg_size;
- 
-                          //unpack the channel agregate
-                          func_ret = unpack_vx725_vx730_pha_chagg(v1730_chagg_data, &vx725_vx730_pha_data);
-                          
-                          //Set the remaining analysis variables
-                          db_arr[EVTS].Valid = 1;
-                          db_arr[EVTS].board = user_data.boardid;
-                          db_arr[EVTS].channel = vx725_vx730_pha_data.channel + channels[chaggcounter];
-                          db_arr[EVTS].Ifast =  vx725_vx730_pha_data.energy;
-                          db_arr[EVTS].Islow =  vx725_vx730_pha_data.energy;                
-                          db_arr[EVTS].InvalidReason = 0;
- 
-                          //Map it
-                          db_arr[EVTS].ID = MapID[db_arr[EVTS].channel][db_arr[EVTS].board]; 
- 
-                          
-                          //Do waveform analysis and calculate times
-                          if(vx725_vx730_pha_data.dual_trace) {
-                            db_arr[EVTS].Ns = 4.0*vx725_vx730_pha_data.nsdb8;
-                          }
-                          else {
-                            db_arr[EVTS].Ns = 8.0*vx725_vx730_pha_data.nsdb8;
-                          }
-                          
-                          double dT=0;
-                          if ( ! input_params.Use_Firmware_FineTime ) {
-                            dT = Calculate_Fractional_Time(vx725_vx730_pha_data.analog_probe1,
-                                                           db_arr[EVTS].Ns, 
-                                                           vx725_vx730_pha_data.dual_trace, 
-                                                           user_data.modtype,
-                                                           analysis_params);
-                          }
-                          else {
-                            dT = 2.*vx725_vx730_pha_data.fine_time_stamp/65356.;
-                          }
-                                                    
-                          db_arr[EVTS].timestamp = vx725_vx730_pha_data.trigger_time_tag;                       //31-bit time in clock ticks
-                          db_arr[EVTS].timestamp += 2147483648*vx725_vx730_pha_data.extended_time_stamp;        //16-bit extended time in clock ticks
-                          db_arr[EVTS].timestamp *= 2.0;                                                        //timestamp now in ns                 
-                          db_arr[EVTS].timestamp += dT;                                                         //Full timestamp in ns
-                          
- 
-                          if(input_params.Analysis_Stage > 0) {
-                            //need to add the time deviations before time sorting
-                            if(db_arr[EVTS].ID < 200) {
-                              db_arr[EVTS].timestamp += TimeDeviations[db_arr[EVTS].ID];
-                            }
-                            
-                            //Add the DANCE delay
-                            if(db_arr[EVTS].ID < 162) {
-                              db_arr[EVTS].timestamp += DANCE_Delay;
-                            }
-                     
-                            //Add the He3 delay
-                            if(db_arr[EVTS].ID == He3_ID) {
-                              db_arr[EVTS].timestamp += He3_Delay;
-                            } 
-                            
-                            //Add the U235 delay
-                            if(db_arr[EVTS].ID == U235_ID) {
-                              db_arr[EVTS].timestamp += U235_Delay;
-                            } 
-                            
-                            //Add the Li6 delay
-                            if(db_arr[EVTS].ID == Li6_ID) {
-                              db_arr[EVTS].timestamp += Li6_Delay;
-                            }
-                          }
- 
-                          db_arr[EVTS].TOF = db_arr[EVTS].timestamp;                                            //Start with TOF as Full timestamp in ns
- 
+          // get the cpu bank information
+          gzseek(gz_in,bank32.fDataSize,SEEK_CUR);
+          TotalBankSize -= EventBankSize;
+          break; // you break here because the cpu comes last
+        }
+      }
 #ifdef Unpacker_Verbose
-                          //cout<<"Valid: "<<(int)db_arr[EVTS].Valid<<"  ";
-                          //cout<<"Board: "<<(int)db_arr[EVTS].board<<"  ";
-                          //cout<<"Channel: "<<(int)db_arr[EVTS].channel<<"  ";
-                          //cout<<"NS: "<<db_arr[EVTS].Ns<<"  ";
-                          //cout<<"Timestamp: "<<db_arr[EVTS].timestamp<<"  ";
-                          //cout<<"TOF: "<<db_arr[EVTS].TOF<<"  ";
-                          //cout<<"Ifast: "<<db_arr[EVTS].Ifast<<"  ";
-                          //cout<<"ISlow: "<<db_arr[EVTS].Islow<<endl;
-#endif
-                          
- 
-          
-#ifdef Histogram_Digital_Probes
-                          //Fill probe histograms
-                          if(input_params.Read_Binary==0) {
-                            if(db_arr[EVTS].ID<256) {
-                              for(int kay=0;kay<db_arr[EVTS].Ns;kay++) {
-                                //digital probes
-                                hDigital_Probe1_ID->Fill(kay,db_arr[EVTS].ID,vx725_vx730_pha_data.digital_probe1[kay]);
-                                hDigital_Probe2_ID->Fill(kay,db_arr[EVTS].ID,vx725_vx730_pha_data.digital_probe2[kay]);
-                              }
-                            }
-                          }
+      cout<<"After trig bank"<<endl;
 #endif
-                          
-#ifdef Histogram_Waveforms
-                          //Fill waveform histograms
-                          if(input_params.Read_Binary==0) {
-                            if(db_arr[EVTS].ID<162) {
-                              for(int kay=0; kay<db_arr[EVTS].Ns; kay++) {
-                                hWaveform_ID->Fill(kay,vx725_vx730_pha_data.analog_probe1[kay],db_arr[EVTS].ID);
-                              }
-                            }                        
-                 
-                            if(db_arr[EVTS].ID == He3_ID) {
-                              for(int kay=0;kay<db_arr[EVTS].Ns;kay++) {
-                                hWaveform_He3->Fill(kay,vx725_vx730_pha_data.analog_probe1[kay]);
-                              } 
-                            }
-                            if(db_arr[EVTS].ID == Bkg_ID) {
-                              for(int kay=0;kay<db_arr[EVTS].Ns;kay++) {
-                                hWaveform_Bkg->Fill(kay,vx725_vx730_pha_data.analog_probe1[kay]);
-                              }
-                            } 
-                            if(db_arr[EVTS].ID == U235_ID) {
-                              for(int kay=0;kay<db_arr[EVTS].Ns;kay++) {
-                                hWaveform_U235->Fill(kay,vx725_vx730_pha_data.analog_probe1[kay]);
-                              } 
-                            }
-                            if(db_arr[EVTS].ID == Li6_ID) {
-                              for(int kay=0;kay<db_arr[EVTS].Ns;kay++) {
-                                hWaveform_Li6->Fill(kay,vx725_vx730_pha_data.analog_probe1[kay]);
-                              } 
-                            }
-                            
-                            if(db_arr[EVTS].ID == T0_ID) {
-                              for(int kay=0;kay<db_arr[EVTS].Ns;kay++) {
-                                hWaveform_T0->Fill(kay,vx725_vx730_pha_data.analog_probe1[kay]);
-                              }
-                            }
-                          }
-#endif
- 
- 
-                          //keep track of the smallest timestamp
-                          if(db_arr[EVTS].TOF<analysis_params->smallest_timestamp) {
-                           analysis_params->smallest_timestamp=db_arr[EVTS].TOF;
-                          }    
-                          //keep track of the largest timestamp
-                          if(db_arr[EVTS].TOF>analysis_params->largest_timestamp) {
-                            analysis_params->largest_timestamp=db_arr[EVTS].TOF;
-                          }  
-                      
-                          EVTS++;
-            
-                          analysis_params->entries_unpacked++;
-                          analysis_params->entries_awaiting_timesort++;
- 
- 
-                          
+
+      int last_detnum = evaggr->P[0].detector_id;
+      int where_in_peakbank = 0;
+      int64_t event_smallest_timestamp = Time_Max;
+      for (uint32_t evtnum=0;evtnum<evaggr->N;++evtnum) {
+        int current_detnum = evaggr->P[evtnum].detector_id;
+        if (current_detnum != last_detnum) {
+          where_in_peakbank = 0;
+        }
+        uint32_t wflen = evaggr->P[evtnum].width;        // CEVT_BANK variable
+
+        uint8_t board = (int)((1.*((int)current_detnum)-1)/16.);                             //Board number
+        uint8_t channel = (1*current_detnum-1)-16*board;                                     //Channel number
+        const Channel_Entry_t &entry = channel_table.channel[board][channel & (Table_Channels-1)];
+
+        //Skip channels that are not accepted before copying and timing the waveform
+        if(!entry.accepted) {
+          Add_Rejected_Entries(board, channel & (Table_Channels-1), 1);
+          where_in_peakbank += wflen;
+          last_detnum = current_detnum;
+          continue;
+        }
+
+        analysis_params->wf_integral=0;
+        for (uint wfindex=where_in_peakbank;wfindex<where_in_peakbank+wflen;++wfindex) {
+          // at this point we have reserved only 40 samples in db_arr waveform !!
+          evaggr->wavelets[evtnum][wfindex-where_in_peakbank] = imported_peaks[current_detnum][wfindex];
+        }
+        where_in_peakbank += wflen;
+        last_detnum = current_detnum;
+
+        uint64_t timestamp_raw = (evaggr->P[evtnum].position & 0x7FFFFFFFFFFF);                // 47 bits for timestamp
+
 #ifdef Unpacker_Verbose
-                          //cout<<"chaggwordstoread: "<<chaggwordstoread<<"  wordstoread: "<<wordstoread<<endl;
+        cout<<"timestamp_raw: "<<timestamp_raw<<endl;
 #endif
-                        } //End of check on chagg words to read
-                        
-                        //increment the chagg counter
-                        chaggcounter++;
- 
-                      } //End of check on PHA
- 
- 
-                    } //End of wordstoread > 0 
-                    
+
+        DEVT_BANK &hit = db_arr[EVTS];
+
+        hit.timestamp        = timestamp_raw;                                               //Digitizer timestamp
+        hit.Ns               = evaggr->P[evtnum].width;                                     //Number of samples of the waveform
+        hit.Ifast            = evaggr->P[evtnum].integral[0];                               //Fast integral
+        hit.Islow            = evaggr->P[evtnum].integral[1]-evaggr->P[evtnum].integral[0]; //Slow integral
+        hit.board            = board;                                                       //Board number
+        hit.channel          = channel;                                                     //Channel number
+        hit.ID               = entry.ID;                                                    //ID from DANCE map
+        hit.Valid = 1;                                                                      //Everything starts valid
+        hit.InvalidReason = 0;
+
 #ifdef Unpacker_Verbose
-                     cout<<EventBankSize<<"  "<<BytesRead<<endl;
-#endif
-    
-                    EventBankSize -= BytesRead;
-                    TotalBankSize -= BytesRead;
-                    // BytesRead = 0;
-                    
-                  } //End of check on 725 or 730
-                } //End of check on event bank size
- 
-                if(readextra) {
-                  uint32_t extra = 0;
-                  gzret=gzread(gz_in,&extra,sizeof(extra));
-                  TotalBankSize -= sizeof(extra);
-                } //End of read extra
-              } //End of check  on total bank size
-            }  //Endf of EventID 1 (Data)
- 
-            else if(head.fEventId==8){
-              
-              // this is scaler data
-              gzret=gzread(gz_in,&bhead,sizeof(BankHeader_t));        
-              
-#ifdef Diagnostic_Verbose
-              cout << "SCALER " << endl;
-              cout << "Bank_HEADER " << endl;
-              cout << dec <<"TotalBankSize (bytes): " << bhead.fDataSize << endl;
-              cout << dec << bhead.fFlags << endl;
-#endif    
-            
-              TotalBankSize = bhead.fDataSize;
- 
-              //This is the number of active boards
-              int nactiveboards = 0;
-              
-              while(TotalBankSize > 0) {
- 
-                gzret=gzread(gz_in,&bank,sizeof(BankHeader_t));        
-                TotalBankSize-=sizeof(Bank_t);
-                
-#ifdef Diagnostic_Verbose
-                cout<<"TotalBankSize after Bank Header Read "<<TotalBankSize<<endl;
-                cout << bank.fName[0] << bank.fName[1] << bank.fName[2]<< bank.fName[3] << endl;
-                cout << dec << bank.fType << endl;
-                cout << dec << bank.fDataSize << endl;
-#endif
-                //see if data is on an 8-byte boundary
-                bool readextra = false;
-                if(bank.fDataSize%8 !=0) {
-                  readextra = true; 
-                }
-                
-                //This is the time struct
-                if (bank.fName[0]=='T' && bank.fName[1]=='I' && bank.fName[2]== 'M' && bank.fName[3]=='E') {
-                  outputdiagnosticsfile << "TIME\n";
-#ifdef Diagnostic_Verbose
-                  cout<<endl<<"Time"<<endl;
-#endif
-                  gzret=gzread(gz_in,&timevalue,sizeof(timevalue));
-                  TotalBankSize-=sizeof(timevalue);
- 
-                  outputdiagnosticsfile << timevalue.tv_sec<<"  "<<timevalue.tv_usec<<"\n";
-                }
-                
-                //These are the Digitizer Rates
-                if (bank.fName[0]=='S' && bank.fName[1]=='C' && bank.fName[2]== 'L' && bank.fName[3]=='R') {
-                  
-                  nactiveboards = bank.fDataSize/sizeof(uint32_t);
-                  outputdiagnosticsfile << "SCLR  "<<nactiveboards<<"\n";
- 
-#ifdef Diagnostic_Verbose
-                  cout<<endl<<"Digitizer Rates"<<endl;
-#endif
-                  nactiveboards = bank.fDataSize/sizeof(uint32_t);
-                  for(int eye=0; eye<nactiveboards; eye++) {
-                    gzret=gzread(gz_in,&Digitizer_Rates[eye],sizeof(uint32_t));
-#ifdef Diagnostic_Verbose
-                    cout<<eye<<"  "<<Digitizer_Rates[eye]<<endl;
-#endif
-                    TotalBankSize-=sizeof(uint32_t);
-                    outputdiagnosticsfile << Digitizer_Rates[eye]<<"\n";
-                  }
-                }
- 
-                //These are the Acquisition Status
-                if (bank.fName[0]=='A' && bank.fName[1]=='C' && bank.fName[2]== 'Q' && bank.fName[3]=='S') {
-                  nactiveboards = bank.fDataSize/sizeof(uint32_t);
-                  outputdiagnosticsfile << "ACQS  "<<nactiveboards<<"\n";
-#ifdef Diagnostic_Verbose
-                  cout<<endl<<"Acquisition Status"<<endl;
-#endif
-                  nactiveboards = bank.fDataSize/sizeof(uint32_t);
-                  for(int eye=0; eye<nactiveboards; eye++) {
-                    gzret=gzread(gz_in,&Acquisition_Status[eye],sizeof(uint32_t));
-#ifdef Diagnostic_Verbose
-                    cout<<eye<<"  "<<Acquisition_Status[eye]<<endl;
-#endif
-                    TotalBankSize-=sizeof(uint32_t);
-                    outputdiagnosticsfile << Acquisition_Status[eye]<<"\n";
-                  }
-                }
- 
-                //These are the Failure Status
-                if (bank.fName[0]=='F' && bank.fName[1]=='A' && bank.fName[2]== 'I' && bank.fName[3]=='L') {
-                  nactiveboards = bank.fDataSize/sizeof(uint32_t);
-                  outputdiagnosticsfile << "FAIL  "<<nactiveboards<<"\n";
-#ifdef Diagnostic_Verbose
-                  cout<<endl<<"Failure Status"<<endl;
-#endif
-                  nactiveboards = bank.fDataSize/sizeof(uint32_t);
-                  for(int eye=0; eye<nactiveboards; eye++) {
-                    gzret=gzread(gz_in,&Failure_Status[eye],sizeof(uint32_t));
- 
-                    if(Failure_Status[eye] != 0) {
-                      faillog<<"Run: "<<input_params.RunNumber<<"  Board: "<<eye<<" Failure_Status: "<<Failure_Status[eye]<<endl;
-                    }
-#ifdef Diagnostic_Verbose
-                    cout<<eye<<"  "<<Failure_Status[eye]<<endl;
-#endif
-                    TotalBankSize-=sizeof(uint32_t);
-                    outputdiagnosticsfile << Failure_Status[eye]<<"\n";
-                  }
-                }
- 
-                //These are the Readout Status
-                if (bank.fName[0]=='R' && bank.fName[1]=='E' && bank.fName[2]== 'A' && bank.fName[3]=='D') {
-                  nactiveboards = bank.fDataSize/sizeof(uint32_t);
-                  outputdiagnosticsfile << "READ  "<<nactiveboards<<"\n";
-#ifdef Diagnostic_Verbose
-                  cout<<endl<<"Readout Status"<<endl;
-#endif
-                  nactiveboards = bank.fDataSize/sizeof(uint32_t);
-                  for(int eye=0; eye<nactiveboards; eye++) {
-                    gzret=gzread(gz_in,&Readout_Status[eye],sizeof(uint32_t));
-#ifdef Diagnostic_Verbose
-                    cout<<eye<<"  "<<Readout_Status[eye]<<endl;
-#endif
-                    TotalBankSize-=sizeof(uint32_t);
-                    outputdiagnosticsfile << Readout_Status[eye]<<"\n";
-                  }
-                }
- 
-                //These are the 8500 + 4n register values
-                if (bank.fName[0]=='D' && bank.fName[1]=='I' && bank.fName[2]== 'A' && bank.fName[3]=='G') {
-                  outputdiagnosticsfile << "DIAG  "<<nactiveboards<<"\n";
- 
-#ifdef Diagnostic_Verbose
-                  cout<<endl<<"0x8500 + 4n Diagnostics"<<endl;
-#endif
-                  for(int eye=0; eye<nactiveboards; eye++) {
-                    for(int jay=0; jay<8; jay++) {
-                      gzret=gzread(gz_in,&Register_0x8504n[eye][jay],sizeof(uint32_t));
-                      TotalBankSize-=sizeof(uint32_t);
-                      outputdiagnosticsfile << Register_0x8504n[eye][jay]<<"  ";
-                    }
-                    outputdiagnosticsfile <<"\n";
- 
-                  }
-                
-#ifdef Diagnostic_Verbose
-                  for(int eye=0; eye<8; eye++) {
-                    for(int jay=0; jay<nactiveboards; jay++) {
-                      cout<<Register_0x8504n[jay][eye]<<"  ";
-                    }
-                    cout<<endl;
-                  }
-#endif
-                }
- 
-                //These are the ADC Temps
-                if (bank.fName[0]=='T' && bank.fName[1]=='E' && bank.fName[2]== 'M' && bank.fName[3]=='P') {
-                  outputdiagnosticsfile << "TEMP  "<<nactiveboards<<"\n";
-#ifdef Diagnostic_Verbose
-                  cout<<endl<<"ADC Temps"<<endl;
-#endif
-                  for(int eye=0; eye<nactiveboards; eye++) {
-                    for(int jay=0; jay<16; jay++) {
-                      gzret=gzread(gz_in,&ADC_Temp[eye][jay],sizeof(uint16_t));
-                      TotalBankSize-=sizeof(uint16_t);
-                      outputdiagnosticsfile << ADC_Temp[eye][jay]<<"  ";
-                    }
-                    outputdiagnosticsfile <<"\n";
-                  }
-                
-#ifdef Diagnostic_Verbose
-                  for(int eye=0; eye<16; eye++) {
-                    for(int jay=0; jay<nactiveboards; jay++) {
-                      cout<<ADC_Temp[jay][eye]<<"  ";
-                    }
-                    cout<<endl;
-                  }
-#endif
-                }
- 
-                //These are the 0x1n2C values
-                if (bank.fName[0]=='1' && bank.fName[1]=='n' && bank.fName[2]== '2' && bank.fName[3]=='C') {
-                  outputdiagnosticsfile << "1n2C  "<<nactiveboards<<"\n";
-#ifdef Diagnostic_Verbose
-                  cout<<endl<<"Register 0x1n2C"<<endl;
-#endif
-                  for(int eye=0; eye<nactiveboards; eye++) {
-                    for(int jay=0; jay<16; jay++) {
-                      gzret=gzread(gz_in,&Register_0x1n2C[eye][jay],sizeof(uint32_t));
-                      TotalBankSize-=sizeof(uint32_t);
-                      outputdiagnosticsfile << Register_0x1n2C[eye][jay]<<"  ";
-                    }
-                    outputdiagnosticsfile <<"\n";
-                  }
-                
-#ifdef Diagnostic_Verbose
-                  for(int eye=0; eye<16; eye++) {
-                    for(int jay=0; jay<nactiveboards; jay++) {
-                      cout<<Register_0x1n2C[jay][eye]<<"  ";
-                    }
-                    cout<<endl;
-                  }
-#endif
-                }
-                
-                //These are the Channel Status
-                if (bank.fName[0]=='C' && bank.fName[1]=='H' && bank.fName[2]== 'S' && bank.fName[3]=='T') {
-                  outputdiagnosticsfile << "CHST  "<<nactiveboards<<"\n";
-#ifdef Diagnostic_Verbose
-                  cout<<endl<<"Channel Status"<<endl;
-#endif
-                  for(int eye=0; eye<nactiveboards; eye++) {
-                    for(int jay=0; jay<16; jay++) {
-                      gzret=gzread(gz_in,&Channel_Status[eye][jay],sizeof(uint32_t));
-                      TotalBankSize-=sizeof(uint32_t);
-                      outputdiagnosticsfile << Channel_Status[eye][jay]<<"  ";
-                    }
-                    outputdiagnosticsfile <<"\n";
-                  }
-                
-#ifdef Diagnostic_Verbose
-                  for(int eye=0; eye<16; eye++) {
-                    for(int jay=0; jay<nactiveboards; jay++) {
-                      cout<<Channel_Status[jay][eye]<<"  ";
-                    }
-                    cout<<endl;
-                  }
-#endif
-                }
-                
-                if(readextra) {
-                  uint32_t extra = 0;
-                  gzret=gzread(gz_in,&extra,sizeof(extra));
-                  TotalBankSize -= sizeof(extra);
-                }              
-              }
-#ifdef Diagnostic_Verbose
-              cout<<"Done with Scalers. Total Bank Size: "<<TotalBankSize<<endl;
+        cout<<(int)hit.board<<"  "<<(int)hit.channel<<endl;
 #endif
-            }  //End of Event ID 8 (Diagnostics)
- 
- 
-            //Scalers
-            else if(head.fEventId==2) {
-                
-              TotalBankSize  = head.fDataSize;
- 
-#ifdef Scaler_Verbose
-              cout << dec <<"TotalBankSize (bytes): " << TotalBankSize << endl;
+        // CALCULATE THE LEADING EDGE using constant fraction "frac"
+        int imin=0;
+        double sigmin=1e9;
+        double frac=0.04;
+        double base=0;
+        double secmom=0.;
+        int NNN=10;
+
+        double dT = 0;
+
+        //Beam monitor waveforms for caen2015 data are ostensibly useless
+        if(hit.ID <= 200) {
+          if(hit.ID<162) frac=0.04;
+          else frac=0.1;
+
+          frac=0.2;
+
+          for(int i=0;i<hit.Ns;i++) {
+            wf1[i]=evaggr->wavelets[evtnum][i]+8192;
+
+            if(i<NNN) {
+              base+=(1.*wf1[i]);
+              secmom+=(1.*wf1[i]*1.*wf1[i]);
+            }
+            if((1.*wf1[i])<sigmin) {
+              sigmin=1.*wf1[i];
+              imin=i;
+            }
+          }
+
+          double thr=(sigmin-base/(1.*NNN))*frac+base/(1.*NNN);
+          for(int i=imin;i>1;i--){
+            if((1.*wf1[i])<thr && (1.*wf1[i-1])>thr){
+              double dSig=(1.*wf1[i-1]-1.*wf1[i]);
+              if(dSig!=0) dT=(1.*wf1[i-1]-thr)/dSig*2.+(i-1)*2.;  // this is in ns
+              else dT=(i-1)*2.;
+            }
+          }
+
+          //Waveform diagnostics
+          Sample_Waveform(hit.ID, Waveform_Good, wf1, hit.Ns, hit.Ifast, hit.Islow, 0);
+        } //end loop over ID <= 200
+
+#ifdef Histogram_Waveforms
+        //Fill waveform histogram
+        if(hit.ID<162) {
+          for(int i=0;i<hit.Ns;i++) {
+            hWaveform_ID->Fill(i,wf1[i],hit.ID);
+          }
+        }
+
+        if(hit.ID == He3_ID) {
+          for(int i=0;i<hit.Ns;i++) {
+            hWaveform_He3->Fill(i,wf1[i]);
+          }
+        }
+        if(hit.ID == Bkg_ID) {
+          for(int i=0;i<hit.Ns;i++) {
+            hWaveform_Bkg->Fill(i,wf1[i]);
+          }
+        }
+        if(hit.ID == U235_ID) {
+          for(int i=0;i<hit.Ns;i++) {
+            hWaveform_U235->Fill(i,wf1[i]);
+          }
+        }
+        if(hit.ID == Li6_ID) {
+          for(int i=0;i<hit.Ns;i++) {
+            hWaveform_Li6->Fill(i,wf1[i]);
+          }
+        }
+        if(hit.ID == T0_ID) {
+          for(int i=0;i<hit.Ns;i++) {
+            hWaveform_T0->Fill(i,wf1[i]);
+          }
+        }
 #endif
-              gzread(gz_in,&bhead,sizeof(BankHeader_t));
-              TotalBankSize -= sizeof( BankHeader_t );
-              
-#ifdef Scaler_Verbose
-              cout << "Bank_HEADER " << endl;
-              cout << dec <<"TotalBankSize (bytes): " << bhead.fDataSize << endl;
-              cout << dec << bhead.fFlags << endl;
+
+        hit.timestamp *= 2*Time_Ticks;                                               //timestamp now in time ticks (2 ns clock)
+        hit.timestamp += Time_From_ns(dT);                                           //Full timestamp in time ticks
+
+        //Time deviations and delays
+        hit.timestamp += entry.time_offset_ticks;
+
+        //keep track of the smallest timestamp
+        if(hit.timestamp<analysis_params->smallest_timestamp) {
+          analysis_params->smallest_timestamp=hit.timestamp;
+        }
+        if(hit.timestamp<event_smallest_timestamp) {
+          event_smallest_timestamp=hit.timestamp;
+        }
+        //keep track of the largest timestamp
+        if(hit.timestamp>analysis_params->largest_timestamp) {
+          analysis_params->largest_timestamp=hit.timestamp;
+        }
+
+        EVTS++;
+
+        analysis_params->entries_unpacked++;
+        analysis_params->entries_awaiting_timesort++;
+
+#ifdef Unpacker_Verbose
+        cout<<EVTS<<"  "<<analysis_params->entries_unpacked<<endl;
 #endif
-              while (TotalBankSize > 0) {
- 
-                //MLTM
-                gzread( gz_in, &bank32, sizeof( Bank32_t ) );
-                TotalBankSize -= sizeof( Bank32_t );
- 
-#ifdef Scaler_Verbose
-                cout << "BANK " << endl;
-                cout << bank32.fName[0] << bank32.fName[1] << bank32.fName[2]<< bank32.fName[3] << endl;
-                cout << dec << bank32.fType << endl;
-                cout << "Size: "<<dec << bank32.fDataSize << endl;
+      }         //End of loop on eventnum
+
+      //The first good event with entries after corrupted data ends the lost time range
+      if(event_smallest_timestamp < Time_Max) {
+        End_Corrupt_Range(event_smallest_timestamp, analysis_params);
+      }
+    }  //End of if on CEVT bank
+    break;
+  } //End of loop on EventBankSize
+
+  return 1;
+}
+
+
+//****************** caen2018 ******************//
+
+CAEN2018_Decoder::CAEN2018_Decoder(Input_Parameters *input_params, const char *name, Board_Bank_Decoder_t (*select_decoder)(uint32_t firmware_word)) : MIDAS_Decoder(input_params) {
+
+  this->name = name;
+  this->select_decoder = select_decoder;
+
+  int unpacker_threads = input_params->Unpacker_Threads;
+#if defined(Histogram_Waveforms) || defined(Histogram_Digital_Probes) || defined(MakeTimeStampHistogram)
+  //These histograms are filled while the boards are decoded
+  unpacker_threads = 1;
 #endif
-                //see if data is on an 8-byte boundary
-                bool readextra = false;
-                if(bank32.fDataSize%8 !=0) {
-                  readextra = true; 
-                }
-                
-                if (bank32.fName[0]=='M' && bank32.fName[1]=='L' && bank32.fName[2]== 'T' && bank32.fName[3]=='M') {
-                  
-                  uint32_t time_seconds;
-                  gzret=gzread(gz_in,&time_seconds,sizeof(time_seconds));
-                  TotalBankSize-=sizeof(time_seconds);
- 
-#ifdef Scaler_Verbose
-                  cout << time_seconds<<"\n";
+  board_pool = new Thread_Pool(unpacker_threads);
+  for(int eye=0; eye<board_pool->Size(); eye++) {
+    board_decoders.push_back(new Board_Decoder_t);
+  }
+}
+
+CAEN2018_Decoder::~CAEN2018_Decoder() {
+  delete board_pool;
+  for(size_t eye=0; eye<board_decoders.size(); eye++) {
+    delete board_decoders[eye];
+  }
+}
+
+int CAEN2018_Decoder::Read_Record(gzFile gz_in, DEVT_BANK *db_arr, uint32_t &EVTS, Analysis_Parameters *analysis_params) {
+
+  EventHeader_t head;           //MIDAS event header
+  BankHeader_t bhead;           //MIDAS bank header
+  Bank32_t bank32;              //MIDAS 32-bit bank
+  uint32_t TotalBankSize=0;     // bhead.fDataSize;
+  uint32_t nbanks=0;            //Number of board banks in this MIDAS event
+  uint64_t event_bytes=0;       //Bytes of the event read after the bank header
+  int gzret=0;
+
+  //Start reading the file
+  if(Read_Event_Header(gz_in, &head, &bhead, analysis_params) == 0) {
+    return 0;
+  }
+
+#ifdef Unpacker_Verbose
+  cout<<"Type: "<<head.fEventId<<"  TotalDataSize  "<<head.fDataSize<<endl;
 #endif
-                }
-                if (bank32.fName[0]=='S' && bank32.fName[1]=='C' && bank32.fName[2]== 'L' && bank32.fName[3]=='R') {
- 
-                  gzret=gzread(gz_in,&sclr_totals,sizeof(sclr_totals));
-                  TotalBankSize-=sizeof(sclr_totals);
-          
-                  for(int kay=0; kay<N_SCLR; kay++) {
-                    hScalers->SetBinContent(kay+1,sclr_totals.totals[kay]);
-#ifdef Scaler_Verbose
-                    cout<<kay<<"  "<<sclr_totals.totals[kay]<<endl;
+  hEventID->Fill(head.fEventId);
+
+  // 0x8000 is a begin of run
+  // 0x8001 is an end of run
+  // 0x8002 is an ASCII message created by the logger
+  if(head.fEventId==0x8001) {
+    return 0;
+  }
+  else if(head.fEventId==8 || head.fEventId==2) {
+    return Post_Side_Event(gz_in, &head, analysis_params);
+  }
+  else if(head.fEventId!=1) {
+    Skip_MIDAS_Event(gz_in, &head);
+    return 1;
+  }
+
+  //Data (the bank header is read with the event header)
+#ifdef Unpacker_Verbose
+  cout<<"Event Data"<<endl;
+  cout << "Bank_HEADER " << endl;
+  cout <<"TotalBankSize (bytes): " << bhead.fDataSize << endl;
+  cout << bhead.fFlags << endl;
 #endif
-                  }
-                }
-                
-                if (bank32.fName[0]=='R' && bank32.fName[1]=='A' && bank32.fName[2]== 'T' && bank32.fName[3]=='E') {
-                 
-                  gzret=gzread(gz_in,&sclr_rates,sizeof(sclr_rates));
-                  TotalBankSize-=sizeof(sclr_rates);
- 
-#ifdef Scaler_Verbose
-                  for(int kay=0; kay<N_SCLR; kay++) {
-                    cout<<kay<<"  "<<sclr_rates.rates[kay]<<endl;
-                  }
+
+  TotalBankSize = bhead.fDataSize;
+
+  //Read in the bank of every board in this event
+  while(TotalBankSize>0) {
+
+    if(TotalBankSize < sizeof(Bank32_t)) {
+      return Corrupt_Event(gz_in, "MIDAS bank header does not fit in the event", event_bytes, analysis_params);
+    }
+    gzret=gzread(gz_in,&bank32,sizeof(Bank32_t));
+    if(gzret < (int)sizeof(Bank32_t)) {
+      return Truncated_Event(gz_in, event_bytes + (gzret > 0 ? gzret : 0), analysis_params);
+    }
+    TotalBankSize -= sizeof(Bank32_t);
+    event_bytes += sizeof(Bank32_t);
+
+    //the data lie on 8 byte boundaries so there will be an extra 4 bytes at the end of the data that is "unaccounted" for in the header
+    uint32_t extra_size = (bank32.fDataSize%8 != 0) ? sizeof(uint32_t) : 0;
+    if((uint64_t)bank32.fDataSize + extra_size > TotalBankSize) {
+      return Corrupt_Event(gz_in, "MIDAS bank size does not fit in the event", event_bytes, analysis_params);
+    }
+
+#ifdef Unpacker_Verbose
+    cout<<"TotalBankSize after Bank Header Read "<<TotalBankSize<<endl;
+    cout << "BANK  " << bank32.fName[0] << bank32.fName[1] << bank32.fName[2]<< bank32.fName[3] << endl;
+    cout << dec << bank32.fType << endl;
+    cout << dec << bank32.fDataSize << endl;
 #endif
-                }
-                
-                if(readextra) {
-                  uint32_t extra = 0;
-                  gzret=gzread(gz_in,&extra,sizeof(extra));
-                  TotalBankSize -= sizeof(extra);
-                }        
-                
-#ifdef Scaler_Verbose
-                cout << dec <<"TotalBankSize (bytes): " << TotalBankSize << endl;
+
+    if(nbanks == board_banks.size()) {
+      board_banks.push_back(Board_Bank_t());
+      bank_decoders.push_back(&Decode_Board_Bank);
+    }
+    Board_Bank_t &board_bank = board_banks[nbanks];
+    board_bank.nwords = bank32.fDataSize/sizeof(uint32_t);
+    if(board_bank.words.size() < board_bank.nwords) {
+      board_bank.words.resize(board_bank.nwords);
+    }
+    if(board_bank.nwords > 0) {
+      gzret=gzread(gz_in,&board_bank.words[0],board_bank.nwords*sizeof(uint32_t));
+      if(gzret < (int)(board_bank.nwords*sizeof(uint32_t))) {
+        return Truncated_Event(gz_in, event_bytes + (gzret > 0 ? gzret : 0), analysis_params);
+      }
+      //Pick the PSD or PHA decoder from the firmware word of this board
+      bank_decoders[nbanks] = select_decoder(board_bank.words[0]);
+    }
+    else {
+      bank_decoders[nbanks] = &Decode_Board_Bank;
+    }
+    TotalBankSize -= bank32.fDataSize;
+    event_bytes += bank32.fDataSize;
+    nbanks++;
+
+    if(extra_size > 0) {
+      uint32_t extra = 0;
+      gzret=gzread(gz_in,&extra,sizeof(extra));
+      if(gzret < (int)sizeof(extra)) {
+        return Truncated_Event(gz_in, event_bytes + (gzret > 0 ? gzret : 0), analysis_params);
+      }
+      TotalBankSize -= sizeof(extra);
+      event_bytes += sizeof(extra);
+    } //End of read extra
+  } //End of check on total bank size
+
+  //Decode the boards
+  board_pool->Run(nbanks, [&](int task, int worker) {
+      bank_decoders[task](&board_banks[task], board_decoders[worker], input_params);
+    });
+
+  //Collect the entries from each board
+  bool event_good = true;
+  int64_t event_smallest_timestamp = Time_Max;
+
+  for(uint32_t bee=0; bee<nbanks; bee++) {
+
+    Board_Bank_t &board_bank = board_banks[bee];
+
+    if(board_bank.status < 0 && !input_params->Recover_Corrupt_Data) {
+      //Make sure the board header ID is 10 before proceeding
+      if(board_bank.status == -1) {
+        cout<<RED<<"Unpacker [ERROR] CAEN Data Header is NOT 10!"<<endl;
+      }
+      else {
+        cout<<RED<<"Unpacker [ERROR] CAEN Aggregate Sizes do not match the MIDAS Bank Size!"<<endl;
+      }
+      cout<<"Entries: "<<EVTS<<" Total Entries: "<<analysis_params->entries_unpacked<<endl;
+      cout<<"Unpacker [ERROR] Data beyond this point would be corrupt and thus I am exiting to analysis!  Set Recover_Corrupt_Data to skip it"<<RESET<<endl;
+      return -1;
+    }
+    //Keep the entries decoded before the bad header or size and skip the rest of the bank
+    else if(board_bank.status < 0) {
+      Skip_Corrupt_Data(gz_in,
+                        board_bank.status == -1 ? "CAEN Data Header is NOT 10" : "CAEN Aggregate Sizes do not match the MIDAS Bank Size",
+                        (uint64_t)(board_bank.nwords - board_bank.error_pos)*sizeof(uint32_t), 0, 1, analysis_params);
+      event_good = false;
+    }
+
+    //Channels past the first 16 (x27xx) are in the next channel table boards
+    for(int cee=0; cee<Bank_Channels; cee++) {
+      if(board_bank.rejected[cee] > 0) {
+        Add_Rejected_Entries(board_bank.boardid + cee/Table_Channels, cee%Table_Channels, board_bank.rejected[cee]);
+      }
+    }
+
+    uint32_t nhits = board_bank.hits.size();
+    if(nhits == 0) {
+      continue;
+    }
+    if(EVTS + nhits > (uint32_t)input_params->DEVT_Array_Size) {
+      DANCE_Error("Unpacker","MIDAS event does not fit in the DEVT array. Increase DEVT_Array_Size in the cfg file");
+      return -1;
+    }
+
+    memcpy(&db_arr[EVTS], &board_bank.hits[0], nhits*sizeof(DEVT_BANK));
+    EVTS += nhits;
+    analysis_params->entries_unpacked += nhits;
+    analysis_params->entries_awaiting_timesort += nhits;
+
+    //keep track of the smallest timestamp
+    if(board_bank.smallest_timestamp<analysis_params->smallest_timestamp) {
+      analysis_params->smallest_timestamp=board_bank.smallest_timestamp;
+    }
+    if(board_bank.smallest_timestamp<event_smallest_timestamp) {
+      event_smallest_timestamp=board_bank.smallest_timestamp;
+    }
+    //keep track of the largest timestamp
+    if(board_bank.largest_timestamp>analysis_params->largest_timestamp) {
+      analysis_params->largest_timestamp=board_bank.largest_timestamp;
+    }
+  }
+
+  //The first good event with entries after corrupted data ends the lost time range
+  if(event_good && event_smallest_timestamp < Time_Max) {
+    End_Corrupt_Range(event_smallest_timestamp, analysis_params);
+  }
+
+  return 1;
+}
+
+
+//****************** stage1 ******************//
+
+//Only the stage 0 binaries written with WF_Integral carry the waveform integral
+static inline double Stage1_WF_Integral(const DEVT_STAGE1 &devt_stage1) {
+  return 0;
+}
+
+static inline double Stage1_WF_Integral(const DEVT_STAGE1_WF &devt_stage1) {
+  return devt_stage1.wfintegral;
+}
+
+template<typename Stage1_t>
+Stage1_Decoder<Stage1_t>::Stage1_Decoder(Input_Parameters *input_params, const char *name) : Data_Decoder(input_params) {
+  this->name = name;
+  records.resize(Stage1ReadSize);
+}
+
+template<typename Stage1_t>
+int Stage1_Decoder<Stage1_t>::Read_Record(gzFile gz_in, DEVT_BANK *db_arr, uint32_t &EVTS, Analysis_Parameters *analysis_params) {
+
+  //Read up to the end of the block so blocks are the same size as reading entry by entry
+  uint32_t nrecords = records.size();
+  uint32_t block_size = input_params->Block_Buffer_Size;
+  uint32_t array_size = input_params->DEVT_Array_Size;
+  if(EVTS < block_size && block_size - EVTS < nrecords) {
+    nrecords = block_size - EVTS;
+  }
+  if(EVTS + nrecords > array_size) {
+    nrecords = array_size - EVTS;
+  }
+
+  int gzret = gzread(gz_in,&records[0],nrecords*sizeof(Stage1_t));
+
+  //Nothing left in this file (a partial entry at the end is dropped)
+  if(gzret < (int)sizeof(Stage1_t)) {
+    return 0;
+  }
+
+  bytes_read += gzret;
+  nrecords = gzret/sizeof(Stage1_t);
+
+  uint32_t naccepted = 0;
+
+  for(uint32_t eye=0; eye<nrecords; eye++) {
+
+    DEVT_BANK &hit = db_arr[EVTS];
+    const Stage1_t &devt_stage1 = records[eye];
+
+    //Skip IDs excluded in the cfg file
+    if(!channel_table.detector[devt_stage1.ID].accepted) {
+      Add_Rejected_ID(devt_stage1.ID);
+      continue;
+    }
+
+    //Fill the array
+    hit.timestamp = Time_From_ns(devt_stage1.timestamp);
+    hit.wfintegral = Stage1_WF_Integral(devt_stage1);
+    hit.Ifast = devt_stage1.Ifast;
+    hit.Islow = devt_stage1.Islow;
+    hit.ID = devt_stage1.ID;
+    hit.Valid = 1; //Everything starts valid
+    hit.InvalidReason = 0; //Everything starts valid
+    hit.pileup_detected = 0;
+
+    //Time deviations and delays
+    hit.timestamp += channel_table.detector[hit.ID].time_offset_ticks;
+
+    //keep track of the smallest timestamp
+    if(hit.timestamp<analysis_params->smallest_timestamp) {
+      analysis_params->smallest_timestamp=hit.timestamp;
+    }
+    //keep track of the largest timestamp
+    if(hit.timestamp>analysis_params->largest_timestamp) {
+      analysis_params->largest_timestamp=hit.timestamp;
+    }
+
+    EVTS++;
+    naccepted++;
+  }
+
+  analysis_params->entries_unpacked += naccepted;
+  analysis_params->entries_awaiting_timesort += naccepted;
+
+  return 1;
+}
+
+//The input format is resolved once from the cfg file
+Data_Decoder* Make_Data_Decoder(Input_Parameters *input_params) {
+
+  //Stage 0 unpacking/stage 1 from midas
+  if(input_params->Read_Binary==0 && input_params->Read_Simulation==0) {
+    if(strcmp(input_params->DataFormat.c_str(),"caen2015") == 0) {
+      return new CAEN2015_Decoder(input_params);
+    }
+    else if(strcmp(input_params->DataFormat.c_str(),"caen2018") == 0) {
+      return new CAEN2018_Decoder(input_params, "caen2018", &Select_Board_Bank_Decoder);
+    }
+    else if(strcmp(input_params->DataFormat.c_str(),"x27xx") == 0) {
+      return new CAEN2018_Decoder(input_params, "x27xx", &Select_X27xx_Board_Bank_Decoder);
+    }
+    umsg.str("");
+    umsg<<"I dont understand Data Format "<<input_params->DataFormat;
+    DANCE_Error("Unpacker",umsg.str());
+    return NULL;
+  }
+
+  //GEANT4 simulation
+  if(input_params->Read_Simulation==1) {
+    return new Stage1_Decoder<DEVT_STAGE1>(input_params,"GEANT4 simulation");
+  }
+
+  //Stage 0 binaries
+  if(input_params->WF_Integral) {
+    return new Stage1_Decoder<DEVT_STAGE1_WF>(input_params,"stage0 binary with WF integral");
+  }
+  return new Stage1_Decoder<DEVT_STAGE1>(input_params,"stage0 binary");
+}
+
+//Start of unpacking, and the time and bytes read at the last progress statement, for the rates
+static double progress_begin = 0;
+static double progress_time = 0;
+static uint64_t progress_bytes = 0;
+
+//Progress statement: the counters of the unpacker, sort, eventbuilder and analyzer, the time sorted buffer (buffer_entries between
+//oldest_timestamp and newest_timestamp) and the read rates from total_bytes
+void Print_Progress(const Input_Parameters &input_params, const Analysis_Parameters *analysis_params, size_t buffer_entries, int64_t oldest_timestamp, int64_t newest_timestamp, uint64_t total_bytes) {
+
+  if(input_params.Read_Simulation == 0) {
+    cout<<"Processing Run Number: "<<input_params.RunNumber<<endl;
+  }
+  else {
+    cout<<"Processing Simulated Data"<<endl;
+  }
+
+  if(buffer_entries>0) {
+    cout<<"datadeque size non-zero: " << buffer_entries <<endl;
+    cout<<"Oldest Time in the Buffer: "<<Time_To_ns(oldest_timestamp)<<endl;
+    cout<<"Newest Time in the Buffer: "<<Time_To_ns(newest_timestamp)<<endl;
+  }
+
+  cout<<analysis_params->entries_unpacked<<" Entries Unpacked "<<endl;
+  cout<<analysis_params->entries_awaiting_timesort<<" Entries Awaiting timesort"<<endl;
+  cout<<buffer_entries<<" Entries Sorted and in the Buffer"<<endl;
+#ifdef CheckBufferDepth
+  if(analysis_params->max_buffer_utilization < 0.75) {
+    cout<<GREEN<<" Max Buffer Utilization: "<<100.0*analysis_params->max_buffer_utilization<<" %"<<RESET<<endl;
+  }
+  else if(analysis_params->max_buffer_utilization < 0.90) {
+    cout<<YELLOW<<" Max Buffer Utilization: "<<100.0*analysis_params->max_buffer_utilization<<" %"<<RESET<<endl;
+  }
+  else {
+    cout<<RED<<" Max Buffer Utilization: "<<100.0*analysis_params->max_buffer_utilization<<" %"<<RESET<<endl;
+  }
 #endif
- 
-              } //End of while(TotalBankSize > 0)
-            
-            } // End of Event ID 2 (Scalers)
- 
-            // 0x8000 is a begin of run
-            // 0x8001 is an end of run
-            // 0x8002 is an ASCII message created by the logger 
-          
-            else if(head.fEventId==0x8000 || head.fEventId==0x8001 || head.fEventId==0x8002 || head.fEventId == 9 ) {
-              //see if its the end of run
-              if(head.fEventId==0x8001) {
-                subrun=false;
-                break;
-              }
-              
-              char *fData;
-              fData=(char*)malloc(head.fDataSize);
-              gzret=gzread(gz_in,fData,head.fDataSize);
-              free (fData);        
-            }
-                    
-            else {
-              // cout<<"EventID: "<<head.fEventId<<" Unknown"<<endl;
- 
-              TotalBankSize=TotalDataSize;
-              
-              uint32_t garbage;
-              while(TotalBankSize > 0) {
-                gzret = gzread(gz_in,&garbage, sizeof(garbage));
-                TotalBankSize -= sizeof(garbage);
-                //cout<<"Garbage Total Bank Size: "<<TotalBankSize<<endl;
-              }            
- 
-            }  //End of catchall   
-          }  //End of EventHeader gzret > 0
-        } //End of caen2018 format check
+  cout<<analysis_params->entries_written_to_binary<<" Entries Written to Binary"<<endl;
+  cout<<analysis_params->entries_invalid<<" Entries Invalid ("<<100.0*analysis_params->entries_invalid/analysis_params->entries_processed<<" %)"<<endl;
+  cout<<analysis_params->entries_built<<" Entries Built into "<<analysis_params->events_built<<" Events"<<endl;
+  cout<<analysis_params->event_vector_reallocations<<" Event Vector Reallocations"<<endl;
+  cout<<"Analyzed "<<analysis_params->entries_analyzed<<" Entries from "<<analysis_params->events_analyzed<<" Events"<<endl;
+
+  cout<<setw(20)<<left<<"Breakdown:"<<setw(12)<<left<<"DANCE"<<setw(12)<<left<<"T0"<<setw(12)<<left<<"Li6"<<setw(12)<<left<<"U235"<<setw(12)<<left<<"He3"<<setw(12)<<left<<"Background"<<setw(12)<<left<<"Unknown"<<setw(12)<<left<<endl;
+
+  cout<<setw(20)<<left<<"Entries:"<<setw(12)<<left<<analysis_params->DANCE_entries_analyzed;
+  cout<<setw(12)<<left<<analysis_params->T0_entries_analyzed;
+  cout<<setw(12)<<left<<analysis_params->Li6_entries_analyzed;
+  cout<<setw(12)<<left<<analysis_params->U235_entries_analyzed;
+  cout<<setw(12)<<left<<analysis_params->He3_entries_analyzed;
+  cout<<setw(12)<<left<<analysis_params->Bkg_entries_analyzed;
+  cout<<setw(12)<<left<<analysis_params->Unknown_entries<<endl;
+
+  cout<<setw(20)<<left<<"Events:"<<setw(12)<<left<<analysis_params->DANCE_events_analyzed;
+  cout<<setw(12)<<left<<analysis_params->T0_events_analyzed;
+  cout<<setw(12)<<left<<analysis_params->Li6_events_analyzed;
+  cout<<setw(12)<<left<<analysis_params->U235_events_analyzed;
+  cout<<setw(12)<<left<<analysis_params->He3_events_analyzed;
+  cout<<setw(12)<<left<<analysis_params->Bkg_events_analyzed<<endl;
+
+  if(analysis_params->DANCE_events_analyzed > 0) {
+    cout<<setw(20)<<left<<"Average Mult:"<<setw(12)<<left<<(1.0*analysis_params->DANCE_entries_analyzed)/(1.0*analysis_params->DANCE_events_analyzed)<<endl;
+  }
+  cout<<endl;
+
+  struct timeval tv;
+  gettimeofday(&tv,NULL);
+  double time_elapsed=tv.tv_sec+(tv.tv_usec/1000000.0);
+
+  uint64_t bytes_read = total_bytes - progress_bytes;
+
+  cout << "Average Entry Processing Rate: "<<(double)analysis_params->entries_unpacked/(time_elapsed-progress_begin)<<" Entries per second "<<endl;
+  cout << "Average Data Read Rate: "<<(double)total_bytes/(time_elapsed-progress_begin)/(1024.0*1024.0)<<" MB/s"<<endl;
+  cout << "Instantaneous Data Read Rate: "<<(double)bytes_read/(time_elapsed-progress_time)/(1024.0*1024.0)<<" MB/s"<<endl;
+  cout << (double)total_bytes/(1024.0*1024.0*1024.0)<<" GiB Read"<<endl<<endl<<endl;
+
+  progress_bytes = total_bytes;
+  progress_time = time_elapsed;
+}
+
+int Unpack_Data(queue<gzFile> &gz_queue, double begin, Input_Parameters input_params, Analysis_Parameters *analysis_params) {
+
+  gzFile gz_in;
+
+  //Boolean control variables
+  bool run=true;
+
+  //Structures to put data in
+  Sorted_Buffer datadeque(input_params.Pipeline ? 1 : 2*input_params.DEVT_Array_Size);  //Storage container for time sorted data (starts with room for a couple of blocks, the pipeline has its own)
+  DEVT_BANK *db_arr = NULL;        //Storage array for entries (the blocks of the pipeline with Pipeline on)
+  if(!input_params.Pipeline) {
+    db_arr = new DEVT_BANK[input_params.DEVT_Array_Size];
+  }
+
+  //The buffer depth starts at Buffer_Depth and is raised by sort_array if entries arrive later than that
+  analysis_params->buffer_depth = input_params.Buffer_Depth;
+
+  //Window of the stage 1 block sort from the time offsets
+  Set_Sort_Window(input_params);
+
+  //Counters
+  uint32_t EVTS=0;              //Total number of entries unpacked since last time sort
+  uint32_t progresscounter=1;   //Keep track of how many progress statements have been made
+  bool progress_due=false;      //A progress statement is due from the pipeline after the next block
+  int read_ret=0;               //Return of the decoder
+
+  //time profiling for performance
+  struct timeval tv;              //Real time
+
+  //waveform ratio gates
+  char gatename[200];
+  sprintf(gatename,"Gates/%s",PILEUPGATE);
+  ifstream pileupcutin(gatename);
+  if(pileupcutin.is_open()){
+    pileupcutin >> wf_ratio_low >> wf_ratio_high;
+  }
+  else {
+    umsg.str("");
+    umsg<<"Failed to Load waveform ratio Cut " << gatename;
+    DANCE_Error("Unpacker",umsg.str());
+    delete [] db_arr;
+    return -1;
+  }
+  pileupcutin.close();
+
+  //Decoder for the input format
+  Data_Decoder *decoder = Make_Data_Decoder(&input_params);
+  if(!decoder) {
+    delete [] db_arr;
+    return -1;
+  }
+
+  umsg.str("");
+  umsg<<"Data Format: "<<decoder->Name();
+  DANCE_Info("Unpacker",umsg.str());
+
+  //Sort and eventbuild, and analyze, on their own threads
+  if(input_params.Pipeline) {
+    func_ret = Start_Pipeline(input_params,analysis_params);
+    if(func_ret) {
+      delete decoder;
+      return -1;
+    }
+    db_arr = Pipeline_Block();
+  }
+
+  //Start of the unpacking process
+  gettimeofday(&tv,NULL);
+  progress_begin = tv.tv_sec+(tv.tv_usec/1000000.0);
+  progress_time = progress_begin;
+  progress_bytes = 0;
+
+  DANCE_Info("Unpacker","Started Unpacking");
+
+  while(run && !gz_queue.empty()) {
+
+    gz_in=gz_queue.front();
+
+    while(true) {
+
+      //Event limit control
+      if(analysis_params->entries_unpacked > EventLimit) {
+        run=false;
+        break;
+      }
+
+      //Progess indicator
+      if(analysis_params->entries_unpacked > progresscounter*ProgressInterval) {
+        progresscounter++;
+
+        //The analysis stage of the pipeline prints it when it gets to the next block
+        if(input_params.Pipeline) {
+          progress_due = true;
+        }
         else {
-          cout<<RED<<"Unpacker: [ERROR] I dont understand Data Format "<<input_params.DataFormat<<RESET<<endl;
-          return -1;
+          Print_Progress(input_params,analysis_params,datadeque.size(),datadeque.size()>0 ? datadeque.front().timestamp : 0,datadeque.size()>0 ? datadeque.back().timestamp : 0,decoder->Bytes_Read());
         }
- 
-        //At this point we need to start ordering and eventbuilding
-          if(EVTS >= BlockBufferSize) {
-            
-            //Sort this block of data
-            func_ret = sort_array(db_arr,datadeque,EVTS,input_params,analysis_params);
-            if(func_ret) {
-              cout<<RED<<"Problem with sort_array in the MIDAS Reader"<<RESET<<endl;
-              return -1;
-            }
-                    
-            //Eventbuild
-            func_ret = Build_Events(datadeque,input_params,analysis_params);
-            if(func_ret) {
-              cout<<RED<<"Problem with build_events in the MIDAS Reader"<<RESET<<endl;
-              return -1;
-            }
-  
-            //Reset the event counter and smallest timestamp
-            EVTS=0;
-            analysis_params->entries_awaiting_timesort=0;
-            analysis_params->smallest_timestamp=2.814749767e14;
-            
-          } //end check on block buffer size and eventbuild
-        }//end while subrun
-
-        gz_queue.pop();
-        if (gz_queue.size()>0) {
-          //currently unused
-          analysis_params->largest_subrun_timestamp=analysis_params->largest_timestamp;
-
-          //grab the new subrun
-          gz_in=gz_queue.front();
-          input_params.SubRunNumber++;
-          subrun=true;
+      } //end progress indicator
+
+      //Read the next MIDAS event or block of stage1 entries
+      read_ret = decoder->Read_Record(gz_in, db_arr, EVTS, analysis_params);
+      if(read_ret < 0) {
+        delete decoder;
+        if(input_params.Pipeline) {
+          Abort_Pipeline();
         }
         else {
-          run=false;
-          break;
+          delete [] db_arr;
         }
-      }  //end of while run
+        return -1;
+      }
+      //End of the subrun
+      else if(read_ret == 0) {
+        break;
+      }
 
+      //At this point we need to start ordering and eventbuilding
+      if(EVTS >= (uint32_t)input_params.Block_Buffer_Size && input_params.Pipeline) {
 
-      cout<<"Unpacker [INFO]: Run Length: "<<analysis_params->largest_timestamp/1000000000.0<<" seconds"<<endl;
- 
-      //Now that we are done sorting we need to empty the buffer
-      cout<<GREEN<<"Unpacker [INFO]: Finished Unpacking Data"<<RESET<<endl;
-    
-      //see if anything is left in the unsorted part
-      if(EVTS>0) {
- 
-        umsg.str("");
-        umsg<<"Unpacker [INFO]: There are "<<EVTS<<" Entries left to sort and "<<datadeque.size()<<" Entries left in the Buffer";
-        DANCE_Info("Unpacker",umsg.str());
-        
-        //Sort this block of data
-        func_ret = sort_array(db_arr,datadeque,EVTS,input_params,analysis_params);
+        //Hand the block to the pipeline to sort and eventbuild, and unpack into the next one
+        func_ret = Send_Pipeline_Block(EVTS,progress_due,analysis_params,decoder->Bytes_Read());
         if(func_ret) {
-          cout<<RED<<"Problem with sort_array in the empty stage of the MIDAS Reader"<<RESET<<endl;
+          DANCE_Error("Unpacker","Problem in the pipeline");
+          delete decoder;
+          Abort_Pipeline();
           return -1;
         }
- 
+        db_arr = Pipeline_Block();
+        progress_due = false;
+
+        //Reset the event counter and smallest timestamp
         EVTS=0;
         analysis_params->entries_awaiting_timesort=0;
- 
+        analysis_params->smallest_timestamp=Time_Max;
       }
-    
-      if(datadeque.size()>0) {
- 
-        //need to set the buffer depth to zero
-        input_params.Buffer_Depth = 0;
- 
-        //Eventbuild
-        func_ret = Build_Events(datadeque,input_params,analysis_params);
-        if(func_ret) {
-          cout<<RED<<"Problem with build_events in the empty stage of the MIDAS Reader"<<RESET<<endl;
-          return -1;
-        }
- 
-        if(datadeque.size()==0) {
-          cout<<GREEN<<"Unpacker [INFO]: Buffer empty, unpacking complete."<<RESET<<endl;
-        }
-      } //end check on timesort and datadeque
- 
-    } // END OF MIDAS READER
- 
- 
-    //Stage 1 unpacker
-    if(input_params.Read_Binary==1 || input_params.Read_Simulation==1) {
- 
-      while(run) {
-        
-        //Event limit control
-        if(analysis_params->entries_unpacked > EventLimit) {
-          run=false;
-          gz_queue.pop();
-        }
-        
-        //Progress indicator
-        if(analysis_params->entries_unpacked > progresscounter*ProgressInterval) {
-          progresscounter++;
-          if(input_params.Read_Simulation == 0) {
-            cout<<"Processing Run Number: "<<input_params.RunNumber<<endl;
-          }
-          else {
-            cout<<"Processing Simulated Data"<<endl;
-          }
- 
-          cout<<analysis_params->entries_unpacked<<" Entries Unpacked "<<endl;
-          cout<<analysis_params->entries_awaiting_timesort<<" Entries Awaiting timesort"<<endl;
-          cout<<datadeque.size()<<" Entries Sorted and in the Buffer"<<endl;
-#ifdef CheckBufferDepth
-          if(analysis_params->max_buffer_utilization < 0.75) {
-            cout<<GREEN<<" Max Buffer Utilization: "<<100.0*analysis_params->max_buffer_utilization<<" %"<<RESET<<endl;
-          }
-          else if(analysis_params->max_buffer_utilization < 0.90) {
-            cout<<YELLOW<<" Max Buffer Utilization: "<<100.0*analysis_params->max_buffer_utilization<<" %"<<RESET<<endl;
-          }
-          else {
-            cout<<RED<<" Max Buffer Utilization: "<<100.0*analysis_params->max_buffer_utilization<<" %"<<RESET<<endl;
-          }
-#endif
-          cout<<analysis_params->entries_written_to_binary<<" Entries Written to Binary"<<endl;
-          cout<<analysis_params->entries_invalid<<" Entries Invalid ("<<100.0*analysis_params->entries_invalid/analysis_params->entries_processed<<" %)"<<endl;
-          cout<<analysis_params->entries_built<<" Entries Built into "<<analysis_params->events_built<<" Events"<<endl;
-          cout<<"Analyzed "<<analysis_params->entries_analyzed<<" Entries from "<<analysis_params->events_analyzed<<" Events"<<endl;
- 
-          cout<<setw(20)<<left<<"Breakdown:"<<setw(12)<<left<<"DANCE"<<setw(12)<<left<<"T0"<<setw(12)<<left<<"Li6"<<setw(12)<<left<<"U235"<<setw(12)<<left<<"He3"<<setw(12)<<left<<"Background"<<setw(12)<<left<<"Unknown"<<setw(12)<<left<<endl;
- 
-          cout<<setw(20)<<left<<"Entries:"<<setw(12)<<left<<analysis_params->DANCE_entries_analyzed;
-          cout<<setw(12)<<left<<analysis_params->T0_entries_analyzed;
-          cout<<setw(12)<<left<<analysis_params->Li6_entries_analyzed;
-          cout<<setw(12)<<left<<analysis_params->U235_entries_analyzed;
-          cout<<setw(12)<<left<<analysis_params->He3_entries_analyzed;
-          cout<<setw(12)<<left<<analysis_params->Bkg_entries_analyzed;
-          cout<<setw(12)<<left<<analysis_params->Unknown_entries<<endl;
- 
-          cout<<setw(20)<<left<<"Events:"<<setw(12)<<left<<analysis_params->DANCE_events_analyzed;
-          cout<<setw(12)<<left<<analysis_params->T0_events_analyzed;
-          cout<<setw(12)<<left<<analysis_params->Li6_events_analyzed;
-          cout<<setw(12)<<left<<analysis_params->U235_events_analyzed;
-          cout<<setw(12)<<left<<analysis_params->He3_events_analyzed;
-          cout<<setw(12)<<left<<analysis_params->Bkg_events_analyzed<<endl;
- 
-          if(analysis_params->DANCE_events_analyzed > 0) {
-            cout<<setw(20)<<left<<"Average Mult:"<<setw(12)<<left<<(1.0*analysis_params->DANCE_entries_analyzed)/(1.0*analysis_params->DANCE_events_analyzed)<<endl;
-          }
-          cout<<endl;
- 
-          gettimeofday(&tv,NULL); 
-          time_elapsed=tv.tv_sec+(tv.tv_usec/1000000.0);
-        
-          cout << "Average Entry Processing Rate: "<<(double)analysis_params->entries_unpacked/(time_elapsed-unpack_begin)<<" Entries per second "<<endl;
-          cout << "Average Data Read Rate: "<<(double)TOTAL_BYTES/(time_elapsed-unpack_begin)/(1024.0*1024.0)<<" MB/s"<<endl;
-          cout << "Instantaneous Data Read Rate: "<<(double)BYTES_READ/(time_elapsed-time_elapsed_old)/(1024.0*1024.0)<<" MB/s"<<endl;
-          cout << (double)TOTAL_BYTES/(1024.0*1024.0*1024.0)<<" GiB Read"<<endl<<endl<<endl;
-          
-          BYTES_READ=0;
-          time_elapsed_old = time_elapsed;
-        }
-        
-        gzret=gzread(gz_in,&devt_stage1,sizeof(DEVT_STAGE1));
-        // gzseek(gz_in,devt_padding,SEEK_CUR);
-        
-        if(gzret!=0) {
-          
-          BYTES_READ += gzret;
-          TOTAL_BYTES += gzret;
-          
-          //Fill the array
-          db_arr[EVTS].timestamp = devt_stage1.timestamp;
-          db_arr[EVTS].Ifast = devt_stage1.Ifast;
-          db_arr[EVTS].Islow = devt_stage1.Islow;
-          db_arr[EVTS].ID = devt_stage1.ID;
-          db_arr[EVTS].Valid = 1; //Everything starts valid
-          db_arr[EVTS].InvalidReason = 0; //Everything starts valid
- 
-          //Time Deviations
-          if(input_params.Analysis_Stage > 0) {
-            //need to add the time deviations before time sorting
-            if(db_arr[EVTS].ID < 200) {
-              db_arr[EVTS].timestamp += TimeDeviations[db_arr[EVTS].ID];
-            }
-            
-            //Add the DANCE delay
-            if(db_arr[EVTS].ID < 162) {
-              db_arr[EVTS].timestamp += DANCE_Delay;
-            }
- 
-            //Add the He3 delay
-            if(db_arr[EVTS].ID == He3_ID) {
-              db_arr[EVTS].timestamp += He3_Delay;
-            } 
-            
-            //Add the U235 delay
-            if(db_arr[EVTS].ID == U235_ID) {
-              db_arr[EVTS].timestamp += U235_Delay;
-            } 
-            
-            //Add the Li6 delay
-            if(db_arr[EVTS].ID == Li6_ID) {
-              db_arr[EVTS].timestamp += Li6_Delay;
-            }
-          }
- 
-          db_arr[EVTS].TOF = db_arr[EVTS].timestamp;                                            //Start with TOF as Full timestamp in ns
- 
- 
-          //keep track of the smallest timestamp
-          if(db_arr[EVTS].TOF<analysis_params->smallest_timestamp) {
-            analysis_params->smallest_timestamp=db_arr[EVTS].TOF;
-          }    
-          //keep track of the largest timestamp
-          if(db_arr[EVTS].TOF>analysis_params->largest_timestamp) {
-            analysis_params->largest_timestamp=db_arr[EVTS].TOF;
-          }  
-            
-          EVTS++;           
- 
-          analysis_params->entries_unpacked++;
-          analysis_params->entries_awaiting_timesort++;
- 
-        }
-        else {
-          run=false;
-          gz_queue.pop();
-          break;
-        }
- 
-        //At this point we need to start ordering and eventbuilding
-        if(EVTS >= BlockBufferSize) {
-          
-          //sort this block of data
-          func_ret = sort_array(db_arr,datadeque,EVTS,input_params,analysis_params);
-          if(func_ret) {
-            cout<<RED<<"Problem with sort_array in the Binary Reader"<<RESET<<endl;
-            return -1;
-          }
- 
-          //Eventbuild
-          func_ret = Build_Events(datadeque,input_params, analysis_params);
-          if(func_ret) {
-            cout<<RED<<"Problem with build_events in the Binary Reader"<<RESET<<endl;
-            return -1;
-          }
-          
-          //Reset the event counter and smallest timestamp
-          EVTS=0;
-          analysis_params->entries_awaiting_timesort=0;
-          analysis_params->smallest_timestamp=2.814749767e14;
-                  
-        }        
-      }  //end of while(run)
- 
-      umsg.str("");
-      umsg<<"Run Length: "<<analysis_params->largest_timestamp/1000000000.0<<" seconds";
-      DANCE_Info("Unpacker",umsg.str());
- 
-      //Now that we are done sorting we need to empty the buffer
-      DANCE_Info("Unpacker","Finished unpacking data");
-    
-      //see if anything is left in the unsorted part
-      if(EVTS>0) {
-        umsg.str("");
-        umsg<<"There are "<<EVTS<<" Entries left to sort and "<<datadeque.size()<<" Entries left in the Buffer";
-        DANCE_Info("Unpacker",umsg.str());
- 
+      else if(EVTS >= (uint32_t)input_params.Block_Buffer_Size) {
+
         //Sort this block of data
         func_ret = sort_array(db_arr,datadeque,EVTS,input_params,analysis_params);
         if(func_ret) {
-          DANCE_Error("Unpacker","Problem with sort_array in the empty stage of the Binary Reader");
+          DANCE_Error("Unpacker","Problem with sort_array");
+          delete decoder;
+          delete [] db_arr;
           return -1;
         }
-        
-        EVTS=0;
-        analysis_params->entries_awaiting_timesort=0;
-      }
-    
-      if(datadeque.size()>0) {
- 
-        //need to set the buffer depth to zero
-        input_params.Buffer_Depth = 0;
- 
+
         //Eventbuild
-        func_ret = Build_Events(datadeque,input_params, analysis_params);
+        func_ret = Build_Events(datadeque,input_params,analysis_params);
         if(func_ret) {
-          DANCE_Error("Unpacker","Problem with build_events in the empty stage of the Binary Reader");
+          DANCE_Error("Unpacker","Problem with build_events");
+          delete decoder;
+          delete [] db_arr;
           return -1;
         }
-         
-        if(datadeque.size()==0) {
-          DANCE_Success("Unpacker","Buffer empty, unpacking complete.");
-        }
-      }
-    } //end of if(input_params.Read_Binary==1)
 
+        //Reset the event counter and smallest timestamp
+        EVTS=0;
+        analysis_params->entries_awaiting_timesort=0;
+        analysis_params->smallest_timestamp=Time_Max;
+
+      } //end check on block buffer size and eventbuild
+    } //end of loop over the subrun
+
+    gz_queue.pop();
+    if(run && gz_queue.size()>0) {
+      //currently unused
+      analysis_params->largest_subrun_timestamp=analysis_params->largest_timestamp;
+
+      //grab the new subrun
+      input_params.SubRunNumber++;
+    }
+  } //end of loop over the subruns
+
+  //Files left after the event limit are not read
+  while(!gz_queue.empty()) {
+    gz_queue.pop();
+  }
+
+  umsg.str("");
+  umsg<<"Run Length: "<<Time_To_ns(analysis_params->largest_timestamp)/1000000000.0<<" seconds";
+  DANCE_Info("Unpacker",umsg.str());
+
+  //Now that we are done sorting we need to empty the buffer
+  DANCE_Info("Unpacker","Finished unpacking data");
+  Report_Rejected_Entries();
+
+  if(analysis_params->corrupt_ranges > 0) {
+    umsg.str("");
+    umsg<<"Found "<<analysis_params->corrupt_ranges<<" Stretches of Corrupted or Truncated Data: Skipped "<<analysis_params->corrupt_bytes_skipped<<" Bytes, ";
+    umsg<<analysis_params->corrupt_events_skipped<<" MIDAS Events, and the rest of "<<analysis_params->corrupt_banks_skipped<<" Board Banks";
+    DANCE_Error("Unpacker",umsg.str());
+  }
+
+  //The pipeline sorts what is left in the unsorted part and empties its buffer
+  if(input_params.Pipeline) {
+    if(EVTS>0) {
+      umsg.str("");
+      umsg<<"There are "<<EVTS<<" Entries left to sort";
+      DANCE_Info("Unpacker",umsg.str());
+    }
+
+    func_ret = Stop_Pipeline(EVTS,analysis_params);
+    if(func_ret) {
+      DANCE_Error("Unpacker","Problem in the pipeline in the empty stage");
+      delete decoder;
+      return -1;
+    }
+
+    EVTS=0;
+    analysis_params->entries_awaiting_timesort=0;
+  }
+
+  //see if anything is left in the unsorted part
+  else if(EVTS>0) {
+    umsg.str("");
+    umsg<<"There are "<<EVTS<<" Entries left to sort and "<<datadeque.size()<<" Entries left in the Buffer";
+    DANCE_Info("Unpacker",umsg.str());
+
+    //Sort this block of data
+    func_ret = sort_array(db_arr,datadeque,EVTS,input_params,analysis_params);
+    if(func_ret) {
+      DANCE_Error("Unpacker","Problem with sort_array in the empty stage");
+      delete decoder;
+      delete [] db_arr;
+      return -1;
+    }
+
+    EVTS=0;
+    analysis_params->entries_awaiting_timesort=0;
+  }
+
+  umsg.str("");
+  umsg<<"Latest Entries: "<<analysis_params->max_lateness/1.0e9<<" seconds behind the newest entry in the buffer";
+  if(analysis_params->max_lateness_ID >= 0) {
+    umsg<<" (ID "<<analysis_params->max_lateness_ID<<")";
+  }
+  umsg<<".  Buffer Depth: "<<input_params.Buffer_Depth<<" seconds at the start, "<<analysis_params->buffer_depth<<" seconds at the end";
+  DANCE_Info("Unpacker",umsg.str());
+  if(analysis_params->late_entries > 0) {
+    umsg.str("");
+    umsg<<analysis_params->late_entries<<" Entries arrived after their time was event built";
+    if(analysis_params->buffer_memory_limited) {
+      umsg<<" (the buffer depth was held back by Max_Buffer_Memory)";
+    }
+    umsg<<".  Rerun with Buffer_Depth of at least "<<Buffer_Depth_Margin*analysis_params->max_lateness/1.0e9<<" seconds";
+    DANCE_Error("Unpacker",umsg.str());
+  }
+
+  umsg.str("");
+  umsg<<"Time ordered "<<analysis_params->blocks_sorted<<" Blocks: "<<analysis_params->blocks_window_sorted<<" window sorted, ";
+#ifdef Sort_Merge_Streams
+  umsg<<analysis_params->blocks_sorted-analysis_params->blocks_window_sorted-analysis_params->blocks_fully_sorted<<" merged from the channel streams, ";
+#endif
+  umsg<<analysis_params->blocks_fully_sorted<<" fully sorted";
+  DANCE_Info("Unpacker",umsg.str());
+
+  if(datadeque.size()>0) {
 
-    func_ret = Write_Root_File(input_params, analysis_params);
+    //need to set the buffer depth to zero
+    analysis_params->buffer_depth = 0;
 
-    if (func_ret) {
+    //Eventbuild
+    func_ret = Build_Events(datadeque,input_params,analysis_params);
+    if(func_ret) {
+      DANCE_Error("Unpacker","Problem with build_events in the empty stage");
+      delete decoder;
+      delete [] db_arr;
       return -1;
     }
-    if (gz_queue.size()==1){gz_queue.pop();} 
-  } 
+
+    if(datadeque.size()==0) {
+      DANCE_Success("Unpacker","Buffer empty, unpacking complete.");
+    }
+  } //end check on timesort and datadeque
+
+  delete decoder;
+  if(!input_params.Pipeline) {
+    delete [] db_arr;
+  }
+  Stop_Sort_Threads();
+
+  //Everything from the scaler and diagnostics events needs to be in before the root file
+  Stop_Diagnostics();
+
+  func_ret = Write_Root_File(input_params, analysis_params);
+  if (func_ret) {
+    return -1;
+  }
+
   //Make the time deviations if needed (Likely only a stage 0 thing)
   if(input_params.FitTimeDev) {
     Make_Time_Deviations(input_params.RunNumber);
   }
 
-
-
- 
   //Unpacking is finished.  Return the total number of events unpacked and analyzed
   return analysis_params->entries_unpacked;
- 
- 
 }
 
 int Initialize_Unpacker(Input_Parameters input_params) {  
@@ -2364,6 +2578,9 @@ int Initialize_Unpacker(Input_Parameters input_params) {
   if(input_params.FitTimeDev) {
     cout<<"Time Deviations will be determined following analysis"<<endl;
   }
+  cout<<"Probe Unpacker: "<<unpack_vx725_vx730_probe_isa()<<endl;
+  cout<<"Unpacker Threads: "<<input_params.Unpacker_Threads<<endl;
+  cout<<"Sort Threads: "<<input_params.Sort_Threads<<endl;
   cout<<endl;
  
   //initialize histograms
@@ -2375,10 +2592,29 @@ int Initialize_Unpacker(Input_Parameters input_params) {
   //initiliaze the time deviations
   func_ret += Read_TimeDeviations(input_params);
 
-  //Make the ouput diagnostics file
-  if(input_params.Analysis_Stage == 0 && (strcmp(input_params.DataFormat.c_str(),"caen2018") == 0) && input_params.Read_Simulation==0) {
-    func_ret += Make_Output_Diagnostics_File(input_params.RunNumber);
-  }
+#ifdef Validate_ChAgg_Decoders
+  //check the specialized channel aggregate decoders
+  func_ret += test_vx725_vx730_decoders();
+#endif
+
+#ifdef Validate_X27xx_Decoder
+  //round trip synthetic events through the x27xx decoder
+  func_ret += test_x27xx_psd_decoder();
+#endif
+
+  //Threads sorting the blocks (Sort_Threads in the cfg file)
+  func_ret += Start_Sort_Threads(input_params);
+
+#ifdef Benchmark_Block_Sort
+  //time the block sort
+  func_ret += benchmark_sort(input_params);
+#endif
+
+  //Start the consumer of the scaler and diagnostics events
+  func_ret += Start_Diagnostics(input_params);
+
+  //Waveform reservoirs (Waveform_Reservoir_Size in the cfg file)
+  func_ret += Initialize_Waveform_Reservoir(input_params);
  
   if(func_ret==0) {
     DANCE_Success("Unpacker","Initialized");
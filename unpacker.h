@@ -43,7 +43,7 @@
 //*  Cathleen E. Fry        *//
 //*  cfry@lanl.gov          *//
 //*  unpacker.h             *// 
-//*  Last Edit: 01/22/20    *//  
+//*  Last Edit: 10/19/26    *//  
 //***************************//
 
 #ifndef UNPACKER_H
@@ -55,7 +55,10 @@
 #include <string.h>
 #include <iostream>
 #include <stdint.h>
+#include <sys/time.h>
 #include <queue>
+#include <vector>
+#include <fstream>
 
 //ROOT Includes
 #include "TFile.h"
@@ -63,22 +66,169 @@
 
 //File Includes
 #include "structures.h"
+#include "unpack_vx725_vx730.h"
+#include "unpack_x27xx.h"
+#include "thread_pool.h"
+#include "channel_table.h"
 
 using namespace std;
 
+//Channels of the largest board (x27xx)
+#define Bank_Channels 64
+
+//One caen2018 board bank and the entries decoded from it
+struct Board_Bank_t {
+  vector<uint32_t> words;                //Bank data (firmware word, user extra word, board aggregates)
+  uint32_t nwords;                       //Number of words of the bank in use
+  vector<DEVT_BANK> hits;                //Decoded entries
+  int64_t smallest_timestamp;            //Smallest timestamp of the decoded entries (time ticks)
+  int64_t largest_timestamp;             //Largest timestamp of the decoded entries (time ticks)
+  int status;                            //0 is good, -1 bad board header, -2 aggregate sizes do not fit the bank
+  uint32_t error_pos;                    //Word at which decoding stopped if status is not 0
+  uint8_t boardid;                       //Channel table board of the first 16 channels (the board ID from the firmware word for Vx725/Vx730)
+  uint32_t rejected[Bank_Channels];      //Entries skipped in each channel (not accepted in the channel table)
+};
+
+//Decoding space for one thread (the probe arrays make these large)
+struct Board_Decoder_t {
+  Vx725_Vx730_PSD_Data_t psd_data;
+  Vx725_Vx730_PHA_Data_t pha_data;
+  X27xx_PSD_Data_t x27xx_psd_data;
+};
+
+//Hit decoder for the board aggregates of one firmware (DPP-PSD or DPP-PHA)
+typedef int (*Board_Bank_Decoder_t)(Board_Bank_t *board_bank, Board_Decoder_t *decoder, Input_Parameters *input_params);
+
+//Input decoders.  One is made from the cfg file before unpacking starts and reads the records
+//of its format (MIDAS events or stage1 entries) into the block of entries awaiting the time sort
+class Data_Decoder {
+ public:
+  Data_Decoder(Input_Parameters *input_params);
+  virtual ~Data_Decoder() {}
+
+  //Reads the next record into db_arr.  Returns 1 if a record was read, 0 at the end of the file and -1 on an error
+  virtual int Read_Record(gzFile gz_in, DEVT_BANK *db_arr, uint32_t &EVTS, Analysis_Parameters *analysis_params) = 0;
+  virtual const char* Name() = 0;
+
+  uint64_t Bytes_Read() { return bytes_read; }
+
+ protected:
+  Input_Parameters *input_params;
+  uint64_t bytes_read;           //Total number of Bytes read
+};
+
+//MIDAS files.  Reads the event headers and, with Recover_Corrupt_Data on, scans past corrupted
+//data to the next good data event header and records the time range that was lost
+class MIDAS_Decoder : public Data_Decoder {
+ public:
+  MIDAS_Decoder(Input_Parameters *input_params);
+
+ protected:
+  //Reads the next event header (and the bank header of data events).  Returns 1 if read and 0 at the end of the file
+  int Read_Event_Header(gzFile gz_in, EventHeader_t *head, BankHeader_t *bhead, Analysis_Parameters *analysis_params);
+
+  //Called on corrupted data in an event that has nbytes read.  Returns -1 if not recovering, otherwise
+  //scans to the next event and returns 1 (0 if the file ended first)
+  int Corrupt_Event(gzFile gz_in, const char *reason, uint64_t nbytes, Analysis_Parameters *analysis_params);
+
+  //Called when the file ends inside an event that has nbytes read.  Returns 0
+  int Truncated_Event(gzFile gz_in, uint64_t nbytes, Analysis_Parameters *analysis_params);
+
+  //Counts corrupted data that is skipped and starts a corrupted time range if not in one
+  void Skip_Corrupt_Data(gzFile gz_in, const char *reason, uint64_t nbytes, uint32_t nevents, uint32_t nbanks, Analysis_Parameters *analysis_params);
+
+  //Called after a good data event.  Closes the corrupted time range at the first entry of the event
+  void End_Corrupt_Range(int64_t first_timestamp, Analysis_Parameters *analysis_params);
+
+  //Reads a scaler or diagnostics event and posts it to the diagnostics consumer.  Returns like Read_Record
+  int Post_Side_Event(gzFile gz_in, EventHeader_t *head, Analysis_Parameters *analysis_params);
+
+ private:
+  bool Valid_Event_Header(const EventHeader_t &head, const BankHeader_t &bhead);
+  int Resync(gzFile gz_in, const unsigned char *seed, int nseed, EventHeader_t *head, BankHeader_t *bhead, Analysis_Parameters *analysis_params);
+
+  bool resync_pending;                 //Next header was found by Resync
+  EventHeader_t resync_head;
+  BankHeader_t resync_bhead;
+  bool have_serial;
+  uint32_t last_serial;                //Serial number of the last good data event
+  uint32_t last_time;                  //MIDAS time of the last good data event (s)
+
+  bool in_corrupt_range;               //Between corrupted data and the next good data event
+  int64_t corrupt_begin;               //Largest timestamp before the corrupted data (time ticks)
+  uint32_t corrupt_begin_time;         //MIDAS time of the last good data event before the corrupted data (s)
+  uint64_t range_bytes;                //Bytes skipped in this range
+  uint32_t range_events;               //MIDAS events dropped in this range
+};
+
+//MIDAS events from the caen2015 DAQ (CEVT banks)
+class CAEN2015_Decoder : public MIDAS_Decoder {
+ public:
+  CAEN2015_Decoder(Input_Parameters *input_params);
+  ~CAEN2015_Decoder();
+  int Read_Record(gzFile gz_in, DEVT_BANK *db_arr, uint32_t &EVTS, Analysis_Parameters *analysis_params);
+  const char* Name() { return "caen2015"; }
+
+ private:
+  long devt_padding;                   //padding between banks not divisible by 64 bits
+  short (*imported_peaks)[16384];      //this is actually supported channels / supported length of PXXX bank
+  unsigned short int wf1[15000];
+  CEVT_BANK *evinfo;                   //caen event info
+  test_struct_cevt *evaggr;            //event aggregate
+};
+
+//MIDAS events from the caen2018 DAQ (one bank per V1725/V1730 board running DPP-PSD or DPP-PHA).
+//x27xx boards use the same events with the board bank decoder picked by select_decoder
+class CAEN2018_Decoder : public MIDAS_Decoder {
+ public:
+  CAEN2018_Decoder(Input_Parameters *input_params, const char *name, Board_Bank_Decoder_t (*select_decoder)(uint32_t firmware_word));
+  ~CAEN2018_Decoder();
+  int Read_Record(gzFile gz_in, DEVT_BANK *db_arr, uint32_t &EVTS, Analysis_Parameters *analysis_params);
+  const char* Name() { return name; }
+
+ private:
+  const char *name;
+  Board_Bank_Decoder_t (*select_decoder)(uint32_t firmware_word);  //Board bank decoder from the firmware word
+  vector<Board_Bank_t> board_banks;          //Raw data and decoded entries of each board bank in a MIDAS event
+  vector<Board_Bank_Decoder_t> bank_decoders;  //Hit decoder of each board bank
+  Thread_Pool *board_pool;                   //Threads that decode the boards of a MIDAS event
+  vector<Board_Decoder_t*> board_decoders;   //Decoding space for each thread
+};
+
+//Stage1 entries, from the stage 0 binaries (DEVT_STAGE1 or DEVT_STAGE1_WF) or from GEANT4
+template<typename Stage1_t>
+class Stage1_Decoder : public Data_Decoder {
+ public:
+  Stage1_Decoder(Input_Parameters *input_params, const char *name);
+  int Read_Record(gzFile gz_in, DEVT_BANK *db_arr, uint32_t &EVTS, Analysis_Parameters *analysis_params);
+  const char* Name() { return name; }
+
+ private:
+  const char *name;
+  vector<Stage1_t> records;          //Entries read in one go
+};
+
 //Function prototypes
+Data_Decoder* Make_Data_Decoder(Input_Parameters *input_params);
+Board_Bank_Decoder_t Select_Board_Bank_Decoder(uint32_t firmware_word);
+int Decode_PSD_Board_Bank(Board_Bank_t *board_bank, Board_Decoder_t *decoder, Input_Parameters *input_params);
+int Decode_PHA_Board_Bank(Board_Bank_t *board_bank, Board_Decoder_t *decoder, Input_Parameters *input_params);
+Board_Bank_Decoder_t Select_X27xx_Board_Bank_Decoder(uint32_t firmware_word);
+int Decode_X27xx_PSD_Board_Bank(Board_Bank_t *board_bank, Board_Decoder_t *decoder, Input_Parameters *input_params);
+int Decode_Board_Bank(Board_Bank_t *board_bank, Board_Decoder_t *decoder, Input_Parameters *input_params);
 int Unpack_Data(queue<gzFile> &gz_queue, double begin, Input_Parameters input_params, Analysis_Parameters *analysis_params);
+void Print_Progress(const Input_Parameters &input_params, const Analysis_Parameters *analysis_params, size_t buffer_entries, int64_t oldest_timestamp, int64_t newest_timestamp, uint64_t total_bytes);
 int Make_DANCE_Map();
 int Read_TimeDeviations(Input_Parameters input_params);
-int Make_Output_Diagnostics_File(int RunNumber);
 int Read_DetectorLoad_Histogram(Input_Parameters input_params);
 
 int Create_Unpacker_Histograms(Input_Parameters input_params);
 int Write_Unpacker_Histograms(TFile *fout, Input_Parameters input_params);
 int Write_Root_File(Input_Parameters input_params, Analysis_Parameters *analysis_params);
-double Calculate_Fractional_Time(uint16_t waveform[], uint32_t Ns, uint8_t dual_trace, uint16_t model, Analysis_Parameters *analysis_params);
+double Calculate_Fractional_Time(uint16_t waveform[], uint32_t Ns, uint8_t dual_trace, uint16_t model, double *wf_integral, bool *wf_tail);
 int Make_Output_Binfile(Input_Parameters input_params);
 int Initialize_Unpacker(Input_Parameters input_params);
+int Check_Channel_Table(Input_Parameters input_params);
 
 #endif
 
@@ -46,6 +46,7 @@
 
 #include "validator.h"
 #include "message.h"
+#include "channel_table.h"
 
 #include <iostream>
 #include <fstream>
@@ -166,6 +167,9 @@ int Read_PI_Gates() {
   //  Gamma_Gate->Print();
   Retrigger_Gate=new TCutG("Retrigger_Gate",Nretriggercut,x_retriggercut,y_retriggercut);
 
+  //Hand the gates to the channel table
+  Set_PI_Gates(Gamma_Gate, Alpha_Gate, Retrigger_Gate);
+
 
   DANCE_Success("Validator","Read PI Gates");
 
@@ -224,10 +228,10 @@ int Check_Crystal_Blocking(DEVT_BANK *devt_bank, Analysis_Parameters *analysis_p
   
   int ID = devt_bank->ID;
   
-  double timediff = devt_bank->timestamp - analysis_params->last_timestamp[ID];
+  int64_t timediff = devt_bank->timestamp - analysis_params->last_timestamp[ID];
 
   //Blocking Time to avoid retrigger problems
-  if(timediff < input_params.Crystal_Blocking_Time) {
+  if(timediff < input_params.Crystal_Blocking_Ticks) {
     devt_bank->Valid=0;
     devt_bank->InvalidReason |= Invalid::CrystalBlocking;
 #ifdef Validator_Verbose
@@ -245,7 +249,7 @@ int Check_Retrigger(DEVT_BANK *devt_bank, Analysis_Parameters *analysis_params)
   int ID = devt_bank->ID;
   
   //Time between this crystal hit and the last crystal hit
-  double timediff = devt_bank->timestamp - analysis_params->last_timestamp[ID];
+  double timediff = Time_To_ns(devt_bank->timestamp - analysis_params->last_timestamp[ID]);
 
   //Ratio of this crystal hit and the last crystal hit
   double slowratio = devt_bank->Islow / analysis_params->last_Islow[ID];
@@ -253,7 +257,10 @@ int Check_Retrigger(DEVT_BANK *devt_bank, Analysis_Parameters *analysis_params)
   
   //  cout<<"timediff: "<<timediff<<" ratio: "<<ratio<<"  "<<Retrigger_Gate<<endl;
 
-  if(Retrigger_Gate->IsInside(timediff,slowratio)) {
+  //PI gate of this crystal
+  TCutG *retrigger_gate = channel_table.detector[ID].retrigger_gate;
+
+  if(retrigger_gate->IsInside(timediff,slowratio)) {
     devt_bank->Valid=0;
     devt_bank->InvalidReason += 8;
 #ifdef Validator_Verbose
@@ -261,7 +268,7 @@ int Check_Retrigger(DEVT_BANK *devt_bank, Analysis_Parameters *analysis_params)
 #endif
   }
 
-  if(Retrigger_Gate->IsInside(timediff,fastratio)) {
+  if(retrigger_gate->IsInside(timediff,fastratio)) {
     devt_bank->Valid=0;
     devt_bank->InvalidReason |= Invalid::RetriggerFast;
 #ifdef Validator_Verbose
@@ -277,7 +284,7 @@ int Check_Retrigger(DEVT_BANK *devt_bank, Analysis_Parameters *analysis_params)
 
 int Check_Alpha(DEVT_BANK *devt_bank) {
   
-  if(Alpha_Gate->IsInside(devt_bank->Eslow, devt_bank->Efast)) {
+  if(channel_table.detector[devt_bank->ID].alpha_gate->IsInside(devt_bank->Eslow, devt_bank->Efast)) {
     devt_bank->IsGamma = 0;
     devt_bank->IsAlpha = 1;    
 #ifdef Validator_Verbose
@@ -290,7 +297,7 @@ int Check_Alpha(DEVT_BANK *devt_bank) {
 
 int Check_Gamma(DEVT_BANK *devt_bank) {
   
-  if(Gamma_Gate->IsInside(devt_bank->Eslow, devt_bank->Efast)) {
+  if(channel_table.detector[devt_bank->ID].gamma_gate->IsInside(devt_bank->Eslow, devt_bank->Efast)) {
     devt_bank->IsGamma = 1;
     devt_bank->IsAlpha = 0;    
 #ifdef Validator_Verbose
@@ -0,0 +1,249 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+//***************************//
+//*  waveform_reservoir.cpp *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+//File includes
+#include "waveform_reservoir.h"
+#include "global.h"
+#include "message.h"
+
+//C/C++ includes
+#include <iostream>
+#include <sstream>
+#include <string.h>
+#include <thread>
+#include <functional>
+
+//ROOT includes
+#include "TH1.h"
+#include "TH2.h"
+#include "TH3.h"
+
+using namespace std;
+
+int waveform_reservoir_size = 0;
+
+static Waveform_Reservoir_t reservoirs[256][Waveform_Categories];
+
+static const char *category_names[Waveform_Categories] = {"Good", "Pileup", "Negative"};
+
+//xorshift64* per unpacker thread
+static inline uint64_t Reservoir_Random() {
+  static thread_local uint64_t state = 0;
+  if(state == 0) {
+    state = 0x9E3779B97F4A7C15ULL ^ (uint64_t)hash<thread::id>()(this_thread::get_id());
+    if(state == 0) {
+      state = 1;
+    }
+  }
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return state * 0x2545F4914F6CDD1DULL;
+}
+
+int Initialize_Waveform_Reservoir(Input_Parameters input_params) {
+
+  waveform_reservoir_size = input_params.Waveform_Reservoir_Size;
+  if(waveform_reservoir_size <= 0 || input_params.Read_Binary != 0 || input_params.Read_Simulation != 0) {
+    waveform_reservoir_size = 0;
+    return 0;
+  }
+
+  for(int eye=0; eye<256; eye++) {
+    for(int jay=0; jay<Waveform_Categories; jay++) {
+      reservoirs[eye][jay].seen = 0;
+      reservoirs[eye][jay].slots.clear();
+    }
+  }
+
+  stringstream wmsg;
+  wmsg<<"Keeping "<<waveform_reservoir_size<<" Waveforms per ID and Pileup Category";
+  DANCE_Success("Waveform Reservoir",wmsg.str());
+  return 0;
+}
+
+//Algorithm R: the nth waveform replaces a random slot with probability size/n
+void Add_Waveform_Sample(uint16_t ID, int category, const uint16_t *waveform, int Ns, uint16_t Ifast, uint16_t Islow, double wf_integral) {
+
+  Waveform_Reservoir_t &reservoir = reservoirs[ID][category];
+
+  uint64_t nseen = reservoir.seen.fetch_add(1, memory_order_relaxed) + 1;
+  uint64_t slot = nseen - 1;
+  if(nseen > (uint64_t)waveform_reservoir_size) {
+    slot = Reservoir_Random() % nseen;
+    if(slot >= (uint64_t)waveform_reservoir_size) {
+      return;
+    }
+  }
+
+  if(Ns > Waveform_Reservoir_Samples) {
+    Ns = Waveform_Reservoir_Samples;
+  }
+
+  lock_guard<mutex> lock(reservoir.slot_mutex);
+  if(reservoir.slots.empty()) {
+    reservoir.slots.resize(waveform_reservoir_size);
+    for(int eye=0; eye<waveform_reservoir_size; eye++) {
+      reservoir.slots[eye].Ns = 0;
+    }
+  }
+  Waveform_Sample_t &sample = reservoir.slots[slot];
+  sample.Ns = Ns;
+  sample.Ifast = Ifast;
+  sample.Islow = Islow;
+  sample.wf_integral = wf_integral;
+  sample.samples.assign(waveform, waveform + Ns);
+}
+
+//Fills hist with every sampled waveform of the ID (x is the sample, y the amplitude)
+static void Fill_Waveform_Histogram(TH2S *hist, int ID) {
+  for(int jay=0; jay<Waveform_Categories; jay++) {
+    const vector<Waveform_Sample_t> &slots = reservoirs[ID][jay].slots;
+    for(size_t kay=0; kay<slots.size(); kay++) {
+      for(int ell=0; ell<slots[kay].Ns; ell++) {
+	hist->Fill(ell,slots[kay].samples[ell]);
+      }
+    }
+  }
+}
+
+//The waveform histograms of the unpacker are made from the reservoirs here, after unpacking
+int Write_Waveform_Reservoir(TFile *fout) {
+
+  if(waveform_reservoir_size <= 0) {
+    return 0;
+  }
+
+  DANCE_Info("Waveform Reservoir","Writing Sampled Waveform Histograms");
+  fout->cd();
+
+  //How many waveforms each reservoir saw and kept (the sampled histograms scale by seen/kept)
+  TH2D *hSeen = new TH2D("Sampled_Waveform_Seen","Waveforms Seen vs Category vs ID",256,0,256,Waveform_Categories,0,Waveform_Categories);
+  TH2D *hKept = new TH2D("Sampled_Waveform_Kept","Waveforms Kept vs Category vs ID",256,0,256,Waveform_Categories,0,Waveform_Categories);
+  for(int eye=0; eye<256; eye++) {
+    for(int jay=0; jay<Waveform_Categories; jay++) {
+      uint64_t nkept = 0;
+      for(size_t kay=0; kay<reservoirs[eye][jay].slots.size(); kay++) {
+	if(reservoirs[eye][jay].slots[kay].Ns > 0) {
+	  nkept++;
+	}
+      }
+      hSeen->SetBinContent(eye+1,jay+1,(double)reservoirs[eye][jay].seen);
+      hKept->SetBinContent(eye+1,jay+1,(double)nkept);
+    }
+  }
+  hSeen->Write();
+  hKept->Write();
+  delete hSeen;
+  delete hKept;
+
+  //Crystal waveforms by category, one at a time to keep the memory down
+  for(int jay=0; jay<Waveform_Categories; jay++) {
+    TH3S *hWaveform = new TH3S(Form("Sampled_Waveform_ID_%s",category_names[jay]),Form("Sampled_Waveform_ID_%s",category_names[jay]),40,0,40,2000,0,20000,162,0,162);
+    for(int eye=0; eye<162; eye++) {
+      const vector<Waveform_Sample_t> &slots = reservoirs[eye][jay].slots;
+      for(size_t kay=0; kay<slots.size(); kay++) {
+	for(int ell=0; ell<slots[kay].Ns; ell++) {
+	  hWaveform->Fill(ell,slots[kay].samples[ell],eye);
+	}
+      }
+    }
+    hWaveform->Write();
+    delete hWaveform;
+  }
+
+  //Crystal waveform integrals
+  TH2F *hID_vs_WFRatio = new TH2F("Sampled_WFRatio_ID","Sampled_WFRatio_ID",1000,-0.2,0.8,162,0,162);
+  TH3F *hID_vs_WFInt_vs_Islow = new TH3F("Sampled_WFInt_Islow_ID","Sampled_WFInt_Islow_ID",500,-1000,4000,2000,0,40000,162,0,162);
+  TH3F *hID_vs_WFRatio_vs_Islow = new TH3F("Sampled_WFRatio_Islow_ID","Sampled_WFRatio_Islow_ID",500,-0.2,0.8,2000,0,40000,162,0,162);
+  for(int eye=0; eye<162; eye++) {
+    for(int jay=0; jay<Waveform_Categories; jay++) {
+      const vector<Waveform_Sample_t> &slots = reservoirs[eye][jay].slots;
+      for(size_t kay=0; kay<slots.size(); kay++) {
+	if(slots[kay].Ns == 0) {
+	  continue;
+	}
+	double ratio = slots[kay].wf_integral/(1.0*slots[kay].Islow);
+	hID_vs_WFRatio->Fill(ratio,eye);
+	hID_vs_WFInt_vs_Islow->Fill(slots[kay].wf_integral,slots[kay].Islow,eye);
+	hID_vs_WFRatio_vs_Islow->Fill(ratio,slots[kay].Islow,eye);
+      }
+    }
+  }
+  hID_vs_WFRatio->Write();
+  hID_vs_WFInt_vs_Islow->Write();
+  hID_vs_WFRatio_vs_Islow->Write();
+  delete hID_vs_WFRatio;
+  delete hID_vs_WFInt_vs_Islow;
+  delete hID_vs_WFRatio_vs_Islow;
+
+  //Beam monitors and T0
+  const int monitor_IDs[5] = {T0_ID, Li6_ID, U235_ID, Bkg_ID, He3_ID};
+  const char *monitor_names[5] = {"T0", "Li6", "U235", "Bkg", "He3"};
+  for(int eye=0; eye<5; eye++) {
+    int nbins = (monitor_IDs[eye] == T0_ID) ? 200 : 600;
+    TH2S *hMonitor = new TH2S(Form("Sampled_%s_Waveform",monitor_names[eye]),Form("Sampled_%s_Waveform",monitor_names[eye]),nbins,0,nbins,2000,0,20000);
+    Fill_Waveform_Histogram(hMonitor, monitor_IDs[eye]);
+    hMonitor->Write();
+    delete hMonitor;
+  }
+
+  //Example crystal waveforms with the same cut as the Histogram_Waveforms ones
+  int nexamples = 0;
+  for(int eye=0; eye<162 && nexamples<20; eye++) {
+    const vector<Waveform_Sample_t> &slots = reservoirs[eye][Waveform_Good].slots;
+    for(size_t kay=0; kay<slots.size() && nexamples<20; kay++) {
+      if(slots[kay].Ns == 0 || slots[kay].Islow <= 5000 || slots[kay].Ifast <= 500 || slots[kay].Ifast >= 1000) {
+	continue;
+      }
+      TH1S *hExample = new TH1S(Form("Sampled_Waveform%d",nexamples),Form("Sampled_Waveform%d_ID%d",nexamples,eye),80,0,80);
+      for(int ell=0; ell<slots[kay].Ns; ell++) {
+	hExample->Fill(ell,slots[kay].samples[ell]);
+      }
+      hExample->Write();
+      delete hExample;
+      nexamples++;
+    }
+  }
+
+  DANCE_Success("Waveform Reservoir","Wrote Sampled Waveform Histograms");
+  return 0;
+}
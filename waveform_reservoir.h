@@ -0,0 +1,95 @@
+
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//   Software Name: DANCE Data Acquisition and Analysis Package       //
+//     Subpackage: DANCE_Analysis                                     //
+//   Identifying Number: C18105                                       // 
+//                                                                    //
+////////////////////////////////////////////////////////////////////////
+//                                                                    //
+//                                                                    //
+// Copyright 2019.                                                    //
+// Triad National Security, LLC. All rights reserved.                 //
+//                                                                    //
+//                                                                    //
+//                                                                    //
+// This program was produced under U.S. Government contract           //
+// 89233218CNA000001 for Los Alamos National Laboratory               //
+// (LANL), which is operated by Triad National Security, LLC          //
+// for the U.S. Department of Energy/National Nuclear Security        //
+// Administration. All rights in the program are reserved by          //
+// Triad National Security, LLC, and the U.S. Department of           //
+// Energy/National Nuclear Security Administration. The Government    //
+// is granted for itself and others acting on its behalf a            //
+// nonexclusive, paid-up, irrevocable worldwide license in this       //
+// material to reproduce, prepare derivative works, distribute        //
+// copies to the public, perform publicly and display publicly,       //
+// and to permit others to do so.                                     //
+//                                                                    //
+// This is open source software; you can redistribute it and/or       //
+// modify it under the terms of the GPLv2 License. If software        //
+// is modified to produce derivative works, such modified             //
+// software should be clearly marked, so as not to confuse it         //
+// with the version available from LANL. Full text of the GPLv2       //
+// License can be found in the License file of the repository         //
+// (GPLv2.0_License.txt).                                             //
+//                                                                    //
+//***************************//
+//*  waveform_reservoir.h   *// 
+//*  Last Edit: 10/19/26    *//  
+//***************************//
+
+#ifndef WAVEFORM_RESERVOIR_H
+#define WAVEFORM_RESERVOIR_H
+
+//C/C++ includes
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+//ROOT includes
+#include "TFile.h"
+
+//File includes
+#include "structures.h"
+
+//Pileup categories of the sampled waveforms
+#define Waveform_Good 0              //WFRatio inside the pileup cut (or not calculated)
+#define Waveform_Pileup 1            //WFRatio outside the pileup cut
+#define Waveform_Negative 2          //Negative waveform integral
+#define Waveform_Categories 3
+
+//One waveform kept in a reservoir
+struct Waveform_Sample_t {
+  uint16_t Ns;                       //Samples kept (0 for an empty slot)
+  uint16_t Ifast;
+  uint16_t Islow;
+  float wf_integral;
+  std::vector<uint16_t> samples;
+};
+
+//Uniform sample of up to Waveform_Reservoir_Size waveforms of one ID and category (reservoir sampling).
+//Every waveform is counted but only those that take a slot are copied, which gets rarer as the run goes on
+struct Waveform_Reservoir_t {
+  std::atomic<uint64_t> seen;        //Waveforms offered
+  std::mutex slot_mutex;             //Taken only to copy a waveform into a slot
+  std::vector<Waveform_Sample_t> slots;
+};
+
+//Waveforms kept per ID and category, 0 is off (Waveform_Reservoir_Size in the cfg file)
+extern int waveform_reservoir_size;
+
+//Function prototypes
+int Initialize_Waveform_Reservoir(Input_Parameters input_params);
+void Add_Waveform_Sample(uint16_t ID, int category, const uint16_t *waveform, int Ns, uint16_t Ifast, uint16_t Islow, double wf_integral);
+int Write_Waveform_Reservoir(TFile *fout);
+
+//Called for every unpacked waveform.  Does nothing unless the reservoirs are on
+static inline void Sample_Waveform(uint16_t ID, int category, const uint16_t *waveform, int Ns, uint16_t Ifast, uint16_t Islow, double wf_integral) {
+  if(waveform_reservoir_size > 0 && ID < 256) {
+    Add_Waveform_Sample(ID, category, waveform, Ns, Ifast, Islow, wf_integral);
+  }
+}
+
+#endif